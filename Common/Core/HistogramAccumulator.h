@@ -0,0 +1,106 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   HistogramAccumulator.h
+/// \brief  Helpers to count histogram entries in dense local arrays and merge them into the ROOT histograms in bulk
+///
+
+#ifndef COMMON_CORE_HISTOGRAMACCUMULATOR_H_
+#define COMMON_CORE_HISTOGRAMACCUMULATOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <TAxis.h>
+
+namespace o2::analysis
+{
+
+/// \brief Bin finder for one histogram axis, without TAxis lookups for fixed-width axes
+///
+/// The bins are the ones of TAxis::FindFixBin, including under- (0) and overflow (nBins + 1):
+/// the arithmetic is the same, in double, so that values on the bin edges land in the same bins as in ROOT.
+/// NaN goes to the overflow, as in ROOT.
+struct AxisBinning {
+  const TAxis* axis = nullptr;
+  int nBins = 0;
+  double min = 0.;
+  double max = 0.;
+  bool fixedWidth = true;
+
+  void set(const TAxis* a)
+  {
+    axis = a;
+    nBins = a->GetNbins();
+    min = a->GetXmin();
+    max = a->GetXmax();
+    fixedWidth = !a->IsVariableBinSize();
+  }
+
+  /// \return bin number including under- (0) and overflow (nBins + 1)
+  int find(double x) const
+  {
+    if (!fixedWidth) {
+      return axis->FindFixBin(x);
+    }
+    if (x < min) {
+      return 0;
+    }
+    if (!(x < max)) {
+      return nBins + 1;
+    }
+    return 1 + static_cast<int>(nBins * (x - min) / (max - min));
+  }
+};
+
+/// \brief Dense counts of histogram cells, with the list of the cells touched since the last flush
+///
+/// The meaning of the cell index is up to the caller, e.g. global bin of a histogram plus an offset per histogram.
+/// flush() visits only the touched cells, so that its cost does not depend on the size of the histograms.
+class DenseCounts
+{
+ public:
+  /// Sets the number of cells and resets all the counts
+  void resize(size_t nCells)
+  {
+    mCounts.assign(nCells, 0);
+    mTouched.clear();
+  }
+  size_t size() const { return mCounts.size(); }
+
+  void add(uint32_t cell)
+  {
+    if (mCounts[cell]++ == 0) {
+      mTouched.push_back(cell);
+    }
+  }
+
+  /// Calls merge(cell, count) for all the cells with non-zero counts and resets them
+  template <typename F>
+  void flush(F&& merge)
+  {
+    for (const auto cell : mTouched) {
+      const uint32_t count = mCounts[cell];
+      mCounts[cell] = 0;
+      merge(cell, count);
+    }
+    mTouched.clear();
+  }
+
+ private:
+  std::vector<uint32_t> mCounts;
+  std::vector<uint32_t> mTouched;
+};
+
+} // namespace o2::analysis
+
+#endif // COMMON_CORE_HISTOGRAMACCUMULATOR_H_
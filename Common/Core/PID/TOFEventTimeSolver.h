@@ -0,0 +1,185 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   TOFEventTimeSolver.h
+/// \brief  Per-collision TOF event time with a pruned search of the mass hypotheses and leave-one-out by downdate
+///
+
+#ifndef COMMON_CORE_PID_TOFEVENTTIMESOLVER_H_
+#define COMMON_CORE_PID_TOFEVENTTIMESOLVER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+// O2 includes
+#include "ReconstructionDataFormats/PID.h"
+
+// O2Physics includes
+#include "Common/Core/PID/PIDTOF.h"
+
+namespace o2::pid::tof
+{
+
+/// \brief TOF event time of one collision from the tracks matched to TOF
+///
+/// Each track gives an estimate t0 = tofSignal - texp of the event time for the pion, kaon and proton hypotheses,
+/// with weight 1 / sigma^2. The event time is the weighted mean of the estimates for the set of hypotheses with the
+/// smallest chi2, together with the collision diamond as prior (t0 = 0 with the diamond resolution).
+/// The hypotheses are searched best-first: the tracks are added from the most to the least precise one and only the
+/// maxCombinations partial sets of hypotheses with the smallest chi2 are kept at each step. The search is exhaustive
+/// as long as 3^n <= maxCombinations, and its cost is linear in the number of tracks above.
+/// The weighted sums of the best set are kept, so that the event time without the contribution of a track is obtained
+/// by removing its term from the sums. The interface follows o2::tof::eventTimeContainer.
+class EventTimeSolver
+{
+ public:
+  static constexpr int nHypotheses = 3;
+
+  float mEventTime = 0.f;         /// Event time with all the tracks
+  float mEventTimeError = 0.f;    /// Error of the event time with all the tracks
+  int mEventTimeMultiplicity = 0; /// Number of tracks used for the event time
+
+  void setMaxCombinations(int maxCombinations) { mMaxCombinations = std::max(maxCombinations, nHypotheses); }
+  /// \param diamond is the size of the collision diamond along z in cm
+  void setDiamond(float diamond)
+  {
+    const float errDiamond = diamond * 33.356409f;
+    mWeightDiamond = 1.f / (errDiamond * errDiamond);
+  }
+
+  /// Computes the event time from the tracks of a collision
+  template <typename TrackType, bool (*trackFilter)(const TrackType&), typename TrackContainer>
+  void solve(const TrackContainer& tracks, const TOFResoParamsV2& parameters)
+  {
+    mT0.clear();
+    mWeight.clear();
+    for (auto const& track : tracks) {
+      if (!trackFilter(track)) {
+        continue;
+      }
+      addTrack<TrackType, o2::track::PID::Pion>(track, parameters);
+      addTrack<TrackType, o2::track::PID::Kaon>(track, parameters);
+      addTrack<TrackType, o2::track::PID::Proton>(track, parameters);
+    }
+    search();
+  }
+
+  /// Gives the event time without the contribution of the track. Tracks must be passed in the same order as to solve().
+  /// \param nTrackIndex is the index of the track among those used, incremented if the track is used
+  /// \param minimumMultiplicity is the minimum number of tracks left for the event time, otherwise only the diamond is used
+  template <typename TrackType, bool (*trackFilter)(const TrackType&)>
+  void removeBias(const TrackType& track, int& nTrackIndex, float& eventTimeValue, float& eventTimeError, const int& minimumMultiplicity = 2) const
+  {
+    eventTimeValue = mEventTime;
+    eventTimeError = mEventTimeError;
+    if (!trackFilter(track)) {
+      return;
+    }
+    const int iTrack = nTrackIndex++;
+    if (mEventTimeMultiplicity - 1 < minimumMultiplicity) {
+      eventTimeValue = 0.f;
+      eventTimeError = 1.f / std::sqrt(mWeightDiamond);
+      return;
+    }
+    const double sumOfWeights = mSumOfWeights - mBestWeight[iTrack];
+    eventTimeValue = (mSumOfWeightedT0 - mBestWeight[iTrack] * mBestT0[iTrack]) / sumOfWeights;
+    eventTimeError = 1. / std::sqrt(sumOfWeights);
+  }
+
+ private:
+  /// Partial set of hypotheses in the search
+  struct Node {
+    double sumOfWeights;
+    double sumOfWeightedT0;
+    double sumOfWeightedT02;
+    int parent;
+    int hypothesis;
+    double chi2() const { return sumOfWeightedT02 - sumOfWeightedT0 * sumOfWeightedT0 / sumOfWeights; }
+  };
+
+  template <typename TrackType, o2::track::PID::ID id>
+  void addTrack(const TrackType& track, const TOFResoParamsV2& parameters)
+  {
+    using Response = ExpTimes<TrackType, id>;
+    const float sigma = Response::GetExpectedSigma(parameters, track, track.tofSignal(), 0.f);
+    mT0.push_back(track.tofSignal() - Response::GetCorrectedExpectedSignal(parameters, track));
+    mWeight.push_back(sigma > 0.f ? 1.f / (sigma * sigma) : 0.f);
+  }
+
+  void search()
+  {
+    const int nTracks = mT0.size() / nHypotheses;
+    mEventTimeMultiplicity = nTracks;
+    mBestT0.resize(nTracks);
+    mBestWeight.resize(nTracks);
+
+    // most precise tracks first, so that the pruning keeps the well-constrained sets
+    mOrder.resize(nTracks);
+    std::iota(mOrder.begin(), mOrder.end(), 0);
+    std::sort(mOrder.begin(), mOrder.end(), [this](int a, int b) { return mWeight[a * nHypotheses] > mWeight[b * nHypotheses]; });
+
+    mNodes.clear();
+    mNodes.push_back({mWeightDiamond, 0., 0., -1, -1});
+    int first = 0, last = 1; // nodes of the current step
+    for (int iStep = 0; iStep < nTracks; iStep++) {
+      const int iTrack = mOrder[iStep];
+      for (int iNode = first; iNode < last; iNode++) {
+        const Node node = mNodes[iNode]; // copy, the nodes are reallocated while growing
+        for (int iHyp = 0; iHyp < nHypotheses; iHyp++) {
+          const double w = mWeight[iTrack * nHypotheses + iHyp];
+          const double t0 = mT0[iTrack * nHypotheses + iHyp];
+          mNodes.push_back({node.sumOfWeights + w, node.sumOfWeightedT0 + w * t0, node.sumOfWeightedT02 + w * t0 * t0, iNode, iHyp});
+        }
+      }
+      first = last;
+      last = mNodes.size();
+      if (last - first > mMaxCombinations) {
+        std::nth_element(mNodes.begin() + first, mNodes.begin() + first + mMaxCombinations, mNodes.end(), [](const Node& a, const Node& b) { return a.chi2() < b.chi2(); });
+        last = first + mMaxCombinations;
+        mNodes.resize(last);
+      }
+    }
+
+    int best = first;
+    for (int iNode = first + 1; iNode < last; iNode++) {
+      if (mNodes[iNode].chi2() < mNodes[best].chi2()) {
+        best = iNode;
+      }
+    }
+    mSumOfWeights = mNodes[best].sumOfWeights;
+    mSumOfWeightedT0 = mNodes[best].sumOfWeightedT0;
+    mEventTime = mSumOfWeightedT0 / mSumOfWeights;
+    mEventTimeError = 1. / std::sqrt(mSumOfWeights);
+    for (int iStep = nTracks - 1, iNode = best; iStep >= 0; iStep--, iNode = mNodes[iNode].parent) {
+      const int iTrack = mOrder[iStep];
+      mBestT0[iTrack] = mT0[iTrack * nHypotheses + mNodes[iNode].hypothesis];
+      mBestWeight[iTrack] = mWeight[iTrack * nHypotheses + mNodes[iNode].hypothesis];
+    }
+  }
+
+  int mMaxCombinations = 243;
+  float mWeightDiamond = 1.f;
+  double mSumOfWeights = 0.;
+  double mSumOfWeightedT0 = 0.;
+  std::vector<float> mT0;         /// event time estimates of the tracks, for the pion, kaon and proton hypotheses
+  std::vector<float> mWeight;     /// weights of the event time estimates
+  std::vector<float> mBestT0;     /// event time estimate of each track for the best set of hypotheses
+  std::vector<float> mBestWeight; /// weight of each track for the best set of hypotheses
+  std::vector<int> mOrder;
+  std::vector<Node> mNodes;
+};
+
+} // namespace o2::pid::tof
+
+#endif // COMMON_CORE_PID_TOFEVENTTIMESOLVER_H_
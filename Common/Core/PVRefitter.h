@@ -0,0 +1,345 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/// \file PVRefitter.h
+/// \brief Refit of primary vertices with some of their contributors removed
+///
+/// The track parameters of the PV contributors are grouped once per DF into contiguous per-collision spans. Two refits
+/// are offered on top of them:
+/// - refit(): full refit with PVertexer, using one vertexer per thread which is initialised again only when the
+///   magnetic field changes;
+/// - refitWithout(): linearised fit, where removing k tracks downdates the normal equations of the fit with all the
+///   contributors. Each refit then costs O(k) instead of a fit over all the contributors, which makes leave-one-out
+///   studies O(N) per collision instead of O(N^2).
+
+#ifndef COMMON_CORE_PVREFITTER_H_
+#define COMMON_CORE_PVREFITTER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Math/SMatrix.h"
+
+#include "CommonUtils/ConfigurableParam.h"
+#include "DetectorsBase/Propagator.h"
+#include "DetectorsVertexing/PVertexer.h"
+#include "MathUtils/Utils.h"
+#include "ReconstructionDataFormats/PrimaryVertex.h"
+#include "ReconstructionDataFormats/Track.h"
+#include "ReconstructionDataFormats/Vertex.h"
+
+#include "Common/Core/trackUtilities.h"
+
+namespace o2::analysis
+{
+
+class PVRefitter
+{
+ public:
+  /// Normal equations of the linearised vertex fit, A * v = b, and constant term c of the chi2 = c - 2 v.b + v.A.v
+  /// The track model is the one of PVertexer: straight lines in the tracking frame, at the DCA to the seed vertex.
+  struct NormalEquations {
+    double a[6] = {0., 0., 0., 0., 0., 0.}; ///< symmetric A, packed as XX, XY, YY, XZ, YZ, ZZ
+    double b[3] = {0., 0., 0.};
+    double c = 0.;
+    int nTracks = 0;
+
+    NormalEquations& operator+=(const NormalEquations& other)
+    {
+      for (int i = 0; i < 6; i++) {
+        a[i] += other.a[i];
+      }
+      for (int i = 0; i < 3; i++) {
+        b[i] += other.b[i];
+      }
+      c += other.c;
+      nTracks += other.nTracks;
+      return *this;
+    }
+
+    NormalEquations& operator-=(const NormalEquations& other)
+    {
+      for (int i = 0; i < 6; i++) {
+        a[i] -= other.a[i];
+      }
+      for (int i = 0; i < 3; i++) {
+        b[i] -= other.b[i];
+      }
+      c -= other.c;
+      nTracks -= other.nTracks;
+      return *this;
+    }
+
+    /// Solves the normal equations
+    /// \return false if less than 2 tracks are left or if the system is singular
+    bool solve(o2::dataformats::PrimaryVertex& vertex) const
+    {
+      if (nTracks < 2) {
+        return false;
+      }
+      ROOT::Math::SMatrix<double, 3, 3, ROOT::Math::MatRepSym<double, 3>> cov;
+      cov(0, 0) = a[0];
+      cov(0, 1) = a[1];
+      cov(1, 1) = a[2];
+      cov(0, 2) = a[3];
+      cov(1, 2) = a[4];
+      cov(2, 2) = a[5];
+      if (!cov.Invert()) {
+        return false;
+      }
+      ROOT::Math::SVector<double, 3> rhs(b, 3);
+      ROOT::Math::SVector<double, 3> pos = cov * rhs;
+      vertex.setXYZ(pos[0], pos[1], pos[2]);
+      vertex.setCov(cov(0, 0), cov(0, 1), cov(1, 1), cov(0, 2), cov(1, 2), cov(2, 2));
+      vertex.setChi2(c - ROOT::Math::Dot(pos, rhs));
+      vertex.setNContributors(nTracks);
+      return true;
+    }
+  };
+
+  /// Applied to the shared vertexers when they are initialised, i.e. before the first refit() of each thread and
+  /// after each change of the magnetic field
+  void setRemoveMeanVertexConstraint(bool remove) { mRemoveMeanVertexConstraint = remove; }
+  void setMatCorrType(o2::base::Propagator::MatCorrType matCorr) { mMatCorr = matCorr; }
+
+  /// Groups the contributors of all the collisions of a DF, with a counting sort over the collision index
+  /// \param collisions are the collisions of the DF, the collision index of the tracks is their row
+  /// \param tracks are the tracks of the DF, with covariance
+  /// \param isContributor selects the tracks used in the fit, e.g. [](auto& track) { return track.isPVContributor(); }
+  template <typename TCollisions, typename TTracks, typename TSelector>
+  void build(TCollisions const& collisions, TTracks const& tracks, TSelector&& isContributor)
+  {
+    const int nCollisions = collisions.size();
+    reset(nCollisions);
+    for (const auto& collision : collisions) {
+      mVertices[collision.globalIndex()] = makeVertexSeed(collision);
+    }
+    for (const auto& track : tracks) {
+      const auto collisionId = track.collisionId();
+      if (collisionId >= 0 && collisionId < nCollisions && isContributor(track)) {
+        mOffsets[collisionId + 1]++;
+      }
+    }
+    for (int iCollision = 0; iCollision < nCollisions; iCollision++) {
+      mOffsets[iCollision + 1] += mOffsets[iCollision];
+    }
+    mTrackIds.resize(mOffsets[nCollisions]);
+    mTracks.resize(mOffsets[nCollisions]);
+    std::vector<int> fill(mOffsets.begin(), mOffsets.end() - 1);
+    for (const auto& track : tracks) {
+      const auto collisionId = track.collisionId();
+      if (collisionId >= 0 && collisionId < nCollisions && isContributor(track)) {
+        const int pos = fill[collisionId]++;
+        mTrackIds[pos] = track.globalIndex();
+        mTracks[pos] = getTrackParCov(track);
+      }
+    }
+  }
+
+  /// Same as build(), for one collision and its tracks; the collision is then accessed with index 0
+  template <typename TCollision, typename TTracks, typename TSelector>
+  void buildSingle(TCollision const& collision, TTracks const& tracks, TSelector&& isContributor)
+  {
+    reset(1);
+    mVertices[0] = makeVertexSeed(collision);
+    for (const auto& track : tracks) {
+      if (isContributor(track)) {
+        mTrackIds.push_back(track.globalIndex());
+        mTracks.push_back(getTrackParCov(track));
+      }
+    }
+    mOffsets[1] = mTracks.size();
+  }
+
+  int nContributors(int iCollision) const { return mOffsets[iCollision + 1] - mOffsets[iCollision]; }
+  std::span<const o2::track::TrackParCov> tracks(int iCollision) const { return {mTracks.data() + mOffsets[iCollision], static_cast<size_t>(nContributors(iCollision))}; }
+  std::span<const int64_t> trackIds(int iCollision) const { return {mTrackIds.data() + mOffsets[iCollision], static_cast<size_t>(nContributors(iCollision))}; }
+  const o2::dataformats::VertexBase& vertexSeed(int iCollision) const { return mVertices[iCollision]; }
+
+  /// \return position of the track in the contributors of the collision, -1 if it is not a contributor
+  int findContributor(int iCollision, int64_t trackId) const
+  {
+    const auto ids = trackIds(iCollision);
+    const auto it = std::lower_bound(ids.begin(), ids.end(), trackId); // tracks are grouped in table order
+    return (it != ids.end() && *it == trackId) ? static_cast<int>(it - ids.begin()) : -1;
+  }
+
+  /// Prepares the vertexer of the thread for the refits of a collision. It is done only once per collision.
+  /// The vertexer takes the field of the propagator when it is initialised, so it is initialised again when the
+  /// field changes, e.g. after initFieldFromGRP() for a new run.
+  /// \return false if not enough contributors are accepted by the vertexer
+  bool prepare(int iCollision)
+  {
+    auto& shared = sharedVertexer();
+    const float bz = o2::base::Propagator::Instance()->getNominalBz();
+    if (!shared.initialised || shared.bz != bz) {
+      if (mRemoveMeanVertexConstraint) {
+        o2::conf::ConfigurableParam::updateFromString("pvertexer.useMeanVertexConstraint=false");
+      }
+      shared.vertexer.init();
+      shared.initialised = true;
+      shared.bz = bz;
+      shared.owner = nullptr; // the prepared refit, if any, used the previous field
+    }
+    if (shared.owner != this || shared.generation != mGeneration || shared.collision != iCollision) {
+      shared.owner = this;
+      shared.generation = mGeneration;
+      shared.collision = iCollision;
+      shared.doable = shared.vertexer.prepareVertexRefit(tracks(iCollision), mVertices[iCollision]);
+    }
+    return shared.doable;
+  }
+
+  /// Full refit with PVertexer of the collision with the contributors flagged by useTrack
+  /// \return refitted vertex, with chi2 -1 if the refit is not doable
+  o2::dataformats::PrimaryVertex refit(int iCollision, const std::vector<bool>& useTrack)
+  {
+    if (!prepare(iCollision)) {
+      o2::dataformats::PrimaryVertex vertex;
+      vertex.setChi2(-1.f);
+      return vertex;
+    }
+    return sharedVertexer().vertexer.refitVertex(useTrack, mVertices[iCollision]);
+  }
+
+  /// Linearised fit of the collision without the contributors at the given positions
+  /// \return refitted vertex, with chi2 -1 if the fit fails
+  o2::dataformats::PrimaryVertex refitWithout(int iCollision, std::span<const int> removed)
+  {
+    o2::dataformats::PrimaryVertex vertex;
+    auto equations = fullFit(iCollision);
+    const int first = mOffsets[iCollision];
+    for (const auto pos : removed) {
+      equations -= mTerms[first + pos];
+    }
+    if (!equations.solve(vertex)) {
+      vertex = o2::dataformats::PrimaryVertex{};
+      vertex.setChi2(-1.f);
+    }
+    return vertex;
+  }
+
+  o2::dataformats::PrimaryVertex refitWithout(int iCollision, int removed) { return refitWithout(iCollision, std::span<const int>(&removed, 1)); }
+
+  /// Normal equations of the linearised fit with all the contributors, built once per collision
+  const NormalEquations& fullFit(int iCollision)
+  {
+    if (!mLinearised[iCollision]) {
+      linearise(iCollision);
+    }
+    return mFullFits[iCollision];
+  }
+
+ private:
+  struct SharedVertexer {
+    o2::vertexing::PVertexer vertexer;
+    bool initialised = false;
+    float bz = 0.f; ///< field of the propagator when the vertexer was initialised
+    const PVRefitter* owner = nullptr;
+    uint64_t generation = 0;
+    int collision = -1;
+    bool doable = false;
+  };
+
+  static SharedVertexer& sharedVertexer()
+  {
+    thread_local SharedVertexer shared;
+    return shared;
+  }
+
+  template <typename TCollision>
+  static o2::dataformats::VertexBase makeVertexSeed(TCollision const& collision)
+  {
+    o2::dataformats::VertexBase vertex;
+    vertex.setXYZ(collision.posX(), collision.posY(), collision.posZ());
+    vertex.setCov(collision.covXX(), collision.covXY(), collision.covYY(), collision.covXZ(), collision.covYZ(), collision.covZZ());
+    return vertex;
+  }
+
+  void reset(int nCollisions)
+  {
+    mGeneration++;
+    mOffsets.assign(nCollisions + 1, 0);
+    mVertices.assign(nCollisions, {});
+    mTrackIds.clear();
+    mTracks.clear();
+    mTerms.clear();
+    mFullFits.assign(nCollisions, {});
+    mLinearised.assign(nCollisions, false);
+  }
+
+  /// Contributions of the tracks of a collision to the normal equations, with the residuals (dy, dz) of each track
+  /// to the vertex v linear in v: dy = y - tgP * x + (tgP * cosA + sinA) * vx + (tgP * sinA - cosA) * vy,
+  /// dz = z - tgL * x + tgL * cosA * vx + tgL * sinA * vy - vz
+  void linearise(int iCollision)
+  {
+    mTerms.resize(mTracks.size());
+    const auto& seed = mVertices[iCollision];
+    auto& full = mFullFits[iCollision];
+    for (int i = mOffsets[iCollision]; i < mOffsets[iCollision + 1]; i++) {
+      auto& term = mTerms[i];
+      term = NormalEquations{};
+      auto trc = mTracks[i];
+      if (!o2::base::Propagator::Instance()->propagateToDCABxByBz({seed.getX(), seed.getY(), seed.getZ()}, trc, 2.f, mMatCorr)) {
+        continue;
+      }
+      const double det = static_cast<double>(trc.getSigmaY2()) * trc.getSigmaZ2() - static_cast<double>(trc.getSigmaZY()) * trc.getSigmaZY();
+      if (det <= 0.) {
+        continue;
+      }
+      const double wYY = trc.getSigmaZ2() / det, wZZ = trc.getSigmaY2() / det, wYZ = -trc.getSigmaZY() / det;
+      float sinA, cosA;
+      o2::math_utils::sincos(trc.getAlpha(), sinA, cosA);
+      const double snp = trc.getSnp();
+      const double tgP = snp / std::sqrt((1. - snp) * (1. + snp));
+      const double tgL = trc.getTgl();
+      const double jY[3] = {tgP * cosA + sinA, tgP * sinA - cosA, 0.};
+      const double jZ[3] = {tgL * cosA, tgL * sinA, -1.};
+      const double rY = trc.getY() - tgP * trc.getX();
+      const double rZ = trc.getZ() - tgL * trc.getX();
+      double wjY[3], wjZ[3];
+      for (int k = 0; k < 3; k++) {
+        wjY[k] = wYY * jY[k] + wYZ * jZ[k];
+        wjZ[k] = wYZ * jY[k] + wZZ * jZ[k];
+      }
+      int iPacked = 0;
+      for (int k = 0; k < 3; k++) {
+        for (int l = 0; l <= k; l++) {
+          term.a[iPacked++] = jY[k] * wjY[l] + jZ[k] * wjZ[l];
+        }
+        term.b[k] = -(wjY[k] * rY + wjZ[k] * rZ);
+      }
+      term.c = rY * (wYY * rY + wYZ * rZ) + rZ * (wYZ * rY + wZZ * rZ);
+      term.nTracks = 1;
+      full += term;
+    }
+    mLinearised[iCollision] = true;
+  }
+
+  bool mRemoveMeanVertexConstraint = false;
+  o2::base::Propagator::MatCorrType mMatCorr = o2::base::Propagator::MatCorrType::USEMatCorrLUT;
+  uint64_t mGeneration = 0;
+
+  std::vector<int> mOffsets;                          ///< first contributor of each collision, CSR layout
+  std::vector<int64_t> mTrackIds;                     ///< global index of the contributors
+  std::vector<o2::track::TrackParCov> mTracks;        ///< parameters of the contributors
+  std::vector<o2::dataformats::VertexBase> mVertices; ///< seed vertex of each collision
+  std::vector<NormalEquations> mTerms;                ///< contribution of each contributor to the linearised fit
+  std::vector<NormalEquations> mFullFits;             ///< linearised fit of each collision with all the contributors
+  std::vector<bool> mLinearised;
+};
+
+} // namespace o2::analysis
+
+#endif // COMMON_CORE_PVREFITTER_H_
@@ -180,3 +180,47 @@ void TrackSelection::print() const
     }
   }
 }
+
+int TrackSelectionSet::AddSelection(const TrackSelection& selection)
+{
+  Thresholds t;
+  t.trackType = static_cast<uint8_t>(selection.mTrackType);
+  t.minPt = selection.mMinPt;
+  t.maxPt = selection.mMaxPt;
+  t.minEta = selection.mMinEta;
+  t.maxEta = selection.mMaxEta;
+  t.minNClustersTPC = selection.mMinNClustersTPC;
+  t.minNCrossedRowsTPC = selection.mMinNCrossedRowsTPC;
+  t.minNCrossedRowsOverFindableClustersTPC = selection.mMinNCrossedRowsOverFindableClustersTPC;
+  t.maxChi2PerClusterTPC = selection.mMaxChi2PerClusterTPC;
+  t.requireTPCRefit = selection.mRequireTPCRefit;
+  t.minNClustersITS = selection.mMinNClustersITS;
+  t.maxChi2PerClusterITS = selection.mMaxChi2PerClusterITS;
+  t.requireITSRefit = selection.mRequireITSRefit;
+  t.requireGoldenChi2 = selection.mRequireGoldenChi2;
+  t.maxDcaXY = selection.mMaxDcaXY;
+  t.maxDcaZ = selection.mMaxDcaZ;
+  for (int map = 0; map < 256; map++) {
+    t.itsHits[map] = selection.FulfillsITSHitRequirements(static_cast<uint8_t>(map));
+  }
+  mThresholds.push_back(t);
+
+  DcaXYTable table;
+  if (selection.mMaxDcaXYPtDep) {
+    table.function = selection.mMaxDcaXYPtDep;
+    const int nPoints = static_cast<int>(kDcaXYTablePtMax / kDcaXYTableStep) + 1;
+    table.values.resize(nPoints, 0.f);
+    table.tolerances.resize(nPoints, 0.f);
+    for (int i = 1; i < nPoints; i++) { // pt = 0 is never used, see PassesDcaXY()
+      table.values[i] = table.function(i * kDcaXYTableStep);
+    }
+    // estimate the interpolation error from the middle of each interval, with a safety margin
+    for (int i = 1; i + 1 < nPoints; i++) {
+      float exact = table.function((i + 0.5f) * kDcaXYTableStep);
+      float interpolated = 0.5f * (table.values[i] + table.values[i + 1]);
+      table.tolerances[i] = 2.f * std::abs(exact - interpolated) + 1e-6f;
+    }
+  }
+  mDcaXYTables.push_back(table);
+  return mThresholds.size() - 1;
+}
@@ -16,6 +16,9 @@
 #ifndef COMMON_CORE_TRACKSELECTION_H_
 #define COMMON_CORE_TRACKSELECTION_H_
 
+#include <array>
+#include <cmath>
+#include <functional>
 #include <set>
 #include <vector>
 #include <utility>
@@ -229,6 +232,7 @@ class TrackSelection
   void print() const;
 
  private:
+  friend class TrackSelectionSet;
   bool FulfillsITSHitRequirements(uint8_t itsClusterMap) const;
 
   o2::aod::track::TrackTypeEnum mTrackType{o2::aod::track::TrackTypeEnum::Track};
@@ -259,4 +263,119 @@ class TrackSelection
   ClassDefNV(TrackSelection, 1);
 };
 
+/// Set of track selections evaluated together. The columns of a track are read once, then the masks of all
+/// the selections (same bits as TrackSelection::IsSelectedMask()) are computed in one loop over a table of thresholds.
+/// The ITS hit requirements are precomputed for all the 256 cluster maps and the pt-dependent DCAxy limits are
+/// tabulated; the exact function is only called for tracks close to the tabulated limit.
+class TrackSelectionSet
+{
+ public:
+  static constexpr uint16_t kAllCuts = (1 << static_cast<int>(TrackSelection::TrackCuts::kNCuts)) - 1;
+
+  /// Add a copy of a selection to the set. Later changes of the selection are not seen by the set.
+  /// @return index of the selection in the mask array filled by IsSelectedMask()
+  int AddSelection(const TrackSelection& selection);
+  int GetNSelections() const { return mThresholds.size(); }
+
+  /// @return whether all the cuts of a selection are passed, given its mask
+  static bool IsSelected(uint16_t mask) { return mask == kAllCuts; }
+
+  /// Compute the masks of all the selections for one track, masks must hold GetNSelections() elements
+  template <typename T>
+  void IsSelectedMask(T const& track, uint16_t* masks) const
+  {
+    using TrackCuts = TrackSelection::TrackCuts;
+    const uint8_t trackType = track.trackType();
+    const bool isRun2 = trackType == o2::aod::track::Run2Track || trackType == o2::aod::track::Run2Tracklet;
+    const float pt = track.pt();
+    const float eta = track.eta();
+    const int tpcNCls = track.tpcNClsFound();
+    const int tpcCrossedRows = track.tpcNClsCrossedRows();
+    const float tpcCrossedRowsOverFindable = track.tpcCrossedRowsOverFindableCls();
+    const float tpcChi2 = track.tpcChi2NCl();
+    const uint32_t flags = track.flags();
+    const bool tpcRefit = isRun2 ? (flags & o2::aod::track::TPCrefit) : track.hasTPC();
+    const bool itsRefit = isRun2 ? (flags & o2::aod::track::ITSrefit) : track.hasITS();
+    const bool goldenChi2 = flags & o2::aod::track::GoldenChi2;
+    const int itsNCls = track.itsNCls();
+    const float itsChi2 = track.itsChi2NCl();
+    const uint8_t itsClusterMap = track.itsClusterMap();
+    const float dcaXY = std::abs(track.dcaXY());
+    const float dcaZ = std::abs(track.dcaZ());
+
+    auto bit = [](bool pass, TrackCuts cut) { return static_cast<uint16_t>(pass) << static_cast<int>(cut); };
+    for (size_t i = 0; i < mThresholds.size(); i++) {
+      const auto& t = mThresholds[i];
+      masks[i] = bit(trackType == t.trackType, TrackCuts::kTrackType) |
+                 bit(pt >= t.minPt && pt <= t.maxPt, TrackCuts::kPtRange) |
+                 bit(eta >= t.minEta && eta <= t.maxEta, TrackCuts::kEtaRange) |
+                 bit(tpcNCls >= t.minNClustersTPC, TrackCuts::kTPCNCls) |
+                 bit(tpcCrossedRows >= t.minNCrossedRowsTPC, TrackCuts::kTPCCrossedRows) |
+                 bit(tpcCrossedRowsOverFindable >= t.minNCrossedRowsOverFindableClustersTPC, TrackCuts::kTPCCrossedRowsOverNCls) |
+                 bit(tpcChi2 <= t.maxChi2PerClusterTPC, TrackCuts::kTPCChi2NDF) |
+                 bit(!t.requireTPCRefit || tpcRefit, TrackCuts::kTPCRefit) |
+                 bit(itsNCls >= t.minNClustersITS, TrackCuts::kITSNCls) |
+                 bit(itsChi2 <= t.maxChi2PerClusterITS, TrackCuts::kITSChi2NDF) |
+                 bit(!t.requireITSRefit || itsRefit, TrackCuts::kITSRefit) |
+                 bit(t.itsHits[itsClusterMap], TrackCuts::kITSHits) |
+                 bit(!(isRun2 && t.requireGoldenChi2) || goldenChi2, TrackCuts::kGoldenChi2) |
+                 bit(PassesDcaXY(i, pt, dcaXY), TrackCuts::kDCAxy) |
+                 bit(dcaZ <= t.maxDcaZ, TrackCuts::kDCAz);
+    }
+  }
+
+ private:
+  struct Thresholds {
+    uint8_t trackType;
+    float minPt, maxPt;
+    float minEta, maxEta;
+    int minNClustersTPC;
+    int minNCrossedRowsTPC;
+    float minNCrossedRowsOverFindableClustersTPC;
+    float maxChi2PerClusterTPC;
+    bool requireTPCRefit;
+    int minNClustersITS;
+    float maxChi2PerClusterITS;
+    bool requireITSRefit;
+    bool requireGoldenChi2;
+    float maxDcaXY;
+    float maxDcaZ;
+    std::array<bool, 256> itsHits; // ITS hit requirements, for each cluster map
+  };
+
+  // tabulated pt-dependent DCAxy limit of one selection
+  struct DcaXYTable {
+    std::function<float(float)> function{};
+    std::vector<float> values{};     // limit at pt = i * kDcaXYTableStep
+    std::vector<float> tolerances{}; // maximum deviation of the interpolated limit from the function, per interval
+  };
+  static constexpr float kDcaXYTableStep = 0.005f;
+  static constexpr float kDcaXYTablePtMax = 20.f;
+
+  bool PassesDcaXY(size_t i, float pt, float absDcaXY) const
+  {
+    const auto& table = mDcaXYTables[i];
+    if (!table.function) {
+      return absDcaXY <= mThresholds[i].maxDcaXY;
+    }
+    const float x = pt / kDcaXYTableStep;
+    const int bin = static_cast<int>(x);
+    // the first interval is not tabulated, as the limit usually diverges at pt = 0
+    if (bin < 1 || bin + 1 >= static_cast<int>(table.values.size())) {
+      return absDcaXY <= table.function(pt);
+    }
+    const float limit = table.values[bin] + (x - bin) * (table.values[bin + 1] - table.values[bin]);
+    if (absDcaXY < limit - table.tolerances[bin]) {
+      return true;
+    }
+    if (absDcaXY > limit + table.tolerances[bin]) {
+      return false;
+    }
+    return absDcaXY <= table.function(pt); // close to the limit: use the exact value
+  }
+
+  std::vector<Thresholds> mThresholds{};
+  std::vector<DcaXYTable> mDcaXYTables{};
+};
+
 #endif // COMMON_CORE_TRACKSELECTION_H_
@@ -11,7 +11,12 @@
 
 #include <map>
 #include <list>
+#include <deque>
+#include <vector>
+#include <future>
+#include <tuple>
 #include <fstream>
+#include <cstring>
 #include <getopt.h>
 
 #include "TSystem.h"
@@ -24,9 +29,164 @@
 #include <TGrid.h>
 #include <TMap.h>
 #include <TLeaf.h>
+#include <TROOT.h>
 
 #include "aodMerger.h"
 
+// Index columns of one input file, read ahead by a worker thread in parallel mode
+// Key: <DF folder>/<tree> --> index branch --> values (two per entry for fIndexSlice)
+// Trees with VLA index columns are not prefetched and take the serial path
+struct PrefetchedFile {
+  TFile* file = nullptr;
+  std::map<std::string, std::map<std::string, std::vector<int>>> indexColumns;
+};
+
+PrefetchedFile prefetchFile(TString fileName)
+{
+  PrefetchedFile prefetched;
+  prefetched.file = TFile::Open(fileName);
+  if (!prefetched.file) {
+    return prefetched;
+  }
+  for (auto key1 : *prefetched.file->GetListOfKeys()) {
+    TString dfName(key1->GetName());
+    if (!dfName.BeginsWith("DF_")) {
+      continue;
+    }
+    auto folder = (TDirectoryFile*)prefetched.file->Get(dfName);
+    for (auto key2 : *folder->GetListOfKeys()) {
+      std::string treeKey = Form("%s/%s", dfName.Data(), key2->GetName());
+      if (prefetched.indexColumns.count(treeKey) > 0) {
+        continue; // other cycle of the same tree
+      }
+      auto tree = (TTree*)prefetched.file->Get(treeKey.c_str());
+      if (!tree) {
+        continue;
+      }
+
+      std::vector<std::pair<TBranch*, int>> indexBranches;
+      bool hasVLAIndex = false;
+      TObjArray* branches = tree->GetListOfBranches();
+      for (int i = 0; i < branches->GetEntriesFast(); ++i) {
+        TBranch* br = (TBranch*)branches->UncheckedAt(i);
+        TString branchName(br->GetName());
+        if (!branchName.BeginsWith("fIndex") || branchName.EndsWith("_size")) {
+          continue;
+        }
+        if (((TLeaf*)br->GetListOfLeaves()->First())->GetLeafCount() != nullptr) {
+          hasVLAIndex = true;
+          break;
+        }
+        indexBranches.push_back({br, branchName.BeginsWith("fIndexSlice") ? 2 : 1});
+      }
+
+      if (!hasVLAIndex && indexBranches.size() > 0) {
+        tree->SetCacheSize(10000000);
+        for (auto& [br, width] : indexBranches) {
+          tree->AddBranchToCache(br);
+        }
+        tree->StopCacheLearningPhase();
+
+        auto& columns = prefetched.indexColumns[treeKey];
+        auto entries = tree->GetEntries();
+        int value[2] = {0, 0};
+        for (auto& [br, width] : indexBranches) {
+          auto& column = columns[br->GetName()];
+          column.resize(entries * width);
+          br->SetAddress(value);
+          for (Long64_t i = 0; i < entries; i++) {
+            br->GetEntry(i);
+            for (int j = 0; j < width; j++) {
+              column[i * width + j] = value[j];
+            }
+          }
+          br->ResetAddress();
+        }
+      }
+      delete tree;
+    }
+  }
+  return prefetched;
+}
+
+// Compares all DF folders of two merged files entry by entry, byte by byte per leaf
+// Returns the number of differences found
+int compareOutputs(const char* fileName, const char* referenceFileName, int verbosity)
+{
+  auto file = TFile::Open(fileName);
+  auto referenceFile = TFile::Open(referenceFileName);
+  if (!file || !referenceFile) {
+    printf("ERROR: Could not open %s or %s for comparison\n", fileName, referenceFileName);
+    return 1;
+  }
+
+  int differences = 0;
+  std::list<std::string> checkedFolders;
+  for (auto key1 : *referenceFile->GetListOfKeys()) {
+    TString dfName(key1->GetName());
+    if (!dfName.BeginsWith("DF_")) {
+      continue;
+    }
+    checkedFolders.push_back(dfName.Data());
+    auto referenceFolder = (TDirectoryFile*)referenceFile->Get(dfName);
+    auto folder = (TDirectoryFile*)file->Get(dfName);
+    if (!folder) {
+      printf("  Comparison: folder %s missing\n", dfName.Data());
+      differences++;
+      continue;
+    }
+    if (folder->GetListOfKeys()->GetEntries() != referenceFolder->GetListOfKeys()->GetEntries()) {
+      printf("  Comparison: different number of trees in folder %s\n", dfName.Data());
+      differences++;
+    }
+    for (auto key2 : *referenceFolder->GetListOfKeys()) {
+      auto referenceTree = (TTree*)referenceFolder->Get(key2->GetName());
+      auto tree = (TTree*)folder->Get(key2->GetName());
+      if (!tree || tree->GetEntries() != referenceTree->GetEntries() || tree->GetNbranches() != referenceTree->GetNbranches()) {
+        printf("  Comparison: tree %s/%s missing or different in structure\n", dfName.Data(), key2->GetName());
+        differences++;
+        delete tree;
+        delete referenceTree;
+        continue;
+      }
+      auto leaves = tree->GetListOfLeaves();
+      auto referenceLeaves = referenceTree->GetListOfLeaves();
+      bool identical = true;
+      for (Long64_t i = 0; i < tree->GetEntries() && identical; i++) {
+        tree->GetEntry(i);
+        referenceTree->GetEntry(i);
+        for (int j = 0; j < leaves->GetEntriesFast(); j++) {
+          auto leaf = (TLeaf*)leaves->UncheckedAt(j);
+          auto referenceLeaf = (TLeaf*)referenceLeaves->UncheckedAt(j);
+          int size = leaf->GetLen() * leaf->GetLenType();
+          if (std::strcmp(leaf->GetName(), referenceLeaf->GetName()) != 0 || size != referenceLeaf->GetLen() * referenceLeaf->GetLenType() ||
+              memcmp(leaf->GetValuePointer(), referenceLeaf->GetValuePointer(), size) != 0) {
+            printf("  Comparison: tree %s/%s differs at entry %lld in leaf %s\n", dfName.Data(), key2->GetName(), i, referenceLeaf->GetName());
+            identical = false;
+            differences++;
+            break;
+          }
+        }
+      }
+      if (identical && verbosity > 1) {
+        printf("  Comparison: tree %s/%s identical (%lld entries)\n", dfName.Data(), key2->GetName(), tree->GetEntries());
+      }
+      delete tree;
+      delete referenceTree;
+    }
+  }
+  for (auto key1 : *file->GetListOfKeys()) {
+    TString dfName(key1->GetName());
+    if (dfName.BeginsWith("DF_") && std::find(checkedFolders.begin(), checkedFolders.end(), dfName.Data()) == checkedFolders.end()) {
+      printf("  Comparison: additional folder %s\n", dfName.Data());
+      differences++;
+    }
+  }
+  file->Close();
+  referenceFile->Close();
+  return differences;
+}
+
 // AOD merger with correct index rewriting
 // No need to know the datamodel because the branch names follow a canonical standard (identified by fIndex)
 int main(int argc, char* argv[])
@@ -36,6 +196,8 @@ int main(int argc, char* argv[])
   long maxDirSize = 100000000;
   bool skipNonExistingFiles = false;
   int verbosity = 2;
+  int parallelism = 0;
+  std::string referenceFileName;
   int exitCode = 0; // 0: success, >0: failure
 
   int option_index = 0;
@@ -46,6 +208,8 @@ int main(int argc, char* argv[])
     {"skip-non-existing-files", no_argument, nullptr, 3},
     {"verbosity", required_argument, nullptr, 4},
     {"help", no_argument, nullptr, 5},
+    {"parallel", required_argument, nullptr, 6},
+    {"compare-to", required_argument, nullptr, 7},
     {nullptr, 0, nullptr, 0}};
 
   while (true) {
@@ -62,6 +226,10 @@ int main(int argc, char* argv[])
       skipNonExistingFiles = true;
     } else if (c == 4) {
       verbosity = atoi(optarg);
+    } else if (c == 6) {
+      parallelism = atoi(optarg);
+    } else if (c == 7) {
+      referenceFileName = optarg;
     } else if (c == 5) {
       printf("AO2D merging tool. Options: \n");
       printf("  --input <inputfile.txt>      Contains path to files to be merged. Default: %s\n", inputCollection.c_str());
@@ -69,6 +237,8 @@ int main(int argc, char* argv[])
       printf("  --max-size <size in Bytes>   Target directory size. Default: %ld. Set to 0 if file is not self-contained.\n", maxDirSize);
       printf("  --skip-non-existing-files    Flag to allow skipping of non-existing files in the input list.\n");
       printf("  --verbosity <flag>           Verbosity of output (default: %d).\n", verbosity);
+      printf("  --parallel <n>               Number of input files read ahead concurrently, 0 is serial. Default: %d\n", parallelism);
+      printf("  --compare-to <file.root>     Compare the merged output entry by entry to a reference file (e.g. from a serial merge).\n");
       return -1;
     } else {
       return -2;
@@ -82,6 +252,11 @@ int main(int argc, char* argv[])
   if (skipNonExistingFiles) {
     printf("  WARNING: Skipping non-existing files.\n");
   }
+  if (parallelism > 0) {
+    printf("  Parallel mode: reading %d files ahead\n", parallelism);
+    // Input files are opened and read in worker threads; output is written in input order by this thread only
+    ROOT::EnableThreadSafety();
+  }
 
   std::map<std::string, TTree*> trees;
   std::map<std::string, uint64_t> sizeCompressed;
@@ -96,12 +271,9 @@ int main(int argc, char* argv[])
   std::ifstream in;
   in.open(inputCollection);
   TString line;
+  std::vector<TString> inputFileNames;
   bool connectedToAliEn = false;
-  TMap* metaData = nullptr;
-  TMap* parentFiles = nullptr;
-  int totalMergedDFs = 0;
-  int mergedDFs = 0;
-  while (in.good() && exitCode == 0) {
+  while (in.good()) {
     in >> line;
 
     if (line.Length() == 0) {
@@ -113,10 +285,39 @@ int main(int argc, char* argv[])
       TGrid::Connect("alien:");
       connectedToAliEn = true; // Only try once
     }
+    inputFileNames.push_back(line);
+    line = "";
+  }
+
+  // in parallel mode, up to parallelism files are opened and their index columns read ahead
+  std::deque<std::future<PrefetchedFile>> prefetchQueue;
+  size_t nextPrefetch = 0;
+  auto fillPrefetchQueue = [&]() {
+    while (parallelism > 0 && nextPrefetch < inputFileNames.size() && prefetchQueue.size() < (size_t)parallelism) {
+      prefetchQueue.push_back(std::async(std::launch::async, prefetchFile, inputFileNames[nextPrefetch++]));
+    }
+  };
+
+  TMap* metaData = nullptr;
+  TMap* parentFiles = nullptr;
+  int totalMergedDFs = 0;
+  int mergedDFs = 0;
+  for (size_t iFile = 0; iFile < inputFileNames.size() && exitCode == 0; iFile++) {
+    line = inputFileNames[iFile];
 
     printf("Processing input file: %s\n", line.Data());
 
-    auto inputFile = TFile::Open(line);
+    TFile* inputFile = nullptr;
+    PrefetchedFile prefetched;
+    if (parallelism > 0) {
+      fillPrefetchQueue();
+      prefetched = prefetchQueue.front().get();
+      prefetchQueue.pop_front();
+      fillPrefetchQueue();
+      inputFile = prefetched.file;
+    } else {
+      inputFile = TFile::Open(line);
+    }
     if (!inputFile) {
       printf("Error: Could not open input file %s.\n", line.Data());
       if (skipNonExistingFiles) {
@@ -215,6 +416,17 @@ int main(int argc, char* argv[])
         foundTrees.push_back(treeName);
 
         auto inputTree = (TTree*)inputFile->Get(Form("%s/%s", dfName, treeName));
+        std::map<std::string, std::vector<int>>* prefetchedColumns = nullptr;
+        if (parallelism > 0) {
+          auto prefetchedTree = prefetched.indexColumns.find(Form("%s/%s", dfName, treeName));
+          if (prefetchedTree != prefetched.indexColumns.end()) {
+            prefetchedColumns = &prefetchedTree->second;
+          }
+          // baskets of all branches are read ahead in one go
+          inputTree->SetCacheSize(50000000);
+          inputTree->AddBranchToCache("*", true);
+          inputTree->StopCacheLearningPhase();
+        }
         bool fastCopy = (inputTree->GetTotBytes() > 10000000); // Only do this for large enough trees to avoid that baskets are too small
         if (verbosity > 1) {
           printf("    Processing tree %s with %lld entries with total size %lld (fast copy: %d)\n", treeName, inputTree->GetEntries(), inputTree->GetTotBytes(), fastCopy);
@@ -249,7 +461,9 @@ int main(int argc, char* argv[])
 
         auto outputTree = trees[treeName];
         // register index and connect VLA columns
+        // index columns which were prefetched are rewritten in bulk and not read again entry by entry
         std::vector<std::pair<int*, int>> indexList;
+        std::vector<std::tuple<int*, std::vector<int>*, int, int>> bulkIndexList; // buffer, column, width, offset
         std::vector<char*> vlaPointers;
         std::vector<int*> indexPointers;
         TObjArray* branches = inputTree->GetListOfBranches();
@@ -286,32 +500,58 @@ int main(int argc, char* argv[])
             memset(buffer, 0, 2 * sizeof(buffer[0]));
             vlaPointers.push_back(reinterpret_cast<char*>(buffer));
 
-            inputTree->SetBranchAddress(br->GetName(), buffer);
             outputTree->SetBranchAddress(br->GetName(), buffer);
 
-            indexList.push_back({buffer, offsets[getTableName(branchName, treeName)]});
-            indexList.push_back({buffer + 1, offsets[getTableName(branchName, treeName)]});
+            if (prefetchedColumns && prefetchedColumns->count(br->GetName()) > 0) {
+              inputTree->SetBranchStatus(br->GetName(), 0);
+              bulkIndexList.push_back({buffer, &prefetchedColumns->at(br->GetName()), 2, offsets[getTableName(branchName, treeName)]});
+            } else {
+              inputTree->SetBranchAddress(br->GetName(), buffer);
+              indexList.push_back({buffer, offsets[getTableName(branchName, treeName)]});
+              indexList.push_back({buffer + 1, offsets[getTableName(branchName, treeName)]});
+            }
           } else if (branchName.BeginsWith("fIndex") && !branchName.EndsWith("_size")) {
             int* buffer = new int;
             *buffer = 0;
             indexPointers.push_back(buffer);
 
-            inputTree->SetBranchAddress(br->GetName(), buffer);
             outputTree->SetBranchAddress(br->GetName(), buffer);
 
-            indexList.push_back({buffer, offsets[getTableName(branchName, treeName)]});
+            if (prefetchedColumns && prefetchedColumns->count(br->GetName()) > 0) {
+              inputTree->SetBranchStatus(br->GetName(), 0);
+              bulkIndexList.push_back({buffer, &prefetchedColumns->at(br->GetName()), 1, offsets[getTableName(branchName, treeName)]});
+            } else {
+              inputTree->SetBranchAddress(br->GetName(), buffer);
+              indexList.push_back({buffer, offsets[getTableName(branchName, treeName)]});
+            }
           }
         }
 
-        if (indexList.size() > 0) {
+        if (indexList.size() > 0 || bulkIndexList.size() > 0) {
           auto entries = inputTree->GetEntries();
           int minIndexOffset = unassignedIndexOffset[treeName];
           auto newMinIndexOffset = minIndexOffset;
+          // shift prefetched index columns in one pass, same rules as below
+          for (auto& [buffer, column, width, offset] : bulkIndexList) {
+            for (auto& index : *column) {
+              if (index < 0) {
+                index += minIndexOffset;
+                newMinIndexOffset = std::min(newMinIndexOffset, index);
+              } else {
+                index += offset;
+              }
+            }
+          }
           for (int i = 0; i < entries; i++) {
             for (auto& index : indexList) {
               *(index.first) = 0; // Any positive number will do, in any case it will not be filled in the output. Otherwise the previous entry is used and manipulated in the following.
             }
             inputTree->GetEntry(i);
+            for (auto& [buffer, column, width, offset] : bulkIndexList) {
+              for (int j = 0; j < width; j++) {
+                buffer[j] = (*column)[i * width + j];
+              }
+            }
             // shift index columns by offset
             for (const auto& idx : indexList) {
               // if negative, the index is unassigned. In this case, the different unassigned blocks have to get unique negative IDs
@@ -338,6 +578,9 @@ int main(int argc, char* argv[])
         }
 
         delete inputTree;
+        if (prefetchedColumns) {
+          prefetchedColumns->clear();
+        }
 
         for (auto& buffer : indexPointers) {
           delete buffer;
@@ -430,6 +673,25 @@ int main(int argc, char* argv[])
     exitCode = 2;
   }
 
+  // close files which were read ahead but not merged (only after a failure)
+  for (auto& pending : prefetchQueue) {
+    auto unused = pending.get();
+    if (unused.file) {
+      unused.file->Close();
+    }
+  }
+
+  if (exitCode == 0 && referenceFileName.size() > 0) {
+    printf("Comparing output to reference file %s\n", referenceFileName.c_str());
+    int differences = compareOutputs(outputFileName.c_str(), referenceFileName.c_str(), verbosity);
+    if (differences > 0) {
+      printf("ERROR: Output differs from reference file in %d places.\n", differences);
+      exitCode = 6;
+    } else {
+      printf("Output identical to reference file.\n");
+    }
+  }
+
   // in case of failure, remove the incomplete file
   if (exitCode != 0) {
     printf("Removing incomplete output file %s.\n", outputFile->GetName());
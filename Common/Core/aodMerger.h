@@ -14,7 +14,7 @@
 const char* removeVersionSuffix(const char* treeName)
 {
   // remove version suffix, e.g. O2v0_001 becomes O2v0
-  static TString tmp;
+  thread_local static TString tmp;
   tmp = treeName;
   if (tmp.First("_") >= 0) {
     tmp.Remove(tmp.First("_"));
@@ -29,7 +29,7 @@ const char* getTableName(const char* branchName, const char* treeName)
   //   fIndexArray<Table>[_<Suffix>]
   //   fIndexSlice<Table>[_<Suffix>]
   // if <Table> is empty it is a self index and treeName is used as table name
-  static TString tableName;
+  thread_local static TString tableName;
   tableName = branchName;
   if (tableName.BeginsWith("fIndexArray") || tableName.BeginsWith("fIndexSlice")) {
     tableName.Remove(0, 11);
@@ -10,13 +10,20 @@
 // or submit itself to any jurisdiction.
 
 #include <map>
+#include <set>
 #include <list>
+#include <deque>
+#include <vector>
+#include <future>
+#include <tuple>
+#include <algorithm>
 #include <fstream>
 #include <getopt.h>
 
 #include "TSystem.h"
 #include "TFile.h"
 #include "TTree.h"
+#include "TTreeFormula.h"
 #include "TList.h"
 #include "TKey.h"
 #include "TDirectory.h"
@@ -24,20 +31,295 @@
 #include <TGrid.h>
 #include <TMap.h>
 #include <TLeaf.h>
+#include <TROOT.h>
 
 #include "aodMerger.h"
 
-// AOD reduction tool
-//   Designed for the 2022 pp data with specific selections:
+// Row predicate: rows of <tree> for which <expression> is true are dropped
+// Syntax:
+//   <tree>:<expression>                              expression evaluated on <tree> itself
+//   <tree>:<indexBranch>-><targetTree>:<expression>  expression evaluated on the row of <targetTree> that <indexBranch> points to
+struct RowPredicate {
+  std::string tree;
+  std::string indexBranch;
+  std::string targetTree;
+  std::string expression;
+};
+
+bool parsePredicate(const std::string& text, RowPredicate& predicate)
+{
+  auto colon = text.find(':');
+  if (colon == std::string::npos || colon == 0) {
+    return false;
+  }
+  predicate.tree = text.substr(0, colon);
+  auto rest = text.substr(colon + 1);
+  auto arrow = rest.find("->");
+  auto targetColon = (arrow == std::string::npos) ? std::string::npos : rest.find(':', arrow);
+  if (arrow != std::string::npos && targetColon != std::string::npos) {
+    predicate.indexBranch = rest.substr(0, arrow);
+    predicate.targetTree = rest.substr(arrow + 2, targetColon - arrow - 2);
+    predicate.expression = rest.substr(targetColon + 1);
+  } else {
+    predicate.expression = rest;
+  }
+  return predicate.expression.size() > 0;
+}
+
+// Tables which are joined row by row with a base table share its rows to keep
+const char* getRowGroup(const char* treeName)
+{
+  static const std::map<std::string, std::string> joinedTables = {
+    {"O2trackextra", "O2track"},
+    {"O2trackcov", "O2track"},
+    {"O2mctracklabel", "O2track"},
+    {"O2fwdtrackcov", "O2fwdtrack"},
+    {"O2mcfwdtracklabel", "O2fwdtrack"},
+    {"O2mcmfttracklabel", "O2mfttrack"},
+    {"O2mccollisionlabel", "O2collision"}};
+  const char* table = removeVersionSuffix(treeName);
+  auto joined = joinedTables.find(table);
+  return (joined != joinedTables.end()) ? joined->second.c_str() : table;
+}
+
+struct ThinnedTree {
+  std::string name;
+  std::string group;
+  // index branch --> (referenced row group, width), with width 2 for fIndexSlice
+  std::map<std::string, std::pair<std::string, int>> indexBranches;
+  // index branch --> index values rewritten for the output
+  std::map<std::string, std::vector<int>> indexColumns;
+  bool needsRewrite = false;
+};
+
+// Result of the analysis of one DF folder: which rows survive and the rewritten index columns
+struct ThinnedFolder {
+  std::string dfName;
+  std::vector<ThinnedTree> trees;
+  std::map<std::string, std::vector<char>> keep; // row group --> keep flag per row
+  int exitCode = 0;
+};
+
+// Evaluates a TTreeFormula for all rows of a tree
+bool evaluateFormula(TTree* tree, const std::string& expression, std::vector<char>& result)
+{
+  TTreeFormula formula("thinnerPredicate", expression.c_str(), tree);
+  if (formula.GetNdim() == 0) {
+    printf("    *** FATAL ***: Cannot compile expression %s on tree %s\n", expression.c_str(), tree->GetName());
+    return false;
+  }
+  auto entries = tree->GetEntries();
+  result.assign(entries, 0);
+  for (Long64_t i = 0; i < entries; i++) {
+    tree->LoadTree(i);
+    formula.GetNdata();
+    result[i] = formula.EvalInstance() != 0;
+  }
+  return true;
+}
+
+// Derives the rows to keep in one DF folder from the predicates and the index dependencies between tables
+// A row is dropped if a predicate selects it or if any of its (assigned) fIndex columns points to a dropped row
+ThinnedFolder analyseFolder(TString fileName, std::string dfName, const std::vector<RowPredicate>& predicates)
+{
+  ThinnedFolder folder;
+  folder.dfName = dfName;
+  auto inputFile = TFile::Open(fileName);
+  if (!inputFile) {
+    folder.exitCode = 1;
+    return folder;
+  }
+
+  // one entry per tree name, Get() picks the highest cycle
+  std::set<std::string> treeNames;
+  for (auto key : *((TDirectoryFile*)inputFile->Get(dfName.c_str()))->GetListOfKeys()) {
+    treeNames.insert(key->GetName());
+  }
+
+  std::map<std::string, Long64_t> groupEntries;
+  std::map<std::string, std::map<std::string, std::vector<int>>> rawIndexColumns;
+  std::vector<std::tuple<std::string, std::string, std::string>> vlaIndexBranches; // tree, branch, referenced row group
+  for (auto& treeName : treeNames) {
+    auto tree = (TTree*)inputFile->Get(Form("%s/%s", dfName.c_str(), treeName.c_str()));
+    ThinnedTree thinnedTree;
+    thinnedTree.name = treeName;
+    thinnedTree.group = getRowGroup(treeName.c_str());
+    if (groupEntries.count(thinnedTree.group) > 0 && groupEntries[thinnedTree.group] != tree->GetEntries()) {
+      printf("    *** FATAL ***: Tree %s has %lld entries but its table %s has %lld\n", treeName.c_str(), tree->GetEntries(), thinnedTree.group.c_str(), groupEntries[thinnedTree.group]);
+      folder.exitCode = 10;
+    }
+    groupEntries[thinnedTree.group] = tree->GetEntries();
+
+    TObjArray* branches = tree->GetListOfBranches();
+    for (int i = 0; i < branches->GetEntriesFast(); ++i) {
+      TBranch* br = (TBranch*)branches->UncheckedAt(i);
+      TString branchName(br->GetName());
+      if (!branchName.BeginsWith("fIndex") || branchName.EndsWith("_size")) {
+        continue;
+      }
+      if (((TLeaf*)br->GetListOfLeaves()->First())->GetLeafCount() != nullptr) {
+        // copied unchanged, only an error if the referenced table is thinned (checked below)
+        vlaIndexBranches.push_back({treeName, br->GetName(), getTableName(branchName, treeName.c_str())});
+        continue;
+      }
+      int width = branchName.BeginsWith("fIndexSlice") ? 2 : 1;
+      thinnedTree.indexBranches[br->GetName()] = {getTableName(branchName, treeName.c_str()), width};
+
+      // bulk read of the index column
+      auto& column = rawIndexColumns[treeName][br->GetName()];
+      auto entries = tree->GetEntries();
+      column.resize(entries * width);
+      int value[2] = {0, 0};
+      br->SetAddress(value);
+      for (Long64_t j = 0; j < entries; j++) {
+        br->GetEntry(j);
+        for (int k = 0; k < width; k++) {
+          column[j * width + k] = value[k];
+        }
+      }
+      br->ResetAddress();
+    }
+    folder.trees.push_back(thinnedTree);
+    delete tree;
+  }
+  for (auto& [group, entries] : groupEntries) {
+    folder.keep[group].assign(entries, 1);
+  }
+
+  // apply predicates
+  for (auto& predicate : predicates) {
+    auto evaluatedTree = predicate.indexBranch.empty() ? predicate.tree : predicate.targetTree;
+    auto tree = (TTree*)inputFile->Get(Form("%s/%s", dfName.c_str(), evaluatedTree.c_str()));
+    if (!tree) {
+      printf("    WARNING: Tree %s not found in %s, predicate not applied\n", evaluatedTree.c_str(), dfName.c_str());
+      continue;
+    }
+    std::vector<char> selected;
+    if (!evaluateFormula(tree, predicate.expression, selected)) {
+      folder.exitCode = 11;
+      delete tree;
+      continue;
+    }
+    delete tree;
+    auto& keep = folder.keep[getRowGroup(predicate.tree.c_str())];
+    if (predicate.indexBranch.empty()) {
+      for (size_t i = 0; i < keep.size() && i < selected.size(); i++) {
+        keep[i] &= !selected[i];
+      }
+    } else {
+      auto& column = rawIndexColumns[predicate.tree][predicate.indexBranch];
+      if (column.size() != keep.size()) {
+        printf("    *** FATAL ***: Index %s not found in %s or not a single index\n", predicate.indexBranch.c_str(), predicate.tree.c_str());
+        folder.exitCode = 12;
+        continue;
+      }
+      for (size_t i = 0; i < keep.size(); i++) {
+        if (column[i] >= 0 && column[i] < (int)selected.size() && selected[column[i]]) {
+          keep[i] = 0;
+        }
+      }
+    }
+  }
+
+  // propagate drops along single index columns until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& tree : folder.trees) {
+      auto& keep = folder.keep[tree.group];
+      for (auto& [branchName, target] : tree.indexBranches) {
+        if (target.second != 1 || folder.keep.count(target.first) == 0) {
+          continue;
+        }
+        auto& targetKeep = folder.keep[target.first];
+        auto& column = rawIndexColumns[tree.name][branchName];
+        for (size_t i = 0; i < keep.size(); i++) {
+          if (keep[i] && column[i] >= 0 && column[i] < (int)targetKeep.size() && !targetKeep[column[i]]) {
+            keep[i] = 0;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  // new row number for each kept row: newIndex[g][i] = number of kept rows before i
+  std::map<std::string, std::vector<int>> newIndex;
+  std::set<std::string> thinnedGroups;
+  for (auto& [group, keep] : folder.keep) {
+    auto& mapping = newIndex[group];
+    mapping.resize(keep.size() + 1);
+    int kept = 0;
+    for (size_t i = 0; i < keep.size(); i++) {
+      mapping[i] = kept;
+      kept += keep[i];
+    }
+    mapping[keep.size()] = kept;
+    if (kept != (int)keep.size()) {
+      thinnedGroups.insert(group);
+    }
+  }
+
+  for (auto& [treeName, branchName, target] : vlaIndexBranches) {
+    if (thinnedGroups.count(target) > 0) {
+      printf("    *** FATAL ***: VLA index %s in %s points to the thinned table %s, which is not supported\n", branchName.c_str(), treeName.c_str(), target.c_str());
+      folder.exitCode = 9;
+    }
+  }
+
+  // rewrite index columns in bulk
+  for (auto& tree : folder.trees) {
+    tree.needsRewrite = thinnedGroups.count(tree.group) > 0;
+    for (auto& [branchName, target] : tree.indexBranches) {
+      if (thinnedGroups.count(target.first) == 0) {
+        continue;
+      }
+      tree.needsRewrite = true;
+      auto& mapping = newIndex[target.first];
+      int maxIndex = mapping.size() - 1;
+      auto column = std::move(rawIndexColumns[tree.name][branchName]);
+      if (target.second == 1) {
+        for (auto& index : column) {
+          if (index >= 0 && index < maxIndex) {
+            index = mapping[index];
+          }
+        }
+      } else {
+        // slices are shrunk to the kept rows inside, empty slices become (-1, -1)
+        for (size_t i = 0; i < column.size(); i += 2) {
+          if (column[i] < 0 || column[i + 1] < 0) {
+            continue;
+          }
+          int first = mapping[std::min(column[i], maxIndex)];
+          int last = mapping[std::min(column[i + 1] + 1, maxIndex)] - 1;
+          column[i] = (last >= first) ? first : -1;
+          column[i + 1] = (last >= first) ? last : -1;
+        }
+      }
+      tree.indexColumns[branchName] = std::move(column);
+    }
+  }
+  inputFile->Close();
+  return folder;
+}
+
+// Default selection used for the 2022 pp data:
 //   - Remove all TPC only tracks
-//   - Remove all V0s which refer to any removed track
-//   - Remove all cascade which refer to any removed V0
 //   - Remove all ambiguous track entries which point to a track with collision
-//   - Adjust all indices
+// V0s, cascades and all other rows which refer to removed tracks are removed through the index dependencies
+const std::vector<std::string> defaultPredicates = {
+  "O2trackextra:fTPCNClsFindable>0&&fITSClusterMap==0&&fTRDPattern==0&&fTOFChi2<-1.",
+  "O2ambiguoustrack:fIndexTracks->O2track_iu:fIndexCollisions>=0"};
+
+// AOD reduction tool
+//   Rows are removed according to a configurable set of predicates (see RowPredicate)
+//   The rows to keep are derived over the dependency graph of all fIndex columns and all indices are adjusted
 int main(int argc, char* argv[])
 {
   std::string inputFileName("AO2D.root");
   std::string outputFileName("AO2D_thinned.root");
+  std::vector<std::string> predicateStrings;
+  int parallelism = 0;
   int exitCode = 0; // 0: success, >0: failure
 
   int option_index = 1;
@@ -45,6 +327,8 @@ int main(int argc, char* argv[])
     {"input", required_argument, nullptr, 0},
     {"output", required_argument, nullptr, 1},
     {"help", no_argument, nullptr, 2},
+    {"drop", required_argument, nullptr, 3},
+    {"parallel", required_argument, nullptr, 4},
     {nullptr, 0, nullptr, 0}};
 
   while (true) {
@@ -55,22 +339,53 @@ int main(int argc, char* argv[])
       inputFileName = optarg;
     } else if (c == 1) {
       outputFileName = optarg;
+    } else if (c == 3) {
+      predicateStrings.push_back(optarg);
+    } else if (c == 4) {
+      parallelism = atoi(optarg);
     } else if (c == 2) {
       printf("AO2D thinning tool. Options: \n");
       printf("  --input <inputfile.root>     Contains input file path to the file to be thinned. Default: %s\n", inputFileName.c_str());
       printf("  --output <outputfile.root>   Target output ROOT file. Default: %s\n", outputFileName.c_str());
+      printf("  --drop <predicate>           Drop rows selected by predicate, can be given several times. Syntax:\n");
+      printf("                                 <tree>:<expression>\n");
+      printf("                                 <tree>:<indexBranch>-><targetTree>:<expression>\n");
+      printf("                               Default:\n");
+      for (auto& predicate : defaultPredicates) {
+        printf("                                 %s\n", predicate.c_str());
+      }
+      printf("  --parallel <n>               Number of DF folders analysed concurrently, 0 is serial. Default: %d\n", parallelism);
       return -1;
     } else {
       return -2;
     }
   }
 
+  if (predicateStrings.empty()) {
+    predicateStrings = defaultPredicates;
+  }
+  std::vector<RowPredicate> predicates;
+  for (auto& predicateString : predicateStrings) {
+    RowPredicate predicate;
+    if (!parsePredicate(predicateString, predicate)) {
+      printf("Error: Cannot parse predicate %s\n", predicateString.c_str());
+      return -3;
+    }
+    predicates.push_back(predicate);
+  }
+
   printf("AOD reduction started with:\n");
   printf("  Input file: %s\n", inputFileName.c_str());
   printf("  Ouput file name: %s\n", outputFileName.c_str());
+  for (auto& predicateString : predicateStrings) {
+    printf("  Dropping rows with: %s\n", predicateString.c_str());
+  }
+  if (parallelism > 0) {
+    printf("  Parallel mode: analysing %d folders concurrently\n", parallelism);
+    ROOT::EnableThreadSafety();
+  }
 
   auto outputFile = TFile::Open(outputFileName.c_str(), "RECREATE", "", 501);
-  TDirectory* outputDir = nullptr;
 
   if (inputFileName.find("alien:") == 0) {
     printf("Connecting to AliEn...");
@@ -86,6 +401,7 @@ int main(int argc, char* argv[])
   TList* keyList = inputFile->GetListOfKeys();
   keyList->Sort();
 
+  std::vector<std::string> dfNames;
   for (auto key1 : *keyList) {
     if (((TObjString*)key1)->GetString().EqualTo("metaData")) {
       auto metaData = (TMap*)inputFile->Get("metaData");
@@ -99,208 +415,85 @@ int main(int argc, char* argv[])
       parentFiles->Write("parentFiles", TObject::kSingleKey);
     }
 
-    if (!((TObjString*)key1)->GetString().BeginsWith("DF_")) {
-      continue;
+    if (((TObjString*)key1)->GetString().BeginsWith("DF_")) {
+      dfNames.push_back(((TObjString*)key1)->GetString().Data());
     }
+  }
 
-    auto dfName = ((TObjString*)key1)->GetString().Data();
-
-    printf("  Processing folder %s\n", dfName);
-    auto folder = (TDirectoryFile*)inputFile->Get(dfName);
-    auto treeList = folder->GetListOfKeys();
-    treeList->Sort();
-
-    // purging keys from duplicates
-    for (auto i = 0; i < treeList->GetEntries(); ++i) {
-      TKey* ki = (TKey*)treeList->At(i);
-      for (int j = i + 1; j < treeList->GetEntries(); ++j) {
-        TKey* kj = (TKey*)treeList->At(j);
-        if (std::strcmp(ki->GetName(), kj->GetName()) == 0 && std::strcmp(ki->GetTitle(), kj->GetTitle()) == 0) {
-          if (ki->GetCycle() < kj->GetCycle()) {
-            printf("    *** FATAL *** we had ordered the keys, first cycle should be higher, please check");
-            exitCode = 5;
-          } else {
-            // key is a duplicate, let's remove it
-            treeList->Remove(kj);
-            j--;
-          }
-        } else {
-          // we changed key, since they are sorted, we won't have the same anymore
-          break;
-        }
-      }
+  // folders are analysed (keep-sets and rewritten indices) ahead of time in parallel mode, and written in order
+  std::deque<std::future<ThinnedFolder>> analysisQueue;
+  size_t nextAnalysis = 0;
+  auto fillAnalysisQueue = [&]() {
+    while (parallelism > 0 && nextAnalysis < dfNames.size() && analysisQueue.size() < (size_t)parallelism) {
+      analysisQueue.push_back(std::async(std::launch::async, analyseFolder, TString(inputFileName.c_str()), dfNames[nextAnalysis++], std::cref(predicates)));
     }
+  };
 
-    // Certain order needed in order to populate vectors of skipped entries
-    auto v0Entry = (TObject*)treeList->FindObject("O2v0_001");
-    treeList->Remove(v0Entry);
-    treeList->AddFirst(v0Entry);
+  for (auto& dfName : dfNames) {
+    printf("  Processing folder %s\n", dfName.c_str());
 
-    // Prepare maps for track skimming
-    auto trackExtraTree = (TTree*)inputFile->Get(Form("%s/%s", dfName, "O2trackextra")); // for example we can use this line to access the track table
-    if (trackExtraTree == nullptr) {
-      printf("O2trackextra table not found\n");
-      exitCode = 6;
-      break;
-    }
-    auto track_iu = (TTree*)inputFile->Get(Form("%s/%s", dfName, "O2track_iu"));
-    if (track_iu == nullptr) {
-      printf("O2track_iu table not found\n");
-      exitCode = 7;
-      break;
+    ThinnedFolder folder;
+    if (parallelism > 0) {
+      fillAnalysisQueue();
+      folder = analysisQueue.front().get();
+      analysisQueue.pop_front();
+      fillAnalysisQueue();
+    } else {
+      folder = analyseFolder(inputFileName.c_str(), dfName, predicates);
     }
-    auto v0s = (TTree*)inputFile->Get(Form("%s/%s", dfName, "O2v0_001"));
-    if (v0s == nullptr) {
-      printf("O2v0_001 table not found\n");
-      exitCode = 8;
+    if (folder.exitCode > 0) {
+      exitCode = folder.exitCode;
       break;
     }
 
-    std::vector<int> acceptedTracks(trackExtraTree->GetEntries(), -1);
-    std::vector<bool> hasCollision(trackExtraTree->GetEntries(), false);
-    std::vector<int> keepV0s(v0s->GetEntries(), -1);
-
-    uint8_t tpcNClsFindable = 0;
-    uint8_t ITSClusterMap = 0;
-    uint8_t TRDPattern = 0;
-    float_t TOFChi2 = 0;
-    // char16_t fTPCNClsFindableMinusFound = 0;
-    trackExtraTree->SetBranchAddress("fTPCNClsFindable", &tpcNClsFindable);
-    trackExtraTree->SetBranchAddress("fITSClusterMap", &ITSClusterMap);
-    trackExtraTree->SetBranchAddress("fTRDPattern", &TRDPattern);
-    trackExtraTree->SetBranchAddress("fTOFChi2", &TOFChi2);
-    // trackExtraTree->SetBranchAddress("fTPCNClsFindableMinusFound", &fTPCNClsFindableMinusFound);
-
-    int fIndexCollisions = 0;
-    track_iu->SetBranchAddress("fIndexCollisions", &fIndexCollisions);
-
-    // loop over all tracks
-    auto entries = trackExtraTree->GetEntries();
-    int counter = 0;
-    for (int i = 0; i < entries; i++) {
-      trackExtraTree->GetEntry(i);
-      track_iu->GetEntry(i);
-
-      // Remove TPC only tracks
-      if (tpcNClsFindable > 0. && ITSClusterMap == 0 && TRDPattern == 0 && TOFChi2 < -1.) {
-        counter++;
-      } else {
-        acceptedTracks[i] = i - counter;
-      }
-      hasCollision[i] = (fIndexCollisions >= 0);
-    }
+    auto outputDir = outputFile->mkdir(dfName.c_str());
+    printf("Writing to output folder %s\n", dfName.c_str());
 
-    for (auto key2 : *treeList) {
-      auto treeName = ((TObjString*)key2)->GetString().Data();
-
-      auto inputTree = (TTree*)inputFile->Get(Form("%s/%s", dfName, treeName));
+    for (auto& thinnedTree : folder.trees) {
+      auto treeName = thinnedTree.name.c_str();
+      auto inputTree = (TTree*)inputFile->Get(Form("%s/%s", dfName.c_str(), treeName));
       printf("    Processing tree %s with %lld entries with total size %lld\n", treeName, inputTree->GetEntries(), inputTree->GetTotBytes());
 
-      // Connect trees but do not copy entries (using the clone function)
-      // NOTE Basket size etc. are copied in CloneTree()
-      if (!outputDir) {
-        outputDir = outputFile->mkdir(dfName);
-        printf("Writing to output folder %s\n", dfName);
-      }
       outputDir->cd();
+      if (!thinnedTree.needsRewrite) {
+        // nothing changes in this tree: baskets are copied without decompression
+        auto outputTree = inputTree->CloneTree(-1, "fast");
+        outputTree->Write();
+        delete outputTree;
+        delete inputTree;
+        continue;
+      }
+
+      // NOTE Basket size etc. are copied in CloneTree()
       auto outputTree = inputTree->CloneTree(0);
       outputTree->SetAutoFlush(0);
 
-      std::vector<int*> indexList;
-      std::vector<char*> vlaPointers;
+      // rewritten index columns replace the input branches
+      std::vector<std::tuple<int*, const std::vector<int>*, int>> indexList; // buffer, column, width
       std::vector<int*> indexPointers;
-      TObjArray* branches = inputTree->GetListOfBranches();
-      for (int i = 0; i < branches->GetEntriesFast(); ++i) {
-        TBranch* br = (TBranch*)branches->UncheckedAt(i);
-        TString branchName(br->GetName());
-        TString tableName(getTableName(branchName, treeName));
-        // register index of track index ONLY
-        if (!tableName.EqualTo("O2track")) {
-          continue;
-        }
-        // detect VLA
-        if (((TLeaf*)br->GetListOfLeaves()->First())->GetLeafCount() != nullptr) {
-          printf("  *** FATAL ***: VLA detection is not supported\n");
-          exitCode = 9;
-        } else if (branchName.BeginsWith("fIndexSlice")) {
-          int* buffer = new int[2];
-          memset(buffer, 0, 2 * sizeof(buffer[0]));
-          vlaPointers.push_back(reinterpret_cast<char*>(buffer));
-          inputTree->SetBranchAddress(br->GetName(), buffer);
-          outputTree->SetBranchAddress(br->GetName(), buffer);
-
-          indexList.push_back(buffer);
-          indexList.push_back(buffer + 1);
-        } else if (branchName.BeginsWith("fIndex") && !branchName.EndsWith("_size")) {
-          int* buffer = new int;
-          *buffer = 0;
-          indexPointers.push_back(buffer);
-
-          inputTree->SetBranchAddress(br->GetName(), buffer);
-          outputTree->SetBranchAddress(br->GetName(), buffer);
-
-          indexList.push_back(buffer);
-        }
-      }
-
-      bool processingTracks = memcmp(treeName, "O2track", 7) == 0; // matches any of the track tables
-      bool processingCascades = memcmp(treeName, "O2cascade", 9) == 0;
-      bool processingV0s = memcmp(treeName, "O2v0", 4) == 0;
-      bool processingAmbiguousTracks = memcmp(treeName, "O2ambiguoustrack", 16) == 0;
-
-      auto indexV0s = -1;
-      if (processingCascades) {
-        inputTree->SetBranchAddress("fIndexV0s", &indexV0s);
-        outputTree->SetBranchAddress("fIndexV0s", &indexV0s);
+      for (auto& [branchName, column] : thinnedTree.indexColumns) {
+        int width = thinnedTree.indexBranches[branchName].second;
+        int* buffer = new int[2];
+        memset(buffer, 0, 2 * sizeof(buffer[0]));
+        indexPointers.push_back(buffer);
+        inputTree->SetBranchStatus(branchName.c_str(), 0);
+        outputTree->SetBranchAddress(branchName.c_str(), buffer);
+        indexList.push_back({buffer, &column, width});
       }
 
+      auto& keep = folder.keep[thinnedTree.group];
       auto entries = inputTree->GetEntries();
-      for (int i = 0; i < entries; i++) {
-        inputTree->GetEntry(i);
-        bool fillThisEntry = true;
-        // Special case for Tracks, TracksExtra, TracksCov
-        if (processingTracks) {
-          if (acceptedTracks[i] < 0) {
-            fillThisEntry = false;
-          }
-        } else {
-          // Other table than Tracks* --> reassign indices to Tracks
-          for (const auto& idx : indexList) {
-            int oldTrackIndex = *idx;
-
-            // if negative, the index is unassigned.
-            if (oldTrackIndex >= 0) {
-              if (acceptedTracks[oldTrackIndex] < 0) {
-                fillThisEntry = false;
-              } else {
-                *idx = acceptedTracks[oldTrackIndex];
-              }
-            }
-          }
-        }
-
-        // Reassign v0 index of cascades
-        if (processingCascades) {
-          if (keepV0s[indexV0s] < 0) {
-            fillThisEntry = false;
-          } else {
-            indexV0s = keepV0s[indexV0s];
-          }
-        }
-
-        // Keep only tracks which have no collision, see O2-3601
-        if (processingAmbiguousTracks) {
-          if (hasCollision[i]) {
-            fillThisEntry = false;
-          }
+      for (Long64_t i = 0; i < entries; i++) {
+        if (!keep[i]) {
+          continue;
         }
-
-        if (fillThisEntry) {
-          outputTree->Fill();
-          if (processingV0s) {
-            keepV0s[i] = outputTree->GetEntries() - 1;
+        inputTree->GetEntry(i);
+        for (auto& [buffer, column, width] : indexList) {
+          for (int j = 0; j < width; j++) {
+            buffer[j] = (*column)[i * width + j];
           }
         }
+        outputTree->Fill();
       }
 
       if (entries != outputTree->GetEntries()) {
@@ -310,9 +503,6 @@ int main(int argc, char* argv[])
       delete inputTree;
 
       for (auto& buffer : indexPointers) {
-        delete buffer;
-      }
-      for (auto& buffer : vlaPointers) {
         delete[] buffer;
       }
 
@@ -320,11 +510,9 @@ int main(int argc, char* argv[])
       outputTree->Write();
       delete outputTree;
     }
-    if (exitCode > 0) {
-      break;
-    }
-
-    outputDir = nullptr;
+  }
+  for (auto& pending : analysisQueue) {
+    pending.wait();
   }
   inputFile->Close();
 
@@ -29,6 +29,7 @@
 #include "Common/DataModel/TrackSelectionTables.h"
 #include "Common/DataModel/EventSelection.h"
 #include "Common/DataModel/FT0Corrected.h"
+#include "Common/Core/PID/TOFEventTimeSolver.h"
 #include "TableHelper.h"
 #include "pidTOFBase.h"
 
@@ -144,6 +145,9 @@ struct tofEventTime {
   Configurable<bool> fatalOnPassNotAvailable{"fatalOnPassNotAvailable", true, "Flag to throw a fatal if the pass is not available in the retrieved CCDB object"};
   Configurable<bool> sel8TOFEvTime{"sel8TOFEvTime", false, "Flag to compute the ev. time only for events that pass the sel8 ev. selection"};
   Configurable<int> maxNtracksInSet{"maxNtracksInSet", 10, "Size of the set to consider for the TOF ev. time computation"};
+  Configurable<bool> useEvTimeSolver{"useEvTimeSolver", false, "Flag to compute the TOF ev. time with all the tracks of the collision, with a pruned search of the mass hypotheses"};
+  Configurable<int> maxEvTimeCombinations{"maxEvTimeCombinations", 243, "Maximum number of sets of mass hypotheses kept at each step of the pruned search"};
+  o2::pid::tof::EventTimeSolver mEvTimeSolver; // Reused across collisions to keep its buffers
 
   void init(o2::framework::InitContext& initContext)
   {
@@ -242,6 +246,9 @@ struct tofEventTime {
     mRespParamsV2.print();
     o2::tof::eventTimeContainer::setMaxNtracksInSet(maxNtracksInSet.value);
     o2::tof::eventTimeContainer::printConfig();
+    mEvTimeSolver.setDiamond(diamond);
+    mEvTimeSolver.setMaxCombinations(maxEvTimeCombinations.value);
+    LOG(info) << "TOF ev. time computed with " << (useEvTimeSolver ? "the pruned search on all tracks" : "the sets of tracks");
   }
 
   ///
@@ -276,6 +283,94 @@ struct tofEventTime {
   template <o2::track::PID::ID pid>
   using ResponseImplementationEvTime = o2::pid::tof::ExpTimes<TrksEvTime::iterator, pid>;
   using EvTimeCollisions = soa::Join<aod::Collisions, aod::EvSels>;
+
+  /// Fills the tables for the tracks of a collision with the TOF event time, with the bias of each track removed
+  /// \param evTimeTOF is the TOF event time of the collision, either from the sets of tracks or from the solver
+  template <typename EvTimeType, typename TrackContainer>
+  void fillEvTimeTOF(const TrackContainer& tracksInCollision, const EvTimeType& evTimeTOF)
+  {
+    int nGoodTracksForTOF = 0;
+    float et = evTimeTOF.mEventTime;
+    float erret = evTimeTOF.mEventTimeError;
+
+    for (auto const& trk : tracksInCollision) { // Loop on Tracks
+      if constexpr (removeTOFEvTimeBias) {
+        evTimeTOF.template removeBias<TrksEvTime::iterator, filterForTOFEventTime>(trk, nGoodTracksForTOF, et, erret, 2);
+      }
+      uint8_t flags = 0;
+      if (erret < errDiamond && (maxEvTimeTOF <= 0.f || abs(et) < maxEvTimeTOF)) {
+        flags |= o2::aod::pidflags::enums::PIDFlags::EvTimeTOF;
+      } else {
+        et = 0.f;
+        erret = errDiamond;
+      }
+      tableFlags(flags);
+      tableEvTime(et, erret);
+      if (enableTableTOFOnly) {
+        tableEvTimeTOFOnly((uint8_t)filterForTOFEventTime(trk), et, erret, evTimeTOF.mEventTimeMultiplicity);
+      }
+    }
+  }
+
+  /// Fills the tables for the tracks of a collision with the combination of the TOF and FT0 event times
+  template <typename EvTimeType, typename TrackContainer, typename CollisionType>
+  void fillEvTimeTOFAndFT0(const TrackContainer& tracksInCollision, const EvTimeType& evTimeTOF, const CollisionType& collision)
+  {
+    float t0AC[2] = {.0f, 999.f};                                                                                   // Value and error of T0A or T0C or T0AC
+    float t0TOF[2] = {static_cast<float_t>(evTimeTOF.mEventTime), static_cast<float_t>(evTimeTOF.mEventTimeError)}; // Value and error of TOF
+
+    uint8_t flags = 0;
+    int nGoodTracksForTOF = 0;
+    float eventTime = 0.f;
+    float sumOfWeights = 0.f;
+    float weight = 0.f;
+
+    for (auto const& trk : tracksInCollision) { // Loop on Tracks
+      // Reset the flag
+      flags = 0;
+      // Reset the event time
+      eventTime = 0.f;
+      sumOfWeights = 0.f;
+      weight = 0.f;
+      // Remove the bias on TOF ev. time
+      if constexpr (removeTOFEvTimeBias) {
+        evTimeTOF.template removeBias<TrksEvTime::iterator, filterForTOFEventTime>(trk, nGoodTracksForTOF, t0TOF[0], t0TOF[1], 2);
+      }
+      if (t0TOF[1] < errDiamond && (maxEvTimeTOF <= 0 || abs(t0TOF[0]) < maxEvTimeTOF)) {
+        flags |= o2::aod::pidflags::enums::PIDFlags::EvTimeTOF;
+
+        weight = 1.f / (t0TOF[1] * t0TOF[1]);
+        eventTime += t0TOF[0] * weight;
+        sumOfWeights += weight;
+      }
+
+      if (collision.has_foundFT0()) { // T0 measurement is available
+        // const auto& ft0 = collision.foundFT0();
+        if (collision.t0ACValid()) {
+          t0AC[0] = collision.t0AC() * 1000.f;
+          t0AC[1] = collision.t0resolution() * 1000.f;
+          flags |= o2::aod::pidflags::enums::PIDFlags::EvTimeT0AC;
+        }
+
+        weight = 1.f / (t0AC[1] * t0AC[1]);
+        eventTime += t0AC[0] * weight;
+        sumOfWeights += weight;
+      }
+
+      if (sumOfWeights < weightDiamond) { // avoiding sumOfWeights = 0 or worse that diamond
+        eventTime = 0;
+        sumOfWeights = weightDiamond;
+        tableFlags(0);
+      } else {
+        tableFlags(flags);
+      }
+      tableEvTime(eventTime / sumOfWeights, sqrt(1. / sumOfWeights));
+      if (enableTableTOFOnly) {
+        tableEvTimeTOFOnly((uint8_t)filterForTOFEventTime(trk), t0TOF[0], t0TOF[1], evTimeTOF.mEventTimeMultiplicity);
+      }
+    }
+  }
+
   void processNoFT0(TrksEvTime const& tracks,
                     EvTimeCollisions const&)
   {
@@ -308,27 +403,11 @@ struct tofEventTime {
       const auto& tracksInCollision = tracks.sliceBy(perCollision, lastCollisionId);
 
       // First make table for event time
-      const auto evTimeTOF = evTimeMakerForTracks<TrksEvTime::iterator, filterForTOFEventTime, o2::pid::tof::ExpTimes>(tracksInCollision, mRespParamsV2, diamond);
-      int nGoodTracksForTOF = 0;
-      float et = evTimeTOF.mEventTime;
-      float erret = evTimeTOF.mEventTimeError;
-
-      for (auto const& trk : tracksInCollision) { // Loop on Tracks
-        if constexpr (removeTOFEvTimeBias) {
-          evTimeTOF.removeBias<TrksEvTime::iterator, filterForTOFEventTime>(trk, nGoodTracksForTOF, et, erret, 2);
-        }
-        uint8_t flags = 0;
-        if (erret < errDiamond && (maxEvTimeTOF <= 0.f || abs(et) < maxEvTimeTOF)) {
-          flags |= o2::aod::pidflags::enums::PIDFlags::EvTimeTOF;
-        } else {
-          et = 0.f;
-          erret = errDiamond;
-        }
-        tableFlags(flags);
-        tableEvTime(et, erret);
-        if (enableTableTOFOnly) {
-          tableEvTimeTOFOnly((uint8_t)filterForTOFEventTime(trk), et, erret, evTimeTOF.mEventTimeMultiplicity);
-        }
+      if (useEvTimeSolver) {
+        mEvTimeSolver.solve<TrksEvTime::iterator, filterForTOFEventTime>(tracksInCollision, mRespParamsV2);
+        fillEvTimeTOF(tracksInCollision, mEvTimeSolver);
+      } else {
+        fillEvTimeTOF(tracksInCollision, evTimeMakerForTracks<TrksEvTime::iterator, filterForTOFEventTime, o2::pid::tof::ExpTimes>(tracksInCollision, mRespParamsV2, diamond));
       }
     }
   }
@@ -371,60 +450,11 @@ struct tofEventTime {
       const auto& collision = t.collision_as<EvTimeCollisionsFT0>();
 
       // Compute the TOF event time
-      const auto evTimeTOF = evTimeMakerForTracks<TrksEvTime::iterator, filterForTOFEventTime, o2::pid::tof::ExpTimes>(tracksInCollision, mRespParamsV2, diamond);
-
-      float t0AC[2] = {.0f, 999.f};                                                                                   // Value and error of T0A or T0C or T0AC
-      float t0TOF[2] = {static_cast<float_t>(evTimeTOF.mEventTime), static_cast<float_t>(evTimeTOF.mEventTimeError)}; // Value and error of TOF
-
-      uint8_t flags = 0;
-      int nGoodTracksForTOF = 0;
-      float eventTime = 0.f;
-      float sumOfWeights = 0.f;
-      float weight = 0.f;
-
-      for (auto const& trk : tracksInCollision) { // Loop on Tracks
-        // Reset the flag
-        flags = 0;
-        // Reset the event time
-        eventTime = 0.f;
-        sumOfWeights = 0.f;
-        weight = 0.f;
-        // Remove the bias on TOF ev. time
-        if constexpr (removeTOFEvTimeBias) {
-          evTimeTOF.removeBias<TrksEvTime::iterator, filterForTOFEventTime>(trk, nGoodTracksForTOF, t0TOF[0], t0TOF[1], 2);
-        }
-        if (t0TOF[1] < errDiamond && (maxEvTimeTOF <= 0 || abs(t0TOF[0]) < maxEvTimeTOF)) {
-          flags |= o2::aod::pidflags::enums::PIDFlags::EvTimeTOF;
-
-          weight = 1.f / (t0TOF[1] * t0TOF[1]);
-          eventTime += t0TOF[0] * weight;
-          sumOfWeights += weight;
-        }
-
-        if (collision.has_foundFT0()) { // T0 measurement is available
-          // const auto& ft0 = collision.foundFT0();
-          if (collision.t0ACValid()) {
-            t0AC[0] = collision.t0AC() * 1000.f;
-            t0AC[1] = collision.t0resolution() * 1000.f;
-            flags |= o2::aod::pidflags::enums::PIDFlags::EvTimeT0AC;
-          }
-
-          weight = 1.f / (t0AC[1] * t0AC[1]);
-          eventTime += t0AC[0] * weight;
-          sumOfWeights += weight;
-        }
-
-        if (sumOfWeights < weightDiamond) { // avoiding sumOfWeights = 0 or worse that diamond
-          eventTime = 0;
-          sumOfWeights = weightDiamond;
-          tableFlags(0);
-        } else {
-          tableFlags(flags);
-        }
-        tableEvTime(eventTime / sumOfWeights, sqrt(1. / sumOfWeights));
-        if (enableTableTOFOnly) {
-          tableEvTimeTOFOnly((uint8_t)filterForTOFEventTime(trk), t0TOF[0], t0TOF[1], evTimeTOF.mEventTimeMultiplicity);
-        }
+      if (useEvTimeSolver) {
+        mEvTimeSolver.solve<TrksEvTime::iterator, filterForTOFEventTime>(tracksInCollision, mRespParamsV2);
+        fillEvTimeTOFAndFT0(tracksInCollision, mEvTimeSolver, collision);
+      } else {
+        fillEvTimeTOFAndFT0(tracksInCollision, evTimeMakerForTracks<TrksEvTime::iterator, filterForTOFEventTime, o2::pid::tof::ExpTimes>(tracksInCollision, mRespParamsV2, diamond), collision);
       }
     }
   }
@@ -18,13 +18,108 @@
 #include "Framework/RunningWorkflowInfo.h"
 #include "Common/DataModel/Multiplicity.h"
 #include "Common/DataModel/Centrality.h"
+#include "Common/Core/HistogramAccumulator.h"
 #include <CCDB/BasicCCDBManager.h>
 #include <TH1F.h>
 #include <TFormula.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 using namespace o2;
 using namespace o2::framework;
 
+/// Flat lookup representation of a percentile calibration histogram.
+/// Uniform bins are found with o2::analysis::AxisBinning, i.e. with the arithmetic of TAxis::FindFixBin. For variable
+/// binning the axis range is divided in uniform cells, each one pointing to the first histogram bin it overlaps, so that
+/// the bin of a value is found with one multiplication and a few comparisons with the bin edges.
+/// The result is identical to GetBinContent(FindFixBin(x)); optionally values are interpolated linearly between bin centers.
+struct PercentileLookupTable {
+  std::vector<float> binContent; // including underflow (0) and overflow (nBins + 1)
+  std::vector<float> binCenter;
+  std::vector<double> binUpEdge;
+  std::vector<int> cellFirstBin;
+  o2::analysis::AxisBinning axisBinning; // used for uniform bins
+  double xMin = 0., xMax = 0., invCellWidth = 0.;
+  int nBins = 0;
+  bool uniformBins = true;
+
+  void build(const TH1* h, int granularity)
+  {
+    const TAxis* axis = h->GetXaxis();
+    nBins = axis->GetNbins();
+    xMin = axis->GetXmin();
+    xMax = axis->GetXmax();
+    axisBinning.set(axis);
+    uniformBins = axisBinning.fixedWidth;
+    binContent.resize(nBins + 2);
+    binCenter.resize(nBins + 2);
+    binUpEdge.resize(nBins + 2);
+    double minWidth = xMax - xMin;
+    for (int ibin = 0; ibin <= nBins + 1; ibin++) {
+      binContent[ibin] = h->GetBinContent(ibin);
+      binCenter[ibin] = axis->GetBinCenter(ibin);
+      binUpEdge[ibin] = (ibin <= nBins) ? axis->GetBinUpEdge(ibin) : xMax;
+      if (ibin >= 1 && ibin <= nBins) {
+        minWidth = std::min(minWidth, axis->GetBinWidth(ibin));
+      }
+    }
+    if (uniformBins) {
+      cellFirstBin.clear();
+      return;
+    }
+    const int nCells = std::clamp(static_cast<int>(granularity * (xMax - xMin) / minWidth), nBins, 1 << 20);
+    invCellWidth = nCells / (xMax - xMin);
+    cellFirstBin.resize(nCells);
+    int ibin = 1;
+    for (int icell = 0; icell < nCells; icell++) {
+      const double cellLow = xMin + icell / invCellWidth;
+      while (ibin < nBins && binUpEdge[ibin] <= cellLow) {
+        ibin++;
+      }
+      cellFirstBin[icell] = ibin;
+    }
+  }
+
+  int findBin(float x) const
+  {
+    if (uniformBins) {
+      return axisBinning.find(x);
+    }
+    // as TAxis::FindFixBin: NaN goes to the overflow
+    if (x < xMin) {
+      return 0;
+    }
+    if (!(x < xMax)) {
+      return nBins + 1;
+    }
+    const int icell = std::min(static_cast<int>((x - xMin) * invCellWidth), static_cast<int>(cellFirstBin.size()) - 1);
+    int ibin = cellFirstBin[icell];
+    // the cell can be off by one from rounding, the bin is then settled by the edges
+    while (ibin > 1 && x < binUpEdge[ibin - 1]) {
+      ibin--;
+    }
+    while (x >= binUpEdge[ibin]) {
+      ibin++;
+    }
+    return ibin;
+  }
+
+  float eval(float x, bool interpolate) const
+  {
+    const int ibin = findBin(x);
+    if (!interpolate || ibin < 1 || ibin > nBins) {
+      return binContent[ibin];
+    }
+    const int jbin = (x < binCenter[ibin]) ? ibin - 1 : ibin + 1;
+    if (jbin < 1 || jbin > nBins) {
+      return binContent[ibin];
+    }
+    const float fraction = (x - binCenter[ibin]) / (binCenter[jbin] - binCenter[ibin]);
+    return binContent[ibin] + fraction * (binContent[jbin] - binContent[ibin]);
+  }
+};
+
 struct CentralityTable {
   Produces<aod::CentRun2V0Ms> centRun2V0M;
   Produces<aod::CentRun2SPDTrks> centRun2SPDTracklets;
@@ -54,6 +149,10 @@ struct CentralityTable {
   Configurable<std::string> ccdbPath{"ccdbpath", "Centrality/Estimators", "The CCDB path for centrality/multiplicity information"};
   Configurable<std::string> genName{"genname", "", "Genearator name: HIJING, PYTHIA8, ... Default: \"\""};
   Configurable<bool> doNotCrashOnNull{"doNotCrashOnNull", false, {"Option to not crash on null and instead fill required tables with dummy info"}};
+  Configurable<int> lutGranularity{"lutGranularity", 4, {"Run3: lookup table cells per narrowest calibration bin (variable binning only)"}};
+  Configurable<bool> lutInterpolate{"lutInterpolate", false, {"Run3: interpolate percentiles linearly between calibration bin centers"}};
+  Configurable<bool> useMCScaleTable{"useMCScaleTable", false, {"Run3: evaluate the MC scaling from a precomputed table with linear interpolation instead of the exact formula"}};
+  Configurable<int> mcScaleTablePoints{"mcScaleTablePoints", 5000, {"Run3: number of points of the precomputed MC scaling table"}};
 
   int mRunNumber;
   struct tagRun2V0MCalibration {
@@ -91,6 +190,10 @@ struct CentralityTable {
     TH1* mhMultSelCalib = nullptr;
     float mMCScalePars[6] = {0.0};
     TFormula* mMCScale = nullptr;
+    PercentileLookupTable mLookup;         // built once per run from mhMultSelCalib
+    std::vector<float> mMCScaleTable;      // MC scaling tabulated on [0, mMCScaleTableMax]
+    float mMCScaleTableMax = 0.f;
+    std::vector<float> mMultiplicityBuffer; // multiplicities of the collisions of the current block
     calibrationInfo(std::string name)
       : name(name),
         mCalibrationStored(false),
@@ -100,6 +203,66 @@ struct CentralityTable {
     {
     }
   };
+
+  static float scaleMC(float x, const float pars[6])
+  {
+    return pow(((pars[0] + pars[1] * pow(x, pars[2])) - pars[3]) / pars[4], 1.0f / pars[5]);
+  }
+
+  /// Prepares the flat calibration representation of an estimator, once per run
+  void buildLookup(calibrationInfo& estimator)
+  {
+    estimator.mLookup.build(estimator.mhMultSelCalib, lutGranularity);
+    estimator.mMCScaleTable.clear();
+    if (estimator.mMCScale != nullptr && useMCScaleTable) {
+      const int nPoints = std::max(2, mcScaleTablePoints.value);
+      estimator.mMCScaleTableMax = estimator.mLookup.xMax;
+      estimator.mMCScaleTable.resize(nPoints);
+      for (int ipoint = 0; ipoint < nPoints; ipoint++) {
+        estimator.mMCScaleTable[ipoint] = scaleMC(estimator.mMCScaleTableMax * ipoint / (nPoints - 1), estimator.mMCScalePars);
+      }
+    }
+  }
+
+  /// Converts all buffered multiplicities of an estimator into percentiles and fills its table
+  template <typename TTable>
+  void flushEstimator(TTable& table, calibrationInfo& estimator)
+  {
+    auto& multiplicities = estimator.mMultiplicityBuffer;
+    const size_t nCollisions = multiplicities.size();
+    if (!estimator.mCalibrationStored) {
+      for (size_t i = 0; i < nCollisions; i++) {
+        table(105.0f);
+      }
+      multiplicities.clear();
+      return;
+    }
+    if (estimator.mMCScale != nullptr) {
+      if (!estimator.mMCScaleTable.empty()) {
+        const float step = estimator.mMCScaleTableMax / (estimator.mMCScaleTable.size() - 1);
+        const float invStep = 1.f / step;
+        const int lastPoint = estimator.mMCScaleTable.size() - 1;
+        for (size_t i = 0; i < nCollisions; i++) {
+          const float x = multiplicities[i];
+          if (x >= 0.f && x < estimator.mMCScaleTableMax) {
+            const int ipoint = std::min(static_cast<int>(x * invStep), lastPoint - 1);
+            const float fraction = x * invStep - ipoint;
+            multiplicities[i] = estimator.mMCScaleTable[ipoint] + fraction * (estimator.mMCScaleTable[ipoint + 1] - estimator.mMCScaleTable[ipoint]);
+          } else {
+            multiplicities[i] = scaleMC(x, estimator.mMCScalePars);
+          }
+        }
+      } else {
+        for (size_t i = 0; i < nCollisions; i++) {
+          multiplicities[i] = scaleMC(multiplicities[i], estimator.mMCScalePars);
+        }
+      }
+    }
+    for (size_t i = 0; i < nCollisions; i++) {
+      table(estimator.mLookup.eval(multiplicities[i], lutInterpolate));
+    }
+    multiplicities.clear();
+  }
   calibrationInfo FV0AInfo = calibrationInfo("FV0");
   calibrationInfo FT0MInfo = calibrationInfo("FT0");
   calibrationInfo FT0AInfo = calibrationInfo("FT0A");
@@ -337,10 +500,34 @@ struct CentralityTable {
     if (estNTPV == 1) {
       centNTPV.reserve(collisions.size());
     }
+    // Multiplicities are buffered per estimator and converted to percentiles in one pass per estimator.
+    // The buffers are flushed when the calibration changes (new run) and at the end of the DF.
+    auto flushAll = [&]() {
+      if (estFV0A == 1) {
+        flushEstimator(centFV0A, FV0AInfo);
+      }
+      if (estFT0M == 1) {
+        flushEstimator(centFT0M, FT0MInfo);
+      }
+      if (estFT0A == 1) {
+        flushEstimator(centFT0A, FT0AInfo);
+      }
+      if (estFT0C == 1) {
+        flushEstimator(centFT0C, FT0CInfo);
+      }
+      if (estFDDM == 1) {
+        flushEstimator(centFDDM, FDDMInfo);
+      }
+      if (estNTPV == 1) {
+        flushEstimator(centNTPV, NTPVInfo);
+      }
+    };
+
     for (auto const& collision : collisions) {
       /* check the previous run number */
       auto bc = collision.bc_as<BCsWithTimestamps>();
       if (bc.runNumber() != mRunNumber) {
+        flushAll();
         LOGF(info, "timestamp=%llu, run number=%d", bc.timestamp(), bc.runNumber());
         TList* callst = ccdb->getForTimeStamp<TList>(ccdbPath, bc.timestamp());
 
@@ -352,7 +539,7 @@ struct CentralityTable {
         NTPVInfo.mCalibrationStored = false;
         if (callst != nullptr) {
           LOGF(info, "Getting new histograms with %d run number for %d run number", mRunNumber, bc.runNumber());
-          auto getccdb = [callst, bc](struct calibrationInfo& estimator, const Configurable<std::string> generatorName) { // TODO: to consider the name inside the estimator structure
+          auto getccdb = [this, callst, bc](struct calibrationInfo& estimator, const Configurable<std::string> generatorName) { // TODO: to consider the name inside the estimator structure
             estimator.mhMultSelCalib = (TH1*)callst->FindObject(TString::Format("hCalibZeq%s", estimator.name.c_str()).Data());
             estimator.mMCScale = (TFormula*)callst->FindObject(TString::Format("%s-%s", generatorName->c_str(), estimator.name.c_str()).Data());
             if (estimator.mhMultSelCalib != nullptr) {
@@ -366,6 +553,7 @@ struct CentralityTable {
                 }
               }
               estimator.mCalibrationStored = true;
+              buildLookup(estimator);
             } else {
               LOGF(error, "Calibration information from %s for run %d not available", estimator.name.c_str(), bc.runNumber());
             }
@@ -399,43 +587,26 @@ struct CentralityTable {
         }
       }
 
-      auto populateTable = [](auto& table, struct calibrationInfo& estimator, float multiplicity) {
-        auto scaleMC = [](float x, float pars[6]) {
-          return pow(((pars[0] + pars[1] * pow(x, pars[2])) - pars[3]) / pars[4], 1.0f / pars[5]);
-        };
-
-        float percentile = 105.0f;
-        float scaledMultiplicity = multiplicity;
-        if (estimator.mCalibrationStored) {
-          if (estimator.mMCScale != nullptr) {
-            scaledMultiplicity = scaleMC(multiplicity, estimator.mMCScalePars);
-            LOGF(debug, "Unscaled %s multiplicity: %f, scaled %s multiplicity: %f", estimator.name.c_str(), multiplicity, estimator.name.c_str(), scaledMultiplicity);
-          }
-          percentile = estimator.mhMultSelCalib->GetBinContent(estimator.mhMultSelCalib->FindFixBin(scaledMultiplicity));
-        }
-        LOGF(debug, "%s centrality/multiplicity percentile = %.0f for a zvtx eq %s value %.0f", estimator.name.c_str(), percentile, estimator.name.c_str(), scaledMultiplicity);
-        table(percentile);
-      };
-
       if (estFV0A == 1) {
-        populateTable(centFV0A, FV0AInfo, collision.multZeqFV0A());
+        FV0AInfo.mMultiplicityBuffer.push_back(collision.multZeqFV0A());
       }
       if (estFT0M == 1) {
-        populateTable(centFT0M, FT0MInfo, collision.multZeqFT0A() + collision.multZeqFT0C());
+        FT0MInfo.mMultiplicityBuffer.push_back(collision.multZeqFT0A() + collision.multZeqFT0C());
       }
       if (estFT0A == 1) {
-        populateTable(centFT0A, FT0AInfo, collision.multZeqFT0A());
+        FT0AInfo.mMultiplicityBuffer.push_back(collision.multZeqFT0A());
       }
       if (estFT0C == 1) {
-        populateTable(centFT0C, FT0CInfo, collision.multZeqFT0C());
+        FT0CInfo.mMultiplicityBuffer.push_back(collision.multZeqFT0C());
       }
       if (estFDDM == 1) {
-        populateTable(centFDDM, FDDMInfo, collision.multZeqFDDA() + collision.multZeqFDDC());
+        FDDMInfo.mMultiplicityBuffer.push_back(collision.multZeqFDDA() + collision.multZeqFDDC());
       }
       if (estNTPV == 1) {
-        populateTable(centNTPV, NTPVInfo, collision.multZeqNTracksPV());
+        NTPVInfo.mMultiplicityBuffer.push_back(collision.multZeqNTracksPV());
       }
     }
+    flushAll();
   }
   PROCESS_SWITCH(CentralityTable, processRun3, "Provide Run3 calibrated centrality/multiplicity percentiles tables", false);
 };
@@ -55,6 +55,16 @@ struct TrackSelectionTask {
   TrackSelection filtBit3;
   TrackSelection filtBit4;
   TrackSelection filtBit5;
+  // all the selections above, evaluated together for each track
+  enum SelectionIndex { kGlobal = 0,
+                        kGlobalSDD,
+                        kFiltBit1,
+                        kFiltBit2,
+                        kFiltBit3,
+                        kFiltBit4,
+                        kFiltBit5,
+                        kNSelections };
+  TrackSelectionSet selections;
 
   void init(InitContext&)
   {
@@ -116,6 +126,15 @@ struct TrackSelectionTask {
 
     LOG(info) << "setting up filtBit5 = getJEGlobalTrackSelectionRun2();";
     filtBit5 = getJEGlobalTrackSelectionRun2(); // Jet validation requires reduced set of cuts
+
+    // the order must follow SelectionIndex
+    selections.AddSelection(globalTracks);
+    selections.AddSelection(globalTracksSDD);
+    selections.AddSelection(filtBit1);
+    selections.AddSelection(filtBit2);
+    selections.AddSelection(filtBit3);
+    selections.AddSelection(filtBit4);
+    selections.AddSelection(filtBit5);
   }
 
   void process(soa::Join<aod::FullTracks, aod::TracksDCA> const& tracks)
@@ -124,22 +143,21 @@ struct TrackSelectionTask {
     if (produceFBextendedTable) {
       filterTableDetail.reserve(tracks.size());
     }
+    uint16_t masks[kNSelections];
     if (isRun3) {
       for (auto& track : tracks) {
-        o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = globalTracks.IsSelectedMask(track);
-        o2::aod::track::TrackSelectionFlags::flagtype trackflagFB1 = filtBit1.IsSelectedMask(track);
-        o2::aod::track::TrackSelectionFlags::flagtype trackflagFB2 = filtBit2.IsSelectedMask(track);
-        // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB3 = filtBit3.IsSelectedMask(track); // only temporarily commented, will be used
-        // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB4 = filtBit4.IsSelectedMask(track);
-        // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB5 = filtBit5.IsSelectedMask(track);
+        selections.IsSelectedMask(track, masks);
+        o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = masks[kGlobal];
+        o2::aod::track::TrackSelectionFlags::flagtype trackflagFB1 = masks[kFiltBit1];
+        o2::aod::track::TrackSelectionFlags::flagtype trackflagFB2 = masks[kFiltBit2];
 
         filterTable((uint8_t)0,
-                    globalTracks.IsSelectedMask(track),
-                    filtBit1.IsSelected(track),
-                    filtBit2.IsSelected(track),
-                    filtBit3.IsSelected(track),
-                    filtBit4.IsSelected(track),
-                    filtBit5.IsSelected(track));
+                    masks[kGlobal],
+                    TrackSelectionSet::IsSelected(masks[kFiltBit1]),
+                    TrackSelectionSet::IsSelected(masks[kFiltBit2]),
+                    TrackSelectionSet::IsSelected(masks[kFiltBit3]),
+                    TrackSelectionSet::IsSelected(masks[kFiltBit4]),
+                    TrackSelectionSet::IsSelected(masks[kFiltBit5]));
         if (produceFBextendedTable) {
           filterTableDetail(o2::aod::track::TrackSelectionFlags::checkFlag(trackflagGlob, o2::aod::track::TrackSelectionFlags::kTrackType),
                             o2::aod::track::TrackSelectionFlags::checkFlag(trackflagGlob, o2::aod::track::TrackSelectionFlags::kPtRange),
@@ -164,14 +182,15 @@ struct TrackSelectionTask {
     }
 
     for (auto& track : tracks) {
-      o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = globalTracks.IsSelectedMask(track);
-      filterTable((uint8_t)globalTracksSDD.IsSelected(track),
-                  globalTracks.IsSelectedMask(track),
-                  filtBit1.IsSelected(track),
-                  filtBit2.IsSelected(track),
-                  filtBit3.IsSelected(track),
-                  filtBit4.IsSelected(track),
-                  filtBit5.IsSelected(track));
+      selections.IsSelectedMask(track, masks);
+      o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = masks[kGlobal];
+      filterTable((uint8_t)TrackSelectionSet::IsSelected(masks[kGlobalSDD]),
+                  masks[kGlobal],
+                  TrackSelectionSet::IsSelected(masks[kFiltBit1]),
+                  TrackSelectionSet::IsSelected(masks[kFiltBit2]),
+                  TrackSelectionSet::IsSelected(masks[kFiltBit3]),
+                  TrackSelectionSet::IsSelected(masks[kFiltBit4]),
+                  TrackSelectionSet::IsSelected(masks[kFiltBit5]));
       if (produceFBextendedTable) {
         filterTableDetail(o2::aod::track::TrackSelectionFlags::checkFlag(trackflagGlob, o2::aod::track::TrackSelectionFlags::kTrackType),
                           o2::aod::track::TrackSelectionFlags::checkFlag(trackflagGlob, o2::aod::track::TrackSelectionFlags::kPtRange),
@@ -33,6 +33,86 @@
 #include "TVirtualFitter.h"
 #include "TProfile.h"
 #include "TFitResult.h"
+#include "Math/Minimizer.h"
+#include "Math/Factory.h"
+#include "Math/Functor.h"
+#include "Math/MinimizerOptions.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//________________________________________________________________
+//Worker threads kept alive for a whole fit and woken at every chi2 evaluation
+class multGlauberNBDWorkers
+{
+ public:
+  multGlauberNBDWorkers(Int_t lNWorkers)
+  {
+    for (Int_t it = 1; it <= lNWorkers; it++)
+      fThreads.emplace_back([this, it]() { Loop(it); });
+  }
+  ~multGlauberNBDWorkers()
+  {
+    {
+      std::lock_guard<std::mutex> lLock(fMutex);
+      fStop = true;
+    }
+    fWake.notify_all();
+    for (auto& lThread : fThreads)
+      lThread.join();
+  }
+  Int_t GetNThreads() const { return fThreads.size() + 1; }
+
+  //Runs lTask(it) for it = 0 ... GetNThreads()-1, it = 0 on the calling thread
+  void Run(const std::function<void(Int_t)>& lTask)
+  {
+    {
+      std::lock_guard<std::mutex> lLock(fMutex);
+      fTask = &lTask;
+      fPending = fThreads.size();
+      fGeneration++;
+    }
+    fWake.notify_all();
+    lTask(0);
+    std::unique_lock<std::mutex> lLock(fMutex);
+    fDone.wait(lLock, [this]() { return fPending == 0; });
+    fTask = nullptr;
+  }
+
+ private:
+  void Loop(Int_t it)
+  {
+    Long_t lSeen = 0;
+    while (true) {
+      const std::function<void(Int_t)>* lTask = nullptr;
+      {
+        std::unique_lock<std::mutex> lLock(fMutex);
+        fWake.wait(lLock, [this, lSeen]() { return fStop || fGeneration != lSeen; });
+        if (fStop)
+          return;
+        lSeen = fGeneration;
+        lTask = fTask;
+      }
+      (*lTask)(it);
+      std::lock_guard<std::mutex> lLock(fMutex);
+      if (--fPending == 0)
+        fDone.notify_one();
+    }
+  }
+
+  std::vector<std::thread> fThreads;
+  std::mutex fMutex;
+  std::condition_variable fWake;
+  std::condition_variable fDone;
+  const std::function<void(Int_t)>* fTask = nullptr;
+  Long_t fGeneration = 0;
+  Long_t fPending = 0;
+  bool fStop = false;
+};
 
 ClassImp(multGlauberNBDFitter);
 
@@ -53,7 +133,13 @@ multGlauberNBDFitter::multGlauberNBDFitter() : TNamed(),
                                                ff(0.8),
                                                fnorm(100),
                                                fFitOptions("R0"),
-                                               fFitNpx(5000)
+                                               fFitNpx(5000),
+                                               fFastFit(kTRUE),
+                                               fNThreads(1),
+                                               fWorkers(0x0),
+                                               fAncCurrentf(-1),
+                                               fLatticeOrigin(0),
+                                               fLatticeSize(0)
 {
   // Constructor
   fNpart = new Double_t[fMaxNpNcPairs];
@@ -93,7 +179,13 @@ multGlauberNBDFitter::multGlauberNBDFitter(const char* name, const char* title)
                                                                                   ff(0.8),
                                                                                   fnorm(100),
                                                                                   fFitOptions("R0"),
-                                                                                  fFitNpx(5000)
+                                                                                  fFitNpx(5000),
+                                                                                  fFastFit(kTRUE),
+                                                                                  fNThreads(1),
+                                                                                  fWorkers(0x0),
+                                                                                  fAncCurrentf(-1),
+                                                                                  fLatticeOrigin(0),
+                                                                                  fLatticeSize(0)
 {
   //Named constructor
   fNpart = new Double_t[fMaxNpNcPairs];
@@ -279,6 +371,15 @@ Bool_t multGlauberNBDFitter::DoFit()
     cout << "---> Config: Nancestors will be taken as float" << endl;
   cout << "---> Now fitting, please wait..." << endl;
 
+  //Likelihood and integral fits still need the TF1 interface
+  if (fFastFit && !fFitOptions.Contains("L", TString::kIgnoreCase) && !fFitOptions.Contains("I", TString::kIgnoreCase)) {
+    Bool_t lFastFitValid = DoFastFit();
+    timer->Stop();
+    cout << "---> Fitting took " << timer->RealTime() << " seconds" << endl;
+    delete timer;
+    return lFastFitValid;
+  }
+
   fGlauberNBD->SetNpx(fFitNpx);
   TFitResultPtr fitptr;
   fFitOptions.Append("S");
@@ -296,6 +397,275 @@ Bool_t multGlauberNBDFitter::DoFit()
   return fitptr.Get()->IsValid();
 }
 
+//________________________________________________________________
+Bool_t multGlauberNBDFitter::BuildAncestorDistribution(Double_t lf)
+{
+  //Fills the flat ancestor distribution for this value of f
+  //Binning follows fhNanc, but no TH1::Fill is involved
+  const Double_t lAlmost0 = 1.e-13;
+  if (TMath::Abs(fAncCurrentf - lf) < lAlmost0 && !fAncWeight.empty())
+    return kTRUE;
+
+  const Int_t lNBins = fhNanc->GetNbinsX();
+  const Double_t lLow = fhNanc->GetXaxis()->GetXmin();
+  const Double_t lInvWidth = lNBins / (fhNanc->GetXaxis()->GetXmax() - lLow);
+  std::vector<Double_t> lContent(lNBins, 0.0);
+  for (Long_t ibin = 0; ibin < fNNpNcPairs; ibin++) {
+    Double_t lNanc = fNpart[ibin] * lf + fNcoll[ibin] * (1.0 - lf);
+    if (fAncestorMode == 0)
+      lNanc = (Int_t)lNanc;
+    if (fAncestorMode == 1)
+      lNanc = TMath::Floor(lNanc + 0.5);
+    Double_t lPosition = (lNanc - lLow) * lInvWidth;
+    if (lPosition < 0 || lPosition >= lNBins)
+      continue; //under/overflow, as in fhNanc
+    lContent[(Long_t)lPosition] += fContent[ibin];
+  }
+
+  //Keep only populated bins above the one containing zero (as in ProbDistrib)
+  fAncCenter.clear();
+  fAncWeight.clear();
+  Double_t lIntegral = 0.0;
+  for (Int_t ibin = 0; ibin < lNBins; ibin++)
+    lIntegral += lContent[ibin];
+  if (lIntegral < 1) {
+    cout << "ERROR: ANCESTOR HISTOGRAM EMPTY" << endl;
+    return kFALSE;
+  }
+  const Int_t lStartBin = fhNanc->FindBin(0.0); //first bin to use, 0-based
+  for (Int_t ibin = lStartBin; ibin < lNBins; ibin++) {
+    if (lContent[ibin] <= 0)
+      continue;
+    fAncCenter.push_back(fhNanc->GetBinCenter(ibin + 1));
+    fAncWeight.push_back(lContent[ibin] / lIntegral);
+  }
+  fAncCurrentf = lf;
+  return kTRUE;
+}
+
+//________________________________________________________________
+Bool_t multGlauberNBDFitter::InitializeFitBins()
+{
+  //Determines bins of fhV0M to fit and a unit-spaced lattice covering them
+  //The NBD obeys P(x+1) = P(x) (x+k)/(x+1) mu/(mu+k), also for non-integer x,
+  //so it can be computed on the lattice by recurrence only
+  Double_t lLoRange, lHiRange;
+  fGlauberNBD->GetRange(lLoRange, lHiRange);
+  fFitBins.clear();
+  fFitX.clear();
+  for (Int_t ibin = 1; ibin <= fhV0M->GetNbinsX(); ibin++) {
+    Double_t lCenter = fhV0M->GetBinCenter(ibin);
+    if (lCenter < lLoRange || lCenter > lHiRange)
+      continue;
+    fFitBins.push_back(ibin);
+    //modes 0 and 1 evaluate the (integer) NBD at truncated x
+    fFitX.push_back(fAncestorMode != 2 ? TMath::Floor(lCenter) : lCenter);
+  }
+  if (fFitBins.empty()) {
+    cout << "No bins of the input histogram in fit range!" << endl;
+    return kFALSE;
+  }
+  fLatticeOrigin = fFitX.front();
+  fLatticeSize = (Long_t)TMath::Ceil(fFitX.back() - fLatticeOrigin) + 2;
+  fLattice.assign(fLatticeSize, 0.0);
+  fThreadBuffers.assign(fLatticeSize * fNThreads, 0.0);
+  return kTRUE;
+}
+
+//________________________________________________________________
+void multGlauberNBDFitter::ConvolveAncestors(Long_t lFirst, Long_t lLast, Double_t lMu, Double_t lk, Double_t* lBuffer)
+{
+  //The recurrence starts at the NBD mode (computed once with LnGamma)
+  //and walks outwards until the contribution becomes negligible
+  const Double_t lCutoff = 1.e-18;
+  const Double_t lq = lMu / (lMu + lk); //independent of Nancestors
+  const Double_t lLogq = TMath::Log(lq);
+  const Double_t lLog1mq = TMath::Log(1.0 - lq);
+  //First lattice point that is evaluated at all (ProbDistrib gives 0 otherwise)
+  const Long_t lFirstPoint = fLatticeOrigin > 1e-6 ? 0 : (Long_t)TMath::Floor(1e-6 - fLatticeOrigin) + 1;
+  if (lFirstPoint >= fLatticeSize)
+    return;
+
+  for (Long_t iAnc = lFirst; iAnc < lLast; iAnc++) {
+    const Double_t lThisk = fAncCenter[iAnc] * lk;
+    const Double_t lWeight = fAncWeight[iAnc];
+    Double_t lMode = (lThisk * lq - 1.0) / (1.0 - lq);
+    Long_t lStart = (Long_t)TMath::Floor(lMode - fLatticeOrigin + 0.5);
+    lStart = std::min(std::max(lStart, lFirstPoint), fLatticeSize - 1);
+
+    const Double_t x0 = fLatticeOrigin + lStart;
+    const Double_t lP0 = lWeight * TMath::Exp(TMath::LnGamma(x0 + lThisk) - TMath::LnGamma(x0 + 1.) - TMath::LnGamma(lThisk) + x0 * lLogq + lThisk * lLog1mq);
+    if (lP0 <= 0)
+      continue;
+    const Double_t lThreshold = lP0 * lCutoff;
+    lBuffer[lStart] += lP0;
+
+    //upwards: P(x+1) = P(x) (x+k)/(x+1) q
+    Double_t lP = lP0;
+    for (Long_t n = lStart + 1; n < fLatticeSize; n++) {
+      const Double_t x = fLatticeOrigin + n - 1;
+      lP *= lq * (x + lThisk) / (x + 1.);
+      if (lP < lThreshold && x > lMode)
+        break;
+      lBuffer[n] += lP;
+    }
+    //downwards: P(x-1) = P(x) x/((x-1+k) q)
+    lP = lP0;
+    for (Long_t n = lStart - 1; n >= lFirstPoint; n--) {
+      const Double_t x = fLatticeOrigin + n + 1;
+      lP *= x / ((x - 1. + lThisk) * lq);
+      if (lP < lThreshold && x < lMode)
+        break;
+      lBuffer[n] += lP;
+    }
+  }
+}
+
+//________________________________________________________________
+Bool_t multGlauberNBDFitter::EvaluateHistogram(const Double_t* par, Double_t* lOutput)
+{
+  //Evaluates the full Glauber+NBD prediction at all fitted bins at once
+  //Ancestor bins are split across the worker threads of the fit, each with its own buffer
+  if (fFitBins.empty() || fLattice.empty())
+    return kFALSE;
+  if (!BuildAncestorDistribution(par[2]))
+    return kFALSE;
+
+  const Long_t lNAnc = fAncCenter.size();
+  const Int_t lNThreads = fWorkers ? std::min<Long_t>(fWorkers->GetNThreads(), std::max<Long_t>(1, lNAnc)) : 1;
+  if ((Long_t)fThreadBuffers.size() < fLatticeSize * lNThreads)
+    fThreadBuffers.assign(fLatticeSize * lNThreads, 0.0);
+  std::fill(fThreadBuffers.begin(), fThreadBuffers.begin() + fLatticeSize * lNThreads, 0.0);
+
+  if (lNThreads == 1) {
+    ConvolveAncestors(0, lNAnc, par[0], par[1], fThreadBuffers.data());
+  } else {
+    const Long_t lChunk = (lNAnc + lNThreads - 1) / lNThreads;
+    fWorkers->Run([this, lChunk, lNAnc, lNThreads, par](Int_t it) {
+      if (it >= lNThreads)
+        return;
+      Long_t lFirst = it * lChunk;
+      Long_t lLast = std::min(lNAnc, lFirst + lChunk);
+      ConvolveAncestors(lFirst, lLast, par[0], par[1], fThreadBuffers.data() + it * fLatticeSize);
+    });
+  }
+
+  //Reduction over thread buffers (contiguous, vectorizable)
+  Double_t* lLattice = fLattice.data();
+  std::copy(fThreadBuffers.begin(), fThreadBuffers.begin() + fLatticeSize, fLattice.begin());
+  for (Int_t it = 1; it < lNThreads; it++) {
+    const Double_t* lBuffer = fThreadBuffers.data() + it * fLatticeSize;
+    for (Long_t n = 0; n < fLatticeSize; n++)
+      lLattice[n] += lBuffer[n];
+  }
+
+  //Lattice to bins: exact for integer bin widths, linear interpolation otherwise
+  const Long_t lNFitBins = fFitX.size();
+  for (Long_t i = 0; i < lNFitBins; i++) {
+    Double_t lPosition = fFitX[i] - fLatticeOrigin;
+    Long_t n = (Long_t)lPosition;
+    Double_t lFrac = lPosition - n;
+    Double_t lValue = lLattice[n];
+    if (lFrac > 1e-9 && n + 1 < fLatticeSize)
+      lValue += lFrac * (lLattice[n + 1] - lLattice[n]);
+    lOutput[i] = fFitX[i] > 1e-6 ? par[3] * lValue : 0.0;
+  }
+  return kTRUE;
+}
+
+//________________________________________________________________
+Double_t multGlauberNBDFitter::Chi2(const Double_t* par)
+{
+  //Same definition as the default TH1::Fit chi2: empty bins are skipped
+  std::vector<Double_t> lPrediction(fFitBins.size(), 0.0);
+  if (!EvaluateHistogram(par, lPrediction.data()))
+    return 1e+30;
+  Double_t lChi2 = 0.0;
+  for (size_t i = 0; i < fFitBins.size(); i++) {
+    Double_t lContent = fhV0M->GetBinContent(fFitBins[i]);
+    Double_t lError = fhV0M->GetBinError(fFitBins[i]);
+    if (lContent == 0 || lError <= 0)
+      continue;
+    Double_t lResidual = (lContent - lPrediction[i]) / lError;
+    lChi2 += lResidual * lResidual;
+  }
+  return lChi2;
+}
+
+//________________________________________________________________
+Bool_t multGlauberNBDFitter::DoFastFit()
+{
+  //Minimizes the chi2 of the whole histogram directly, without TF1 calls
+  InitAncestor();
+  if (fNNpNcPairs < 0 && !InitializeNpNc())
+    return kFALSE;
+  if (!fhV0M) {
+    cout << "Please provide input histogram with SetInputV0M before fitting!" << endl;
+    return kFALSE;
+  }
+  if (!InitializeFitBins())
+    return kFALSE;
+  fAncCurrentf = -1;
+
+  std::unique_ptr<ROOT::Math::Minimizer> lMinimizer(ROOT::Math::Factory::CreateMinimizer(ROOT::Math::MinimizerOptions::DefaultMinimizerType().c_str(), ROOT::Math::MinimizerOptions::DefaultMinimizerAlgo().c_str()));
+  if (!lMinimizer) {
+    cout << "Could not create minimizer!" << endl;
+    return kFALSE;
+  }
+  ROOT::Math::Functor lChi2Functor([this](const Double_t* par) { return Chi2(par); }, 4);
+  lMinimizer->SetFunction(lChi2Functor);
+  lMinimizer->SetMaxFunctionCalls(5000000);
+  lMinimizer->SetMaxIterations(5000000);
+  lMinimizer->SetErrorDef(1.0);
+  if (fFitOptions.Contains("Q"))
+    lMinimizer->SetPrintLevel(0);
+
+  const char* lParName[4] = {"mu", "k", "f", "norm"};
+  for (Int_t ipar = 0; ipar < 4; ipar++) {
+    Double_t lValue = fGlauberNBD->GetParameter(ipar);
+    Double_t lLow, lHigh;
+    fGlauberNBD->GetParLimits(ipar, lLow, lHigh);
+    Double_t lStep = fGlauberNBD->GetParError(ipar) > 0 ? fGlauberNBD->GetParError(ipar) : TMath::Max(0.1 * TMath::Abs(lValue), 0.01);
+    if (lLow * lHigh != 0 && lLow >= lHigh) {
+      lMinimizer->SetFixedVariable(ipar, lParName[ipar], lValue);
+    } else if (lLow < lHigh) {
+      lMinimizer->SetLimitedVariable(ipar, lParName[ipar], lValue, lStep, lLow, lHigh);
+    } else {
+      lMinimizer->SetVariable(ipar, lParName[ipar], lValue, lStep);
+    }
+  }
+  //Worker threads are started once for the whole minimization
+  std::unique_ptr<multGlauberNBDWorkers> lWorkers;
+  if (fNThreads > 1)
+    lWorkers = std::make_unique<multGlauberNBDWorkers>(fNThreads - 1);
+  fWorkers = lWorkers.get();
+  Bool_t lValid = lMinimizer->Minimize();
+  fWorkers = 0x0;
+  lWorkers.reset();
+
+  const Double_t* lResult = lMinimizer->X();
+  const Double_t* lErrors = lMinimizer->Errors();
+  for (Int_t ipar = 0; ipar < 4; ipar++) {
+    fGlauberNBD->SetParameter(ipar, lResult[ipar]);
+    if (lErrors)
+      fGlauberNBD->SetParError(ipar, lErrors[ipar]);
+  }
+  fGlauberNBD->SetChisquare(lMinimizer->MinValue());
+  fMu = lResult[0];
+  fk = lResult[1];
+  ff = lResult[2];
+  fnorm = lResult[3];
+
+  //Keep ancestor histogram available for inspection
+  fCurrentf = -1;
+  if (BuildAncestorDistribution(ff)) {
+    fhNanc->Reset();
+    for (size_t i = 0; i < fAncCenter.size(); i++)
+      fhNanc->Fill(fAncCenter[i], fAncWeight[i]);
+  }
+  return lValid;
+}
+
 //________________________________________________________________
 Bool_t multGlauberNBDFitter::InitializeNpNc()
 {
@@ -13,6 +13,7 @@
 #define MULTGLAUBERNBDFITTER_H
 
 #include <iostream>
+#include <vector>
 #include "TNamed.h"
 #include "TF1.h"
 #include "TH1.h"
@@ -21,6 +22,7 @@
 #include "TProfile.h"
 
 using namespace std;
+class multGlauberNBDWorkers;
 class multGlauberNBDFitter : public TNamed
 {
 
@@ -38,6 +40,16 @@ class multGlauberNBDFitter : public TNamed
   //Do Fit: where everything happens
   Bool_t DoFit();
 
+  //Fast fit: chi2 of the whole histogram handed directly to the minimizer
+  Bool_t DoFastFit();
+
+  //Whole-histogram evaluator: fills lOutput[i] with the Glauber+NBD
+  //prediction for each of the fitted bins of the V0M histogram
+  Bool_t EvaluateHistogram(const Double_t* par, Double_t* lOutput);
+
+  //Chi2 of the current input with respect to parameters par
+  Double_t Chi2(const Double_t* par);
+
   //Set input characteristics: the 2D plot with Npart, Nanc
   Bool_t SetNpartNcollCorrelation(TH2* hNpNc);
 
@@ -72,6 +84,12 @@ class multGlauberNBDFitter : public TNamed
   void SetFitOptions(TString lOpt);
   void SetFitNpx(Long_t lNpx);
 
+  //Fast fit configuration
+  void SetFastFit(Bool_t lFastFit = kTRUE) { fFastFit = lFastFit; }
+  Bool_t GetFastFit() { return fFastFit; }
+  void SetNThreads(Int_t lNThreads) { fNThreads = lNThreads > 0 ? lNThreads : 1; }
+  Int_t GetNThreads() { return fNThreads; }
+
   //For ancestor mode 2
   Double_t ContinuousNBD(Double_t n, Double_t mu, Double_t k);
 
@@ -81,6 +99,15 @@ class multGlauberNBDFitter : public TNamed
   //void    Print(Option_t *option="") const;
 
  private:
+  //Flat ancestor distribution for a given f (same binning as fhNanc)
+  Bool_t BuildAncestorDistribution(Double_t lf);
+
+  //Prepares list of fitted bins and the unit-spaced evaluation lattice
+  Bool_t InitializeFitBins();
+
+  //Adds the NBD of ancestor bins [lFirst, lLast) times their weight to lBuffer
+  void ConvolveAncestors(Long_t lFirst, Long_t lLast, Double_t lMu, Double_t lk, Double_t* lBuffer);
+
   //This function serves as the (analytical) NBD
   TF1* fNBD;
 
@@ -115,6 +142,24 @@ class multGlauberNBDFitter : public TNamed
   TString fFitOptions;
   Long_t fFitNpx;
 
-  ClassDef(multGlauberNBDFitter, 1);
+  //Fast fit: configuration
+  Bool_t fFastFit;
+  Int_t fNThreads;
+  multGlauberNBDWorkers* fWorkers; //! persistent threads, alive during the fast fit only
+
+  //Fast fit: flat ancestor distribution (bin centers and weights)
+  std::vector<Double_t> fAncCenter; //!
+  std::vector<Double_t> fAncWeight; //!
+  Double_t fAncCurrentf;            //!
+
+  //Fast fit: fitted bins and evaluation lattice x = fLatticeOrigin + n
+  std::vector<Int_t> fFitBins;          //!
+  std::vector<Double_t> fFitX;          //!
+  std::vector<Double_t> fLattice;       //!
+  std::vector<Double_t> fThreadBuffers; //!
+  Double_t fLatticeOrigin;              //!
+  Long_t fLatticeSize;                  //!
+
+  ClassDef(multGlauberNBDFitter, 2);
 };
 #endif
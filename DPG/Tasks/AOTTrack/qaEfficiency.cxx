@@ -24,6 +24,7 @@
 #include "ReconstructionDataFormats/DCA.h"
 #include "ReconstructionDataFormats/Track.h"
 #include "Common/Core/TrackSelection.h"
+#include "Common/Core/HistogramAccumulator.h"
 #include "Common/DataModel/EventSelection.h"
 #include "Common/Core/TrackSelectionDefaults.h"
 #include "Common/DataModel/TrackSelectionTables.h"
@@ -33,8 +34,112 @@
 #include "TEfficiency.h"
 #include "THashList.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
 using namespace o2::framework;
 
+/// \brief Accumulator of the counts of the MC efficiency histograms
+///
+/// The histograms of each particle (index) are registered once, with the variables to be used on their axes.
+/// For each track or particle the caller gives the mask of the histograms to be filled and the values of the
+/// variables: the counts are incremented in flat arrays indexed by the global bin of ROOT and are merged into
+/// the histograms by flush(). Only the cells touched since the last flush are visited.
+class EfficiencyAccumulator
+{
+ public:
+  static constexpr int maxHistograms = 64; /// One bit of the mask per histogram of a particle
+
+  void setNIndices(int nIndices) { mSlots.assign(nIndices * maxHistograms, Slot{}); }
+
+  /// Registers a histogram
+  /// \param index is the index of the particle
+  /// \param histogram is the position of the histogram in the mask
+  /// \param varX is the variable on the x axis
+  /// \param varY is the variable on the y axis, -1 for 1D histograms
+  void setHistogram(int index, int histogram, TH1* h, int varX, int varY = -1)
+  {
+    Slot& slot = mSlots[index * maxHistograms + histogram];
+    slot.hist = h;
+    slot.varX = varX;
+    slot.varY = varY;
+    slot.x.set(h->GetXaxis());
+    slot.nCellsX = slot.x.nBins + 2;
+    if (varY >= 0) {
+      slot.y.set(h->GetYaxis());
+    }
+    slot.offset = mCounts.size();
+    mCounts.resize(mCounts.size() + h->GetNcells());
+    mOffsets.push_back(slot.offset);
+    mOffsetSlots.push_back(index * maxHistograms + histogram);
+  }
+
+  /// \return true if at least one histogram is registered for the particle
+  bool hasHistograms(int index) const
+  {
+    for (int i = 0; i < maxHistograms; i++) {
+      if (mSlots[index * maxHistograms + i].hist) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Counts an entry in the histograms of the mask
+  void fill(int index, uint64_t mask, const float* values)
+  {
+    const Slot* slots = &mSlots[index * maxHistograms];
+    while (mask) {
+      const int histogram = std::countr_zero(mask);
+      mask &= mask - 1;
+      const Slot& slot = slots[histogram];
+      if (!slot.hist) {
+        continue;
+      }
+      int bin = slot.x.find(values[slot.varX]);
+      if (slot.varY >= 0) {
+        bin += slot.nCellsX * slot.y.find(values[slot.varY]);
+      }
+      mCounts.add(slot.offset + bin);
+    }
+  }
+
+  /// Adds the counts to the histograms and resets them
+  void flush()
+  {
+    mCounts.flush([&](uint32_t cell, uint32_t count) {
+      // the offsets are registered in increasing order: the slot is the last one starting at or before the cell
+      const size_t iOffset = std::upper_bound(mOffsets.begin(), mOffsets.end(), static_cast<size_t>(cell)) - mOffsets.begin() - 1;
+      const Slot& slot = mSlots[mOffsetSlots[iOffset]];
+      const int bin = cell - slot.offset;
+      slot.hist->AddBinContent(bin, count);
+      if (slot.hist->GetSumw2N() > 0) {
+        slot.hist->GetSumw2()->fArray[bin] += count;
+      }
+      slot.hist->SetEntries(slot.hist->GetEntries() + count);
+    });
+  }
+
+ private:
+  struct Slot {
+    TH1* hist = nullptr;
+    int varX = 0;
+    int varY = -1;
+    o2::analysis::AxisBinning x;
+    o2::analysis::AxisBinning y;
+    int nCellsX = 0;
+    size_t offset = 0;
+  };
+
+  std::vector<Slot> mSlots;
+  o2::analysis::DenseCounts mCounts;
+  std::vector<size_t> mOffsets;  /// first cell of each registered histogram, in increasing order
+  std::vector<int> mOffsetSlots; /// slot of each registered histogram
+};
+
 struct QaEfficiency {
   // Particle information
   static constexpr int nSpecies = o2::track::PID::NIDs; // One per PDG
@@ -95,6 +200,78 @@ struct QaEfficiency {
   HistogramRegistry histosNegPdg{"HistosNegPdg", {}, OutputObjHandlingPolicy::AnalysisObject};
   static constexpr int nHistograms = nSpecies * 2;
 
+  // Positions of the MC histograms of a particle in the mask of the efficiency accumulator
+  enum EffHistogram : int {
+    kPtIts = 0,
+    kPtTpc,
+    kPtItsTpc,
+    kPtItsTof,
+    kPtTpcTof,
+    kPtItsTpcTrd,
+    kPtItsTpcTof,
+    kPtItsTpcTrdTof,
+    kPtTrkItsTpc,
+    kPtGenerated,
+    kPtItsPrm,
+    kPtItsTpcPrm,
+    kPtTrkItsTpcPrm,
+    kPtItsTpcTofPrm,
+    kPtGeneratedPrm,
+    kPtItsTpcStr,
+    kPtTrkItsTpcStr,
+    kPtItsTpcTofStr,
+    kPtGeneratedStr,
+    kPtItsTpcMat,
+    kPtTrkItsTpcMat,
+    kPtItsTpcTofMat,
+    kPtGeneratedMat,
+    kPItsTpc,
+    kPTrkItsTpc,
+    kPItsTpcTof,
+    kPGenerated,
+    kEtaItsTpc,
+    kEtaTrkItsTpc,
+    kEtaItsTpcTof,
+    kEtaGenerated,
+    kEtaItsTpcPrm,
+    kEtaTrkItsTpcPrm,
+    kEtaItsTpcTofPrm,
+    kEtaGeneratedPrm,
+    kYItsTpc,
+    kYItsTpcTof,
+    kYGenerated,
+    kPhiItsTpc,
+    kPhiTrkItsTpc,
+    kPhiItsTpcTof,
+    kPhiGenerated,
+    kPhiItsTpcPrm,
+    kPhiTrkItsTpcPrm,
+    kPhiItsTpcTofPrm,
+    kPhiGeneratedPrm,
+    kPtEtaItsTpc,
+    kPtEtaTrkItsTpc,
+    kPtEtaItsTpcTof,
+    kPtEtaGenerated,
+    nEffHistograms
+  };
+  static_assert(nEffHistograms <= EfficiencyAccumulator::maxHistograms);
+  static constexpr uint64_t bit(int h) { return uint64_t{1} << h; }
+  // Variables of the MC efficiency histograms
+  enum EffVariable : int {
+    kMcP = 0,
+    kMcPt,
+    kMcEta,
+    kMcY,
+    kMcPhi,
+    kTrkP,
+    kTrkPt,
+    kTrkEta,
+    kTrkPhi,
+    nEffVariables
+  };
+  EfficiencyAccumulator effAccumulator;
+  std::array<bool, nHistograms> mcHistogramsEnabled{}; // Particles with histograms, depending on the PDG and sign selections
+
   // Pt
   static constexpr std::string_view hPtIts[nHistograms] = {"MC/el/pos_pdg/pt/its", "MC/mu/pos_pdg/pt/its", "MC/pi/pos_pdg/pt/its",
                                                            "MC/ka/pos_pdg/pt/its", "MC/pr/pos_pdg/pt/its", "MC/de/pos_pdg/pt/its",
@@ -552,6 +729,76 @@ struct QaEfficiency {
       registry->add(hPtEtaGenerated[histogramIndex].data(), "Generated " + tagPtEta, kTH2D, {axisPt, axisEta});
     }
 
+    // Registering the histograms in the efficiency accumulator
+    auto setHistogram = [&](int histogram, auto histName, int varX) {
+      effAccumulator.setHistogram(histogramIndex, histogram, registry->get<TH1>(histName).get(), varX);
+    };
+    setHistogram(kPtIts, HIST(hPtIts[histogramIndex]), kMcPt);
+    setHistogram(kPtTpc, HIST(hPtTpc[histogramIndex]), kMcPt);
+    setHistogram(kPtItsTpc, HIST(hPtItsTpc[histogramIndex]), kMcPt);
+    setHistogram(kPtItsTof, HIST(hPtItsTof[histogramIndex]), kMcPt);
+    setHistogram(kPtTpcTof, HIST(hPtTpcTof[histogramIndex]), kMcPt);
+    setHistogram(kPtItsTpcTrd, HIST(hPtItsTpcTrd[histogramIndex]), kMcP);
+    setHistogram(kPtItsTpcTof, HIST(hPtItsTpcTof[histogramIndex]), kMcPt);
+    setHistogram(kPtItsTpcTrdTof, HIST(hPtItsTpcTrdTof[histogramIndex]), kMcP);
+    setHistogram(kPtTrkItsTpc, HIST(hPtTrkItsTpc[histogramIndex]), kTrkPt);
+    setHistogram(kPtGenerated, HIST(hPtGenerated[histogramIndex]), kMcPt);
+
+    setHistogram(kPtItsPrm, HIST(hPtItsPrm[histogramIndex]), kMcPt);
+    setHistogram(kPtItsTpcPrm, HIST(hPtItsTpcPrm[histogramIndex]), kMcPt);
+    setHistogram(kPtTrkItsTpcPrm, HIST(hPtTrkItsTpcPrm[histogramIndex]), kTrkPt);
+    setHistogram(kPtItsTpcTofPrm, HIST(hPtItsTpcTofPrm[histogramIndex]), kMcPt);
+    setHistogram(kPtGeneratedPrm, HIST(hPtGeneratedPrm[histogramIndex]), kMcPt);
+
+    setHistogram(kPtItsTpcStr, HIST(hPtItsTpcStr[histogramIndex]), kMcPt);
+    setHistogram(kPtTrkItsTpcStr, HIST(hPtTrkItsTpcStr[histogramIndex]), kTrkPt);
+    setHistogram(kPtItsTpcTofStr, HIST(hPtItsTpcTofStr[histogramIndex]), kMcPt);
+    setHistogram(kPtGeneratedStr, HIST(hPtGeneratedStr[histogramIndex]), kMcPt);
+
+    setHistogram(kPtItsTpcMat, HIST(hPtItsTpcMat[histogramIndex]), kMcPt);
+    setHistogram(kPtTrkItsTpcMat, HIST(hPtTrkItsTpcMat[histogramIndex]), kTrkPt);
+    setHistogram(kPtItsTpcTofMat, HIST(hPtItsTpcTofMat[histogramIndex]), kMcPt);
+    setHistogram(kPtGeneratedMat, HIST(hPtGeneratedMat[histogramIndex]), kMcPt);
+
+    setHistogram(kPItsTpc, HIST(hPItsTpc[histogramIndex]), kMcP);
+    setHistogram(kPTrkItsTpc, HIST(hPTrkItsTpc[histogramIndex]), kTrkP);
+    setHistogram(kPItsTpcTof, HIST(hPItsTpcTof[histogramIndex]), kMcP);
+    setHistogram(kPGenerated, HIST(hPGenerated[histogramIndex]), kMcP);
+
+    setHistogram(kEtaItsTpc, HIST(hEtaItsTpc[histogramIndex]), kMcEta);
+    setHistogram(kEtaTrkItsTpc, HIST(hEtaTrkItsTpc[histogramIndex]), kTrkEta);
+    setHistogram(kEtaItsTpcTof, HIST(hEtaItsTpcTof[histogramIndex]), kMcEta);
+    setHistogram(kEtaGenerated, HIST(hEtaGenerated[histogramIndex]), kMcEta);
+
+    setHistogram(kEtaItsTpcPrm, HIST(hEtaItsTpcPrm[histogramIndex]), kMcEta);
+    setHistogram(kEtaTrkItsTpcPrm, HIST(hEtaTrkItsTpcPrm[histogramIndex]), kTrkEta);
+    setHistogram(kEtaItsTpcTofPrm, HIST(hEtaItsTpcTofPrm[histogramIndex]), kMcEta);
+    setHistogram(kEtaGeneratedPrm, HIST(hEtaGeneratedPrm[histogramIndex]), kMcEta);
+
+    setHistogram(kYItsTpc, HIST(hYItsTpc[histogramIndex]), kMcY);
+    setHistogram(kYItsTpcTof, HIST(hYItsTpcTof[histogramIndex]), kMcY);
+    setHistogram(kYGenerated, HIST(hYGenerated[histogramIndex]), kMcY);
+
+    setHistogram(kPhiItsTpc, HIST(hPhiItsTpc[histogramIndex]), kMcPhi);
+    setHistogram(kPhiTrkItsTpc, HIST(hPhiTrkItsTpc[histogramIndex]), kTrkPhi);
+    setHistogram(kPhiItsTpcTof, HIST(hPhiItsTpcTof[histogramIndex]), kMcPhi);
+    setHistogram(kPhiGenerated, HIST(hPhiGenerated[histogramIndex]), kMcPhi);
+
+    setHistogram(kPhiItsTpcPrm, HIST(hPhiItsTpcPrm[histogramIndex]), kMcPhi);
+    setHistogram(kPhiTrkItsTpcPrm, HIST(hPhiTrkItsTpcPrm[histogramIndex]), kTrkPhi);
+    setHistogram(kPhiItsTpcTofPrm, HIST(hPhiItsTpcTofPrm[histogramIndex]), kMcPhi);
+    setHistogram(kPhiGeneratedPrm, HIST(hPhiGeneratedPrm[histogramIndex]), kMcPhi);
+
+    if (doPtEta) {
+      auto setHistogram2D = [&](int histogram, auto histName, int varX, int varY) {
+        effAccumulator.setHistogram(histogramIndex, histogram, registry->get<TH2>(histName).get(), varX, varY);
+      };
+      setHistogram2D(kPtEtaItsTpc, HIST(hPtEtaItsTpc[histogramIndex]), kMcPt, kMcEta);
+      setHistogram2D(kPtEtaTrkItsTpc, HIST(hPtEtaTrkItsTpc[histogramIndex]), kTrkPt, kTrkEta);
+      setHistogram2D(kPtEtaItsTpcTof, HIST(hPtEtaItsTpcTof[histogramIndex]), kMcPt, kMcEta);
+      setHistogram2D(kPtEtaGenerated, HIST(hPtEtaGenerated[histogramIndex]), kMcPt, kMcEta);
+    }
+
     LOG(info) << "Done with particle: " << partName;
   }
 
@@ -743,6 +990,7 @@ struct QaEfficiency {
 
     listEfficiencyMC.setObject(new THashList);
 
+    effAccumulator.setNIndices(nHistograms);
     static_for<0, 1>([&](auto pdgSign) {
       makeMCHistograms<pdgSign, o2::track::PID::Electron>(doEl);
       makeMCHistograms<pdgSign, o2::track::PID::Muon>(doMu);
@@ -764,6 +1012,9 @@ struct QaEfficiency {
       makeMCEfficiency<pdgSign, o2::track::PID::Helium3>(doHe);
       makeMCEfficiency<pdgSign, o2::track::PID::Alpha>(doAl);
     });
+    for (int i = 0; i < nHistograms; i++) {
+      mcHistogramsEnabled[i] = effAccumulator.hasHistograms(i);
+    }
   }
 
   void initData(const AxisSpec& axisSel)
@@ -967,200 +1218,122 @@ struct QaEfficiency {
     }
   }
 
-  template <int pdgSign, o2::track::PID::ID id, typename particleType>
-  bool isPdgSelected(const particleType& mcParticle)
+  /// \return index of the MC histograms of the particle (id + pdgSign * nSpecies), -1 if its PDG code is not selected
+  int mcHistogramIndex(const int pdgCode) const
   {
-    static_assert(pdgSign == 0 || pdgSign == 1);
-    static_assert(id > 0 || id < nSpecies);
-
-    // Selecting a specific PDG
-    if constexpr (pdgSign == 0) {
-      return mcParticle.pdgCode() == PDGs[id];
-    } else {
-      return mcParticle.pdgCode() == -PDGs[id];
+    for (int id = 0; id < nSpecies; id++) {
+      if (pdgCode == PDGs[id]) {
+        return mcHistogramsEnabled[id] ? id : -1;
+      }
+      if (pdgCode == -PDGs[id]) {
+        return mcHistogramsEnabled[id + nSpecies] ? id + nSpecies : -1;
+      }
     }
+    return -1;
   }
 
-  template <int pdgSign, o2::track::PID::ID id, typename trackType>
-  void fillMCTrackHistograms(const trackType& track, const bool doMakeHistograms)
+  template <typename particleType>
+  bool isPhysicalPrimary(const particleType& mcParticle)
   {
-    static_assert(pdgSign == 0 || pdgSign == 1);
-    if (!doMakeHistograms) {
-      return;
-    }
-
-    if constexpr (pdgSign == 0) {
-      if (!doPositivePDG) {
-        return;
-      }
-    } else {
-      if (!doNegativePDG) {
-        return;
+    if (maxProdRadius < 999.f) {
+      if ((mcParticle.vx() * mcParticle.vx() + mcParticle.vy() * mcParticle.vy()) > maxProdRadius * maxProdRadius) {
+        return false;
       }
     }
+    return mcParticle.isPhysicalPrimary();
+  }
 
-    HistogramRegistry* h = &histosPosPdg;
-    if constexpr (pdgSign == 1) {
-      h = &histosNegPdg;
-    }
-
-    constexpr int histogramIndex = id + pdgSign * nSpecies;
-    LOG(debug) << "fillMCTrackHistograms for pdgSign '" << pdgSign << "' and id '" << static_cast<int>(id) << "' " << particleName(pdgSign, id) << " with index " << histogramIndex;
+  template <typename trackType>
+  void fillMCTrackHistograms(const trackType& track)
+  {
     const auto mcParticle = track.mcParticle();
-
-    if (!isPdgSelected<pdgSign, id>(mcParticle)) { // Selecting PDG code
+    const int histogramIndex = mcHistogramIndex(mcParticle.pdgCode());
+    if (histogramIndex < 0) { // Selecting PDG code
       return;
     }
+    histos.fill(HIST("MC/trackSelection"), 19 + histogramIndex % nSpecies);
 
-    histos.fill(HIST("MC/trackSelection"), 19 + id);
-
+    // Mask of the histograms passed by the track
+    const bool passedItsTpc = passedITS && passedTPC;
+    uint64_t mask = 0;
     if (passedITS) {
-      h->fill(HIST(hPtIts[histogramIndex]), mcParticle.pt());
+      mask |= bit(kPtIts);
     }
     if (passedTPC) {
-      h->fill(HIST(hPtTpc[histogramIndex]), mcParticle.pt());
-    }
-    if (passedITS && passedTPC) {
-      h->fill(HIST(hPItsTpc[histogramIndex]), mcParticle.p());
-      h->fill(HIST(hPtItsTpc[histogramIndex]), mcParticle.pt());
-      h->fill(HIST(hEtaItsTpc[histogramIndex]), mcParticle.eta());
-      h->fill(HIST(hYItsTpc[histogramIndex]), mcParticle.y());
-      h->fill(HIST(hPhiItsTpc[histogramIndex]), mcParticle.phi());
-
-      h->fill(HIST(hPTrkItsTpc[histogramIndex]), track.p());
-      h->fill(HIST(hPtTrkItsTpc[histogramIndex]), track.pt());
-      h->fill(HIST(hEtaTrkItsTpc[histogramIndex]), track.eta());
-      h->fill(HIST(hPhiTrkItsTpc[histogramIndex]), track.phi());
-
-      if (doPtEta) {
-        h->fill(HIST(hPtEtaItsTpc[histogramIndex]), mcParticle.pt(), mcParticle.eta());
-        h->fill(HIST(hPtEtaTrkItsTpc[histogramIndex]), track.pt(), track.eta());
-        if (passedTOF) {
-          h->fill(HIST(hPtEtaItsTpcTof[histogramIndex]), mcParticle.pt(), mcParticle.eta());
-        }
-      }
+      mask |= bit(kPtTpc);
+    }
+    if (passedItsTpc) {
+      mask |= bit(kPItsTpc) | bit(kPtItsTpc) | bit(kEtaItsTpc) | bit(kYItsTpc) | bit(kPhiItsTpc) |
+              bit(kPTrkItsTpc) | bit(kPtTrkItsTpc) | bit(kEtaTrkItsTpc) | bit(kPhiTrkItsTpc) |
+              bit(kPtEtaItsTpc) | bit(kPtEtaTrkItsTpc);
     }
     if (passedITS && passedTOF) {
-      h->fill(HIST(hPtItsTof[histogramIndex]), mcParticle.pt());
+      mask |= bit(kPtItsTof);
     }
     if (passedTPC && passedTOF) {
-      h->fill(HIST(hPtTpcTof[histogramIndex]), mcParticle.pt());
-    }
-    if (passedITS && passedTPC && passedTRD) {
-      h->fill(HIST(hPtItsTpcTrd[histogramIndex]), mcParticle.p());
+      mask |= bit(kPtTpcTof);
     }
-    if (passedITS && passedTPC && passedTOF) {
-      h->fill(HIST(hPItsTpcTof[histogramIndex]), mcParticle.p());
-      h->fill(HIST(hPtItsTpcTof[histogramIndex]), mcParticle.pt());
-      h->fill(HIST(hEtaItsTpcTof[histogramIndex]), mcParticle.eta());
-      h->fill(HIST(hYItsTpcTof[histogramIndex]), mcParticle.y());
-      h->fill(HIST(hPhiItsTpcTof[histogramIndex]), mcParticle.phi());
+    if (passedItsTpc && passedTRD) {
+      mask |= bit(kPtItsTpcTrd);
     }
-    if (passedITS && passedTPC && passedTRD && passedTOF) {
-      h->fill(HIST(hPtItsTpcTrdTof[histogramIndex]), mcParticle.p());
+    if (passedItsTpc && passedTOF) {
+      mask |= bit(kPItsTpcTof) | bit(kPtItsTpcTof) | bit(kEtaItsTpcTof) | bit(kYItsTpcTof) | bit(kPhiItsTpcTof) | bit(kPtEtaItsTpcTof);
     }
-
-    bool isPhysicalPrimary = mcParticle.isPhysicalPrimary();
-    if (maxProdRadius < 999.f) {
-      if ((mcParticle.vx() * mcParticle.vx() + mcParticle.vy() * mcParticle.vy()) > maxProdRadius * maxProdRadius) {
-        isPhysicalPrimary = false;
-      }
+    if (passedItsTpc && passedTRD && passedTOF) {
+      mask |= bit(kPtItsTpcTrdTof);
     }
 
-    if (isPhysicalPrimary) {
+    if (isPhysicalPrimary(mcParticle)) {
       if (passedITS) {
-        h->fill(HIST(hPtItsPrm[histogramIndex]), mcParticle.pt());
+        mask |= bit(kPtItsPrm);
       }
-      if (passedITS && passedTPC) {
-        h->fill(HIST(hPtItsTpcPrm[histogramIndex]), mcParticle.pt());
-        h->fill(HIST(hPtTrkItsTpcPrm[histogramIndex]), track.pt());
-        h->fill(HIST(hEtaItsTpcPrm[histogramIndex]), mcParticle.eta());
-        h->fill(HIST(hEtaTrkItsTpcPrm[histogramIndex]), track.eta());
-        h->fill(HIST(hPhiItsTpcPrm[histogramIndex]), mcParticle.phi());
-        h->fill(HIST(hPhiTrkItsTpcPrm[histogramIndex]), track.phi());
+      if (passedItsTpc) {
+        mask |= bit(kPtItsTpcPrm) | bit(kPtTrkItsTpcPrm) | bit(kEtaItsTpcPrm) | bit(kEtaTrkItsTpcPrm) | bit(kPhiItsTpcPrm) | bit(kPhiTrkItsTpcPrm);
         if (passedTOF) {
-          h->fill(HIST(hPtItsTpcTofPrm[histogramIndex]), mcParticle.pt());
-          h->fill(HIST(hEtaItsTpcTofPrm[histogramIndex]), mcParticle.eta());
-          h->fill(HIST(hPhiItsTpcTofPrm[histogramIndex]), mcParticle.phi());
+          mask |= bit(kPtItsTpcTofPrm) | bit(kEtaItsTpcTofPrm) | bit(kPhiItsTpcTofPrm);
         }
       }
     } else if (mcParticle.getProcess() == 4) { // Particle decay
-      if (passedITS && passedTPC) {
-        h->fill(HIST(hPtItsTpcStr[histogramIndex]), mcParticle.pt());
-        h->fill(HIST(hPtTrkItsTpcStr[histogramIndex]), track.pt());
+      if (passedItsTpc) {
+        mask |= bit(kPtItsTpcStr) | bit(kPtTrkItsTpcStr);
         if (passedTOF) {
-          h->fill(HIST(hPtItsTpcTofStr[histogramIndex]), mcParticle.pt());
+          mask |= bit(kPtItsTpcTofStr);
         }
       }
     } else { // Material
-      if (passedITS && passedTPC) {
-        h->fill(HIST(hPtItsTpcMat[histogramIndex]), mcParticle.pt());
-        h->fill(HIST(hPtTrkItsTpcMat[histogramIndex]), track.pt());
+      if (passedItsTpc) {
+        mask |= bit(kPtItsTpcMat) | bit(kPtTrkItsTpcMat);
         if (passedTOF) {
-          h->fill(HIST(hPtItsTpcTofMat[histogramIndex]), mcParticle.pt());
+          mask |= bit(kPtItsTpcTofMat);
         }
       }
     }
+
+    const float values[nEffVariables] = {mcParticle.p(), mcParticle.pt(), mcParticle.eta(), mcParticle.y(), mcParticle.phi(),
+                                         track.p(), track.pt(), track.eta(), track.phi()};
+    effAccumulator.fill(histogramIndex, mask, values);
   }
 
-  template <int pdgSign, o2::track::PID::ID id, typename particleType>
-  void fillMCParticleHistograms(const particleType& mcParticle, const bool doMakeHistograms)
+  template <typename particleType>
+  void fillMCParticleHistograms(const particleType& mcParticle)
   {
-    static_assert(pdgSign == 0 || pdgSign == 1);
-    if (!doMakeHistograms) {
+    const int histogramIndex = mcHistogramIndex(mcParticle.pdgCode());
+    if (histogramIndex < 0) { // Selecting PDG code
       return;
     }
+    histos.fill(HIST("MC/particleSelection"), 6 + histogramIndex % nSpecies);
 
-    if constexpr (pdgSign == 0) {
-      if (!doPositivePDG) {
-        return;
-      }
-    } else {
-      if (!doNegativePDG) {
-        return;
-      }
-    }
-
-    HistogramRegistry* h = &histosPosPdg;
-    if (pdgSign == 1) {
-      h = &histosNegPdg;
-    }
-
-    constexpr int histogramIndex = id + pdgSign * nSpecies;
-    LOG(debug) << "fillMCParticleHistograms for pdgSign '" << pdgSign << "' and id '" << static_cast<int>(id) << "' " << particleName(pdgSign, id) << " with index " << histogramIndex;
-    if (!isPdgSelected<pdgSign, id>(mcParticle)) { // Selecting PDG code
-      return;
-    }
-    histos.fill(HIST("MC/particleSelection"), 6 + id);
-
-    h->fill(HIST(hPGenerated[histogramIndex]), mcParticle.p());
-    h->fill(HIST(hPtGenerated[histogramIndex]), mcParticle.pt());
-
-    bool isPhysicalPrimary = mcParticle.isPhysicalPrimary();
-    if (maxProdRadius < 999.f) {
-      if ((mcParticle.vx() * mcParticle.vx() + mcParticle.vy() * mcParticle.vy()) > maxProdRadius * maxProdRadius) {
-        isPhysicalPrimary = false;
-      }
-    }
-
-    if (isPhysicalPrimary) {
-      h->fill(HIST(hPtGeneratedPrm[histogramIndex]), mcParticle.pt());
-      h->fill(HIST(hEtaGeneratedPrm[histogramIndex]), mcParticle.eta());
-      h->fill(HIST(hPhiGeneratedPrm[histogramIndex]), mcParticle.phi());
-    } else {
-      if (mcParticle.getProcess() == 4) { // Particle deday
-        h->fill(HIST(hPtGeneratedStr[histogramIndex]), mcParticle.pt());
-      } else { // Material
-        h->fill(HIST(hPtGeneratedMat[histogramIndex]), mcParticle.pt());
-      }
+    uint64_t mask = bit(kPGenerated) | bit(kPtGenerated) | bit(kEtaGenerated) | bit(kYGenerated) | bit(kPhiGenerated) | bit(kPtEtaGenerated);
+    if (isPhysicalPrimary(mcParticle)) {
+      mask |= bit(kPtGeneratedPrm) | bit(kEtaGeneratedPrm) | bit(kPhiGeneratedPrm);
+    } else if (mcParticle.getProcess() == 4) { // Particle decay
+      mask |= bit(kPtGeneratedStr);
+    } else { // Material
+      mask |= bit(kPtGeneratedMat);
     }
 
-    h->fill(HIST(hEtaGenerated[histogramIndex]), mcParticle.eta());
-    h->fill(HIST(hYGenerated[histogramIndex]), mcParticle.y());
-    h->fill(HIST(hPhiGenerated[histogramIndex]), mcParticle.phi());
-    if (doPtEta) {
-      h->fill(HIST(hPtEtaGenerated[histogramIndex]), mcParticle.pt(), mcParticle.eta());
-    }
+    const float values[nEffVariables] = {mcParticle.p(), mcParticle.pt(), mcParticle.eta(), mcParticle.y(), mcParticle.phi(), 0.f, 0.f, 0.f, 0.f};
+    effAccumulator.fill(histogramIndex, mask, values);
   }
 
   template <int pdgSign, o2::track::PID::ID id>
@@ -1496,17 +1669,7 @@ struct QaEfficiency {
         }
         // Filling variable histograms
         histos.fill(HIST("MC/trackLength"), track.length());
-        static_for<0, 1>([&](auto pdgSign) {
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Electron>(track, doEl);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Muon>(track, doMu);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Pion>(track, doPi);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Kaon>(track, doKa);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Proton>(track, doPr);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Deuteron>(track, doDe);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Triton>(track, doTr);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Helium3>(track, doHe);
-          fillMCTrackHistograms<pdgSign, o2::track::PID::Alpha>(track, doAl);
-        });
+        fillMCTrackHistograms(track);
       }
     }
 
@@ -1520,20 +1683,12 @@ struct QaEfficiency {
         continue;
       }
 
-      static_for<0, 1>([&](auto pdgSign) {
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Electron>(mcParticle, doEl);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Muon>(mcParticle, doMu);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Pion>(mcParticle, doPi);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Kaon>(mcParticle, doKa);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Proton>(mcParticle, doPr);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Deuteron>(mcParticle, doDe);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Triton>(mcParticle, doTr);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Helium3>(mcParticle, doHe);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Alpha>(mcParticle, doAl);
-      });
+      fillMCParticleHistograms(mcParticle);
     }
     histos.fill(HIST("MC/eventMultiplicity"), dNdEta * 0.5f / 2.f);
 
+    effAccumulator.flush();
+
     // Fill TEfficiencies
     static_for<0, 1>([&](auto pdgSign) {
       fillMCEfficiency<pdgSign, o2::track::PID::Electron>(doEl);
@@ -1560,17 +1715,7 @@ struct QaEfficiency {
       }
       // Filling variable histograms
       histos.fill(HIST("MC/trackLength"), track.length());
-      static_for<0, 1>([&](auto pdgSign) {
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Electron>(track, doEl);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Muon>(track, doMu);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Pion>(track, doPi);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Kaon>(track, doKa);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Proton>(track, doPr);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Deuteron>(track, doDe);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Triton>(track, doTr);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Helium3>(track, doHe);
-        fillMCTrackHistograms<pdgSign, o2::track::PID::Alpha>(track, doAl);
-      });
+      fillMCTrackHistograms(track);
     }
 
     for (const auto& mcParticle : mcParticles) {
@@ -1578,19 +1723,11 @@ struct QaEfficiency {
         continue;
       }
 
-      static_for<0, 1>([&](auto pdgSign) {
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Electron>(mcParticle, doEl);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Muon>(mcParticle, doMu);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Pion>(mcParticle, doPi);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Kaon>(mcParticle, doKa);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Proton>(mcParticle, doPr);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Deuteron>(mcParticle, doDe);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Triton>(mcParticle, doTr);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Helium3>(mcParticle, doHe);
-        fillMCParticleHistograms<pdgSign, o2::track::PID::Alpha>(mcParticle, doAl);
-      });
+      fillMCParticleHistograms(mcParticle);
     }
 
+    effAccumulator.flush();
+
     // Fill TEfficiencies
     static_for<0, 1>([&](auto pdgSign) {
       fillMCEfficiency<pdgSign, o2::track::PID::Electron>(doEl);
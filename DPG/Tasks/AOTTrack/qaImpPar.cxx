@@ -28,6 +28,7 @@
 #include "CommonUtils/NameConf.h"
 #include "Framework/AnalysisDataModel.h"
 #include "Common/Core/TrackSelection.h"
+#include "Common/Core/PVRefitter.h"
 #include "DetectorsVertexing/PVertexer.h"
 #include "ReconstructionDataFormats/Vertex.h"
 #include "CCDB/BasicCCDBManager.h"
@@ -106,6 +107,7 @@ struct QaImpactPar {
   Configurable<uint16_t> maxPVcontrib{"maxPVcontrib", 10000, "Maximum number of PV contributors"};
   Configurable<bool> removeDiamondConstraint{"removeDiamondConstraint", true, "Remove the diamond constraint for the PV refit"};
   Configurable<bool> keepAllTracksPVrefit{"keepAllTracksPVrefit", false, "Keep all tracks for PV refit (for debug)"};
+  Configurable<bool> useFastPVrefit{"useFastPVrefit", false, "PV refit by removing the track from the linearised fit with all the contributors, instead of a full refit"};
   Configurable<bool> use_customITSHitMap{"use_customITSHitMap", false, "Use custom ITS hitmap selection"};
   Configurable<int> customITShitmap{"customITShitmap", 0, "Custom ITS hitmap (consider the binary representation)"};
   Configurable<int> n_customMinITShits{"n_customMinITShits", 0, "Minimum number of layers crossed by a track among those in \"customITShitmap\""};
@@ -138,6 +140,7 @@ struct QaImpactPar {
   // Needed for PV refitting
   Service<o2::ccdb::BasicCCDBManager> ccdb;
   o2::base::MatLayerCylSet* lut = nullptr;
+  o2::analysis::PVRefitter refitter;
   // o2::base::Propagator::MatCorrType matCorr = o2::base::Propagator::MatCorrType::USEMatCorrLUT;
   int mRunNumber;
 
@@ -189,6 +192,7 @@ struct QaImpactPar {
   /// init function - declare and define histograms
   void init(InitContext&)
   {
+    refitter.setRemoveMeanVertexConstraint(removeDiamondConstraint); // we want to refit w/o MeanVertex constraint
     // Primary vertex
     const AxisSpec collisionXAxis{100, -20.f, 20.f, "X (cm)"};
     const AxisSpec collisionYAxis{100, -20.f, 20.f, "Y (cm)"};
@@ -363,38 +367,22 @@ struct QaImpactPar {
     ///       For PV refit          ///
     ///////////////////////////////////
     /// retrieve the tracks contributing to the primary vertex fitting
-    std::vector<int64_t> vec_globID_contr = {};
-    std::vector<o2::track::TrackParCov> vec_TrkContributos = {};
     if (fDebug) {
       LOG(info) << "\n === New collision";
     }
     const int nTrk = unfilteredTracks.size();
-    int nContrib = 0;
-    int nNonContrib = 0;
-    for (const auto& unfilteredTrack : unfilteredTracks) {
-      if (!unfilteredTrack.isPVContributor()) {
-        /// the track di not contribute to fit the primary vertex
-        nNonContrib++;
-        continue;
-      }
-      vec_globID_contr.push_back(unfilteredTrack.globalIndex());
-      vec_TrkContributos.push_back(getTrackParCov(unfilteredTrack));
-      nContrib++;
-      if (fDebug) {
-        LOG(info) << "---> a contributor! stuff saved";
-        LOG(info) << "vec_contrib size: " << vec_TrkContributos.size() << ", nContrib: " << nContrib;
-      }
-    }
+    refitter.buildSingle(collision, unfilteredTracks, [](const auto& unfilteredTrack) { return unfilteredTrack.isPVContributor(); });
+    const int nContrib = refitter.nContributors(0);
     if (fDebug) {
-      LOG(info) << "===> nTrk: " << nTrk << ",   nContrib: " << nContrib << ",   nNonContrib: " << nNonContrib;
+      LOG(info) << "===> nTrk: " << nTrk << ",   nContrib: " << nContrib << ",   nNonContrib: " << nTrk - nContrib;
     }
 
-    if (vec_TrkContributos.size() != collision.numContrib()) {
-      LOG(info) << "!!! something wrong in the number of contributor tracks for PV fit !!! " << vec_TrkContributos.size() << " vs. " << collision.numContrib();
+    if (nContrib != collision.numContrib()) {
+      LOG(info) << "!!! something wrong in the number of contributor tracks for PV fit !!! " << nContrib << " vs. " << collision.numContrib();
       return;
     }
 
-    std::vector<bool> vec_useTrk_PVrefit(vec_globID_contr.size(), true);
+    std::vector<bool> vec_useTrk_PVrefit(nContrib, true);
 
     /// Prepare the vertex refitting
     // Get the magnetic field for the Propagator
@@ -411,19 +399,9 @@ struct QaImpactPar {
       }
       mRunNumber = bc.runNumber();
     }
-    // build the VertexBase to initialize the vertexer
-    o2::dataformats::VertexBase Pvtx;
-    Pvtx.setX(collision.posX());
-    Pvtx.setY(collision.posY());
-    Pvtx.setZ(collision.posZ());
-    Pvtx.setCov(collision.covXX(), collision.covXY(), collision.covYY(), collision.covXZ(), collision.covYZ(), collision.covZZ());
-    // configure PVertexer
-    o2::vertexing::PVertexer vertexer;
-    if (removeDiamondConstraint) {
-      o2::conf::ConfigurableParam::updateFromString("pvertexer.useMeanVertexConstraint=false"); // we want to refit w/o MeanVertex constraint
-    }
-    vertexer.init();
-    bool PVrefit_doable = vertexer.prepareVertexRefit(vec_TrkContributos, Pvtx);
+    // prepare the vertexer, shared by the collisions, with the original vertex as seed
+    const auto& Pvtx = refitter.vertexSeed(0);
+    bool PVrefit_doable = refitter.prepare(0);
     if (!PVrefit_doable) {
       LOG(info) << "Not enough tracks accepted for the refit";
       if (doPVrefit) {
@@ -434,7 +412,7 @@ struct QaImpactPar {
     }
 
     if (fDebug) {
-      LOG(info) << "prepareVertexRefit = " << PVrefit_doable << " Ncontrib= " << vec_TrkContributos.size() << " Ntracks= " << collision.numContrib() << " Vtx= " << Pvtx.asString();
+      LOG(info) << "prepareVertexRefit = " << PVrefit_doable << " Ncontrib= " << nContrib << " Ntracks= " << collision.numContrib() << " Vtx= " << Pvtx.asString();
     }
     ///////////////////////////////////
     ///////////////////////////////////
@@ -557,18 +535,14 @@ struct QaImpactPar {
       o2::dataformats::VertexBase PVbase_recalculated;
       bool recalc_imppar = false;
       if (doPVrefit && PVrefit_doable) {
-        auto it_trk = std::find(vec_globID_contr.begin(), vec_globID_contr.end(), track.globalIndex()); /// track global index
-        // if( it_trk==vec_globID_contr.end() ) {
-        //   /// not found: this track did not contribute to the initial PV fitting
-        //   continue;
-        // }
-        if (it_trk != vec_globID_contr.end()) {
+        const int entry = refitter.findContributor(0, track.globalIndex()); /// track global index
+        if (entry >= 0) {
           /// this track contributed to the PV fit: let's do the refit without it
-          const int entry = std::distance(vec_globID_contr.begin(), it_trk);
           if (!keepAllTracksPVrefit) {
             vec_useTrk_PVrefit[entry] = false; /// remove the track from the PV refitting
           }
-          auto Pvtx_refitted = vertexer.refitVertex(vec_useTrk_PVrefit, Pvtx); // vertex refit
+          // vertex refit, either full or downdating the linearised fit with all the contributors
+          auto Pvtx_refitted = useFastPVrefit ? refitter.refitWithout(0, std::span<const int>(&entry, keepAllTracksPVrefit ? 0 : 1)) : refitter.refit(0, vec_useTrk_PVrefit);
           if (fDebug) {
             LOG(info) << "refit " << cnt << "/" << ntr << " result = " << Pvtx_refitted.asString();
           }
@@ -17,6 +17,9 @@
 #define PWGCF_FEMTODREAM_FEMTODREAMOBJECTSELECTION_H_
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -187,8 +190,87 @@ class FemtoDreamObjectSelection
   }
 
  protected:
+  /// Flattens the selections into arrays of thresholds, in the order of the bits in the cut container.
+  /// Each selection becomes low < x < high with x = (observable - offset), or its absolute value, so that
+  /// the evaluation needs neither a switch on the selection type nor any allocation.
+  /// Has to be called once all the selections are set, i.e. at the end of the init of the child class
+  void compileSelections()
+  {
+    const size_t nSel = mSelections.size();
+    mCompiledVariable.resize(nSel);
+    mCompiledOffset.resize(nSel);
+    mCompiledLow.resize(nSel);
+    mCompiledHigh.resize(nSel);
+    mCompiledAbs.resize(nSel);
+    constexpr selValDataType lowest = std::numeric_limits<selValDataType>::has_infinity ? -std::numeric_limits<selValDataType>::infinity() : std::numeric_limits<selValDataType>::lowest();
+    constexpr selValDataType highest = std::numeric_limits<selValDataType>::has_infinity ? std::numeric_limits<selValDataType>::infinity() : std::numeric_limits<selValDataType>::max();
+    for (size_t i = 0; i < nSel; ++i) {
+      auto& sel = mSelections[i];
+      const selValDataType selVal = sel.getSelectionValue();
+      mCompiledVariable[i] = static_cast<int>(sel.getSelectionVariable());
+      mCompiledOffset[i] = 0;
+      mCompiledLow[i] = lowest;
+      mCompiledHigh[i] = highest;
+      mCompiledAbs[i] = false;
+      switch (sel.getSelectionType()) {
+        case (femtoDreamSelection::SelectionType::kUpperLimit):
+          mCompiledHigh[i] = selVal;
+          break;
+        case (femtoDreamSelection::SelectionType::kAbsUpperLimit):
+          mCompiledHigh[i] = selVal;
+          mCompiledAbs[i] = true;
+          break;
+        case (femtoDreamSelection::SelectionType::kLowerLimit):
+          mCompiledLow[i] = selVal;
+          break;
+        case (femtoDreamSelection::SelectionType::kAbsLowerLimit):
+          mCompiledLow[i] = selVal;
+          mCompiledAbs[i] = true;
+          break;
+        case (femtoDreamSelection::SelectionType::kEqual):
+          mCompiledOffset[i] = selVal;
+          mCompiledHigh[i] = std::abs(selVal * 1e-6);
+          mCompiledAbs[i] = true;
+          break;
+      }
+    }
+  }
+
+  /// Check whether a compiled selection is fulfilled, equivalent to FemtoDreamSelection::isSelected
+  /// \param iSel Index of the selection
+  /// \param observable Value of the variable to be checked
+  bool isSelectedCompiled(size_t iSel, selValDataType observable) const
+  {
+    selValDataType x = observable - mCompiledOffset[iSel];
+    x = mCompiledAbs[iSel] ? std::abs(x) : x;
+    return (x > mCompiledLow[iSel]) & (x < mCompiledHigh[iSel]);
+  }
+
+  /// Sets the bits of all compiled selections, except those of skipVariable which need special treatment
+  /// \param observables Values of the variables, indexed by the selection variable
+  /// \param skipVariable Selection variable to be skipped (-1 for none)
+  /// \param cutContainer Bit-wise container for the systematic variations
+  /// \param counter Position of the next bit in the container
+  template <typename cutContainerType>
+  void setCompiledSelectionBits(const selValDataType* observables, int skipVariable, cutContainerType& cutContainer, size_t& counter) const
+  {
+    for (size_t iSel = 0; iSel < mCompiledVariable.size(); ++iSel) {
+      const int var = mCompiledVariable[iSel];
+      if (var == skipVariable) {
+        continue;
+      }
+      cutContainer |= static_cast<cutContainerType>(isSelectedCompiled(iSel, observables[var])) << counter;
+      ++counter;
+    }
+  }
+
   HistogramRegistry* mHistogramRegistry;                                     ///< For QA output
   std::vector<FemtoDreamSelection<selValDataType, selVariable>> mSelections; ///< Vector containing all selections
+  std::vector<int> mCompiledVariable;                                        ///< Selection variable of each compiled selection
+  std::vector<selValDataType> mCompiledOffset;                               ///< Offset subtracted from the observable (kEqual)
+  std::vector<selValDataType> mCompiledLow;                                  ///< Lower bound of each compiled selection
+  std::vector<selValDataType> mCompiledHigh;                                 ///< Upper bound of each compiled selection
+  std::vector<uint8_t> mCompiledAbs;                                         ///< Whether the absolute value of the observable is used
 };
 
 } // namespace femtoDream
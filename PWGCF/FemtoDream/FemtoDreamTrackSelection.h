@@ -17,6 +17,7 @@
 #ifndef PWGCF_FEMTODREAM_FEMTODREAMTRACKSELECTION_H_
 #define PWGCF_FEMTODREAM_FEMTODREAMTRACKSELECTION_H_
 
+#include <array>
 #include <string>
 #include <vector>
 #include <cmath>
@@ -145,6 +146,14 @@ class FemtoDreamTrackSelection : public FemtoDreamObjectSelection<float, femtoDr
   template <typename cutContainerType, typename T>
   std::array<cutContainerType, 2> getCutContainer(T const& track);
 
+  /// Fill the bit-wise container for the selections into a buffer provided by the caller
+  /// \tparam cutContainerType Data type of the bit-wise container for the selections
+  /// \tparam T Data type of the track
+  /// \param track Track
+  /// \param output Bit-wise container for the selections, separately with all selection criteria, and the PID
+  template <typename cutContainerType, typename T>
+  void getCutContainer(T const& track, std::array<cutContainerType, 2>& output);
+
   /// Some basic QA histograms
   /// \tparam part Type of the particle for proper naming of the folders for QA
   /// \tparam tracktype Type of track (track, positive child, negative child) for proper naming of the folders for QA
@@ -244,6 +253,7 @@ class FemtoDreamTrackSelection : public FemtoDreamObjectSelection<float, femtoDr
   float nSigmaPIDOffsetTOF;
   std::vector<o2::track::PID> mPIDspecies; ///< All the particle species for which the n_sigma values need to be stored
   static constexpr int kNtrackSelection = 14;
+  static constexpr size_t kMaxPIDspecies = o2::track::PID::NIDsTot; ///< Size of the per-track n_sigma buffers
   static constexpr std::string_view mSelectionNames[kNtrackSelection] = {"Sign",
                                                                          "PtMin",
                                                                          "PtMax",
@@ -362,6 +372,11 @@ void FemtoDreamTrackSelection::init(HistogramRegistry* registry)
   dcaZMax = getMinimalSelection(femtoDreamTrackSelection::kDCAzMax, femtoDreamSelection::kAbsUpperLimit);
   dcaMin = getMinimalSelection(femtoDreamTrackSelection::kDCAMin, femtoDreamSelection::kAbsLowerLimit);
   nSigmaPIDMax = getMinimalSelection(femtoDreamTrackSelection::kPIDnSigmaMax, femtoDreamSelection::kAbsUpperLimit);
+
+  if (mPIDspecies.size() > kMaxPIDspecies) {
+    LOG(fatal) << "FemtoDreamTrackCuts: Too many PID species - quitting!";
+  }
+  compileSelections();
 }
 
 template <typename T>
@@ -396,11 +411,6 @@ bool FemtoDreamTrackSelection::isSelectedMinimal(T const& track)
   const auto dcaZ = track.dcaZ();
   const auto dca = track.dcaXY(); // Accordingly to FemtoDream in AliPhysics  as well as LF analysis,
                                   // only dcaXY should be checked; NOT std::sqrt(pow(dcaXY, 2.) + pow(dcaZ, 2.))
-  std::vector<float> pidTPC, pidTOF;
-  for (auto it : mPIDspecies) {
-    pidTPC.push_back(getNsigmaTPC(track, it));
-    pidTOF.push_back(getNsigmaTOF(track, it));
-  }
 
   if (nPtMinSel > 0 && pT < pTMin) {
     return false;
@@ -444,10 +454,10 @@ bool FemtoDreamTrackSelection::isSelectedMinimal(T const& track)
 
   if (nPIDnSigmaSel > 0) {
     bool isFulfilled = false;
-    for (size_t i = 0; i < pidTPC.size(); ++i) {
-      auto pidTPCVal = pidTPC.at(i);
-      if (std::abs(pidTPCVal - nSigmaPIDOffsetTPC) < nSigmaPIDMax) {
+    for (auto pid : mPIDspecies) {
+      if (std::abs(getNsigmaTPC(track, pid) - nSigmaPIDOffsetTPC) < nSigmaPIDMax) {
         isFulfilled = true;
+        break;
       }
     }
     if (!isFulfilled) {
@@ -460,89 +470,60 @@ bool FemtoDreamTrackSelection::isSelectedMinimal(T const& track)
 template <typename cutContainerType, typename T>
 std::array<cutContainerType, 2> FemtoDreamTrackSelection::getCutContainer(T const& track)
 {
-  cutContainerType output = 0;
-  size_t counter = 0;
-  cutContainerType outputPID = 0;
-  size_t counterPID = 0;
-  const auto sign = track.sign();
-  const auto pT = track.pt();
-  const auto eta = track.eta();
-  const auto tpcNClsF = track.tpcNClsFound();
-  const auto tpcRClsC = track.tpcCrossedRowsOverFindableCls();
-  const auto tpcNClsC = track.tpcNClsCrossedRows();
-  const auto tpcNClsS = track.tpcNClsShared();
-  const auto itsNCls = track.itsNCls();
-  const auto itsNClsIB = track.itsNClsInnerBarrel();
+  std::array<cutContainerType, 2> output;
+  getCutContainer(track, output);
+  return output;
+}
+
+template <typename cutContainerType, typename T>
+void FemtoDreamTrackSelection::getCutContainer(T const& track, std::array<cutContainerType, 2>& output)
+{
   const auto dcaXY = track.dcaXY();
   const auto dcaZ = track.dcaZ();
-  const auto dca = std::sqrt(pow(dcaXY, 2.) + pow(dcaZ, 2.));
-
-  std::vector<float> pidTPC, pidTOF;
-  for (auto it : mPIDspecies) {
-    pidTPC.push_back(getNsigmaTPC(track, it));
-    pidTOF.push_back(getNsigmaTOF(track, it));
-  }
 
-  float observable = 0.;
-  for (auto& sel : mSelections) {
-    const auto selVariable = sel.getSelectionVariable();
-    if (selVariable == femtoDreamTrackSelection::kPIDnSigmaMax) {
-      /// PID needs to be handled a bit differently since we may need more than one species
-      for (size_t i = 0; i < pidTPC.size(); ++i) {
-        auto pidTPCVal = pidTPC.at(i) - nSigmaPIDOffsetTPC;
-        auto pidTOFVal = pidTOF.at(i) - nSigmaPIDOffsetTOF;
-        sel.checkSelectionSetBit(pidTPCVal, outputPID, counterPID);
-        auto pidComb = std::sqrt(pidTPCVal * pidTPCVal + pidTOFVal * pidTOFVal);
-        sel.checkSelectionSetBit(pidComb, outputPID, counterPID);
-      }
+  std::array<float, kNtrackSelection> observables;
+  observables[femtoDreamTrackSelection::kSign] = track.sign();
+  observables[femtoDreamTrackSelection::kpTMin] = track.pt();
+  observables[femtoDreamTrackSelection::kpTMax] = track.pt();
+  observables[femtoDreamTrackSelection::kEtaMax] = track.eta();
+  observables[femtoDreamTrackSelection::kTPCnClsMin] = track.tpcNClsFound();
+  observables[femtoDreamTrackSelection::kTPCfClsMin] = track.tpcCrossedRowsOverFindableCls();
+  observables[femtoDreamTrackSelection::kTPCcRowsMin] = track.tpcNClsCrossedRows();
+  observables[femtoDreamTrackSelection::kTPCsClsMax] = track.tpcNClsShared();
+  observables[femtoDreamTrackSelection::kITSnClsMin] = track.itsNCls();
+  observables[femtoDreamTrackSelection::kITSnClsIbMin] = track.itsNClsInnerBarrel();
+  observables[femtoDreamTrackSelection::kDCAxyMax] = dcaXY;
+  observables[femtoDreamTrackSelection::kDCAzMax] = dcaZ;
+  observables[femtoDreamTrackSelection::kDCAMin] = std::sqrt(pow(dcaXY, 2.) + pow(dcaZ, 2.));
+  observables[femtoDreamTrackSelection::kPIDnSigmaMax] = 0.f;
+
+  output[femtoDreamTrackSelection::kCuts] = 0;
+  size_t counter = 0;
+  setCompiledSelectionBits(observables.data(), femtoDreamTrackSelection::kPIDnSigmaMax, output[femtoDreamTrackSelection::kCuts], counter);
 
-    } else {
-      /// for the rest it's all the same
-      switch (selVariable) {
-        case (femtoDreamTrackSelection::kSign):
-          observable = sign;
-          break;
-        case (femtoDreamTrackSelection::kpTMin):
-        case (femtoDreamTrackSelection::kpTMax):
-          observable = pT;
-          break;
-        case (femtoDreamTrackSelection::kEtaMax):
-          observable = eta;
-          break;
-        case (femtoDreamTrackSelection::kTPCnClsMin):
-          observable = tpcNClsF;
-          break;
-        case (femtoDreamTrackSelection::kTPCfClsMin):
-          observable = tpcRClsC;
-          break;
-        case (femtoDreamTrackSelection::kTPCcRowsMin):
-          observable = tpcNClsC;
-          break;
-        case (femtoDreamTrackSelection::kTPCsClsMax):
-          observable = tpcNClsS;
-          break;
-        case (femtoDreamTrackSelection::kITSnClsMin):
-          observable = itsNCls;
-          break;
-        case (femtoDreamTrackSelection::kITSnClsIbMin):
-          observable = itsNClsIB;
-          break;
-        case (femtoDreamTrackSelection::kDCAxyMax):
-          observable = dcaXY;
-          break;
-        case (femtoDreamTrackSelection::kDCAzMax):
-          observable = dcaZ;
-          break;
-        case (femtoDreamTrackSelection::kDCAMin):
-          observable = dca;
-          break;
-        case (femtoDreamTrackSelection::kPIDnSigmaMax):
-          break;
-      }
-      sel.checkSelectionSetBit(observable, output, counter);
+  /// PID needs to be handled a bit differently since we may need more than one species
+  output[femtoDreamTrackSelection::kPID] = 0;
+  if (nPIDnSigmaSel == 0) {
+    return;
+  }
+  const size_t nSpecies = mPIDspecies.size();
+  std::array<float, kMaxPIDspecies> pidTPC, pidComb;
+  for (size_t i = 0; i < nSpecies; ++i) {
+    auto pidTPCVal = getNsigmaTPC(track, mPIDspecies[i]) - nSigmaPIDOffsetTPC;
+    auto pidTOFVal = getNsigmaTOF(track, mPIDspecies[i]) - nSigmaPIDOffsetTOF;
+    pidTPC[i] = pidTPCVal;
+    pidComb[i] = std::sqrt(pidTPCVal * pidTPCVal + pidTOFVal * pidTOFVal);
+  }
+  size_t counterPID = 0;
+  for (size_t iSel = 0; iSel < mCompiledVariable.size(); ++iSel) {
+    if (mCompiledVariable[iSel] != femtoDreamTrackSelection::kPIDnSigmaMax) {
+      continue;
+    }
+    for (size_t i = 0; i < nSpecies; ++i) {
+      output[femtoDreamTrackSelection::kPID] |= static_cast<cutContainerType>(isSelectedCompiled(iSel, pidTPC[i])) << counterPID++;
+      output[femtoDreamTrackSelection::kPID] |= static_cast<cutContainerType>(isSelectedCompiled(iSel, pidComb[i])) << counterPID++;
     }
   }
-  return {output, outputPID};
 }
 
 template <o2::aod::femtodreamparticle::ParticleType part, o2::aod::femtodreamparticle::TrackType tracktype, typename T>
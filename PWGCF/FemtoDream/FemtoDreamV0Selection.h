@@ -18,6 +18,7 @@
 #ifndef PWGCF_FEMTODREAM_FEMTODREAMV0SELECTION_H_
 #define PWGCF_FEMTODREAM_FEMTODREAMV0SELECTION_H_
 
+#include <array>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -69,7 +70,7 @@ class FemtoDreamV0Selection
 {
  public:
   FemtoDreamV0Selection()
-    : nPtV0MinSel(0), nPtV0MaxSel(0), nEtaV0MaxSel(0), nDCAV0DaughMax(0), nCPAV0Min(0), nTranRadV0Min(0), nTranRadV0Max(0), nDecVtxMax(0), pTV0Min(9999999.), pTV0Max(-9999999.), etaV0Max(-9999999.), DCAV0DaughMax(-9999999.), CPAV0Min(9999999.), TranRadV0Min(9999999.), TranRadV0Max(-9999999.), DecVtxMax(-9999999.), fInvMassLowLimit(1.05), fInvMassUpLimit(1.3), fRejectKaon(false), fInvMassKaonLowLimit(0.48), fInvMassKaonUpLimit(0.515), nSigmaPIDOffsetTPC(0.) {}
+    : nPtV0MinSel(0), nPtV0MaxSel(0), nEtaV0MaxSel(0), nDCAV0DaughMax(0), nCPAV0Min(0), nTranRadV0Min(0), nTranRadV0Max(0), nDecVtxMax(0), pTV0Min(9999999.), pTV0Max(-9999999.), etaV0Max(-9999999.), DCAV0DaughMax(-9999999.), CPAV0Min(9999999.), TranRadV0Min(9999999.), TranRadV0Max(-9999999.), DecVtxMax(-9999999.), fInvMassLowLimit(1.05), fInvMassUpLimit(1.3), fRejectKaon(false), fInvMassKaonLowLimit(0.48), fInvMassKaonUpLimit(0.515), nSigmaPIDOffsetTPC(0.), fLambdaMassNominal(0.) {}
   /// Initializes histograms for the task
   template <o2::aod::femtodreamparticle::ParticleType part,
             o2::aod::femtodreamparticle::ParticleType daugh,
@@ -237,6 +238,8 @@ class FemtoDreamV0Selection
 
   float nSigmaPIDOffsetTPC;
 
+  double fLambdaMassNominal; ///< PDG mass of the Lambda, cached at init
+
   FemtoDreamTrackSelection PosDaughTrack;
   FemtoDreamTrackSelection NegDaughTrack;
 
@@ -393,6 +396,9 @@ void FemtoDreamV0Selection::init(HistogramRegistry* registry)
                                      femtoDreamSelection::kUpperLimit);
   DecVtxMax = getMinimalSelection(femtoDreamV0Selection::kV0DecVtxMax,
                                   femtoDreamSelection::kAbsUpperLimit);
+
+  fLambdaMassNominal = TDatabasePDG::Instance()->GetParticle(3122)->Mass();
+  compileSelections();
 }
 
 template <typename C, typename V, typename T>
@@ -409,7 +415,7 @@ bool FemtoDreamV0Selection::isSelectedMinimal(C const& col, V const& v0,
   // asfaf
   const float pT = v0.pt();
   const float eta = v0.eta();
-  const std::vector<float> decVtx = {v0.x(), v0.y(), v0.z()};
+  const std::array<float, 3> decVtx = {v0.x(), v0.y(), v0.z()};
   const float tranRad = v0.v0radius();
   const float dcaDaughv0 = v0.dcaV0daughters();
   const float cpav0 = v0.v0cosPA(col.posX(), col.posY(), col.posZ());
@@ -492,7 +498,7 @@ void FemtoDreamV0Selection::fillLambdaQA(C const& col, V const& v0,
   }
   const float pT = v0.pt();
   const float eta = v0.eta();
-  const std::vector<float> decVtx = {v0.x(), v0.y(), v0.z()};
+  const std::array<float, 3> decVtx = {v0.x(), v0.y(), v0.z()};
   const float tranRad = v0.v0radius();
   const float dcaDaughv0 = v0.dcaV0daughters();
   const float cpav0 = v0.v0cosPA(col.posX(), col.posY(), col.posZ());
@@ -549,12 +555,13 @@ template <typename cutContainerType, typename C, typename V, typename T>
 std::array<cutContainerType, 5>
   FemtoDreamV0Selection::getCutContainer(C const& col, V const& v0, T const& posTrack, T const& negTrack)
 {
-  auto outputPosTrack = PosDaughTrack.getCutContainer<cutContainerType>(posTrack);
-  auto outputNegTrack = NegDaughTrack.getCutContainer<cutContainerType>(negTrack);
+  std::array<cutContainerType, 2> outputPosTrack, outputNegTrack;
+  PosDaughTrack.getCutContainer(posTrack, outputPosTrack);
+  NegDaughTrack.getCutContainer(negTrack, outputNegTrack);
   cutContainerType output = 0;
   size_t counter = 0;
 
-  auto lambdaMassNominal = TDatabasePDG::Instance()->GetParticle(3122)->Mass();
+  auto lambdaMassNominal = fLambdaMassNominal;
   auto lambdaMassHypothesis = v0.mLambda();
   auto antiLambdaMassHypothesis = v0.mAntiLambda();
   auto diffLambda = abs(lambdaMassNominal - lambdaMassHypothesis);
@@ -580,51 +587,26 @@ std::array<cutContainerType, 5>
     }
   }
 
-  const auto pT = v0.pt();
-  const auto eta = v0.eta();
-  const auto tranRad = v0.v0radius();
-  const auto dcaDaughv0 = v0.dcaV0daughters();
-  const auto cpav0 = v0.v0cosPA(col.posX(), col.posY(), col.posZ());
-  const std::vector<float> decVtx = {v0.x(), v0.y(), v0.z()};
-
-  float observable = 0.;
-  for (auto& sel : mSelections) {
-    const auto selVariable = sel.getSelectionVariable();
+  std::array<float, kNv0Selection> observables;
+  observables[femtoDreamV0Selection::kV0Sign] = sign;
+  observables[femtoDreamV0Selection::kV0pTMin] = v0.pt();
+  observables[femtoDreamV0Selection::kV0pTMax] = v0.pt();
+  observables[femtoDreamV0Selection::kV0etaMax] = v0.eta();
+  observables[femtoDreamV0Selection::kV0DCADaughMax] = v0.dcaV0daughters();
+  observables[femtoDreamV0Selection::kV0CPAMin] = v0.v0cosPA(col.posX(), col.posY(), col.posZ());
+  observables[femtoDreamV0Selection::kV0TranRadMin] = v0.v0radius();
+  observables[femtoDreamV0Selection::kV0TranRadMax] = v0.v0radius();
+  observables[femtoDreamV0Selection::kV0DecVtxMax] = 0.f;
+  const std::array<float, 3> decVtx = {v0.x(), v0.y(), v0.z()};
+
+  for (size_t iSel = 0; iSel < mCompiledVariable.size(); ++iSel) {
+    const int selVariable = mCompiledVariable[iSel];
     if (selVariable == femtoDreamV0Selection::kV0DecVtxMax) {
       for (size_t i = 0; i < decVtx.size(); ++i) {
-        auto decVtxValue = decVtx.at(i);
-        sel.checkSelectionSetBit(decVtxValue, output, counter);
+        output |= static_cast<cutContainerType>(isSelectedCompiled(iSel, decVtx[i])) << counter++;
       }
     } else {
-      switch (selVariable) {
-        case (femtoDreamV0Selection::kV0Sign):
-          observable = sign;
-          break;
-        case (femtoDreamV0Selection::kV0pTMin):
-          observable = pT;
-          break;
-        case (femtoDreamV0Selection::kV0pTMax):
-          observable = pT;
-          break;
-        case (femtoDreamV0Selection::kV0etaMax):
-          observable = eta;
-          break;
-        case (femtoDreamV0Selection::kV0DCADaughMax):
-          observable = dcaDaughv0;
-          break;
-        case (femtoDreamV0Selection::kV0CPAMin):
-          observable = cpav0;
-          break;
-        case (femtoDreamV0Selection::kV0TranRadMin):
-          observable = tranRad;
-          break;
-        case (femtoDreamV0Selection::kV0TranRadMax):
-          observable = tranRad;
-          break;
-        case (femtoDreamV0Selection::kV0DecVtxMax):
-          break;
-      }
-      sel.checkSelectionSetBit(observable, output, counter);
+      output |= static_cast<cutContainerType>(isSelectedCompiled(iSel, observables[selVariable])) << counter++;
     }
   }
   return {
@@ -17,7 +17,7 @@
 #include <TH3D.h>
 #include <TF3.h>
 #include <TMath.h>
-#include <TComplex.h>
+#include <complex>
 
 #include "JFFlucAnalysis.h"
 
@@ -303,47 +303,47 @@ JFFlucAnalysis::~JFFlucAnalysis()
 
 #define A i
 #define B (1 - i)
-#define C(u) TComplex::Conjugate(u)
+#define C(u) std::conj(u)
 // TODO: conjugate macro
-inline TComplex TwoGap(const TComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b)
+inline JFFlucAnalysis::JComplex TwoGap(const JFFlucAnalysis::JComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b)
 {
   return pQq[A][a][1] * C(pQq[B][b][1]);
 }
 
-inline TComplex ThreeGap(const TComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b, uint c)
+inline JFFlucAnalysis::JComplex ThreeGap(const JFFlucAnalysis::JComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b, uint c)
 {
   return pQq[A][a][1] * C(pQq[B][b][1] * pQq[B][c][1] - pQq[B][b + c][2]);
 }
 
-inline TComplex FourGap22(const TComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b, uint c, uint d)
+inline JFFlucAnalysis::JComplex FourGap22(const JFFlucAnalysis::JComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b, uint c, uint d)
 {
   return pQq[A][a][1] * pQq[A][b][1] * C(pQq[B][c][1] * pQq[B][d][1]) - pQq[A][a + b][2] * C(pQq[B][c][1] * pQq[B][d][1]) - pQq[A][a][1] * pQq[A][b][1] * C(pQq[B][c + d][2]) + pQq[A][a + b][2] * C(pQq[B][c + d][2]);
 }
 
-inline TComplex FourGap13(const TComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b, uint c, uint d)
+inline JFFlucAnalysis::JComplex FourGap13(const JFFlucAnalysis::JComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint a, uint b, uint c, uint d)
 {
   return pQq[A][a][1] * C(pQq[B][b][1] * pQq[B][c][1] * pQq[B][d][1] - pQq[B][b + c][2] * pQq[B][d][1] - pQq[B][b + d][2] * pQq[B][c][1] - pQq[B][c + d][2] * pQq[B][b][1] + 2.0 * pQq[B][b + c + d][3]);
 }
 
-inline TComplex SixGap33(const TComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint n1, uint n2, uint n3, uint n4, uint n5, uint n6)
+inline JFFlucAnalysis::JComplex SixGap33(const JFFlucAnalysis::JComplex (*pQq)[JFFlucAnalysis::kNH][JFFlucAnalysis::nKL], uint i, uint n1, uint n2, uint n3, uint n4, uint n5, uint n6)
 {
   return pQq[A][n1][1] * pQq[A][n2][1] * pQq[A][n3][1] * C(pQq[B][n4][1] * pQq[B][n5][1] * pQq[B][n6][1]) - pQq[A][n1][1] * pQq[A][n2][1] * pQq[A][n3][1] * C(pQq[B][n4 + n5][2] * pQq[B][n6][1]) - pQq[A][n1][1] * pQq[A][n2][1] * pQq[A][n3][1] * C(pQq[B][n4 + n6][2] * pQq[B][n5][1]) - pQq[A][n1][1] * pQq[A][n2][1] * pQq[A][n3][1] * C(pQq[B][n5 + n6][2] * pQq[B][n4][1]) + 2.0 * pQq[A][n1][1] * pQq[A][n2][1] * pQq[A][n3][1] * C(pQq[B][n4 + n5 + n6][3]) - pQq[A][n1 + n2][2] * pQq[A][n3][1] * C(pQq[B][n4][1] * pQq[B][n5][1] * pQq[B][n6][1]) + pQq[A][n1 + n2][2] * pQq[A][n3][1] * C(pQq[B][n4 + n5][2] * pQq[B][n6][1]) + pQq[A][n1 + n2][2] * pQq[A][n3][1] * C(pQq[B][n4 + n6][2] * pQq[B][n5][1]) + pQq[A][n1 + n2][2] * pQq[A][n3][1] * C(pQq[B][n5 + n6][2] * pQq[B][n4][1]) - 2.0 * pQq[A][n1 + n2][2] * pQq[A][n3][1] * C(pQq[B][n4 + n5 + n6][3]) - pQq[A][n1 + n3][2] * pQq[A][n2][1] * C(pQq[B][n4][1] * pQq[B][n5][1] * pQq[B][n6][1]) + pQq[A][n1 + n3][2] * pQq[A][n2][1] * C(pQq[B][n4 + n5][2] * pQq[B][n6][1]) + pQq[A][n1 + n3][2] * pQq[A][n2][1] * C(pQq[B][n4 + n6][2] * pQq[B][n5][1]) + pQq[A][n1 + n3][2] * pQq[A][n2][1] * C(pQq[B][n5 + n6][2] * pQq[B][n4][1]) - 2.0 * pQq[A][n1 + n3][2] * pQq[A][n2][1] * C(pQq[B][n4 + n5 + n6][3]) - pQq[A][n2 + n3][2] * pQq[A][n1][1] * C(pQq[B][n4][1] * pQq[B][n5][1] * pQq[B][n6][1]) + pQq[A][n2 + n3][2] * pQq[A][n1][1] * C(pQq[B][n4 + n5][2] * pQq[B][n6][1]) + pQq[A][n2 + n3][2] * pQq[A][n1][1] * C(pQq[B][n4 + n6][2] * pQq[B][n5][1]) + pQq[A][n2 + n3][2] * pQq[A][n1][1] * C(pQq[B][n5 + n6][2] * pQq[B][n4][1]) - 2.0 * pQq[A][n2 + n3][2] * pQq[A][n1][1] * C(pQq[B][n4 + n5 + n6][3]) + 2.0 * pQq[A][n1 + n2 + n3][3] * C(pQq[B][n4][1] * pQq[B][n5][1] * pQq[B][n6][1]) - 2.0 * pQq[A][n1 + n2 + n3][3] * C(pQq[B][n4 + n5][2] * pQq[B][n6][1]) - 2.0 * pQq[A][n1 + n2 + n3][3] * C(pQq[B][n4 + n6][2] * pQq[B][n5][1]) - 2.0 * pQq[A][n1 + n2 + n3][3] * C(pQq[B][n5 + n6][2] * pQq[B][n4][1]) + 4.0 * pQq[A][n1 + n2 + n3][3] * C(pQq[B][n4 + n5 + n6][3]);
 }
 
-TComplex JFFlucAnalysis::Q(int n, int p)
+JFFlucAnalysis::JComplex JFFlucAnalysis::Q(int n, int p)
 {
   // Return QvectorQC
   // Q{-n, p} = Q{n, p}*
   return n >= 0 ? QvectorQC[n][p] : C(QvectorQC[-n][p]);
 }
 
-TComplex JFFlucAnalysis::Two(int n1, int n2)
+JFFlucAnalysis::JComplex JFFlucAnalysis::Two(int n1, int n2)
 {
   // two-particle correlation <exp[i(n1*phi1 + n2*phi2)]>
   return Q(n1, 1) * Q(n2, 1) - Q(n1 + n2, 2);
 }
 
-TComplex JFFlucAnalysis::Four(int n1, int n2, int n3, int n4)
+JFFlucAnalysis::JComplex JFFlucAnalysis::Four(int n1, int n2, int n3, int n4)
 {
 
   return Q(n1, 1) * Q(n2, 1) * Q(n3, 1) * Q(n4, 1) - Q(n1 + n2, 2) * Q(n3, 1) * Q(n4, 1) - Q(n2, 1) * Q(n1 + n3, 2) * Q(n4, 1) - Q(n1, 1) * Q(n2 + n3, 2) * Q(n4, 1) + 2. * Q(n1 + n2 + n3, 3) * Q(n4, 1) - Q(n2, 1) * Q(n3, 1) * Q(n1 + n4, 2) + Q(n2 + n3, 2) * Q(n1 + n4, 2) - Q(n1, 1) * Q(n3, 1) * Q(n2 + n4, 2) + Q(n1 + n3, 2) * Q(n2 + n4, 2) + 2. * Q(n3, 1) * Q(n1 + n2 + n4, 3) - Q(n1, 1) * Q(n2, 1) * Q(n3 + n4, 2) + Q(n1 + n2, 2) * Q(n3 + n4, 2) + 2. * Q(n2, 1) * Q(n1 + n3 + n4, 3) + 2. * Q(n1, 1) * Q(n2 + n3 + n4, 3) - 6. * Q(n1 + n2 + n3 + n4, 4);
@@ -354,11 +354,11 @@ TComplex JFFlucAnalysis::Four(int n1, int n2, int n3, int n4)
 void JFFlucAnalysis::UserExec(Option_t*)
 {
   for (UInt_t ih = 2; ih < kNH; ih++) {
-    fh_cos_n_phi[ih][fCBin]->Fill(QvectorQC[ih][1].Re() / QvectorQC[0][1].Re());
-    fh_sin_n_phi[ih][fCBin]->Fill(QvectorQC[ih][1].Im() / QvectorQC[0][1].Re());
+    fh_cos_n_phi[ih][fCBin]->Fill(QvectorQC[ih][1].real() / QvectorQC[0][1].real());
+    fh_sin_n_phi[ih][fCBin]->Fill(QvectorQC[ih][1].imag() / QvectorQC[0][1].real());
     //
     //
-    Double_t psi = QvectorQC[ih][1].Theta();
+    Double_t psi = std::arg(QvectorQC[ih][1]);
     fh_psi_n[ih][fCBin]->Fill(psi);
     fh_cos_n_psi_n[ih][fCBin]->Fill(TMath::Cos((Double_t)ih * psi));
     fh_sin_n_psi_n[ih][fCBin]->Fill(TMath::Sin((Double_t)ih * psi));
@@ -367,20 +367,20 @@ void JFFlucAnalysis::UserExec(Option_t*)
   Double_t vn2[kNH][nKL];
   Double_t vn2_vn2[kNH][nKL][kNH][nKL];
 
-  TComplex corr[kNH][nKL];
-  TComplex ncorr[kNH][nKL];
-  TComplex ncorr2[kNH][nKL][kcNH][nKL];
+  JComplex corr[kNH][nKL];
+  JComplex ncorr[kNH][nKL];
+  JComplex ncorr2[kNH][nKL][kcNH][nKL];
 
-  const TComplex(*pQq)[kNH][nKL] = QvectorQCgap;
+  const JComplex(*pQq)[kNH][nKL] = QvectorQCgap;
 
   for (UInt_t i = 0; i < 2; ++i) {
     if ((subeventMask & (1 << i)) == 0)
       continue;
-    Double_t ref_2p = TwoGap(pQq, i, 0, 0).Re();
-    Double_t ref_3p = ThreeGap(pQq, i, 0, 0, 0).Re();
-    Double_t ref_4p = FourGap22(pQq, i, 0, 0, 0, 0).Re();
-    Double_t ref_4pB = FourGap13(pQq, i, 0, 0, 0, 0).Re();
-    Double_t ref_6p = SixGap33(pQq, i, 0, 0, 0, 0, 0, 0).Re();
+    Double_t ref_2p = TwoGap(pQq, i, 0, 0).real();
+    Double_t ref_3p = ThreeGap(pQq, i, 0, 0, 0).real();
+    Double_t ref_4p = FourGap22(pQq, i, 0, 0, 0, 0).real();
+    Double_t ref_4pB = FourGap13(pQq, i, 0, 0, 0, 0).real();
+    Double_t ref_6p = SixGap33(pQq, i, 0, 0, 0, 0, 0, 0).real();
 
     Double_t ebe_2p_weight = 1.0;
     Double_t ebe_3p_weight = 1.0;
@@ -405,20 +405,20 @@ void JFFlucAnalysis::UserExec(Option_t*)
     if (flags & kFlucEbEWeighting) {
       for (UInt_t ik = 3; ik < 2 * nKL; ik++) {
         double dk = (double)ik;
-        ref_2Np[ik] = ref_2Np[ik - 1] * std::max(pQq[A][0][1].Re() - dk, 1.0) * std::max(pQq[B][0][1].Re() - dk, 1.0);
-        ebe_2Np_weight[ik] = ebe_2Np_weight[ik - 1] * std::max(pQq[A][0][1].Re() - dk, 1.0) * std::max(pQq[B][0][1].Re() - dk, 1.0);
+        ref_2Np[ik] = ref_2Np[ik - 1] * std::max(pQq[A][0][1].real() - dk, 1.0) * std::max(pQq[B][0][1].real() - dk, 1.0);
+        ebe_2Np_weight[ik] = ebe_2Np_weight[ik - 1] * std::max(pQq[A][0][1].real() - dk, 1.0) * std::max(pQq[B][0][1].real() - dk, 1.0);
       }
     } else
       for (UInt_t ik = 3; ik < 2 * nKL; ik++) {
         double dk = (double)ik;
-        ref_2Np[ik] = ref_2Np[ik - 1] * std::max(pQq[A][0][1].Re() - dk, 1.0) * std::max(pQq[B][0][1].Re() - dk, 1.0);
+        ref_2Np[ik] = ref_2Np[ik - 1] * std::max(pQq[A][0][1].real() - dk, 1.0) * std::max(pQq[B][0][1].real() - dk, 1.0);
         ebe_2Np_weight[ik] = 1.0;
       }
 
     for (UInt_t ih = 2; ih < kNH; ih++) {
       corr[ih][1] = TwoGap(pQq, i, ih, ih);
       for (UInt_t ik = 2; ik < nKL; ik++)
-        corr[ih][ik] = corr[ih][ik - 1] * corr[ih][1]; // TComplex::Power(corr[ih][1],ik);
+        corr[ih][ik] = corr[ih][ik - 1] * corr[ih][1]; // std::pow(corr[ih][1],ik);
       ncorr[ih][1] = corr[ih][1];
       ncorr[ih][2] = FourGap22(pQq, i, ih, ih, ih, ih);
       ncorr[ih][3] = SixGap33(pQq, i, ih, ih, ih, ih, ih, ih);
@@ -437,12 +437,12 @@ void JFFlucAnalysis::UserExec(Option_t*)
 
     for (UInt_t ih = 2; ih < kNH; ih++) {
       for (UInt_t ik = 1; ik < nKL; ik++) { // 2k(0) =1, 2k(1) =2, 2k(2)=4....
-        vn2[ih][ik] = corr[ih][ik].Re() / ref_2Np[ik - 1];
+        vn2[ih][ik] = corr[ih][ik].real() / ref_2Np[ik - 1];
         fh_vn[ih][ik][fCBin]->Fill(vn2[ih][ik], ebe_2Np_weight[ik - 1]);
-        fh_vna[ih][ik][fCBin]->Fill(ncorr[ih][ik].Re() / ref_2Np[ik - 1], ebe_2Np_weight[ik - 1]);
+        fh_vna[ih][ik][fCBin]->Fill(ncorr[ih][ik].real() / ref_2Np[ik - 1], ebe_2Np_weight[ik - 1]);
         for (UInt_t ihh = 2; ihh < kcNH; ihh++) {
           for (UInt_t ikk = 1; ikk < nKL; ikk++) {
-            vn2_vn2[ih][ik][ihh][ikk] = ncorr2[ih][ik][ihh][ikk] / ref_2Np[ik + ikk - 1];
+            vn2_vn2[ih][ik][ihh][ikk] = ncorr2[ih][ik][ihh][ikk].real() / ref_2Np[ik + ikk - 1];
             fh_vn_vn[ih][ik][ihh][ikk][fCBin]->Fill(vn2_vn2[ih][ik][ihh][ikk], ebe_2Np_weight[ik + ikk - 1]);
           }
         }
@@ -450,73 +450,73 @@ void JFFlucAnalysis::UserExec(Option_t*)
     }
 
     //************************************************************************
-    TComplex V4V2star_2 = pQq[A][4][1] * pQq[B][2][1] * pQq[B][2][1];
-    TComplex V4V2starv2_2 = V4V2star_2 * corr[2][1] / ref_2Np[0];                                       // vn[2][1]
-    TComplex V4V2starv2_4 = V4V2star_2 * corr[2][2] / ref_2Np[1];                                       // vn2[2][2]
-    TComplex V5V2starV3starv2_2 = pQq[A][5][1] * pQq[B][2][1] * pQq[B][3][1] * corr[2][1] / ref_2Np[0]; // vn2[2][1]
-    TComplex V5V2starV3star = pQq[A][5][1] * pQq[B][2][1] * pQq[B][3][1];
-    TComplex V5V2starV3startv3_2 = V5V2starV3star * corr[3][1] / ref_2Np[0]; // vn2[3][1]
-    TComplex V6V2star_3 = pQq[A][6][1] * pQq[B][2][1] * pQq[B][2][1] * pQq[B][2][1];
-    TComplex V6V3star_2 = pQq[A][6][1] * pQq[B][3][1] * pQq[B][3][1];
-    TComplex V6V2starV4star = pQq[A][6][1] * pQq[B][2][1] * pQq[B][4][1];
-    TComplex V7V2star_2V3star = pQq[A][7][1] * pQq[B][2][1] * pQq[B][2][1] * pQq[B][3][1];
-    TComplex V7V2starV5star = pQq[A][7][1] * pQq[B][2][1] * pQq[B][5][1];
-    TComplex V7V3starV4star = pQq[A][7][1] * pQq[B][3][1] * pQq[B][4][1];
-    TComplex V8V2starV3star_2 = pQq[A][8][1] * pQq[B][2][1] * pQq[B][3][1] * pQq[B][3][1];
-    TComplex V8V2star_4 = pQq[A][8][1] * TComplex::Power(pQq[B][2][1], 4);
+    JComplex V4V2star_2 = pQq[A][4][1] * pQq[B][2][1] * pQq[B][2][1];
+    JComplex V4V2starv2_2 = V4V2star_2 * corr[2][1] / ref_2Np[0];                                       // vn[2][1]
+    JComplex V4V2starv2_4 = V4V2star_2 * corr[2][2] / ref_2Np[1];                                       // vn2[2][2]
+    JComplex V5V2starV3starv2_2 = pQq[A][5][1] * pQq[B][2][1] * pQq[B][3][1] * corr[2][1] / ref_2Np[0]; // vn2[2][1]
+    JComplex V5V2starV3star = pQq[A][5][1] * pQq[B][2][1] * pQq[B][3][1];
+    JComplex V5V2starV3startv3_2 = V5V2starV3star * corr[3][1] / ref_2Np[0]; // vn2[3][1]
+    JComplex V6V2star_3 = pQq[A][6][1] * pQq[B][2][1] * pQq[B][2][1] * pQq[B][2][1];
+    JComplex V6V3star_2 = pQq[A][6][1] * pQq[B][3][1] * pQq[B][3][1];
+    JComplex V6V2starV4star = pQq[A][6][1] * pQq[B][2][1] * pQq[B][4][1];
+    JComplex V7V2star_2V3star = pQq[A][7][1] * pQq[B][2][1] * pQq[B][2][1] * pQq[B][3][1];
+    JComplex V7V2starV5star = pQq[A][7][1] * pQq[B][2][1] * pQq[B][5][1];
+    JComplex V7V3starV4star = pQq[A][7][1] * pQq[B][3][1] * pQq[B][4][1];
+    JComplex V8V2starV3star_2 = pQq[A][8][1] * pQq[B][2][1] * pQq[B][3][1] * pQq[B][3][1];
+    JComplex V8V2star_4 = pQq[A][8][1] * pQq[B][2][1] * pQq[B][2][1] * pQq[B][2][1] * pQq[B][2][1];
 
     // New correlators (Modified by You's correction term for self-correlations)
-    TComplex nV4V2star_2 = ThreeGap(pQq, i, 4, 2, 2) / ref_3p;
-    TComplex nV5V2starV3star = ThreeGap(pQq, i, 5, 2, 3) / ref_3p;
-    TComplex nV6V2star_3 = FourGap13(pQq, i, 6, 2, 2, 2) / ref_4pB;
-    TComplex nV6V3star_2 = ThreeGap(pQq, i, 6, 3, 3) / ref_3p;
-    TComplex nV6V2starV4star = ThreeGap(pQq, i, 6, 2, 4) / ref_3p;
-    TComplex nV7V2star_2V3star = FourGap13(pQq, i, 7, 2, 2, 3) / ref_4pB;
-    TComplex nV7V2starV5star = ThreeGap(pQq, i, 7, 2, 5) / ref_3p;
-    TComplex nV7V3starV4star = ThreeGap(pQq, i, 7, 3, 4) / ref_3p;
-    TComplex nV8V2starV3star_2 = FourGap13(pQq, i, 8, 2, 3, 3) / ref_4pB;
-
-    TComplex nV4V4V2V2 = FourGap22(pQq, i, 4, 2, 4, 2) / ref_4p;
-    TComplex nV3V3V2V2 = FourGap22(pQq, i, 3, 2, 3, 2) / ref_4p;
-    TComplex nV5V5V2V2 = FourGap22(pQq, i, 5, 2, 5, 2) / ref_4p;
-    TComplex nV5V5V3V3 = FourGap22(pQq, i, 5, 3, 5, 3) / ref_4p;
-    TComplex nV4V4V3V3 = FourGap22(pQq, i, 4, 3, 4, 3) / ref_4p;
-
-    fh_correlator[0][fCBin]->Fill(V4V2starv2_2.Re());
-    fh_correlator[1][fCBin]->Fill(V4V2starv2_4.Re());
-    fh_correlator[2][fCBin]->Fill(V4V2star_2.Re(), ebe_3p_weight); // added 2015.3.18
-    fh_correlator[3][fCBin]->Fill(V5V2starV3starv2_2.Re());
-    fh_correlator[4][fCBin]->Fill(V5V2starV3star.Re(), ebe_3p_weight);
-    fh_correlator[5][fCBin]->Fill(V5V2starV3startv3_2.Re());
-    fh_correlator[6][fCBin]->Fill(V6V2star_3.Re(), ebe_4p_weightB);
-    fh_correlator[7][fCBin]->Fill(V6V3star_2.Re(), ebe_3p_weight);
-    fh_correlator[8][fCBin]->Fill(V7V2star_2V3star.Re(), ebe_4p_weightB);
-
-    fh_correlator[9][fCBin]->Fill(nV4V2star_2.Re(), ebe_3p_weight); // added 2015.6.10
-    fh_correlator[10][fCBin]->Fill(nV5V2starV3star.Re(), ebe_3p_weight);
-    fh_correlator[11][fCBin]->Fill(nV6V3star_2.Re(), ebe_3p_weight);
+    JComplex nV4V2star_2 = ThreeGap(pQq, i, 4, 2, 2) / ref_3p;
+    JComplex nV5V2starV3star = ThreeGap(pQq, i, 5, 2, 3) / ref_3p;
+    JComplex nV6V2star_3 = FourGap13(pQq, i, 6, 2, 2, 2) / ref_4pB;
+    JComplex nV6V3star_2 = ThreeGap(pQq, i, 6, 3, 3) / ref_3p;
+    JComplex nV6V2starV4star = ThreeGap(pQq, i, 6, 2, 4) / ref_3p;
+    JComplex nV7V2star_2V3star = FourGap13(pQq, i, 7, 2, 2, 3) / ref_4pB;
+    JComplex nV7V2starV5star = ThreeGap(pQq, i, 7, 2, 5) / ref_3p;
+    JComplex nV7V3starV4star = ThreeGap(pQq, i, 7, 3, 4) / ref_3p;
+    JComplex nV8V2starV3star_2 = FourGap13(pQq, i, 8, 2, 3, 3) / ref_4pB;
+
+    JComplex nV4V4V2V2 = FourGap22(pQq, i, 4, 2, 4, 2) / ref_4p;
+    JComplex nV3V3V2V2 = FourGap22(pQq, i, 3, 2, 3, 2) / ref_4p;
+    JComplex nV5V5V2V2 = FourGap22(pQq, i, 5, 2, 5, 2) / ref_4p;
+    JComplex nV5V5V3V3 = FourGap22(pQq, i, 5, 3, 5, 3) / ref_4p;
+    JComplex nV4V4V3V3 = FourGap22(pQq, i, 4, 3, 4, 3) / ref_4p;
+
+    fh_correlator[0][fCBin]->Fill(V4V2starv2_2.real());
+    fh_correlator[1][fCBin]->Fill(V4V2starv2_4.real());
+    fh_correlator[2][fCBin]->Fill(V4V2star_2.real(), ebe_3p_weight); // added 2015.3.18
+    fh_correlator[3][fCBin]->Fill(V5V2starV3starv2_2.real());
+    fh_correlator[4][fCBin]->Fill(V5V2starV3star.real(), ebe_3p_weight);
+    fh_correlator[5][fCBin]->Fill(V5V2starV3startv3_2.real());
+    fh_correlator[6][fCBin]->Fill(V6V2star_3.real(), ebe_4p_weightB);
+    fh_correlator[7][fCBin]->Fill(V6V3star_2.real(), ebe_3p_weight);
+    fh_correlator[8][fCBin]->Fill(V7V2star_2V3star.real(), ebe_4p_weightB);
+
+    fh_correlator[9][fCBin]->Fill(nV4V2star_2.real(), ebe_3p_weight); // added 2015.6.10
+    fh_correlator[10][fCBin]->Fill(nV5V2starV3star.real(), ebe_3p_weight);
+    fh_correlator[11][fCBin]->Fill(nV6V3star_2.real(), ebe_3p_weight);
 
     // use this to avoid self-correlation 4p correlation (2 particles from A, 2 particles from B) -> MA(MA-1)MB(MB-1) : evt weight..
-    fh_correlator[12][fCBin]->Fill(nV4V4V2V2.Re(), ebe_2Np_weight[1]);
-    fh_correlator[13][fCBin]->Fill(nV3V3V2V2.Re(), ebe_2Np_weight[1]);
+    fh_correlator[12][fCBin]->Fill(nV4V4V2V2.real(), ebe_2Np_weight[1]);
+    fh_correlator[13][fCBin]->Fill(nV3V3V2V2.real(), ebe_2Np_weight[1]);
 
-    fh_correlator[14][fCBin]->Fill(nV5V5V2V2.Re(), ebe_2Np_weight[1]);
-    fh_correlator[15][fCBin]->Fill(nV5V5V3V3.Re(), ebe_2Np_weight[1]);
-    fh_correlator[16][fCBin]->Fill(nV4V4V3V3.Re(), ebe_2Np_weight[1]);
+    fh_correlator[14][fCBin]->Fill(nV5V5V2V2.real(), ebe_2Np_weight[1]);
+    fh_correlator[15][fCBin]->Fill(nV5V5V3V3.real(), ebe_2Np_weight[1]);
+    fh_correlator[16][fCBin]->Fill(nV4V4V3V3.real(), ebe_2Np_weight[1]);
 
     // higher order correlators, added 2017.8.10
-    fh_correlator[17][fCBin]->Fill(V8V2starV3star_2.Re(), ebe_4p_weightB);
-    fh_correlator[18][fCBin]->Fill(V8V2star_4.Re()); // 5p weight
-    fh_correlator[19][fCBin]->Fill(nV6V2star_3.Re(), ebe_4p_weightB);
-    fh_correlator[20][fCBin]->Fill(nV7V2star_2V3star.Re(), ebe_4p_weightB);
-    fh_correlator[21][fCBin]->Fill(nV8V2starV3star_2.Re(), ebe_4p_weightB);
-
-    fh_correlator[22][fCBin]->Fill(V6V2starV4star.Re(), ebe_3p_weight);
-    fh_correlator[23][fCBin]->Fill(V7V2starV5star.Re(), ebe_3p_weight);
-    fh_correlator[24][fCBin]->Fill(V7V3starV4star.Re(), ebe_3p_weight);
-    fh_correlator[25][fCBin]->Fill(nV6V2starV4star.Re(), ebe_3p_weight);
-    fh_correlator[26][fCBin]->Fill(nV7V2starV5star.Re(), ebe_3p_weight);
-    fh_correlator[27][fCBin]->Fill(nV7V3starV4star.Re(), ebe_3p_weight);
+    fh_correlator[17][fCBin]->Fill(V8V2starV3star_2.real(), ebe_4p_weightB);
+    fh_correlator[18][fCBin]->Fill(V8V2star_4.real()); // 5p weight
+    fh_correlator[19][fCBin]->Fill(nV6V2star_3.real(), ebe_4p_weightB);
+    fh_correlator[20][fCBin]->Fill(nV7V2star_2V3star.real(), ebe_4p_weightB);
+    fh_correlator[21][fCBin]->Fill(nV8V2starV3star_2.real(), ebe_4p_weightB);
+
+    fh_correlator[22][fCBin]->Fill(V6V2starV4star.real(), ebe_3p_weight);
+    fh_correlator[23][fCBin]->Fill(V7V2starV5star.real(), ebe_3p_weight);
+    fh_correlator[24][fCBin]->Fill(V7V3starV4star.real(), ebe_3p_weight);
+    fh_correlator[25][fCBin]->Fill(nV6V2starV4star.real(), ebe_3p_weight);
+    fh_correlator[26][fCBin]->Fill(nV7V2starV5star.real(), ebe_3p_weight);
+    fh_correlator[27][fCBin]->Fill(nV7V3starV4star.real(), ebe_3p_weight);
   }
 
   enum { kSubA,
@@ -527,23 +527,23 @@ void JFFlucAnalysis::UserExec(Option_t*)
   Double_t event_weight_two = 1.0;
   Double_t event_weight_two_gap = 1.0;
   if (flags & kFlucEbEWeighting) {
-    event_weight_four = Four(0, 0, 0, 0).Re();
-    event_weight_two = Two(0, 0).Re();
-    event_weight_two_gap = (QvectorQCgap[kSubA][0][1] * QvectorQCgap[kSubB][0][1]).Re();
+    event_weight_four = Four(0, 0, 0, 0).real();
+    event_weight_two = Two(0, 0).real();
+    event_weight_two_gap = (QvectorQCgap[kSubA][0][1] * QvectorQCgap[kSubB][0][1]).real();
   }
 
   for (UInt_t ih = 2; ih < kNH; ih++) {
     for (UInt_t ihh = 2, mm = (ih < kcNH ? ih : kcNH); ihh < mm; ihh++) {
-      TComplex scfour = Four(ih, ihh, -ih, -ihh) / Four(0, 0, 0, 0).Re();
+      JComplex scfour = Four(ih, ihh, -ih, -ihh) / Four(0, 0, 0, 0).real();
 
-      fh_SC_with_QC_4corr[ih][ihh][fCBin]->Fill(scfour.Re(), event_weight_four);
+      fh_SC_with_QC_4corr[ih][ihh][fCBin]->Fill(scfour.real(), event_weight_four);
     }
 
-    TComplex sctwo = Two(ih, -ih) / Two(0, 0).Re();
-    fh_SC_with_QC_2corr[ih][fCBin]->Fill(sctwo.Re(), event_weight_two);
+    JComplex sctwo = Two(ih, -ih) / Two(0, 0).real();
+    fh_SC_with_QC_2corr[ih][fCBin]->Fill(sctwo.real(), event_weight_two);
 
-    TComplex sctwoGap = (QvectorQCgap[kSubA][ih][1] * TComplex::Conjugate(QvectorQCgap[kSubB][ih][1])) / (QvectorQCgap[kSubA][0][1] * QvectorQCgap[kSubB][0][1]).Re();
-    fh_SC_with_QC_2corr_gap[ih][fCBin]->Fill(sctwoGap.Re(), event_weight_two_gap);
+    JComplex sctwoGap = (QvectorQCgap[kSubA][ih][1] * std::conj(QvectorQCgap[kSubB][ih][1])) / (QvectorQCgap[kSubA][0][1] * QvectorQCgap[kSubB][0][1]).real();
+    fh_SC_with_QC_2corr_gap[ih][fCBin]->Fill(sctwoGap.real(), event_weight_two_gap);
   }
 }
 
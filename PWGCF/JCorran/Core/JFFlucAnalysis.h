@@ -16,7 +16,8 @@
 #define JFFLUC_ANALYSIS_H
 
 #include "JHistManager.h"
-#include <TComplex.h>
+#include <complex>
+#include <vector>
 
 class JFFlucAnalysis
 {
@@ -26,12 +27,14 @@ class JFFlucAnalysis
   JFFlucAnalysis(const JFFlucAnalysis& a);             // not implemented
   JFFlucAnalysis& operator=(const JFFlucAnalysis& ap); // not implemented
 
+  typedef std::complex<double> JComplex;
+
   ~JFFlucAnalysis();
   void UserCreateOutputObjects();
   void Init();
-  TComplex Q(int n, int p);
-  TComplex Two(int n1, int n2);
-  TComplex Four(int n1, int n2, int n3, int n4);
+  JComplex Q(int n, int p);
+  JComplex Two(int n1, int n2);
+  JComplex Four(int n1, int n2, int n3, int n4);
   void UserExec(Option_t* option);
   void Terminate(Option_t*);
 
@@ -117,13 +120,13 @@ class JFFlucAnalysis
   inline void CalculateQvectorsQC(JInputClass& inputInst)
   {
     // calculate Q-vector for QC method ( no subgroup )
-    for (UInt_t ih = 0; ih < kNH; ih++) {
-      for (UInt_t ik = 0; ik < nKL; ++ik) {
-        QvectorQC[ih][ik] = TComplex(0, 0);
-        for (UInt_t isub = 0; isub < 2; isub++)
-          QvectorQCgap[isub][ih][ik] = TComplex(0, 0);
-      }
-    } // for max harmonics
+    // collect the accepted tracks first, the Q-vectors are then accumulated harmonic by harmonic
+    // over the track arrays, building cos(n*phi), sin(n*phi) by angle addition from one sincos per track
+    fTrkCos.clear();
+    fTrkSin.clear();
+    fTrkWeight.clear();
+    fTrkSubA.clear();
+    fTrkSubB.clear();
     for (auto& track : inputInst) {
       // pt cuts already applied in task.
       if (track.eta() < -fEta_max || track.eta() > fEta_max)
@@ -132,19 +135,45 @@ class JFFlucAnalysis
       Double_t effCorr = 1.0;    // itrack->GetTrackEff();//fEfficiency->GetCorrection( track.pt(), fEffFilterBit, fCent); //XXXXXX
       Double_t phiNUACorr = 1.0; // itrack->GetWeight(); //XXXXXX
 
-      UInt_t isub = (UInt_t)(track.eta() > 0.0);
-      for (UInt_t ih = 0; ih < kNH; ih++) {
-        Double_t tf = 1.0;
-        TComplex q[nKL];
-        for (UInt_t ik = 0; ik < nKL; ik++) {
-          q[ik] = TComplex(tf * TMath::Cos(ih * track.phi()), tf * TMath::Sin(ih * track.phi()));
-          QvectorQC[ih][ik] += q[ik];
-
-          if (TMath::Abs(track.eta()) > fEta_min)
-            QvectorQCgap[isub][ih][ik] += q[ik];
+      Double_t phi = track.phi();
+      fTrkCos.push_back(TMath::Cos(phi));
+      fTrkSin.push_back(TMath::Sin(phi));
+      fTrkWeight.push_back(1.0 / (phiNUACorr * effCorr));
+      bool gap = TMath::Abs(track.eta()) > fEta_min;
+      fTrkSubA.push_back(gap && track.eta() <= 0.0 ? 1.0 : 0.0);
+      fTrkSubB.push_back(gap && track.eta() > 0.0 ? 1.0 : 0.0);
+    }
 
-          tf *= 1.0 / (phiNUACorr * effCorr);
+    const UInt_t ntrk = fTrkCos.size();
+    fTrkCosN.assign(ntrk, 1.0); // cos(ih*phi), starting at ih = 0
+    fTrkSinN.assign(ntrk, 0.0);
+    for (UInt_t ih = 0; ih < kNH; ih++) {
+      fTrkTf.assign(ntrk, 1.0);
+      Double_t re[nKL] = {0.}, im[nKL] = {0.};
+      Double_t reA[nKL] = {0.}, imA[nKL] = {0.};
+      Double_t reB[nKL] = {0.}, imB[nKL] = {0.};
+      for (UInt_t ik = 0; ik < nKL; ik++) {
+        for (UInt_t it = 0; it < ntrk; it++) {
+          Double_t qre = fTrkTf[it] * fTrkCosN[it];
+          Double_t qim = fTrkTf[it] * fTrkSinN[it];
+          fTrkTf[it] *= fTrkWeight[it]; // weight^ik
+          re[ik] += qre;
+          im[ik] += qim;
+          reA[ik] += fTrkSubA[it] * qre;
+          imA[ik] += fTrkSubA[it] * qim;
+          reB[ik] += fTrkSubB[it] * qre;
+          imB[ik] += fTrkSubB[it] * qim;
         }
+        QvectorQC[ih][ik] = JComplex(re[ik], im[ik]);
+        QvectorQCgap[0][ih][ik] = JComplex(reA[ik], imA[ik]);
+        QvectorQCgap[1][ih][ik] = JComplex(reB[ik], imB[ik]);
+      }
+      // advance to harmonic ih+1: e^{i(n+1)phi} = e^{in*phi} * e^{i*phi}
+      for (UInt_t it = 0; it < ntrk; it++) {
+        Double_t c = fTrkCosN[it] * fTrkCos[it] - fTrkSinN[it] * fTrkSin[it];
+        Double_t s = fTrkSinN[it] * fTrkCos[it] + fTrkCosN[it] * fTrkSin[it];
+        fTrkCosN[it] = c;
+        fTrkSinN[it] = s;
       }
     }
   };
@@ -189,8 +218,18 @@ class JFFlucAnalysis
   Double_t fEta_min;
   Double_t fEta_max;
 
-  TComplex QvectorQC[kNH][nKL];
-  TComplex QvectorQCgap[2][kNH][nKL]; // ksub
+  JComplex QvectorQC[kNH][nKL];        // [harmonic][power]
+  JComplex QvectorQCgap[2][kNH][nKL]; // ksub
+
+  // per-event track buffers for the Q-vector calculation
+  std::vector<Double_t> fTrkCos;    //!
+  std::vector<Double_t> fTrkSin;    //!
+  std::vector<Double_t> fTrkCosN;   //!
+  std::vector<Double_t> fTrkSinN;   //!
+  std::vector<Double_t> fTrkWeight; //!
+  std::vector<Double_t> fTrkTf;     //!
+  std::vector<Double_t> fTrkSubA;   //!
+  std::vector<Double_t> fTrkSubB;   //!
 
   JHistManager* fHMG; //!
 
@@ -382,17 +382,13 @@ void EventSelectionFilterAndAnalysis::ConstructCutFromString(const TString& cuts
 void EventSelectionFilterAndAnalysis::ComplexBrickHelper::armedBrick(uint64_t& armedmask, uint64_t& optmask, uint64_t& forcedmask, int& bit)
 {
   auto armedBrick = [&](auto brick, bool opt = false) {
-    std::vector<bool> res = brick->IsArmed();
-    for (auto b : res) {
-      if (b) {
-        SETBIT(armedmask, bit);
-        if (opt) {
-          SETBIT(optmask, bit);
-        } else {
-          SETBIT(forcedmask, bit);
-        }
-      }
-      bit++;
+    uint64_t brickmask = 0UL;
+    brick->IsArmed(brickmask, bit);
+    armedmask |= brickmask;
+    if (opt) {
+      optmask |= brickmask;
+    } else {
+      forcedmask |= brickmask;
     }
   };
 
@@ -430,17 +426,13 @@ void EventSelectionFilterAndAnalysis::StoreArmedMask()
   int bit = 0;
 
   auto armedBrick = [&](auto brick, bool opt = false) {
-    std::vector<bool> res = brick->IsArmed();
-    for (auto b : res) {
-      if (b) {
-        SETBIT(armedMask, bit);
-        if (opt) {
-          SETBIT(optMask, bit);
-        } else {
-          SETBIT(forcedMask, bit);
-        }
-      }
-      bit++;
+    uint64_t brickmask = 0UL;
+    brick->IsArmed(brickmask, bit);
+    armedMask |= brickmask;
+    if (opt) {
+      optMask |= brickmask;
+    } else {
+      forcedMask |= brickmask;
     }
   };
 
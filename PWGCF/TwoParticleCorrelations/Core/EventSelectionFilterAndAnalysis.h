@@ -151,16 +151,7 @@ inline void EventSelectionFilterAndAnalysis::StoreMultiplicities(CollisionToFilt
 
 inline bool EventSelectionFilterAndAnalysis::filterBrickValue(uint64_t& mask, int& bit, CutBrick<float>* brick, float value)
 {
-  bool atleastone = false;
-  std::vector<bool> res = brick->Filter(value);
-  for (auto b : res) {
-    if (b) {
-      atleastone = true;
-      SETBIT(mask, bit);
-    }
-    bit++;
-  }
-  return atleastone;
+  return brick->Filter(value, mask, bit);
 };
 
 inline bool EventSelectionFilterAndAnalysis::ComplexBrickHelper::Filter(uint64_t& mask, int& bit)
@@ -154,13 +154,7 @@ inline uint64_t PIDSelectionFilterAndAnalysis::Filter(TrackToFilter const& track
 
   auto filterBrickValue = [&](auto brick, auto value) {
     if (brick != nullptr) {
-      std::vector<bool> res = brick->Filter(value);
-      for (auto b : res) {
-        if (b) {
-          SETBIT(selectedMask, bit);
-        }
-        bit++;
-      }
+      brick->Filter(value, selectedMask, bit);
     }
   };
   filterBrickValue(mCloseNsigmasTPC[kElectron], track.tpcNSigmaEl());
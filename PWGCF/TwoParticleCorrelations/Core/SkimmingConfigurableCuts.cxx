@@ -9,6 +9,7 @@
 // granted to it by virtue of its status as an Intergovernmental Organization
 // or submit itself to any jurisdiction.
 
+#include <algorithm>
 #include <regex>
 #include <TObjArray.h>
 
@@ -144,18 +145,20 @@ void CutBrickLimit<TValueToFilter>::ConstructCutFromString(const TString& cutstr
   }
 }
 
-/// \brief Returns wether the cut brick is incorporated in the selection chain
-/// \return true if the cut brick is incorporated
+/// \brief Codes wether the cut brick is incorporated in the selection chain
+/// \param mask The mask where the brick bit is set if the brick is incorporated
+/// \param bit The brick bit, on return the bit next to the brick
+/// \return 1 if the cut brick is incorporated 0 otherwise
 template <typename TValueToFilter>
-std::vector<bool> CutBrickLimit<TValueToFilter>::IsArmed()
+int CutBrickLimit<TValueToFilter>::IsArmed(uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
+  int narmed = 0;
   if (this->mMode == this->kSELECTED) {
-    res.push_back(true);
-  } else {
-    res.push_back(false);
+    SETBIT(mask, bit);
+    narmed = 1;
   }
-  return res;
+  bit++;
+  return narmed;
 }
 
 templateClassImp(CutBrickLimit);
@@ -278,18 +281,20 @@ void CutBrickThreshold<TValueToFilter>::ConstructCutFromString(const TString& cu
   }
 }
 
-/// \brief Returns wether the cut brick is incorporated in the selection chain
-/// \return true if the cut brick is incorporated
+/// \brief Codes wether the cut brick is incorporated in the selection chain
+/// \param mask The mask where the brick bit is set if the brick is incorporated
+/// \param bit The brick bit, on return the bit next to the brick
+/// \return 1 if the cut brick is incorporated 0 otherwise
 template <typename TValueToFilter>
-std::vector<bool> CutBrickThreshold<TValueToFilter>::IsArmed()
+int CutBrickThreshold<TValueToFilter>::IsArmed(uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
+  int narmed = 0;
   if (this->mMode == this->kSELECTED) {
-    res.push_back(true);
-  } else {
-    res.push_back(false);
+    SETBIT(mask, bit);
+    narmed = 1;
   }
-  return res;
+  bit++;
+  return narmed;
 }
 
 templateClassImp(CutBrickThreshold);
@@ -417,18 +422,20 @@ void CutBrickRange<TValueToFilter>::ConstructCutFromString(const TString& cutstr
   }
 }
 
-/// \brief Returns wether the cut brick is incorporated in the selection chain
-/// \return true if the cut brick is incorporated
+/// \brief Codes wether the cut brick is incorporated in the selection chain
+/// \param mask The mask where the brick bit is set if the brick is incorporated
+/// \param bit The brick bit, on return the bit next to the brick
+/// \return 1 if the cut brick is incorporated 0 otherwise
 template <typename TValueToFilter>
-std::vector<bool> CutBrickRange<TValueToFilter>::IsArmed()
+int CutBrickRange<TValueToFilter>::IsArmed(uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
+  int narmed = 0;
   if (this->mMode == this->kSELECTED) {
-    res.push_back(true);
-  } else {
-    res.push_back(false);
+    SETBIT(mask, bit);
+    narmed = 1;
   }
-  return res;
+  bit++;
+  return narmed;
 }
 
 templateClassImp(CutBrickRange);
@@ -561,18 +568,20 @@ void CutBrickExtToRange<TValueToFilter>::ConstructCutFromString(const TString& c
   }
 }
 
-/// \brief Returns wether the cut brick is incorporated in the selection chain
-/// \return true if the cut brick is incorporated
+/// \brief Codes wether the cut brick is incorporated in the selection chain
+/// \param mask The mask where the brick bit is set if the brick is incorporated
+/// \param bit The brick bit, on return the bit next to the brick
+/// \return 1 if the cut brick is incorporated 0 otherwise
 template <typename TValueToFilter>
-std::vector<bool> CutBrickExtToRange<TValueToFilter>::IsArmed()
+int CutBrickExtToRange<TValueToFilter>::IsArmed(uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
+  int narmed = 0;
   if (this->mMode == this->kSELECTED) {
-    res.push_back(true);
-  } else {
-    res.push_back(false);
+    SETBIT(mask, bit);
+    narmed = 1;
   }
-  return res;
+  bit++;
+  return narmed;
 }
 
 templateClassImp(CutBrickExtToRange);
@@ -720,53 +729,49 @@ void CutBrickSelectorMultipleRanges<TValueToFilter>::ConstructCutFromString(cons
   }
 }
 
-/// \brief Returns wether the cut brick is incorporated in the selection chain
-/// \return true if the cut brick is incorporated
+/// \brief Codes wether the cut brick is incorporated in the selection chain
+/// \param mask The mask where the bits of the ranges are set if the brick is incorporated
+/// \param bit The bit of the first range, on return the bit next to the brick
+/// \return the number of incorporated ranges
 template <typename TValueToFilter>
-std::vector<bool> CutBrickSelectorMultipleRanges<TValueToFilter>::IsArmed()
+int CutBrickSelectorMultipleRanges<TValueToFilter>::IsArmed(uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
-  res.reserve(Length());
+  int narmed = 0;
   if (this->mMode == this->kSELECTED) {
     for (unsigned int i = 0; i < mActive.size(); ++i) {
-      res.push_back(true);
-    }
-  } else {
-    for (unsigned int i = 0; i < mActive.size(); ++i) {
-      res.push_back(false);
+      SETBIT(mask, bit + i);
     }
+    narmed = mActive.size();
   }
-  return res;
+  bit += mActive.size();
+  return narmed;
 }
 
 /// \brief Filter the passed value to update the brick status accordingly
 /// \param value The value to filter
+/// \param mask The mask where the bit of the range including the value is set
+/// \param bit The bit of the first range, on return the bit next to the brick
 /// \return true if the value passed the cut false otherwise
 template <typename TValueToFilter>
-std::vector<bool> CutBrickSelectorMultipleRanges<TValueToFilter>::Filter(const TValueToFilter& value)
+bool CutBrickSelectorMultipleRanges<TValueToFilter>::Filter(const TValueToFilter& value, uint64_t& mask, int& bit)
 {
+  unsigned int nranges = mActive.size();
+  unsigned int active = nranges;
   if ((mEdges.front() <= value) and (value < mEdges.back())) {
+    active = std::upper_bound(mEdges.begin() + 1, mEdges.end(), value) - mEdges.begin() - 1;
+  }
+  for (unsigned int i = 0; i < nranges; ++i) {
+    mActive[i] = (i == active);
+  }
+  bool passed = active < nranges;
+  if (passed) {
     this->mState = this->kACTIVE;
-    unsigned int last = mActive.size();
-    for (unsigned int i = 0; i < mActive.size(); ++i) {
-      if (value < mEdges[i + 1]) {
-        mActive[i] = true;
-        last = i;
-        break;
-      } else {
-        mActive[i] = false;
-      }
-    }
-    for (unsigned int i = last + 1; i < mActive.size(); ++i) {
-      mActive[i] = false;
-    }
+    SETBIT(mask, bit + active);
   } else {
     this->mState = this->kPASSIVE;
-    for (unsigned int i = 0; i < mActive.size(); ++i) {
-      mActive[i] = false;
-    }
   }
-  return std::vector<bool>(mActive);
+  bit += nranges;
+  return passed;
 }
 
 templateClassImp(CutBrickSelectorMultipleRanges);
@@ -880,6 +885,23 @@ void CutWithVariations<TValueToFilter>::ConstructCutFromString(const TString& cu
   }
   this->Arm(atleastonearmed);
   delete lev1toks;
+  BuildLayout();
+}
+
+/// \brief Builds the layout of the cut in the selection mask
+/// The default bricks and then the variation bricks are collected
+/// in mask order and the cut length is computed once
+template <typename TValueToFilter>
+void CutWithVariations<TValueToFilter>::BuildLayout()
+{
+  mBricks.clear();
+  mLength = 0;
+  for (TList* brklst : {&mDefaultBricks, &mVariationBricks}) {
+    for (int i = 0; i < brklst->GetEntries(); ++i) {
+      mBricks.push_back((CutBrick<TValueToFilter>*)brklst->At(i));
+      mLength += mBricks.back()->Length();
+    }
+  }
 }
 
 /// \brief Stores the brick with a default value for the cut
@@ -899,6 +921,7 @@ bool CutWithVariations<TValueToFilter>::AddDefaultBrick(CutBrick<TValueToFilter>
       return false;
     } else {
       mDefaultBricks.Add(brick);
+      mLength = -1;
       return true;
     }
   } else {
@@ -906,6 +929,7 @@ bool CutWithVariations<TValueToFilter>::AddDefaultBrick(CutBrick<TValueToFilter>
       return false;
     } else {
       mDefaultBricks.Add(brick);
+      mLength = -1;
       return true;
     }
   }
@@ -922,69 +946,61 @@ bool CutWithVariations<TValueToFilter>::AddVariationBrick(CutBrick<TValueToFilte
     return false;
   } else {
     mVariationBricks.Add(brick);
+    mLength = -1;
     return true;
   }
 }
 
-/// \brief Returns wether the cut brick is incorporated in the selection chain
-/// \return true if the cut brick is incorporated
+/// \brief Codes wether the cut bricks are incorporated in the selection chain
+/// \param mask The mask where the bits of the incorporated bricks are set
+/// \param bit The bit of the first brick, on return the bit next to the cut
+/// \return the number of incorporated brick components
 template <typename TValueToFilter>
-std::vector<bool> CutWithVariations<TValueToFilter>::IsArmed()
+int CutWithVariations<TValueToFilter>::IsArmed(uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
-  res.reserve(Length());
+  if (mLength < 0) {
+    BuildLayout();
+  }
   if (this->mMode == this->kSELECTED) {
     int nArmedDefaults = 0;
     int nArmedVariants = 0;
-    for (int i = 0; i < mDefaultBricks.GetEntries(); ++i) {
-      std::vector<bool> tmp = ((CutBrick<TValueToFilter>*)mDefaultBricks.At(i))->IsArmed();
-      res.insert(res.end(), tmp.begin(), tmp.end());
-      for (bool iarmed : tmp) {
-        if (iarmed) {
-          nArmedDefaults++;
-        }
-      }
-    }
-    for (int i = 0; i < mVariationBricks.GetEntries(); ++i) {
-      std::vector<bool> tmp = ((CutBrick<TValueToFilter>*)mVariationBricks.At(i))->IsArmed();
-      res.insert(res.end(), tmp.begin(), tmp.end());
-      for (bool iarmed : tmp) {
-        if (iarmed) {
-          nArmedVariants++;
-        }
+    int nDefaults = mDefaultBricks.GetEntries();
+    for (int i = 0; i < static_cast<int>(mBricks.size()); ++i) {
+      int narmed = mBricks[i]->IsArmed(mask, bit);
+      if (i < nDefaults) {
+        nArmedDefaults += narmed;
+      } else {
+        nArmedVariants += narmed;
       }
     }
     if (nArmedDefaults > 1 or nArmedVariants > 1 or (nArmedDefaults + nArmedVariants) > 1) {
       LOGF(fatal, "CutWithVariations<TValueToFilter>::IsArmed(%s), More than one alternative selected. Default armed %d, variants armed %d", this->GetName(), nArmedDefaults, nArmedVariants);
     }
+    return nArmedDefaults + nArmedVariants;
   } else {
-    for (int i = 0; i < Length(); ++i) {
-      res.push_back(false);
-    }
+    bit += mLength;
+    return 0;
   }
-  return res;
 }
 
 /// Filters the passed value
 /// The bricks on the default values list and in the variation
 /// values list will change to active or passive accordingly to the passed value
 /// \param value The value to filter
+/// \param mask The mask where the bits of the activated bricks are set
+/// \param bit The bit of the first brick, on return the bit next to the cut
 /// \returns true if the value activated any of the bricks
-
 template <typename TValueToFilter>
-std::vector<bool> CutWithVariations<TValueToFilter>::Filter(const TValueToFilter& value)
+bool CutWithVariations<TValueToFilter>::Filter(const TValueToFilter& value, uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
-  res.reserve(Length());
-  for (int i = 0; i < mDefaultBricks.GetEntries(); ++i) {
-    std::vector<bool> tmp = ((CutBrick<TValueToFilter>*)mDefaultBricks.At(i))->Filter(value);
-    res.insert(res.end(), tmp.begin(), tmp.end());
+  if (mLength < 0) {
+    BuildLayout();
   }
-  for (int i = 0; i < mVariationBricks.GetEntries(); ++i) {
-    std::vector<bool> tmp = ((CutBrick<TValueToFilter>*)mVariationBricks.At(i))->Filter(value);
-    res.insert(res.end(), tmp.begin(), tmp.end());
+  bool activated = false;
+  for (auto brick : mBricks) {
+    activated = brick->Filter(value, mask, bit) or activated;
   }
-  return res;
+  return activated;
 }
 
 /// Return the length needed to code the cut
@@ -994,14 +1010,10 @@ template <typename TValueToFilter>
 int CutWithVariations<TValueToFilter>::Length()
 {
   /* TODO: should a single default cut without variations return zero length? */
-  int length = 0;
-  for (int i = 0; i < mDefaultBricks.GetEntries(); ++i) {
-    length += ((CutBrick<TValueToFilter>*)mDefaultBricks.At(i))->Length();
-  }
-  for (int i = 0; i < mVariationBricks.GetEntries(); ++i) {
-    length += ((CutBrick<TValueToFilter>*)mVariationBricks.At(i))->Length();
+  if (mLength < 0) {
+    BuildLayout();
   }
-  return length;
+  return mLength;
 }
 
 /// Virtual function. Return the index of the armed brick within this brick
@@ -1015,13 +1027,9 @@ int CutWithVariations<TValueToFilter>::getArmedIndex()
       bool found = false;
       for (int i = 0; not found and i < brklst.GetEntries(); ++i) {
         index++;
-        std::vector<bool> tmp = ((CutBrick<TValueToFilter>*)brklst.At(i))->IsArmed();
-        for (bool iarmed : tmp) {
-          if (iarmed) {
-            found = true;
-            break;
-          }
-        }
+        uint64_t mask = 0UL;
+        int bit = 0;
+        found = ((CutBrick<TValueToFilter>*)brklst.At(i))->IsArmed(mask, bit) > 0;
       }
       return found;
     };
@@ -1189,17 +1197,19 @@ const std::string TrackSelectionBrick::mCutNames[static_cast<int>(TrackSelection
     "DCAxy",
     "DCAz"};
 
-/// \brief Returns wether the cut brick is incorporated in the selection chain
-/// \return true if the cut brick is incorporated
-std::vector<bool> TrackSelectionBrick::IsArmed()
+/// \brief Codes wether the cut brick is incorporated in the selection chain
+/// \param mask The mask where the brick bit is set if the brick is incorporated
+/// \param bit The brick bit, on return the bit next to the brick
+/// \return 1 if the cut brick is incorporated 0 otherwise
+int TrackSelectionBrick::IsArmed(uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
+  int narmed = 0;
   if (this->mMode == this->kSELECTED) {
-    res.push_back(true);
-  } else {
-    res.push_back(false);
+    SETBIT(mask, bit);
+    narmed = 1;
   }
-  return res;
+  bit++;
+  return narmed;
 }
 
 ClassImp(TrackSelectionBrick);
@@ -18,7 +18,11 @@
 #include <TMath.h>
 #include <TList.h>
 #include <TF1.h>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <set>
+#include <span>
 #include <vector>
 #include <regex>
 #include <TObjArray.h>
@@ -32,6 +36,29 @@ namespace analysis
 {
 namespace PWGCF
 {
+/// \brief Evaluates a function tabulating its values at non-negative integer values of the independent variable
+/// The independent variables of the function based bricks are usually multiplicities or numbers
+/// of clusters so, after the first evaluations, the function is no longer evaluated per event
+/// \param fn the function to evaluate
+/// \param table the already evaluated values, NaN for the entries not evaluated yet
+/// \param x the value of the independent variable
+/// \returns the value of the function at x
+inline double CutBrickEvalTabulated(TF1& fn, std::vector<double>& table, float x)
+{
+  constexpr int kMaxTabulated = 1 << 16;
+  int ix = static_cast<int>(x);
+  if (ix < 0 or kMaxTabulated <= ix or static_cast<float>(ix) != x) {
+    return fn.Eval(x);
+  }
+  if (static_cast<int>(table.size()) <= ix) {
+    table.resize(ix + 1, std::numeric_limits<double>::quiet_NaN());
+  }
+  if (std::isnan(table[ix])) {
+    table[ix] = fn.Eval(x);
+  }
+  return table[ix];
+}
+
 /// \class CutBrick
 /// \brief Virtual class which implements the base component of the selection cuts
 ///
@@ -50,13 +77,29 @@ class CutBrick : public TNamed
   /// \return true if the brick is active
   bool IsActive() { return mState == kACTIVE; }
   /// Pure virual function
-  /// Returns whether the cut brick is incorporated in the selection chain
-  virtual std::vector<bool> IsArmed() = 0;
+  /// Codes whether the brick components are incorporated in the selection chain
+  /// \param mask the mask where the bits of the armed components are set
+  /// \param bit the bit of the first brick component, on return the bit next to the brick
+  /// \returns the number of armed components
+  virtual int IsArmed(uint64_t& mask, int& bit) = 0;
   /// Pure virtual function. Filters the passed value
   /// The brick or brick components will change to active if the passed value
   /// fits within the brick or brick components scope
-  /// \returns a vector of booleans with true on the component for which the value activated the component brick
-  virtual std::vector<bool> Filter(const TValueToFilter&) = 0;
+  /// \param mask the mask where the bits of the components activated by the value are set
+  /// \param bit the bit of the first brick component, on return the bit next to the brick
+  /// \returns true if the value activated any of the brick components
+  virtual bool Filter(const TValueToFilter&, uint64_t& mask, int& bit) = 0;
+  /// Filters a batch of values
+  /// \param values the values to filter
+  /// \param masks the masks, one per value, where the bits of the activated components are set
+  /// \param bit the bit of the first brick component within each of the masks
+  void Filter(std::span<const TValueToFilter> values, std::span<uint64_t> masks, int bit)
+  {
+    for (size_t i = 0; i < values.size(); ++i) {
+      int b = bit;
+      Filter(values[i], masks[i], b);
+    }
+  }
   /// Pure virtual function. Return the length needed to code the brick status
   /// The length is in brick units. The actual length is implementation dependent
   /// \returns Brick length in units of bricks
@@ -111,8 +154,9 @@ class CutBrickLimit : public CutBrick<TValueToFilter>
   CutBrickLimit(const CutBrickLimit&) = delete;
   CutBrickLimit& operator=(const CutBrickLimit&) = delete;
 
-  virtual std::vector<bool> IsArmed() override;
-  virtual std::vector<bool> Filter(const TValueToFilter&) override;
+  using CutBrick<TValueToFilter>::Filter;
+  virtual int IsArmed(uint64_t& mask, int& bit) override;
+  virtual bool Filter(const TValueToFilter&, uint64_t& mask, int& bit) override;
   virtual int Length() override { return 1; }
 
  private:
@@ -126,19 +170,19 @@ class CutBrickLimit : public CutBrick<TValueToFilter>
 
 /// \brief Filter the passed value to update the brick status accordingly
 /// \param value The value to filter
+/// \param mask The mask where the brick bit is set if the value passed the cut
+/// \param bit The brick bit, on return the bit next to the brick
 /// \return true if the value passed the cut false otherwise
 template <typename TValueToFilter>
-inline std::vector<bool> CutBrickLimit<TValueToFilter>::Filter(const TValueToFilter& value)
+inline bool CutBrickLimit<TValueToFilter>::Filter(const TValueToFilter& value, uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
-  if (value < mLimit) {
-    this->mState = this->kACTIVE;
-    res.push_back(true);
-  } else {
-    this->mState = this->kPASSIVE;
-    res.push_back(false);
+  bool active = value < mLimit;
+  this->mState = active ? this->kACTIVE : this->kPASSIVE;
+  if (active) {
+    SETBIT(mask, bit);
   }
-  return res;
+  bit++;
+  return active;
 }
 
 /// \class CutBrickFnLimit
@@ -158,13 +202,14 @@ class CutBrickFnLimit : public CutBrickLimit<TValueToFilter>
   /// sets the value of the limit according the passed variable value
   virtual void setIndependentFnVar(float x) override
   {
-    this->mLimit = TValueToFilter(mFunction.Eval(x));
+    this->mLimit = TValueToFilter(CutBrickEvalTabulated(mFunction, mTable, x));
   }
 
  private:
   void ConstructCutFromString(const TString&);
 
-  TF1 mFunction; ///< the function for evaluating the limit value
+  TF1 mFunction;              ///< the function for evaluating the limit value
+  std::vector<double> mTable; //! the tabulated function values
   ClassDef(CutBrickFnLimit, 1);
 };
 
@@ -182,8 +227,9 @@ class CutBrickThreshold : public CutBrick<TValueToFilter>
   CutBrickThreshold(const CutBrickThreshold&) = delete;
   CutBrickThreshold& operator=(const CutBrickThreshold&) = delete;
 
-  virtual std::vector<bool> IsArmed() override;
-  virtual std::vector<bool> Filter(const TValueToFilter&) override;
+  using CutBrick<TValueToFilter>::Filter;
+  virtual int IsArmed(uint64_t& mask, int& bit) override;
+  virtual bool Filter(const TValueToFilter&, uint64_t& mask, int& bit) override;
   virtual int Length() override { return 1; }
 
  private:
@@ -197,19 +243,19 @@ class CutBrickThreshold : public CutBrick<TValueToFilter>
 
 /// \brief Filter the passed value to update the brick status accordingly
 /// \param value The value to filter
+/// \param mask The mask where the brick bit is set if the value passed the cut
+/// \param bit The brick bit, on return the bit next to the brick
 /// \return true if the value passed the cut false otherwise
 template <typename TValueToFilter>
-inline std::vector<bool> CutBrickThreshold<TValueToFilter>::Filter(const TValueToFilter& value)
+inline bool CutBrickThreshold<TValueToFilter>::Filter(const TValueToFilter& value, uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
-  if (mThreshold < value) {
-    this->mState = this->kACTIVE;
-    res.push_back(true);
-  } else {
-    this->mState = this->kPASSIVE;
-    res.push_back(false);
+  bool active = mThreshold < value;
+  this->mState = active ? this->kACTIVE : this->kPASSIVE;
+  if (active) {
+    SETBIT(mask, bit);
   }
-  return res;
+  bit++;
+  return active;
 }
 
 /// \class CutBrickFnThreshold
@@ -229,13 +275,14 @@ class CutBrickFnThreshold : public CutBrickThreshold<TValueToFilter>
   /// sets the value of the threshold according the passed variable value
   virtual void setIndependentFnVar(float x) override
   {
-    this->mThreshold = TValueToFilter(mFunction.Eval(x));
+    this->mThreshold = TValueToFilter(CutBrickEvalTabulated(mFunction, mTable, x));
   }
 
  private:
   void ConstructCutFromString(const TString&);
 
-  TF1 mFunction; ///< the function for evaluate the threshold value
+  TF1 mFunction;              ///< the function for evaluate the threshold value
+  std::vector<double> mTable; //! the tabulated function values
   ClassDef(CutBrickFnThreshold, 1);
 };
 
@@ -253,8 +300,9 @@ class CutBrickRange : public CutBrick<TValueToFilter>
   CutBrickRange(const CutBrickRange&) = delete;
   CutBrickRange& operator=(const CutBrickRange&) = delete;
 
-  virtual std::vector<bool> IsArmed() override;
-  virtual std::vector<bool> Filter(const TValueToFilter&) override;
+  using CutBrick<TValueToFilter>::Filter;
+  virtual int IsArmed(uint64_t& mask, int& bit) override;
+  virtual bool Filter(const TValueToFilter&, uint64_t& mask, int& bit) override;
   virtual int Length() override { return 1; }
 
  private:
@@ -269,19 +317,19 @@ class CutBrickRange : public CutBrick<TValueToFilter>
 
 /// \brief Filter the passed value to update the brick status accordingly
 /// \param value The value to filter
+/// \param mask The mask where the brick bit is set if the value passed the cut
+/// \param bit The brick bit, on return the bit next to the brick
 /// \return true if the value passed the cut false otherwise
 template <typename TValueToFilter>
-std::vector<bool> CutBrickRange<TValueToFilter>::Filter(const TValueToFilter& value)
+bool CutBrickRange<TValueToFilter>::Filter(const TValueToFilter& value, uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
-  if ((mLow < value) and (value < mUp)) {
-    this->mState = this->kACTIVE;
-    res.push_back(true);
-  } else {
-    this->mState = this->kPASSIVE;
-    res.push_back(false);
+  bool active = (mLow < value) and (value < mUp);
+  this->mState = active ? this->kACTIVE : this->kPASSIVE;
+  if (active) {
+    SETBIT(mask, bit);
   }
-  return res;
+  bit++;
+  return active;
 }
 
 /// \class CutBrickFnRange
@@ -301,15 +349,17 @@ class CutBrickFnRange : public CutBrickRange<TValueToFilter>
   /// sets the value of the limits according the passed variable value
   virtual void setIndependentFnVar(float x) override
   {
-    this->mLow = TValueToFilter(mLowFunction.Eval(x));
-    this->mUp = TValueToFilter(mUpFunction.Eval(x));
+    this->mLow = TValueToFilter(CutBrickEvalTabulated(mLowFunction, mLowTable, x));
+    this->mUp = TValueToFilter(CutBrickEvalTabulated(mUpFunction, mUpTable, x));
   }
 
  private:
   void ConstructCutFromString(const TString&);
 
-  TF1 mLowFunction; ///< the function for evaluating the low limit value
-  TF1 mUpFunction;  ///< the function for evaluating the upper limit value
+  TF1 mLowFunction;              ///< the function for evaluating the low limit value
+  TF1 mUpFunction;               ///< the function for evaluating the upper limit value
+  std::vector<double> mLowTable; //! the tabulated low limit function values
+  std::vector<double> mUpTable;  //! the tabulated upper limit function values
   ClassDef(CutBrickFnRange, 1);
 };
 
@@ -327,8 +377,9 @@ class CutBrickExtToRange : public CutBrick<TValueToFilter>
   CutBrickExtToRange(const CutBrickExtToRange&) = delete;
   CutBrickExtToRange& operator=(const CutBrickExtToRange&) = delete;
 
-  virtual std::vector<bool> IsArmed() override;
-  virtual std::vector<bool> Filter(const TValueToFilter&) override;
+  using CutBrick<TValueToFilter>::Filter;
+  virtual int IsArmed(uint64_t& mask, int& bit) override;
+  virtual bool Filter(const TValueToFilter&, uint64_t& mask, int& bit) override;
   virtual int Length() override { return 1; }
 
  private:
@@ -343,19 +394,19 @@ class CutBrickExtToRange : public CutBrick<TValueToFilter>
 
 /// \brief Filter the passed value to update the brick status accordingly
 /// \param value The value to filter
+/// \param mask The mask where the brick bit is set if the value passed the cut
+/// \param bit The brick bit, on return the bit next to the brick
 /// \return true if the value passed the cut false otherwise
 template <typename TValueToFilter>
-std::vector<bool> CutBrickExtToRange<TValueToFilter>::Filter(const TValueToFilter& value)
+bool CutBrickExtToRange<TValueToFilter>::Filter(const TValueToFilter& value, uint64_t& mask, int& bit)
 {
-  std::vector<bool> res;
-  if ((value < mLow) or (mUp < value)) {
-    this->mState = this->kACTIVE;
-    res.push_back(true);
-  } else {
-    this->mState = this->kPASSIVE;
-    res.push_back(false);
+  bool active = (value < mLow) or (mUp < value);
+  this->mState = active ? this->kACTIVE : this->kPASSIVE;
+  if (active) {
+    SETBIT(mask, bit);
   }
-  return res;
+  bit++;
+  return active;
 }
 
 /// \class CutBrickExtToRange
@@ -375,15 +426,17 @@ class CutBrickFnExtToRange : public CutBrickExtToRange<TValueToFilter>
   /// sets the value of the limits according the passed variable value
   virtual void setIndependentFnVar(float x) override
   {
-    this->mLow = TValueToFilter(mLowFunction.Eval(x));
-    this->mUp = TValueToFilter(mUpFunction.Eval(x));
+    this->mLow = TValueToFilter(CutBrickEvalTabulated(mLowFunction, mLowTable, x));
+    this->mUp = TValueToFilter(CutBrickEvalTabulated(mUpFunction, mUpTable, x));
   }
 
  private:
   void ConstructCutFromString(const TString&);
 
-  TF1 mLowFunction; ///< the function for evaluating the low limit value
-  TF1 mUpFunction;  ///< the function for evaluating the upper limit value
+  TF1 mLowFunction;              ///< the function for evaluating the low limit value
+  TF1 mUpFunction;               ///< the function for evaluating the upper limit value
+  std::vector<double> mLowTable; //! the tabulated low limit function values
+  std::vector<double> mUpTable;  //! the tabulated upper limit function values
   ClassDef(CutBrickFnExtToRange, 1);
 };
 
@@ -403,8 +456,9 @@ class CutBrickSelectorMultipleRanges : public CutBrick<TValueToFilter>
   CutBrickSelectorMultipleRanges(const CutBrickSelectorMultipleRanges&) = delete;
   CutBrickSelectorMultipleRanges& operator=(const CutBrickSelectorMultipleRanges&) = delete;
 
-  virtual std::vector<bool> IsArmed() override;
-  virtual std::vector<bool> Filter(const TValueToFilter&) override;
+  using CutBrick<TValueToFilter>::Filter;
+  virtual int IsArmed(uint64_t& mask, int& bit) override;
+  virtual bool Filter(const TValueToFilter&, uint64_t& mask, int& bit) override;
   /// Return the length needed to code the brick status
   /// The length is in brick units. The actual length is implementation dependent
   /// \returns Brick length in units of bricks
@@ -437,17 +491,21 @@ class CutWithVariations : public CutBrick<TValueToFilter>
   bool AddVariationBrick(CutBrick<TValueToFilter>* brick);
   TList& getDefaultBricks() { return mDefaultBricks; }
   TList& getVariantBricks() { return mVariationBricks; }
-  virtual std::vector<bool> IsArmed() override;
-  virtual std::vector<bool> Filter(const TValueToFilter&) override;
+  using CutBrick<TValueToFilter>::Filter;
+  virtual int IsArmed(uint64_t& mask, int& bit) override;
+  virtual bool Filter(const TValueToFilter&, uint64_t& mask, int& bit) override;
   virtual int Length() override;
   virtual int getArmedIndex() override;
 
  private:
   void ConstructCutFromString(const TString&);
+  void BuildLayout();
 
-  bool mAllowSeveralDefaults; ///< true if allows to store several cut default values
-  TList mDefaultBricks;       ///< the list with the cut default values bricks
-  TList mVariationBricks;     ///< the list with the cut variation values bricks
+  bool mAllowSeveralDefaults;                     ///< true if allows to store several cut default values
+  TList mDefaultBricks;                           ///< the list with the cut default values bricks
+  TList mVariationBricks;                         ///< the list with the cut variation values bricks
+  std::vector<CutBrick<TValueToFilter>*> mBricks; //! the default and then the variation bricks, in mask order
+  int mLength = -1;                               //! the length of the cut, -1 if the layout is not built yet
   ClassDef(CutWithVariations, 1);
 };
 
@@ -471,8 +529,11 @@ class SpecialCutBrick : public TNamed
   /// \return true if the brick is active
   bool IsActive() { return mState == kACTIVE; }
   /// Pure virtual function
-  /// Returns whether the cut brick is incorporated in the selection chain
-  virtual std::vector<bool> IsArmed() = 0;
+  /// Codes whether the brick components are incorporated in the selection chain
+  /// \param mask the mask where the bits of the armed components are set
+  /// \param bit the bit of the first brick component, on return the bit next to the brick
+  /// \returns the number of armed components
+  virtual int IsArmed(uint64_t& mask, int& bit) = 0;
   /// Pure virtual function. Return the length needed to code the brick status
   /// The length is in brick units. The actual length is implementation dependent
   /// \returns Brick length in units of bricks
@@ -528,7 +589,7 @@ class TrackSelectionBrick : public SpecialCutBrick
 
   static const std::string mCutNames[static_cast<int>(TrackCuts::kNCuts)];
 
-  virtual std::vector<bool> IsArmed() override;
+  virtual int IsArmed(uint64_t& mask, int& bit) override;
   template <typename TrackToFilter>
   bool Filter(TrackToFilter const& track)
   {
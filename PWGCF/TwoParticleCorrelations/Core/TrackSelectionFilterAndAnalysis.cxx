@@ -405,17 +405,13 @@ void TrackSelectionFilterAndAnalysis::StoreArmedMask()
   int bit = 0;
 
   auto armedBrick = [&](auto brick, bool opt = false) {
-    std::vector<bool> res = brick->IsArmed();
-    for (auto b : res) {
-      if (b) {
-        SETBIT(armedMask, bit);
-        if (opt) {
-          SETBIT(optMask, bit);
-        } else {
-          SETBIT(forcedMask, bit);
-        }
-      }
-      bit++;
+    uint64_t brickmask = 0UL;
+    brick->IsArmed(brickmask, bit);
+    armedMask |= brickmask;
+    if (opt) {
+      optMask |= brickmask;
+    } else {
+      forcedMask |= brickmask;
     }
   };
 
@@ -139,23 +139,13 @@ uint64_t TrackSelectionFilterAndAnalysis::Filter(TrackToFilter const& track)
   };
 
   auto filterBrickValue = [&](auto brick, auto value) {
-    std::vector<bool> res = brick->Filter(value);
-    for (auto b : res) {
-      if (b) {
-        SETBIT(selectedMask, bit);
-      }
-      bit++;
-    }
+    brick->Filter(value, selectedMask, bit);
   };
 
   auto filterBrickValueNoMask = [](auto brick, auto value) {
-    std::vector<bool> res = brick->Filter(value);
-    for (auto b : res) {
-      if (b) {
-        return true;
-      }
-    }
-    return false;
+    uint64_t mask = 0UL;
+    int bit = 0;
+    return brick->Filter(value, mask, bit);
   };
 
   for (int i = 0; i < mTrackSign.GetEntries(); ++i) {
@@ -45,6 +45,7 @@ class AnalysisCompositeCut : public AnalysisCut
   bool IsSelected(float* values) override;
 
  protected:
+  friend class AnalysisCutCompiler;
   bool fOptionUseAND;                                  // true (default): apply AND on all cuts; false: use OR
   std::vector<AnalysisCut> fCutList;                   // list of cuts
   std::vector<AnalysisCompositeCut> fCompositeCutList; // list of composite cuts
@@ -63,6 +63,7 @@ class AnalysisCut : public TNamed
   };
 
  protected:
+  friend class AnalysisCutCompiler;
   std::vector<CutContainer> fCuts;
 
   ClassDef(AnalysisCut, 1);
@@ -0,0 +1,138 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#include "PWGDQ/Core/AnalysisCutCompiler.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+//____________________________________________________________________________
+void AnalysisCutCompiler::AddCut(const AnalysisCut* cut)
+{
+  //
+  // compile a cut and add it to the set
+  //
+  if (fRoots.size() >= 64) {
+    cout << "AnalysisCutCompiler::AddCut(): Maximum number of 64 cuts reached, cut " << cut->GetName() << " not added!" << endl;
+    return;
+  }
+  fRoots.push_back(CompileCut(cut));
+}
+
+//____________________________________________________________________________
+void AnalysisCutCompiler::Clear()
+{
+  fInstructions.clear();
+  fNodes.clear();
+  fChildren.clear();
+  fRoots.clear();
+  fFunctions.clear();
+}
+
+//____________________________________________________________________________
+int AnalysisCutCompiler::CompileCut(const AnalysisCut* cut)
+{
+  //
+  // recursively compile the cut tree, return the index of the created node
+  //
+  if (cut->IsA() == AnalysisCompositeCut::Class()) {
+    const AnalysisCompositeCut* composite = static_cast<const AnalysisCompositeCut*>(cut);
+    // the children are compiled first, so that their indices end up contiguous in fChildren
+    std::vector<int> children;
+    for (auto& child : composite->fCutList) {
+      children.push_back(CompileCut(&child));
+    }
+    for (auto& child : composite->fCompositeCutList) {
+      children.push_back(CompileCut(&child));
+    }
+    Node node = {false, composite->GetUseAND(), static_cast<int>(fChildren.size()), static_cast<int>(fChildren.size() + children.size())};
+    fChildren.insert(fChildren.end(), children.begin(), children.end());
+    fNodes.push_back(node);
+    return fNodes.size() - 1;
+  }
+
+  Node node = {true, true, static_cast<int>(fInstructions.size()), static_cast<int>(fInstructions.size() + cut->fCuts.size())};
+  for (auto& container : cut->fCuts) {
+    Instruction ins;
+    ins.fVar = container.fVar;
+    ins.fLow = container.fLow;
+    ins.fHigh = container.fHigh;
+    ins.fExclude = container.fExclude;
+    ins.fDepVar = container.fDepVar;
+    ins.fDepLow = container.fDepLow;
+    ins.fDepHigh = container.fDepHigh;
+    ins.fDepExclude = container.fDepExclude;
+    ins.fDepVar2 = container.fDepVar2;
+    ins.fDep2Low = container.fDep2Low;
+    ins.fDep2High = container.fDep2High;
+    ins.fDep2Exclude = container.fDep2Exclude;
+    ins.fFuncLow = (container.fFuncLow ? CompileFunction(container.fFuncLow) : -1);
+    ins.fFuncHigh = (container.fFuncHigh ? CompileFunction(container.fFuncHigh) : -1);
+    fInstructions.push_back(ins);
+  }
+  fNodes.push_back(node);
+  return fNodes.size() - 1;
+}
+
+//____________________________________________________________________________
+int AnalysisCutCompiler::CompileFunction(TF1* function)
+{
+  //
+  // tabulate a TF1 over its range, reusing tables of functions already compiled
+  //
+  for (size_t i = 0; i < fFunctions.size(); ++i) {
+    if (fFunctions[i].fFunction == function) {
+      return i;
+    }
+  }
+  FunctionTable table;
+  table.fFunction = function;
+  double xmin, xmax;
+  function->GetRange(xmin, xmax);
+  int nPoints = (fNFunctionPoints > 1 ? fNFunctionPoints : 2);
+  table.fXmin = xmin;
+  table.fXmax = xmax;
+  table.fInvStep = (xmax > xmin ? (nPoints - 1) / (xmax - xmin) : 0.0);
+  if (xmax > xmin) {
+    table.fValues.resize(nPoints + 1);
+    for (int i = 0; i < nPoints; ++i) {
+      table.fValues[i] = function->Eval(xmin + i / table.fInvStep);
+    }
+    table.fValues[nPoints] = table.fValues[nPoints - 1]; // guard for rounding at the upper edge
+    // estimate the interpolation error from the middle of each interval, with a safety margin covering the float rounding
+    table.fTolerances.resize(nPoints, 0.0);
+    for (int i = 0; i + 1 < nPoints; ++i) {
+      float exact = function->Eval(xmin + (i + 0.5) / table.fInvStep);
+      float interpolated = 0.5 * (table.fValues[i] + table.fValues[i + 1]);
+      float scale = std::max({1.0f, std::abs(table.fValues[i]), std::abs(table.fValues[i + 1])});
+      table.fTolerances[i] = 2.0 * std::abs(exact - interpolated) + 1e-5 * scale;
+    }
+    table.fTolerances[nPoints - 1] = table.fTolerances[nPoints - 2];
+  } else {
+    table.fXmax = table.fXmin; // empty range: always use TF1::Eval
+  }
+  fFunctions.push_back(table);
+  return fFunctions.size() - 1;
+}
+
+//____________________________________________________________________________
+void AnalysisCutCompiler::Evaluate(const float* values, int nObjects, int stride, uint64_t* results) const
+{
+  //
+  // evaluate all cuts for a batch of objects
+  //
+  for (int iobj = 0; iobj < nObjects; ++iobj) {
+    results[iobj] = Evaluate(values + static_cast<size_t>(iobj) * stride);
+  }
+}
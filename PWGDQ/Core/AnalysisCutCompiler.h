@@ -0,0 +1,184 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+//
+// Contact: iarsene@cern.ch, i.c.arsene@fys.uio.no
+//
+// Class compiling a set of AnalysisCut / AnalysisCompositeCut objects into flat instruction lists.
+// All cuts of the set are evaluated at once on a VarManager values array, giving one bit per cut,
+// without virtual calls. TF1 limits are replaced by tabulated functions with linear interpolation; values closer to the
+// interpolated limit than its estimated interpolation error are decided with TF1::Eval, as in AnalysisCut::IsSelected().
+//
+
+#ifndef AnalysisCutCompiler_H
+#define AnalysisCutCompiler_H
+
+#include "PWGDQ/Core/AnalysisCut.h"
+#include "PWGDQ/Core/AnalysisCompositeCut.h"
+#include <TF1.h>
+#include <cstdint>
+#include <vector>
+
+//_________________________________________________________________________
+class AnalysisCutCompiler
+{
+ public:
+  AnalysisCutCompiler() = default;
+  ~AnalysisCutCompiler() = default;
+
+  // Adds a cut to the set; the decision of the i-th added cut is stored in bit i of the result (maximum 64 cuts)
+  void AddCut(const AnalysisCut* cut);
+  void Clear();
+  int GetNCuts() const { return fRoots.size(); }
+
+  // Number of points used to tabulate the TF1 limits over their range (outside the range TF1::Eval is used)
+  void SetNFunctionPoints(int nPoints) { fNFunctionPoints = nPoints; }
+
+  // Evaluates all cuts for one object
+  uint64_t Evaluate(const float* values) const;
+  // Evaluates all cuts for nObjects objects whose values are stored consecutively every "stride" floats
+  void Evaluate(const float* values, int nObjects, int stride, uint64_t* results) const;
+
+ private:
+  struct Instruction {
+    short fVar;
+    float fLow;
+    float fHigh;
+    bool fExclude;
+    short fDepVar;
+    float fDepLow;
+    float fDepHigh;
+    bool fDepExclude;
+    short fDepVar2;
+    float fDep2Low;
+    float fDep2High;
+    bool fDep2Exclude;
+    int fFuncLow;  // index in fFunctions, -1 if not used
+    int fFuncHigh; // index in fFunctions, -1 if not used
+  };
+  // Node of the cut tree: a leaf (AnalysisCut, AND of instructions [fFirst, fLast)) or
+  // a composite cut (AND / OR of the nodes fChildren[fFirst, fLast))
+  struct Node {
+    bool fIsLeaf;
+    bool fUseAND;
+    int fFirst;
+    int fLast;
+  };
+  struct FunctionTable {
+    TF1* fFunction = nullptr;
+    float fXmin = 0.0;
+    float fXmax = 0.0;
+    float fInvStep = 0.0;
+    std::vector<float> fValues;
+    std::vector<float> fTolerances; // maximum deviation of the interpolated value from the function, per interval
+    // interpolated value and its tolerance, or TF1::Eval with tolerance 0 outside the tabulated range
+    float Eval(float x, float& tolerance) const;
+  };
+
+  int CompileCut(const AnalysisCut* cut);
+  int CompileFunction(TF1* function);
+  bool EvaluateNode(int node, const float* values) const;
+  bool CompareToFunction(int function, float x, float value, bool above) const;
+
+  std::vector<Instruction> fInstructions;
+  std::vector<Node> fNodes;
+  std::vector<int> fChildren;
+  std::vector<int> fRoots;
+  std::vector<FunctionTable> fFunctions;
+  int fNFunctionPoints = 2000;
+};
+
+//____________________________________________________________________________
+inline float AnalysisCutCompiler::FunctionTable::Eval(float x, float& tolerance) const
+{
+  if (!(x >= fXmin && x < fXmax)) {
+    tolerance = 0.0;
+    return fFunction->Eval(x);
+  }
+  float position = (x - fXmin) * fInvStep;
+  int i = static_cast<int>(position);
+  float fraction = position - i;
+  tolerance = fTolerances[i];
+  return fValues[i] + fraction * (fValues[i + 1] - fValues[i]);
+}
+
+//____________________________________________________________________________
+inline bool AnalysisCutCompiler::CompareToFunction(int function, float x, float value, bool above) const
+{
+  // value >= f(x) if above is true, value <= f(x) otherwise
+  const FunctionTable& table = fFunctions[function];
+  float tolerance;
+  float limit = table.Eval(x, tolerance);
+  if (value > limit + tolerance) {
+    return above;
+  }
+  if (value < limit - tolerance) {
+    return !above;
+  }
+  // close to the limit: use the exact value, as AnalysisCut::IsSelected()
+  float exact = table.fFunction->Eval(x);
+  return above ? (value >= exact) : (value <= exact);
+}
+
+//____________________________________________________________________________
+inline bool AnalysisCutCompiler::EvaluateNode(int node, const float* values) const
+{
+  const Node& n = fNodes[node];
+  if (n.fIsLeaf) {
+    // same logic as AnalysisCut::IsSelected()
+    for (int i = n.fFirst; i < n.fLast; ++i) {
+      const Instruction& ins = fInstructions[i];
+      if (ins.fDepVar != -1) {
+        bool inRange = (values[ins.fDepVar] > ins.fDepLow && values[ins.fDepVar] <= ins.fDepHigh);
+        if (inRange == ins.fDepExclude) {
+          continue;
+        }
+      }
+      if (ins.fDepVar2 != -1) {
+        bool inRange = (values[ins.fDepVar2] > ins.fDep2Low && values[ins.fDepVar2] <= ins.fDep2High);
+        if (inRange == ins.fDep2Exclude) {
+          continue;
+        }
+      }
+      float value = values[ins.fVar];
+      bool aboveLow = (ins.fFuncLow < 0 ? value >= ins.fLow : CompareToFunction(ins.fFuncLow, values[ins.fDepVar], value, true));
+      bool inRange = aboveLow && (ins.fFuncHigh < 0 ? value <= ins.fHigh : CompareToFunction(ins.fFuncHigh, values[ins.fDepVar], value, false));
+      if (inRange == ins.fExclude) {
+        return false;
+      }
+    }
+    return true;
+  }
+  // same logic as AnalysisCompositeCut::IsSelected()
+  for (int i = n.fFirst; i < n.fLast; ++i) {
+    bool selected = EvaluateNode(fChildren[i], values);
+    if (n.fUseAND && !selected) {
+      return false;
+    }
+    if (!n.fUseAND && selected) {
+      return true;
+    }
+  }
+  return n.fUseAND;
+}
+
+//____________________________________________________________________________
+inline uint64_t AnalysisCutCompiler::Evaluate(const float* values) const
+{
+  uint64_t result = 0;
+  for (size_t i = 0; i < fRoots.size(); ++i) {
+    if (EvaluateNode(fRoots[i], values)) {
+      result |= (uint64_t(1) << i);
+    }
+  }
+  return result;
+}
+
+#endif
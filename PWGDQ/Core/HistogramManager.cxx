@@ -695,8 +695,42 @@ void HistogramManager::FillHistClass(const char* className, Float_t* values)
   }
 
   // get the corresponding std::list containng identifiers to the needed variables to be filled
-  list varList = fVariablesMap[className];
+  FillHistList(hList, fVariablesMap[className], values);
+}
+
+//__________________________________________________________________
+int HistogramManager::GetHistClassHandle(const char* className)
+{
+  //
+  //  resolve a histogram class once, so that it can be filled later without the lookup by name
+  //  returns -1 if the class does not exist
+  //
+  TList* hList = reinterpret_cast<TList*>(fMainList->FindObject(className));
+  if (!hList) {
+    return -1;
+  }
+  fHistClassHandles.emplace_back(hList, &fVariablesMap[className]);
+  return fHistClassHandles.size() - 1;
+}
+
+//__________________________________________________________________
+void HistogramManager::FillHistClass(int handle, Float_t* values)
+{
+  //
+  //  fill a class of histograms using a handle obtained from GetHistClassHandle()
+  //
+  if (handle < 0 || handle >= static_cast<int>(fHistClassHandles.size())) {
+    return;
+  }
+  FillHistList(fHistClassHandles[handle].first, *(fHistClassHandles[handle].second), values);
+}
 
+//__________________________________________________________________
+void HistogramManager::FillHistList(TList* hList, const std::list<std::vector<int>>& varList, Float_t* values)
+{
+  //
+  //  fill the histograms of a list, using the variable identifiers in varList
+  //
   TIter next(hList);
 
   TObject* h = nullptr;
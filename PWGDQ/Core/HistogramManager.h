@@ -28,6 +28,7 @@
 #include <map>
 #include <vector>
 #include <list>
+#include <utility>
 
 class HistogramManager : public TNamed
 {
@@ -85,6 +86,10 @@ class HistogramManager : public TNamed
                     TString* axLabels = nullptr, int varW = -1, bool useSparse = kFALSE);
 
   void FillHistClass(const char* className, float* values);
+  // Resolve a histogram class to a handle which can be used for filling without the lookup by name (-1 if the class does not exist)
+  // Handles should be retrieved after all the histograms were defined
+  int GetHistClassHandle(const char* className);
+  void FillHistClass(int handle, float* values);
 
   void SetUseDefaultVariableNames(bool flag) { fUseDefaultVariableNames = flag; };
   void SetDefaultVarNames(TString* vars, TString* units);
@@ -108,7 +113,10 @@ class HistogramManager : public TNamed
   TString* fVariableNames;          //! variable names
   TString* fVariableUnits;          //! variable units
 
+  std::vector<std::pair<TList*, const std::list<std::vector<int>>*>> fHistClassHandles; //! histogram lists and variable identifiers for the resolved handles
+
   void MakeAxisLabels(TAxis* ax, const char* labels);
+  void FillHistList(TList* hList, const std::list<std::vector<int>>& varList, float* values);
 
   HistogramManager& operator=(const HistogramManager& c);
   HistogramManager(const HistogramManager& c);
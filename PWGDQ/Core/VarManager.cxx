@@ -19,18 +19,56 @@ ClassImp(VarManager);
 TString VarManager::fgVariableNames[VarManager::kNVars] = {""};
 TString VarManager::fgVariableUnits[VarManager::kNVars] = {""};
 bool VarManager::fgUsedVars[VarManager::kNVars] = {false};
-bool VarManager::fgUsedKF = false;
 float VarManager::fgValues[VarManager::kNVars] = {0.0f};
 std::map<int, int> VarManager::fgRunMap;
 TString VarManager::fgRunStr = "";
 std::vector<int> VarManager::fgRunList = {0};
-o2::vertexing::DCAFitterN<2> VarManager::fgFitterTwoProngBarrel;
-o2::vertexing::DCAFitterN<3> VarManager::fgFitterThreeProngBarrel;
-o2::vertexing::FwdDCAFitterN<2> VarManager::fgFitterTwoProngFwd;
-o2::vertexing::FwdDCAFitterN<3> VarManager::fgFitterThreeProngFwd;
+VarContext VarManager::fgDefaultContext(VarManager::fgValues, VarManager::fgUsedVars);
 std::map<VarManager::CalibObjects, TObject*> VarManager::fgCalibs;
 bool VarManager::fgRunTPCPostCalibration[4] = {false, false, false, false};
 
+//__________________________________________________________________
+VarContext::VarContext() : fValuesStorage(new float[VarManager::kNVars]),
+                           fUsedVarsStorage(new bool[VarManager::kNVars])
+{
+  //
+  // constructor of a context owning its arrays
+  //
+  fValues = fValuesStorage.get();
+  fUsedVars = fUsedVarsStorage.get();
+  fUsedKF = false;
+  for (int i = 0; i < VarManager::kNVars; ++i) {
+    fValues[i] = 0.0f;
+    fUsedVars[i] = false;
+  }
+}
+
+//__________________________________________________________________
+VarContext::VarContext(float* values, bool* usedVars) : fValues(values),
+                                                        fUsedVars(usedVars),
+                                                        fUsedKF(false)
+{
+  //
+  // constructor of a context working on external arrays
+  //
+}
+
+//__________________________________________________________________
+void VarContext::CopyConfiguration(const VarContext& c)
+{
+  //
+  // copy the used variables and the vertexing configuration
+  //
+  for (int i = 0; i < VarManager::kNVars; ++i) {
+    fUsedVars[i] = c.fUsedVars[i];
+  }
+  fUsedKF = c.fUsedKF;
+  fFitterTwoProngBarrel = c.fFitterTwoProngBarrel;
+  fFitterThreeProngBarrel = c.fFitterThreeProngBarrel;
+  fFitterTwoProngFwd = c.fFitterTwoProngFwd;
+  fFitterThreeProngFwd = c.fFitterThreeProngFwd;
+}
+
 //__________________________________________________________________
 VarManager::VarManager() : TObject()
 {
@@ -169,23 +207,25 @@ float VarManager::GetRunIndex(double Runnumber)
 }
 
 //__________________________________________________________________
-void VarManager::FillEventDerived(float* values)
+void VarManager::FillEventDerived(float* values, const bool* usedVars)
 {
   //
   // Fill event-wise derived quantities (these are all quantities which can be computed just based on the values already filled in the FillEvent() function)
   //
-  if (fgUsedVars[kRunId]) {
-    values[kRunId] = (fgRunMap.size() > 0 ? fgRunMap[static_cast<int>(values[kRunNo])] : 0);
+  if (usedVars[kRunId]) {
+    // NOTE: the run map is only read here, so that several contexts can be filled concurrently
+    auto run = fgRunMap.find(static_cast<int>(values[kRunNo]));
+    values[kRunId] = (run != fgRunMap.end() ? run->second : 0);
   }
 }
 
 //__________________________________________________________________
-void VarManager::FillTrackDerived(float* values)
+void VarManager::FillTrackDerived(float* values, const bool* usedVars)
 {
   //
   // Fill track-wise derived quantities (these are all quantities which can be computed just based on the values already filled in the FillTrack() function)
   //
-  if (fgUsedVars[kP]) {
+  if (usedVars[kP]) {
     values[kP] = values[kPt] * std::cosh(values[kEta]);
   }
 }
@@ -26,6 +26,7 @@
 #include <cmath>
 #include <iostream>
 #include <utility>
+#include <memory>
 
 #include <TObject.h>
 #include <TString.h>
@@ -60,6 +61,34 @@ using SMatrix5 = ROOT::Math::SVector<double, 5>;
 using Vec3D = ROOT::Math::SVector<double, 3>;
 using namespace o2::constants::physics;
 
+//_________________________________________________________________________
+// Holds the array of values filled by the VarManager, the mask of used variables and the vertexing fitters.
+// The static VarManager API works on the default context, which uses the VarManager::fgValues array.
+// Additional contexts (e.g. one per worker thread) own their arrays and fitters and can be filled concurrently.
+class VarContext
+{
+ public:
+  VarContext();                             // context owning its arrays, with no variable used
+  VarContext(float* values, bool* usedVars); // context working on external arrays of size VarManager::kNVars
+  VarContext(const VarContext& c) = delete;
+  VarContext& operator=(const VarContext& c) = delete;
+
+  // copy the used variables and the fitter configuration from another context (e.g. the default one)
+  void CopyConfiguration(const VarContext& c);
+
+  float* fValues;  // values computed by the Fill functions
+  bool* fUsedVars; // flags for the variables which are needed
+  bool fUsedKF;    // use KFParticle instead of the DCA fitters for the pair vertexing
+  o2::vertexing::DCAFitterN<2> fFitterTwoProngBarrel;
+  o2::vertexing::DCAFitterN<3> fFitterThreeProngBarrel;
+  o2::vertexing::FwdDCAFitterN<2> fFitterTwoProngFwd;
+  o2::vertexing::FwdDCAFitterN<3> fFitterThreeProngFwd;
+
+ private:
+  std::unique_ptr<float[]> fValuesStorage;
+  std::unique_ptr<bool[]> fUsedVarsStorage;
+};
+
 //_________________________________________________________________________
 class VarManager : public TObject
 {
@@ -459,43 +488,43 @@ class VarManager : public TObject
   static void SetupTwoProngKFParticle(float magField)
   {
     KFParticle::SetField(magField);
-    fgUsedKF = true;
+    fgDefaultContext.fUsedKF = true;
   }
 
   // Setup the 2 prong DCAFitterN
   static void SetupTwoProngDCAFitter(float magField, bool propagateToPCA, float maxR, float maxDZIni, float minParamChange, float minRelChi2Change, bool useAbsDCA)
   {
-    fgFitterTwoProngBarrel.setBz(magField);
-    fgFitterTwoProngBarrel.setPropagateToPCA(propagateToPCA);
-    fgFitterTwoProngBarrel.setMaxR(maxR);
-    fgFitterTwoProngBarrel.setMaxDZIni(maxDZIni);
-    fgFitterTwoProngBarrel.setMinParamChange(minParamChange);
-    fgFitterTwoProngBarrel.setMinRelChi2Change(minRelChi2Change);
-    fgFitterTwoProngBarrel.setUseAbsDCA(useAbsDCA);
-    fgUsedKF = false;
+    fgDefaultContext.fFitterTwoProngBarrel.setBz(magField);
+    fgDefaultContext.fFitterTwoProngBarrel.setPropagateToPCA(propagateToPCA);
+    fgDefaultContext.fFitterTwoProngBarrel.setMaxR(maxR);
+    fgDefaultContext.fFitterTwoProngBarrel.setMaxDZIni(maxDZIni);
+    fgDefaultContext.fFitterTwoProngBarrel.setMinParamChange(minParamChange);
+    fgDefaultContext.fFitterTwoProngBarrel.setMinRelChi2Change(minRelChi2Change);
+    fgDefaultContext.fFitterTwoProngBarrel.setUseAbsDCA(useAbsDCA);
+    fgDefaultContext.fUsedKF = false;
   }
 
   // Setup the 2 prong FwdDCAFitterN
   static void SetupTwoProngFwdDCAFitter(float magField, bool propagateToPCA, float maxR, float minParamChange, float minRelChi2Change, bool useAbsDCA)
   {
-    fgFitterTwoProngFwd.setBz(magField);
-    fgFitterTwoProngFwd.setPropagateToPCA(propagateToPCA);
-    fgFitterTwoProngFwd.setMaxR(maxR);
-    fgFitterTwoProngFwd.setMinParamChange(minParamChange);
-    fgFitterTwoProngFwd.setMinRelChi2Change(minRelChi2Change);
-    fgFitterTwoProngFwd.setUseAbsDCA(useAbsDCA);
-    fgUsedKF = false;
+    fgDefaultContext.fFitterTwoProngFwd.setBz(magField);
+    fgDefaultContext.fFitterTwoProngFwd.setPropagateToPCA(propagateToPCA);
+    fgDefaultContext.fFitterTwoProngFwd.setMaxR(maxR);
+    fgDefaultContext.fFitterTwoProngFwd.setMinParamChange(minParamChange);
+    fgDefaultContext.fFitterTwoProngFwd.setMinRelChi2Change(minRelChi2Change);
+    fgDefaultContext.fFitterTwoProngFwd.setUseAbsDCA(useAbsDCA);
+    fgDefaultContext.fUsedKF = false;
   }
   // Use MatLayerCylSet to correct MCS in fwdtrack propagation
   static void SetupMatLUTFwdDCAFitter(o2::base::MatLayerCylSet* m)
   {
-    fgFitterTwoProngFwd.setTGeoMat(false);
-    fgFitterTwoProngFwd.setMatLUT(m);
+    fgDefaultContext.fFitterTwoProngFwd.setTGeoMat(false);
+    fgDefaultContext.fFitterTwoProngFwd.setMatLUT(m);
   }
   // Use GeometryManager to correct MCS in fwdtrack propagation
   static void SetupTGeoFwdDCAFitter()
   {
-    fgFitterTwoProngFwd.setTGeoMat(true);
+    fgDefaultContext.fFitterTwoProngFwd.setTGeoMat(true);
   }
 
   static auto getEventPlane(int harm, float qnxa, float qnya)
@@ -507,17 +536,25 @@ class VarManager : public TObject
   template <uint32_t fillMap, typename T>
   static void FillEvent(T const& event, float* values = nullptr);
   template <uint32_t fillMap, typename T>
+  static void FillEvent(T const& event, VarContext& ctx, float* values = nullptr);
+  template <uint32_t fillMap, typename T>
   static void FillTrack(T const& track, float* values = nullptr);
+  template <uint32_t fillMap, typename T>
+  static void FillTrack(T const& track, VarContext& ctx, float* values = nullptr);
   template <typename U, typename T>
   static void FillTrackMC(const U& mcStack, T const& track, float* values = nullptr);
   template <int pairType, uint32_t fillMap, typename T1, typename T2>
   static void FillPair(T1 const& t1, T2 const& t2, float* values = nullptr);
+  template <int pairType, uint32_t fillMap, typename T1, typename T2>
+  static void FillPair(T1 const& t1, T2 const& t2, VarContext& ctx, float* values = nullptr);
   template <int pairType, typename T1, typename T2>
   static void FillPairME(T1 const& t1, T2 const& t2, float* values = nullptr);
   template <typename T1, typename T2>
   static void FillPairMC(T1 const& t1, T2 const& t2, float* values = nullptr, PairCandidateType pairType = kDecayToEE);
   template <int pairType, uint32_t collFillMap, uint32_t fillMap, typename C, typename T>
   static void FillPairVertexing(C const& collision, T const& t1, T const& t2, float* values = nullptr);
+  template <int pairType, uint32_t collFillMap, uint32_t fillMap, typename C, typename T>
+  static void FillPairVertexing(C const& collision, T const& t1, T const& t2, VarContext& ctx, float* values = nullptr);
   template <int candidateType, uint32_t collFillMap, uint32_t fillMap, typename C, typename T1>
   static void FillDileptonTrackVertexing(C const& collision, T1 const& lepton1, T1 const& lepton2, T1 const& track, float* values);
   template <typename T1, typename T2>
@@ -561,19 +598,19 @@ class VarManager : public TObject
   ~VarManager() override;
 
   static float fgValues[kNVars]; // array holding all variables computed during analysis
+  static VarContext& GetDefaultContext() { return fgDefaultContext; }
   static void ResetValues(int startValue = 0, int endValue = kNVars, float* values = nullptr);
 
  private:
   static bool fgUsedVars[kNVars]; // holds flags for when the corresponding variable is needed (e.g., in the histogram manager, in cuts, mixing handler, etc.)
-  static bool fgUsedKF;
   static void SetVariableDependencies(); // toggle those variables on which other used variables might depend
 
   static std::map<int, int> fgRunMap; // map of runs to be used in histogram axes
   static TString fgRunStr;            // semi-colon separated list of runs, to be used for histogram axis labels
   static std::vector<int> fgRunList;  // vector of runs, to be used for histogram axis
 
-  static void FillEventDerived(float* values = nullptr);
-  static void FillTrackDerived(float* values = nullptr);
+  static void FillEventDerived(float* values = nullptr, const bool* usedVars = fgUsedVars);
+  static void FillTrackDerived(float* values = nullptr, const bool* usedVars = fgUsedVars);
   template <typename T, typename U, typename V>
   static auto getRotatedCovMatrixXX(const T& matrix, U phi, V theta);
   template <typename T>
@@ -582,10 +619,7 @@ class VarManager : public TObject
   static KFPVertex createKFPVertexFromCollision(const T& collision);
   static float calculateCosPA(KFParticle kfp, KFParticle PV);
 
-  static o2::vertexing::DCAFitterN<2> fgFitterTwoProngBarrel;
-  static o2::vertexing::DCAFitterN<3> fgFitterThreeProngBarrel;
-  static o2::vertexing::FwdDCAFitterN<2> fgFitterTwoProngFwd;
-  static o2::vertexing::FwdDCAFitterN<3> fgFitterThreeProngFwd;
+  static VarContext fgDefaultContext; //! context used by the static API, working on fgValues and fgUsedVars
 
   static std::map<CalibObjects, TObject*> fgCalibs; // map of calibration histograms
   static bool fgRunTPCPostCalibration[4];           // 0-electron, 1-pion, 2-kaon, 3-proton
@@ -654,9 +688,15 @@ KFPVertex VarManager::createKFPVertexFromCollision(const T& collision)
 
 template <uint32_t fillMap, typename T>
 void VarManager::FillEvent(T const& event, float* values)
+{
+  FillEvent<fillMap>(event, fgDefaultContext, values);
+}
+
+template <uint32_t fillMap, typename T>
+void VarManager::FillEvent(T const& event, VarContext& ctx, float* values)
 {
   if (!values) {
-    values = fgValues;
+    values = ctx.fValues;
   }
 
   if constexpr ((fillMap & CollisionTimestamp) > 0) {
@@ -666,37 +706,37 @@ void VarManager::FillEvent(T const& event, float* values)
   if constexpr ((fillMap & Collision) > 0) {
     // TODO: trigger info from the event selection requires a separate flag
     //       so that it can be switched off independently of the rest of Collision variables (e.g. if event selection is not available)
-    if (fgUsedVars[kIsINT7]) {
+    if (ctx.fUsedVars[kIsINT7]) {
       values[kIsINT7] = (event.alias_bit(kINT7) > 0);
     }
-    if (fgUsedVars[kIsEMC7]) {
+    if (ctx.fUsedVars[kIsEMC7]) {
       values[kIsEMC7] = (event.alias_bit(kEMC7) > 0);
     }
-    if (fgUsedVars[kIsINT7inMUON]) {
+    if (ctx.fUsedVars[kIsINT7inMUON]) {
       values[kIsINT7inMUON] = (event.alias_bit(kINT7inMUON) > 0);
     }
-    if (fgUsedVars[kIsMuonSingleLowPt7]) {
+    if (ctx.fUsedVars[kIsMuonSingleLowPt7]) {
       values[kIsMuonSingleLowPt7] = (event.alias_bit(kMuonSingleLowPt7) > 0);
     }
-    if (fgUsedVars[kIsMuonSingleHighPt7]) {
+    if (ctx.fUsedVars[kIsMuonSingleHighPt7]) {
       values[kIsMuonSingleHighPt7] = (event.alias_bit(kMuonSingleHighPt7) > 0);
     }
-    if (fgUsedVars[kIsMuonUnlikeLowPt7]) {
+    if (ctx.fUsedVars[kIsMuonUnlikeLowPt7]) {
       values[kIsMuonUnlikeLowPt7] = (event.alias_bit(kMuonUnlikeLowPt7) > 0);
     }
-    if (fgUsedVars[kIsMuonLikeLowPt7]) {
+    if (ctx.fUsedVars[kIsMuonLikeLowPt7]) {
       values[kIsMuonLikeLowPt7] = (event.alias_bit(kMuonLikeLowPt7) > 0);
     }
-    if (fgUsedVars[kIsCUP8]) {
+    if (ctx.fUsedVars[kIsCUP8]) {
       values[kIsCUP8] = (event.alias_bit(kCUP8) > 0);
     }
-    if (fgUsedVars[kIsCUP9]) {
+    if (ctx.fUsedVars[kIsCUP9]) {
       values[kIsCUP9] = (event.alias_bit(kCUP9) > 0);
     }
-    if (fgUsedVars[kIsMUP10]) {
+    if (ctx.fUsedVars[kIsMUP10]) {
       values[kIsMUP10] = (event.alias_bit(kMUP10) > 0);
     }
-    if (fgUsedVars[kIsMUP11]) {
+    if (ctx.fUsedVars[kIsMUP11]) {
       values[kIsMUP11] = (event.alias_bit(kMUP11) > 0);
     }
     values[kVtxX] = event.posX();
@@ -749,37 +789,37 @@ void VarManager::FillEvent(T const& event, float* values)
     values[kTimestamp] = event.timestamp();
     values[kCentVZERO] = event.centRun2V0M();
     values[kCentFT0C] = event.centFT0C();
-    if (fgUsedVars[kIsINT7]) {
+    if (ctx.fUsedVars[kIsINT7]) {
       values[kIsINT7] = (event.triggerAlias() & (uint32_t(1) << kINT7)) > 0;
     }
-    if (fgUsedVars[kIsEMC7]) {
+    if (ctx.fUsedVars[kIsEMC7]) {
       values[kIsEMC7] = (event.triggerAlias() & (uint32_t(1) << kEMC7)) > 0;
     }
-    if (fgUsedVars[kIsINT7inMUON]) {
+    if (ctx.fUsedVars[kIsINT7inMUON]) {
       values[kIsINT7inMUON] = (event.triggerAlias() & (uint32_t(1) << kINT7inMUON)) > 0;
     }
-    if (fgUsedVars[kIsMuonSingleLowPt7]) {
+    if (ctx.fUsedVars[kIsMuonSingleLowPt7]) {
       values[kIsMuonSingleLowPt7] = (event.triggerAlias() & (uint32_t(1) << kMuonSingleLowPt7)) > 0;
     }
-    if (fgUsedVars[kIsMuonSingleHighPt7]) {
+    if (ctx.fUsedVars[kIsMuonSingleHighPt7]) {
       values[kIsMuonSingleHighPt7] = (event.triggerAlias() & (uint32_t(1) << kMuonSingleHighPt7)) > 0;
     }
-    if (fgUsedVars[kIsMuonUnlikeLowPt7]) {
+    if (ctx.fUsedVars[kIsMuonUnlikeLowPt7]) {
       values[kIsMuonUnlikeLowPt7] = (event.triggerAlias() & (uint32_t(1) << kMuonUnlikeLowPt7)) > 0;
     }
-    if (fgUsedVars[kIsMuonLikeLowPt7]) {
+    if (ctx.fUsedVars[kIsMuonLikeLowPt7]) {
       values[kIsMuonLikeLowPt7] = (event.triggerAlias() & (uint32_t(1) << kMuonLikeLowPt7)) > 0;
     }
-    if (fgUsedVars[kIsCUP8]) {
+    if (ctx.fUsedVars[kIsCUP8]) {
       values[kIsCUP8] = (event.triggerAlias() & (uint32_t(1) << kCUP8)) > 0;
     }
-    if (fgUsedVars[kIsCUP9]) {
+    if (ctx.fUsedVars[kIsCUP9]) {
       values[kIsCUP9] = (event.triggerAlias() & (uint32_t(1) << kCUP9)) > 0;
     }
-    if (fgUsedVars[kIsMUP10]) {
+    if (ctx.fUsedVars[kIsMUP10]) {
       values[kIsMUP10] = (event.triggerAlias() & (uint32_t(1) << kMUP10)) > 0;
     }
-    if (fgUsedVars[kIsMUP11]) {
+    if (ctx.fUsedVars[kIsMUP11]) {
       values[kIsMUP11] = (event.triggerAlias() & (uint32_t(1) << kMUP11)) > 0;
     }
   }
@@ -840,29 +880,35 @@ void VarManager::FillEvent(T const& event, float* values)
     values[kMCEventImpParam] = event.impactParameter();
   }
 
-  FillEventDerived(values);
+  FillEventDerived(values, ctx.fUsedVars);
 }
 
 template <uint32_t fillMap, typename T>
 void VarManager::FillTrack(T const& track, float* values)
+{
+  FillTrack<fillMap>(track, fgDefaultContext, values);
+}
+
+template <uint32_t fillMap, typename T>
+void VarManager::FillTrack(T const& track, VarContext& ctx, float* values)
 {
   if (!values) {
-    values = fgValues;
+    values = ctx.fValues;
   }
 
   // Quantities based on the basic table (contains just kine information and filter bits)
   if constexpr ((fillMap & Track) > 0 || (fillMap & Muon) > 0 || (fillMap & ReducedTrack) > 0 || (fillMap & ReducedMuon) > 0) {
     values[kPt] = track.pt();
-    if (fgUsedVars[kPx]) {
+    if (ctx.fUsedVars[kPx]) {
       values[kPx] = track.px();
     }
-    if (fgUsedVars[kPy]) {
+    if (ctx.fUsedVars[kPy]) {
       values[kPy] = track.py();
     }
-    if (fgUsedVars[kPz]) {
+    if (ctx.fUsedVars[kPz]) {
       values[kPz] = track.pz();
     }
-    if (fgUsedVars[kInvPt]) {
+    if (ctx.fUsedVars[kInvPt]) {
       values[kInvPt] = 1. / track.pt();
     }
     values[kEta] = track.eta();
@@ -891,34 +937,34 @@ void VarManager::FillTrack(T const& track, float* values)
   // Quantities based on the barrel tables
   if constexpr ((fillMap & TrackExtra) > 0 || (fillMap & ReducedTrackBarrel) > 0) {
     values[kPin] = track.tpcInnerParam();
-    if (fgUsedVars[kIsITSrefit]) {
+    if (ctx.fUsedVars[kIsITSrefit]) {
       values[kIsITSrefit] = (track.flags() & o2::aod::track::ITSrefit) > 0; // NOTE: This is just for Run-2
     }
-    if (fgUsedVars[kTrackTimeResIsRange]) {
+    if (ctx.fUsedVars[kTrackTimeResIsRange]) {
       values[kTrackTimeResIsRange] = (track.flags() & o2::aod::track::TrackTimeResIsRange) > 0; // NOTE: This is NOT for Run-2
     }
-    if (fgUsedVars[kIsTPCrefit]) {
+    if (ctx.fUsedVars[kIsTPCrefit]) {
       values[kIsTPCrefit] = (track.flags() & o2::aod::track::TPCrefit) > 0; // NOTE: This is just for Run-2
     }
-    if (fgUsedVars[kPVContributor]) {
+    if (ctx.fUsedVars[kPVContributor]) {
       values[kPVContributor] = (track.flags() & o2::aod::track::PVContributor) > 0; // NOTE: This is NOT for Run-2
     }
-    if (fgUsedVars[kIsGoldenChi2]) {
+    if (ctx.fUsedVars[kIsGoldenChi2]) {
       values[kIsGoldenChi2] = (track.flags() & o2::aod::track::GoldenChi2) > 0; // NOTE: This is just for Run-2
     }
-    if (fgUsedVars[kOrphanTrack]) {
+    if (ctx.fUsedVars[kOrphanTrack]) {
       values[kOrphanTrack] = (track.flags() & o2::aod::track::OrphanTrack) > 0; // NOTE: This is NOT for Run-2
     }
-    if (fgUsedVars[kIsSPDfirst]) {
+    if (ctx.fUsedVars[kIsSPDfirst]) {
       values[kIsSPDfirst] = (track.itsClusterMap() & uint8_t(1)) > 0;
     }
-    if (fgUsedVars[kIsSPDboth]) {
+    if (ctx.fUsedVars[kIsSPDboth]) {
       values[kIsSPDboth] = (track.itsClusterMap() & uint8_t(3)) > 0;
     }
-    if (fgUsedVars[kIsSPDany]) {
+    if (ctx.fUsedVars[kIsSPDany]) {
       values[kIsSPDany] = (track.itsClusterMap() & uint8_t(1)) || (track.itsClusterMap() & uint8_t(2));
     }
-    if (fgUsedVars[kITSClusterMap]) {
+    if (ctx.fUsedVars[kITSClusterMap]) {
       values[kITSClusterMap] = track.itsClusterMap();
     }
     values[kTrackTime] = track.trackTime();
@@ -942,12 +988,12 @@ void VarManager::FillTrack(T const& track, float* values)
     values[kHasTPC] = track.hasTPC();
 
     if constexpr ((fillMap & TrackExtra) > 0) {
-      if (fgUsedVars[kITSncls]) {
+      if (ctx.fUsedVars[kITSncls]) {
         values[kITSncls] = track.itsNCls(); // dynamic column
       }
     }
     if constexpr ((fillMap & ReducedTrackBarrel) > 0) {
-      if (fgUsedVars[kITSncls]) {
+      if (ctx.fUsedVars[kITSncls]) {
         values[kITSncls] = 0.0;
         for (int i = 0; i < 7; ++i) {
           values[kITSncls] += ((track.itsClusterMap() & (1 << i)) ? 1 : 0);
@@ -956,16 +1002,16 @@ void VarManager::FillTrack(T const& track, float* values)
       values[kTrackDCAxy] = track.dcaXY();
       values[kTrackDCAz] = track.dcaZ();
       if constexpr ((fillMap & ReducedTrackBarrelCov) > 0) {
-        if (fgUsedVars[kTrackDCAsigXY]) {
+        if (ctx.fUsedVars[kTrackDCAsigXY]) {
           values[kTrackDCAsigXY] = track.dcaXY() / std::sqrt(track.cYY());
         }
-        if (fgUsedVars[kTrackDCAsigZ]) {
+        if (ctx.fUsedVars[kTrackDCAsigZ]) {
           values[kTrackDCAsigZ] = track.dcaZ() / std::sqrt(track.cZZ());
         }
-        if (fgUsedVars[kTrackDCAresXY]) {
+        if (ctx.fUsedVars[kTrackDCAresXY]) {
           values[kTrackDCAresXY] = std::sqrt(track.cYY());
         }
-        if (fgUsedVars[kTrackDCAresZ]) {
+        if (ctx.fUsedVars[kTrackDCAresZ]) {
           values[kTrackDCAresZ] = std::sqrt(track.cZZ());
         }
       }
@@ -977,16 +1023,16 @@ void VarManager::FillTrack(T const& track, float* values)
     values[kTrackDCAxy] = track.dcaXY();
     values[kTrackDCAz] = track.dcaZ();
     if constexpr ((fillMap & TrackCov) > 0) {
-      if (fgUsedVars[kTrackDCAsigXY]) {
+      if (ctx.fUsedVars[kTrackDCAsigXY]) {
         values[kTrackDCAsigXY] = track.dcaXY() / std::sqrt(track.cYY());
       }
-      if (fgUsedVars[kTrackDCAsigZ]) {
+      if (ctx.fUsedVars[kTrackDCAsigZ]) {
         values[kTrackDCAsigZ] = track.dcaZ() / std::sqrt(track.cZZ());
       }
-      if (fgUsedVars[kTrackDCAresXY]) {
+      if (ctx.fUsedVars[kTrackDCAresXY]) {
         values[kTrackDCAresXY] = std::sqrt(track.cYY());
       }
-      if (fgUsedVars[kTrackDCAresZ]) {
+      if (ctx.fUsedVars[kTrackDCAresZ]) {
         values[kTrackDCAresZ] = std::sqrt(track.cZZ());
       }
     }
@@ -1022,7 +1068,7 @@ void VarManager::FillTrack(T const& track, float* values)
     values[kTPCnSigmaPr] = track.tpcNSigmaPr();
 
     // compute TPC postcalibrated electron nsigma based on calibration histograms from CCDB
-    if (fgUsedVars[kTPCnSigmaEl_Corr] && fgRunTPCPostCalibration[0]) {
+    if (ctx.fUsedVars[kTPCnSigmaEl_Corr] && fgRunTPCPostCalibration[0]) {
       TH3F* calibMean = reinterpret_cast<TH3F*>(fgCalibs[kTPCElectronMean]);
       TH3F* calibSigma = reinterpret_cast<TH3F*>(fgCalibs[kTPCElectronSigma]);
 
@@ -1041,7 +1087,7 @@ void VarManager::FillTrack(T const& track, float* values)
       values[kTPCnSigmaEl_Corr] = (values[kTPCnSigmaEl] - mean) / width;
     }
     // compute TPC postcalibrated pion nsigma if required
-    if (fgUsedVars[kTPCnSigmaPi_Corr] && fgRunTPCPostCalibration[1]) {
+    if (ctx.fUsedVars[kTPCnSigmaPi_Corr] && fgRunTPCPostCalibration[1]) {
       TH3F* calibMean = reinterpret_cast<TH3F*>(fgCalibs[kTPCPionMean]);
       TH3F* calibSigma = reinterpret_cast<TH3F*>(fgCalibs[kTPCPionSigma]);
 
@@ -1059,7 +1105,7 @@ void VarManager::FillTrack(T const& track, float* values)
       double width = calibSigma->GetBinContent(binTPCncls, binPin, binEta);
       values[kTPCnSigmaPi_Corr] = (values[kTPCnSigmaPi] - mean) / width;
     }
-    if (fgUsedVars[kTPCnSigmaKa_Corr] && fgRunTPCPostCalibration[2]) {
+    if (ctx.fUsedVars[kTPCnSigmaKa_Corr] && fgRunTPCPostCalibration[2]) {
       TH3F* calibMean = reinterpret_cast<TH3F*>(fgCalibs[kTPCKaonMean]);
       TH3F* calibSigma = reinterpret_cast<TH3F*>(fgCalibs[kTPCKaonSigma]);
 
@@ -1078,7 +1124,7 @@ void VarManager::FillTrack(T const& track, float* values)
       values[kTPCnSigmaKa_Corr] = (values[kTPCnSigmaKa] - mean) / width;
     }
     // compute TPC postcalibrated proton nsigma if required
-    if (fgUsedVars[kTPCnSigmaPr_Corr] && fgRunTPCPostCalibration[3]) {
+    if (ctx.fUsedVars[kTPCnSigmaPr_Corr] && fgRunTPCPostCalibration[3]) {
       TH3F* calibMean = reinterpret_cast<TH3F*>(fgCalibs[kTPCProtonMean]);
       TH3F* calibSigma = reinterpret_cast<TH3F*>(fgCalibs[kTPCProtonSigma]);
 
@@ -1101,7 +1147,7 @@ void VarManager::FillTrack(T const& track, float* values)
     values[kTOFnSigmaKa] = track.tofNSigmaKa();
     values[kTOFnSigmaPr] = track.tofNSigmaPr();
 
-    if (fgUsedVars[kTPCsignalRandomized] || fgUsedVars[kTPCnSigmaElRandomized] || fgUsedVars[kTPCnSigmaPiRandomized] || fgUsedVars[kTPCnSigmaPrRandomized]) {
+    if (ctx.fUsedVars[kTPCsignalRandomized] || ctx.fUsedVars[kTPCnSigmaElRandomized] || ctx.fUsedVars[kTPCnSigmaPiRandomized] || ctx.fUsedVars[kTPCnSigmaPrRandomized]) {
       // NOTE: this is needed temporarily for the study of the impact of TPC pid degradation on the quarkonium triggers in high lumi pp
       //     This study involves a degradation from a dE/dx resolution of 5% to one of 6% (20% worsening)
       //     For this we smear the dE/dx and n-sigmas using a gaus distribution with a width of 3.3%
@@ -1170,7 +1216,7 @@ void VarManager::FillTrack(T const& track, float* values)
   }
 
   // Derived quantities which can be computed based on already filled variables
-  FillTrackDerived(values);
+  FillTrackDerived(values, ctx.fUsedVars);
 }
 
 template <typename U, typename T>
@@ -1205,9 +1251,15 @@ void VarManager::FillTrackMC(const U& mcStack, T const& track, float* values)
 
 template <int pairType, uint32_t fillMap, typename T1, typename T2>
 void VarManager::FillPair(T1 const& t1, T2 const& t2, float* values)
+{
+  FillPair<pairType, fillMap>(t1, t2, fgDefaultContext, values);
+}
+
+template <int pairType, uint32_t fillMap, typename T1, typename T2>
+void VarManager::FillPair(T1 const& t1, T2 const& t2, VarContext& ctx, float* values)
 {
   if (!values) {
-    values = fgValues;
+    values = ctx.fValues;
   }
 
   float m1 = MassElectron;
@@ -1238,7 +1290,7 @@ void VarManager::FillPair(T1 const& t1, T2 const& t2, float* values)
   double Ptot2 = TMath::Sqrt(v2.Px() * v2.Px() + v2.Py() * v2.Py() + v2.Pz() * v2.Pz());
   values[kDeltaPtotTracks] = Ptot1 - Ptot2;
 
-  if (fgUsedVars[kPsiPair]) {
+  if (ctx.fUsedVars[kPsiPair]) {
     values[kDeltaPhiPair] = (t1.sign() > 0) ? (v1.Phi() - v2.Phi()) : (v2.Phi() - v1.Phi());
     double xipair = TMath::ACos((v1.Px() * v2.Px() + v1.Py() * v2.Py() + v1.Pz() * v2.Pz()) / v1.P() / v2.P());
     values[kPsiPair] = (t1.sign() > 0) ? TMath::ASin((v1.Theta() - v2.Theta()) / xipair) : TMath::ASin((v2.Theta() - v1.Theta()) / xipair);
@@ -1250,13 +1302,13 @@ void VarManager::FillPair(T1 const& t1, T2 const& t2, float* values)
   ROOT::Math::XYZVectorF v2_CM{(boostv12(v2).Vect()).Unit()};
   ROOT::Math::XYZVectorF zaxis{(v12.Vect()).Unit()};
 
-  if (fgUsedVars[kCosThetaHE]) {
+  if (ctx.fUsedVars[kCosThetaHE]) {
     values[kCosThetaHE] = (t1.sign() > 0 ? zaxis.Dot(v1_CM) : zaxis.Dot(v2_CM));
   }
 
   if constexpr ((pairType == kDecayToEE) && ((fillMap & TrackCov) > 0 || (fillMap & ReducedTrackBarrelCov) > 0)) {
 
-    if (fgUsedVars[kQuadDCAabsXY] || fgUsedVars[kQuadDCAsigXY] || fgUsedVars[kQuadDCAabsZ] || fgUsedVars[kQuadDCAsigZ] || fgUsedVars[kQuadDCAsigXYZ]) {
+    if (ctx.fUsedVars[kQuadDCAabsXY] || ctx.fUsedVars[kQuadDCAsigXY] || ctx.fUsedVars[kQuadDCAabsZ] || ctx.fUsedVars[kQuadDCAsigZ] || ctx.fUsedVars[kQuadDCAsigXYZ]) {
       // Quantities based on the barrel tables
       double dca1XY = t1.dcaXY();
       double dca2XY = t2.dcaXY();
@@ -1287,14 +1339,14 @@ void VarManager::FillPair(T1 const& t1, T2 const& t2, float* values)
       }
     }
   }
-  if (fgUsedVars[kPairPhiv]) {
+  if (ctx.fUsedVars[kPairPhiv]) {
     // cos(phiv) = w*a /|w||a|
     // with w = u x v
     // and  a = u x z / |u x z|   , unit vector perpendicular to v12 and z-direction (magnetic field)
     // u = v12 / |v12|            , the unit vector of v12
     // v = v1 x v2 / |v1 x v2|    , unit vector perpendicular to v1 and v2
 
-    float bz = fgFitterTwoProngBarrel.getBz();
+    float bz = ctx.fFitterTwoProngBarrel.getBz();
 
     bool swapTracks = false;
     if (v1.Pt() < v2.Pt()) { // ordering of track, pt1 > pt2
@@ -1450,6 +1502,12 @@ void VarManager::FillPairMC(T1 const& t1, T2 const& t2, float* values, PairCandi
 
 template <int pairType, uint32_t collFillMap, uint32_t fillMap, typename C, typename T>
 void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2, float* values)
+{
+  FillPairVertexing<pairType, collFillMap, fillMap>(collision, t1, t2, fgDefaultContext, values);
+}
+
+template <int pairType, uint32_t collFillMap, uint32_t fillMap, typename C, typename T>
+void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2, VarContext& ctx, float* values)
 {
   // check at compile time that the event and cov matrix have the cov matrix
   constexpr bool eventHasVtxCov = ((collFillMap & Collision) > 0 || (collFillMap & ReducedEventVtxCov) > 0);
@@ -1457,11 +1515,11 @@ void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2,
   constexpr bool muonHasCov = ((fillMap & MuonCov) > 0 || (fillMap & ReducedMuonCov) > 0);
 
   if (!values) {
-    values = fgValues;
+    values = ctx.fValues;
   }
 
-  values[kUsedKF] = fgUsedKF;
-  if (!fgUsedKF) {
+  values[kUsedKF] = ctx.fUsedKF;
+  if (!ctx.fUsedKF) {
     int procCode = 0;
 
     // TODO: use trackUtilities functions to initialize the various matrices to avoid code duplication
@@ -1479,7 +1537,7 @@ void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2,
                                       t2.cSnpSnp(), t2.cTglY(), t2.cTglZ(), t2.cTglSnp(), t2.cTglTgl(),
                                       t2.c1PtY(), t2.c1PtZ(), t2.c1PtSnp(), t2.c1PtTgl(), t2.c1Pt21Pt2()};
       o2::track::TrackParCov pars2{t2.x(), t2.alpha(), t2pars, t2covs};
-      procCode = fgFitterTwoProngBarrel.process(pars1, pars2);
+      procCode = ctx.fFitterTwoProngBarrel.process(pars1, pars2);
     } else if constexpr ((pairType == kDecayToMuMu) && muonHasCov) {
       // Initialize track parameters for forward
       double chi21 = t1.chi2();
@@ -1496,7 +1554,7 @@ void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2,
                              t2.c1PtX(), t2.c1PtY(), t2.c1PtPhi(), t2.c1PtTgl(), t2.c1Pt21Pt2()};
       SMatrix55 t2covs(v2.begin(), v2.end());
       o2::track::TrackParCovFwd pars2{t2.z(), t2pars, t2covs, chi22};
-      procCode = fgFitterTwoProngFwd.process(pars1, pars2);
+      procCode = ctx.fFitterTwoProngFwd.process(pars1, pars2);
     } else {
       return;
     }
@@ -1539,12 +1597,12 @@ void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2,
       auto covMatrixPV = primaryVertex.getCov();
 
       if constexpr (pairType == kDecayToEE && trackHasCov) {
-        secondaryVertex = fgFitterTwoProngBarrel.getPCACandidate();
-        bz = fgFitterTwoProngBarrel.getBz();
-        covMatrixPCA = fgFitterTwoProngBarrel.calcPCACovMatrixFlat();
-        auto chi2PCA = fgFitterTwoProngBarrel.getChi2AtPCACandidate();
-        auto trackParVar0 = fgFitterTwoProngBarrel.getTrack(0);
-        auto trackParVar1 = fgFitterTwoProngBarrel.getTrack(1);
+        secondaryVertex = ctx.fFitterTwoProngBarrel.getPCACandidate();
+        bz = ctx.fFitterTwoProngBarrel.getBz();
+        covMatrixPCA = ctx.fFitterTwoProngBarrel.calcPCACovMatrixFlat();
+        auto chi2PCA = ctx.fFitterTwoProngBarrel.getChi2AtPCACandidate();
+        auto trackParVar0 = ctx.fFitterTwoProngBarrel.getTrack(0);
+        auto trackParVar1 = ctx.fFitterTwoProngBarrel.getTrack(1);
         values[kVertexingChi2PCA] = chi2PCA;
         trackParVar0.getPxPyPzGlo(pvec0);
         trackParVar1.getPxPyPzGlo(pvec1);
@@ -1555,12 +1613,12 @@ void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2,
         m1 = MassMuon;
         m2 = MassMuon;
 
-        secondaryVertex = fgFitterTwoProngFwd.getPCACandidate();
-        bz = fgFitterTwoProngFwd.getBz();
-        covMatrixPCA = fgFitterTwoProngFwd.calcPCACovMatrixFlat();
-        auto chi2PCA = fgFitterTwoProngFwd.getChi2AtPCACandidate();
-        auto trackParVar0 = fgFitterTwoProngFwd.getTrack(0);
-        auto trackParVar1 = fgFitterTwoProngFwd.getTrack(1);
+        secondaryVertex = ctx.fFitterTwoProngFwd.getPCACandidate();
+        bz = ctx.fFitterTwoProngFwd.getBz();
+        covMatrixPCA = ctx.fFitterTwoProngFwd.calcPCACovMatrixFlat();
+        auto chi2PCA = ctx.fFitterTwoProngFwd.getChi2AtPCACandidate();
+        auto trackParVar0 = ctx.fFitterTwoProngFwd.getTrack(0);
+        auto trackParVar1 = ctx.fFitterTwoProngFwd.getTrack(1);
         values[kVertexingChi2PCA] = chi2PCA;
         pvec0[0] = trackParVar0.getPx();
         pvec0[1] = trackParVar0.getPy();
@@ -1615,14 +1673,14 @@ void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2,
       KFGeoTwoProngBarrel.AddDaughter(trk0KF);
       KFGeoTwoProngBarrel.AddDaughter(trk1KF);
 
-      if (fgUsedVars[kKFMass])
+      if (ctx.fUsedVars[kKFMass])
         values[kKFMass] = KFGeoTwoProngBarrel.GetMass();
     }
     if constexpr (eventHasVtxCov) {
       KFPVertex kfpVertex = createKFPVertexFromCollision(collision);
       values[kKFNContributorsPV] = kfpVertex.GetNContributors();
       KFParticle KFPV(kfpVertex);
-      if (fgUsedVars[kVertexingLxy] || fgUsedVars[kVertexingLz] || fgUsedVars[kVertexingLxyz] || fgUsedVars[kVertexingLxyErr] || fgUsedVars[kVertexingLzErr] || fgUsedVars[kVertexingTauxy] || fgUsedVars[kVertexingLxyOverErr] || fgUsedVars[kVertexingLzOverErr] || fgUsedVars[kVertexingLxyzOverErr]) {
+      if (ctx.fUsedVars[kVertexingLxy] || ctx.fUsedVars[kVertexingLz] || ctx.fUsedVars[kVertexingLxyz] || ctx.fUsedVars[kVertexingLxyErr] || ctx.fUsedVars[kVertexingLzErr] || ctx.fUsedVars[kVertexingTauxy] || ctx.fUsedVars[kVertexingLxyOverErr] || ctx.fUsedVars[kVertexingLzOverErr] || ctx.fUsedVars[kVertexingLxyzOverErr]) {
         double dxPair2PV = KFGeoTwoProngBarrel.GetX() - KFPV.GetX();
         double dyPair2PV = KFGeoTwoProngBarrel.GetY() - KFPV.GetY();
         double dzPair2PV = KFGeoTwoProngBarrel.GetZ() - KFPV.GetZ();
@@ -1646,35 +1704,35 @@ void VarManager::FillPairVertexing(C const& collision, T const& t1, T const& t2,
         values[kVertexingTauxyErr] = values[kVertexingLxyErr] * KFGeoTwoProngBarrel.GetMass() / (KFGeoTwoProngBarrel.GetPt() * o2::constants::physics::LightSpeedCm2NS);
         values[kVertexingTauzErr] = values[kVertexingLzErr] * KFGeoTwoProngBarrel.GetMass() / (TMath::Abs(KFGeoTwoProngBarrel.GetPz()) * o2::constants::physics::LightSpeedCm2NS);
       }
-      if (fgUsedVars[kVertexingLxyOverErr] || fgUsedVars[kVertexingLzOverErr] || fgUsedVars[kVertexingLxyzOverErr]) {
+      if (ctx.fUsedVars[kVertexingLxyOverErr] || ctx.fUsedVars[kVertexingLzOverErr] || ctx.fUsedVars[kVertexingLxyzOverErr]) {
         values[kVertexingLxyOverErr] = values[kVertexingLxy] / values[kVertexingLxyErr];
         values[kVertexingLzOverErr] = values[kVertexingLz] / values[kVertexingLzErr];
         values[kVertexingLxyzOverErr] = values[kVertexingLxyz] / values[kVertexingLxyzErr];
       }
 
-      if (fgUsedVars[kKFChi2OverNDFGeo])
+      if (ctx.fUsedVars[kKFChi2OverNDFGeo])
         values[kKFChi2OverNDFGeo] = KFGeoTwoProngBarrel.GetChi2() / KFGeoTwoProngBarrel.GetNDF();
-      if (fgUsedVars[kKFCosPA])
+      if (ctx.fUsedVars[kKFCosPA])
         values[kKFCosPA] = calculateCosPA(KFGeoTwoProngBarrel, KFPV);
 
       // in principle, they should be in FillTrack
-      if (fgUsedVars[kKFTrack0DCAxyz] || fgUsedVars[kKFTrack1DCAxyz]) {
+      if (ctx.fUsedVars[kKFTrack0DCAxyz] || ctx.fUsedVars[kKFTrack1DCAxyz]) {
         values[kKFTrack0DCAxyz] = trk0KF.GetDistanceFromVertex(KFPV);
         values[kKFTrack1DCAxyz] = trk1KF.GetDistanceFromVertex(KFPV);
       }
-      if (fgUsedVars[kKFTrack0DCAxy] || fgUsedVars[kKFTrack1DCAxy]) {
+      if (ctx.fUsedVars[kKFTrack0DCAxy] || ctx.fUsedVars[kKFTrack1DCAxy]) {
         values[kKFTrack0DCAxy] = trk0KF.GetDistanceFromVertexXY(KFPV);
         values[kKFTrack1DCAxy] = trk1KF.GetDistanceFromVertexXY(KFPV);
       }
-      if (fgUsedVars[kKFDCAxyzBetweenProngs])
+      if (ctx.fUsedVars[kKFDCAxyzBetweenProngs])
         values[kKFDCAxyzBetweenProngs] = trk0KF.GetDistanceFromParticle(trk1KF);
-      if (fgUsedVars[kKFDCAxyBetweenProngs])
+      if (ctx.fUsedVars[kKFDCAxyBetweenProngs])
         values[kKFDCAxyBetweenProngs] = trk0KF.GetDistanceFromParticle(trk1KF);
 
-      if (fgUsedVars[kKFTracksDCAxyzMax]) {
+      if (ctx.fUsedVars[kKFTracksDCAxyzMax]) {
         values[kKFTracksDCAxyzMax] = values[kKFTrack0DCAxyz] > values[kKFTrack1DCAxyz] ? values[kKFTrack0DCAxyz] : values[kKFTrack1DCAxyz];
       }
-      if (fgUsedVars[kKFTracksDCAxyMax]) {
+      if (ctx.fUsedVars[kKFTracksDCAxyMax]) {
         values[kKFTracksDCAxyMax] = TMath::Abs(values[kKFTrack0DCAxy]) > TMath::Abs(values[kKFTrack1DCAxy]) ? values[kKFTrack0DCAxy] : values[kKFTrack1DCAxy];
       }
     }
@@ -1725,8 +1783,8 @@ void VarManager::FillDileptonTrackVertexing(C const& collision, T1 const& lepton
                            track.c1PtX(), track.c1PtY(), track.c1PtPhi(), track.c1PtTgl(), track.c1Pt21Pt2()};
     SMatrix55 t3covs(v3.begin(), v3.end());
     o2::track::TrackParCovFwd pars3{track.z(), t3pars, t3covs, chi23};
-    procCode = VarManager::fgFitterThreeProngFwd.process(pars1, pars2, pars3);
-    procCodeJpsi = VarManager::fgFitterTwoProngFwd.process(pars1, pars2);
+    procCode = VarManager::fgDefaultContext.fFitterThreeProngFwd.process(pars1, pars2, pars3);
+    procCodeJpsi = VarManager::fgDefaultContext.fFitterTwoProngFwd.process(pars1, pars2);
   } else if constexpr ((candidateType == kBtoJpsiEEK) && trackHasCov) {
     mlepton = MassElectron;
     mtrack = MassKaonCharged;
@@ -1745,8 +1803,8 @@ void VarManager::FillDileptonTrackVertexing(C const& collision, T1 const& lepton
                                          track.cSnpSnp(), track.cTglY(), track.cTglZ(), track.cTglSnp(), track.cTglTgl(),
                                          track.c1PtY(), track.c1PtZ(), track.c1PtSnp(), track.c1PtTgl(), track.c1Pt21Pt2()};
     o2::track::TrackParCov pars3{track.x(), track.alpha(), lepton3pars, lepton3covs};
-    procCode = VarManager::fgFitterThreeProngBarrel.process(pars1, pars2, pars3);
-    procCodeJpsi = VarManager::fgFitterTwoProngBarrel.process(pars1, pars2);
+    procCode = VarManager::fgDefaultContext.fFitterThreeProngBarrel.process(pars1, pars2, pars3);
+    procCodeJpsi = VarManager::fgDefaultContext.fFitterTwoProngBarrel.process(pars1, pars2);
   } else {
     return;
   }
@@ -1796,11 +1854,11 @@ void VarManager::FillDileptonTrackVertexing(C const& collision, T1 const& lepton
     auto covMatrixPV = primaryVertex.getCov();
 
     if constexpr (candidateType == kBtoJpsiEEK && trackHasCov) {
-      secondaryVertex = fgFitterThreeProngBarrel.getPCACandidate();
-      covMatrixPCA = fgFitterThreeProngBarrel.calcPCACovMatrixFlat();
+      secondaryVertex = fgDefaultContext.fFitterThreeProngBarrel.getPCACandidate();
+      covMatrixPCA = fgDefaultContext.fFitterThreeProngBarrel.calcPCACovMatrixFlat();
     } else if constexpr (candidateType == kBcToThreeMuons && muonHasCov) {
-      secondaryVertex = fgFitterThreeProngFwd.getPCACandidate();
-      covMatrixPCA = fgFitterThreeProngFwd.calcPCACovMatrixFlat();
+      secondaryVertex = fgDefaultContext.fFitterThreeProngFwd.getPCACandidate();
+      covMatrixPCA = fgDefaultContext.fFitterThreeProngFwd.calcPCACovMatrixFlat();
     }
 
     double phi = std::atan2(secondaryVertex[1] - collision.posY(), secondaryVertex[0] - collision.posX());
@@ -18,6 +18,8 @@
 // The event filtering (filterPP), centrality, and V0Bits (from v0-selector) can be switched on/off by selecting one
 //  of the process functions
 #include <iostream>
+#include <vector>
+#include <type_traits>
 #include "Framework/AnalysisTask.h"
 #include "Framework/AnalysisDataModel.h"
 #include "Framework/ASoAHelpers.h"
@@ -35,6 +37,7 @@
 #include "PWGDQ/Core/HistogramManager.h"
 #include "PWGDQ/Core/AnalysisCut.h"
 #include "PWGDQ/Core/AnalysisCompositeCut.h"
+#include "PWGDQ/Core/AnalysisCutCompiler.h"
 #include "PWGDQ/Core/HistogramsLibrary.h"
 #include "PWGDQ/Core/CutsLibrary.h"
 #include "DataFormatsGlobalTracking/RecoContainerCreateTracksVariadic.h"
@@ -159,6 +162,18 @@ struct TableMaker {
   AnalysisCompositeCut* fEventCut;              //! Event selection cut
   std::vector<AnalysisCompositeCut> fTrackCuts; //! Barrel track cuts
   std::vector<AnalysisCompositeCut> fMuonCuts;  //! Muon track cuts
+  AnalysisCutCompiler fTrackCutsCompiled;       //! Barrel track cuts, compiled for evaluation in one pass
+  AnalysisCutCompiler fMuonCutsCompiled;        //! Muon track cuts, compiled for evaluation in one pass
+
+  // histogram class handles for each track / muon cut, resolved once in init()
+  std::vector<int> fTrackCutHistHandles;
+  std::vector<int> fAmbiTrackCutHistHandles;
+  std::vector<int> fMuonCutHistHandles;
+  std::vector<int> fAmbiMuonCutHistHandles;
+
+  // flags for the ambiguous barrel / muon tracks in the current DF, indexed by the track global index
+  std::vector<bool> fAmbiguousTracksMid;
+  std::vector<bool> fAmbiguousTracksFwd;
 
   Preslice<MyBarrelTracks> perCollisionTracks = aod::track::collisionId;
   Preslice<MyMuons> perCollisionMuons = aod::fwdtrack::collisionId;
@@ -257,6 +272,16 @@ struct TableMaker {
     VarManager::SetUseVars(fHistMan->GetUsedVars()); // provide the list of required variables so that VarManager knows what to fill
     fOutputList.setObject(fHistMan->GetMainHistogramList());
 
+    // resolve the per-cut histogram classes, to avoid building the class names for every track
+    for (auto& cut : fTrackCuts) {
+      fTrackCutHistHandles.push_back(fHistMan->GetHistClassHandle(Form("TrackBarrel_%s", cut.GetName())));
+      fAmbiTrackCutHistHandles.push_back(fHistMan->GetHistClassHandle(Form("Ambiguous_TrackBarrel_%s", cut.GetName())));
+    }
+    for (auto& cut : fMuonCuts) {
+      fMuonCutHistHandles.push_back(fHistMan->GetHistClassHandle(Form("Muons_%s", cut.GetName())));
+      fAmbiMuonCutHistHandles.push_back(fHistMan->GetHistClassHandle(Form("Ambiguous_Muons_%s", cut.GetName())));
+    }
+
     // CCDB configuration
     if (fConfigComputeTPCpostCalib) {
       fCCDB->setURL(fConfigCcdbUrl.value);
@@ -282,6 +307,9 @@ struct TableMaker {
         fTrackCuts.push_back(*dqcuts::GetCompositeCut(objArray->At(icut)->GetName()));
       }
     }
+    for (auto& cut : fTrackCuts) {
+      fTrackCutsCompiled.AddCut(&cut);
+    }
 
     // Muon cuts
     cutNamesStr = fConfigMuonCuts.value;
@@ -291,10 +319,35 @@ struct TableMaker {
         fMuonCuts.push_back(*dqcuts::GetCompositeCut(objArray->At(icut)->GetName()));
       }
     }
+    for (auto& cut : fMuonCuts) {
+      fMuonCutsCompiled.AddCut(&cut);
+    }
 
     VarManager::SetUseVars(AnalysisCut::fgUsedVars); // provide the list of required variables so that VarManager knows what to fill
   }
 
+  // Flag the tracks present in the ambiguous tracks table of the current DF, so that the membership test in the track loops is O(1)
+  template <typename TAmbiTracks>
+  void fillAmbiguousFlags(TAmbiTracks const& ambiTracks, std::vector<bool>& flags)
+  {
+    flags.clear();
+    for (auto& ambiTrack : ambiTracks) {
+      int64_t idx = -1;
+      if constexpr (std::is_same_v<TAmbiTracks, aod::AmbiguousTracksMid>) {
+        idx = ambiTrack.trackId();
+      } else {
+        idx = ambiTrack.fwdtrackId();
+      }
+      if (idx < 0) {
+        continue;
+      }
+      if (idx >= static_cast<int64_t>(flags.size())) {
+        flags.resize(idx + 1, false);
+      }
+      flags[idx] = true;
+    }
+  }
+
   // Templated function instantianed for all of the process functions
   template <uint32_t TEventFillMap, uint32_t TTrackFillMap, uint32_t TMuonFillMap, typename TEvent, typename TTracks, typename TMuons, typename TAmbiTracks, typename TAmbiMuons>
   void fullSkimming(TEvent const& collision, aod::BCsWithTimestamps const&, TTracks const& tracksBarrel, TMuons const& tracksMuon, TAmbiTracks const& ambiTracksMid, TAmbiMuons const& ambiTracksFwd)
@@ -394,13 +447,7 @@ struct TableMaker {
       for (auto& track : tracksBarrel) {
         if constexpr ((TTrackFillMap & VarManager::ObjTypes::AmbiTrack) > 0) {
           if (fIsAmbiguous) {
-            isAmbiguous = 0;
-            for (auto& ambiTrackMid : ambiTracksMid) {
-              if (ambiTrackMid.trackId() == track.globalIndex()) {
-                isAmbiguous = 1;
-                break;
-              }
-            }
+            isAmbiguous = (track.globalIndex() < static_cast<int64_t>(fAmbiguousTracksMid.size()) && fAmbiguousTracksMid[track.globalIndex()]);
           }
         }
 
@@ -415,14 +462,15 @@ struct TableMaker {
         }
 
         // apply track cuts and fill stats histogram
+        uint64_t cutDecisions = fTrackCutsCompiled.Evaluate(VarManager::fgValues);
         int i = 0;
         for (auto cut = fTrackCuts.begin(); cut != fTrackCuts.end(); cut++, i++) {
-          if ((*cut).IsSelected(VarManager::fgValues)) {
+          if (cutDecisions & (uint64_t(1) << i)) {
             trackTempFilterMap |= (uint8_t(1) << i);
             if (fConfigQA) {
-              fHistMan->FillHistClass(Form("TrackBarrel_%s", (*cut).GetName()), VarManager::fgValues);
+              fHistMan->FillHistClass(fTrackCutHistHandles[i], VarManager::fgValues);
               if (fIsAmbiguous && isAmbiguous == 1) {
-                fHistMan->FillHistClass(Form("Ambiguous_TrackBarrel_%s", (*cut).GetName()), VarManager::fgValues);
+                fHistMan->FillHistClass(fAmbiTrackCutHistHandles[i], VarManager::fgValues);
               }
             }
             (reinterpret_cast<TH1I*>(fStatsList->At(1)))->Fill(static_cast<float>(i));
@@ -521,9 +569,10 @@ struct TableMaker {
         idxPrev = muon.index();
 
         // check the cuts and filters
+        uint64_t cutDecisions = fMuonCutsCompiled.Evaluate(VarManager::fgValues);
         int i = 0;
         for (auto cut = fMuonCuts.begin(); cut != fMuonCuts.end(); cut++, i++) {
-          if ((*cut).IsSelected(VarManager::fgValues))
+          if (cutDecisions & (uint64_t(1) << i))
             trackTempFilterMap |= (uint8_t(1) << i);
         }
 
@@ -538,13 +587,7 @@ struct TableMaker {
       for (auto& muon : tracksMuon) {
         if constexpr ((TMuonFillMap & VarManager::ObjTypes::AmbiMuon) > 0) {
           if (fIsAmbiguous) {
-            isAmbiguous = 0;
-            for (auto& ambiTrackFwd : ambiTracksFwd) {
-              if (ambiTrackFwd.fwdtrackId() == muon.globalIndex()) {
-                isAmbiguous = 1;
-                break;
-              }
-            }
+            isAmbiguous = (muon.globalIndex() < static_cast<int64_t>(fAmbiguousTracksFwd.size()) && fAmbiguousTracksFwd[muon.globalIndex()]);
           }
         }
         trackFilteringTag = uint64_t(0);
@@ -558,14 +601,15 @@ struct TableMaker {
           }
         }
         // apply the muon selection cuts and fill the stats histogram
+        uint64_t cutDecisions = fMuonCutsCompiled.Evaluate(VarManager::fgValues);
         int i = 0;
         for (auto cut = fMuonCuts.begin(); cut != fMuonCuts.end(); cut++, i++) {
-          if ((*cut).IsSelected(VarManager::fgValues)) {
+          if (cutDecisions & (uint64_t(1) << i)) {
             trackTempFilterMap |= (uint8_t(1) << i);
             if (fConfigQA) {
-              fHistMan->FillHistClass(Form("Muons_%s", (*cut).GetName()), VarManager::fgValues);
+              fHistMan->FillHistClass(fMuonCutHistHandles[i], VarManager::fgValues);
               if (fIsAmbiguous && isAmbiguous == 1) {
-                fHistMan->FillHistClass(Form("Ambiguous_Muons_%s", (*cut).GetName()), VarManager::fgValues);
+                fHistMan->FillHistClass(fAmbiMuonCutHistHandles[i], VarManager::fgValues);
               }
             }
             (reinterpret_cast<TH1I*>(fStatsList->At(2)))->Fill(static_cast<float>(i));
@@ -722,14 +766,15 @@ struct TableMaker {
         }
 
         // apply track cuts and fill stats histogram
+        uint64_t cutDecisions = fTrackCutsCompiled.Evaluate(VarManager::fgValues);
         int i = 0;
         for (auto cut = fTrackCuts.begin(); cut != fTrackCuts.end(); cut++, i++) {
-          if ((*cut).IsSelected(VarManager::fgValues)) {
+          if (cutDecisions & (uint64_t(1) << i)) {
             trackTempFilterMap |= (uint8_t(1) << i);
             if (fConfigQA) {
-              fHistMan->FillHistClass(Form("TrackBarrel_%s", (*cut).GetName()), VarManager::fgValues);
+              fHistMan->FillHistClass(fTrackCutHistHandles[i], VarManager::fgValues);
               if (fIsAmbiguous && isAmbiguous == 1) {
-                fHistMan->FillHistClass(Form("Ambiguous_TrackBarrel_%s", (*cut).GetName()), VarManager::fgValues);
+                fHistMan->FillHistClass(fAmbiTrackCutHistHandles[i], VarManager::fgValues);
               }
             }
             (reinterpret_cast<TH1I*>(fStatsList->At(1)))->Fill(static_cast<float>(i));
@@ -828,9 +873,10 @@ struct TableMaker {
         idxPrev = muon.index();
 
         // check the cuts and filters
+        uint64_t cutDecisions = fMuonCutsCompiled.Evaluate(VarManager::fgValues);
         int i = 0;
         for (auto cut = fMuonCuts.begin(); cut != fMuonCuts.end(); cut++, i++) {
-          if ((*cut).IsSelected(VarManager::fgValues))
+          if (cutDecisions & (uint64_t(1) << i))
             trackTempFilterMap |= (uint8_t(1) << i);
         }
 
@@ -860,14 +906,15 @@ struct TableMaker {
           }
         }
         // apply the muon selection cuts and fill the stats histogram
+        uint64_t cutDecisions = fMuonCutsCompiled.Evaluate(VarManager::fgValues);
         int i = 0;
         for (auto cut = fMuonCuts.begin(); cut != fMuonCuts.end(); cut++, i++) {
-          if ((*cut).IsSelected(VarManager::fgValues)) {
+          if (cutDecisions & (uint64_t(1) << i)) {
             trackTempFilterMap |= (uint8_t(1) << i);
             if (fConfigQA) {
-              fHistMan->FillHistClass(Form("Muons_%s", (*cut).GetName()), VarManager::fgValues);
+              fHistMan->FillHistClass(fMuonCutHistHandles[i], VarManager::fgValues);
               if (fIsAmbiguous && isAmbiguous == 1) {
-                fHistMan->FillHistClass(Form("Ambiguous_Muons_%s", (*cut).GetName()), VarManager::fgValues);
+                fHistMan->FillHistClass(fAmbiMuonCutHistHandles[i], VarManager::fgValues);
               }
             }
             (reinterpret_cast<TH1I*>(fStatsList->At(2)))->Fill(static_cast<float>(i));
@@ -1201,6 +1248,7 @@ struct TableMaker {
   void processAmbiguousMuonOnly(MyEvents const& collisions, aod::BCsWithTimestamps const& bcs,
                                 soa::Filtered<MyMuons> const& tracksMuon, aod::AmbiguousTracksFwd const& ambiTracksFwd)
   {
+    fillAmbiguousFlags(ambiTracksFwd, fAmbiguousTracksFwd);
     // Process orphan tracks
     if (fDoDetailedQA && fIsAmbiguous) {
       for (auto& ambiTrackFwd : ambiTracksFwd) {
@@ -1224,6 +1272,7 @@ struct TableMaker {
   void processAmbiguousMuonOnlyWithCov(MyEvents const& collisions, aod::BCsWithTimestamps const& bcs,
                                        soa::Filtered<MyMuonsWithCov> const& tracksMuon, aod::AmbiguousTracksFwd const& ambiTracksFwd)
   {
+    fillAmbiguousFlags(ambiTracksFwd, fAmbiguousTracksFwd);
     // Process orphan tracks
     if (fDoDetailedQA && fIsAmbiguous) {
       for (auto& ambiTrackFwd : ambiTracksFwd) {
@@ -1248,6 +1297,7 @@ struct TableMaker {
   void processAmbiguousBarrelOnly(MyEvents const& collisions, aod::BCsWithTimestamps const& bcs,
                                   soa::Filtered<MyBarrelTracks> const& tracksBarrel, aod::AmbiguousTracksMid const& ambiTracksMid)
   {
+    fillAmbiguousFlags(ambiTracksMid, fAmbiguousTracksMid);
     // Process orphan tracks
     if (fDoDetailedQA && fIsAmbiguous) {
       for (auto& ambiTrack : ambiTracksMid) {
@@ -15,10 +15,14 @@
 #include <vector>
 #include <algorithm>
 #include <TH1F.h>
+#include <TH2D.h>
 #include <TH3F.h>
 #include <THashList.h>
 #include <TList.h>
 #include <TString.h>
+#include <deque>
+#include <map>
+#include <array>
 #include "CCDB/BasicCCDBManager.h"
 #include "DataFormatsParameters/GRPObject.h"
 #include "Framework/runDataProcessing.h"
@@ -487,7 +491,73 @@ struct AnalysisPrefilterSelection {
   PROCESS_SWITCH(AnalysisPrefilterSelection, processDummy, "Do nothing", false);
 };
 
+// Compacted track or muon kept in the event mixing pools, with only the quantities needed for the mixed-event pairing
+struct MixingPoolTrack {
+  float fPt;
+  float fEta;
+  float fPhi;
+  int fSign;
+  uint32_t fFilterMap;
+
+  float pt() const { return fPt; }
+  float eta() const { return fEta; }
+  float phi() const { return fPhi; }
+  int sign() const { return fSign; }
+  uint32_t isBarrelSelected() const { return fFilterMap; }
+  uint32_t isMuonSelected() const { return fFilterMap; }
+};
+
+struct MixingPoolEvent {
+  std::vector<MixingPoolTrack> fTracks; // barrel tracks, or muons in the muon-muon pools
+  std::vector<MixingPoolTrack> fMuons;  // muons, used only for the barrel-muon mixing
+};
+
+// Ring buffers of events, one per mixing category, which are kept across dataframes
+class MixingPool
+{
+ public:
+  void SetDepth(int depth) { fDepth = depth; }
+  const std::deque<MixingPoolEvent>& GetEvents(int category) { return fPools[category]; }
+  void Add(int category, MixingPoolEvent&& event)
+  {
+    auto& pool = fPools[category];
+    fMemory += GetMemory(event);
+    fNEvents++;
+    pool.push_back(std::move(event));
+    while (static_cast<int>(pool.size()) > fDepth) {
+      fMemory -= GetMemory(pool.front());
+      fNEvents--;
+      pool.pop_front();
+    }
+  }
+  size_t GetNEvents() const { return fNEvents; }
+  size_t GetMemory() const { return fMemory; }
+  int GetNCategories() const { return fPools.size(); }
+
+ private:
+  static size_t GetMemory(const MixingPoolEvent& event)
+  {
+    return sizeof(MixingPoolEvent) + (event.fTracks.capacity() + event.fMuons.capacity()) * sizeof(MixingPoolTrack);
+  }
+
+  std::map<int, std::deque<MixingPoolEvent>> fPools;
+  int fDepth = 0;
+  size_t fNEvents = 0;
+  size_t fMemory = 0; // bytes used by the stored events
+};
+
 struct AnalysisEventMixing {
+  // One pool per mixing process, so that the processes never mix the events or the tracks of each other
+  enum MixingPools {
+    kPoolBarrel = 0,
+    kPoolMuon,
+    kPoolBarrelMuon,
+    kPoolBarrelVn,
+    kPoolMuonVn,
+    kNMixingPools
+  };
+  static constexpr const char* fgMixingPoolNames[kNMixingPools] = {"Barrel", "Muon", "BarrelMuon", "BarrelVn", "MuonVn"};
+
   OutputObj<THashList> fOutputList{"output"};
   // Here one should provide the list of electron and muon candidate cuts in the same order as specified in the above
   // single particle selection tasks to preserve the correspondence between the track cut name and its
@@ -496,6 +566,8 @@ struct AnalysisEventMixing {
   Configurable<string> fConfigTrackCuts{"cfgTrackCuts", "", "Comma separated list of barrel track cuts"};
   Configurable<string> fConfigMuonCuts{"cfgMuonCuts", "", "Comma separated list of muon cuts"};
   Configurable<int> fConfigMixingDepth{"cfgMixingDepth", 100, "Number of Events stored for event mixing"};
+  Configurable<int> fConfigMixingPoolDepth{"cfgMixingPoolDepth", 0, "Number of events per mixing category kept across dataframes (0: mix only within the dataframe)"};
+  OutputObj<TH2D> fMixingPoolStats{"MixingPoolStats"};
   Configurable<std::string> fConfigAddEventMixingHistogram{"cfgAddEventMixingHistogram", "", "Comma separated list of histograms"};
 
   Filter filterEventSelected = aod::dqanalysisflags::isEventSelected == 1;
@@ -511,6 +583,7 @@ struct AnalysisEventMixing {
   std::vector<std::vector<TString>> fTrackMuonHistNames;
 
   NoBinningPolicy<aod::dqanalysisflags::MixingHash> hashBin;
+  std::array<MixingPool, kNMixingPools> fMixingPools;
 
   void init(o2::framework::InitContext& context)
   {
@@ -575,6 +648,49 @@ struct AnalysisEventMixing {
     DefineHistograms(fHistMan, histNames.Data(), fConfigAddEventMixingHistogram); // define all histograms
     VarManager::SetUseVars(fHistMan->GetUsedVars());                              // provide the list of required variables so that VarManager knows what to fill
     fOutputList.setObject(fHistMan->GetMainHistogramList());
+
+    for (auto& pool : fMixingPools) {
+      pool.SetDepth(fConfigMixingPoolDepth.value);
+    }
+    fMixingPoolStats.setObject(new TH2D("MixingPoolStats", "Event mixing pools", 4, 0.5, 4.5, kNMixingPools, -0.5, kNMixingPools - 0.5));
+    fMixingPoolStats->GetXaxis()->SetBinLabel(1, "Categories");
+    fMixingPoolStats->GetXaxis()->SetBinLabel(2, "Events");
+    fMixingPoolStats->GetXaxis()->SetBinLabel(3, "Memory (kB)");
+    fMixingPoolStats->GetXaxis()->SetBinLabel(4, "Max memory (kB)");
+    for (int iPool = 0; iPool < kNMixingPools; iPool++) {
+      fMixingPoolStats->GetYaxis()->SetBinLabel(iPool + 1, fgMixingPoolNames[iPool]);
+    }
+  }
+
+  // Copy the selected tracks or muons of an event into the compacted form used in the mixing pool
+  template <bool TMuons, typename TTracks>
+  void compactTracks(TTracks const& tracks, uint32_t filterMask, std::vector<MixingPoolTrack>& compacted)
+  {
+    compacted.reserve(tracks.size());
+    for (auto& track : tracks) {
+      uint32_t filterMap = 0;
+      if constexpr (TMuons) {
+        filterMap = uint32_t(track.isMuonSelected()) & filterMask;
+      } else {
+        filterMap = uint32_t(track.isBarrelSelected()) & filterMask;
+      }
+      if (filterMap) {
+        compacted.push_back({track.pt(), track.eta(), track.phi(), track.sign(), filterMap});
+      }
+    }
+    compacted.shrink_to_fit();
+  }
+
+  void updateMixingPoolStats(int iPool)
+  {
+    const auto& pool = fMixingPools[iPool];
+    double memory = pool.GetMemory() / 1024.0;
+    fMixingPoolStats->SetBinContent(1, iPool + 1, pool.GetNCategories());
+    fMixingPoolStats->SetBinContent(2, iPool + 1, pool.GetNEvents());
+    fMixingPoolStats->SetBinContent(3, iPool + 1, memory);
+    if (memory > fMixingPoolStats->GetBinContent(4, iPool + 1)) {
+      fMixingPoolStats->SetBinContent(4, iPool + 1, memory);
+    }
   }
 
   template <int TPairType, typename TTracks1, typename TTracks2>
@@ -634,9 +750,14 @@ struct AnalysisEventMixing {
 
   // barrel-barrel and muon-muon event mixing
   template <int TPairType, uint32_t TEventFillMap, typename TEvents, typename TTracks>
-  void runSameSide(TEvents& events, TTracks const& tracks, Preslice<TTracks>& preSlice)
+  void runSameSide(TEvents& events, TTracks const& tracks, Preslice<TTracks>& preSlice, int iPool)
   {
     events.bindExternalIndices(&tracks);
+    if (fConfigMixingPoolDepth.value > 0) {
+      runSameSidePool<TPairType, TEventFillMap>(events, tracks, preSlice, fMixingPools[iPool]);
+      updateMixingPoolStats(iPool);
+      return;
+    }
     int mixingDepth = fConfigMixingDepth.value;
     for (auto& [event1, event2] : selfCombinations(hashBin, mixingDepth, -1, events, events)) {
       VarManager::ResetValues(0, VarManager::kNVars);
@@ -652,11 +773,64 @@ struct AnalysisEventMixing {
     } // end event loop
   }
 
+  // barrel-barrel and muon-muon event mixing using the pool of events kept across dataframes
+  // Each event is paired with the events already in the pool for its category, and is then added to the pool
+  template <int TPairType, uint32_t TEventFillMap, typename TEvents, typename TTracks>
+  void runSameSidePool(TEvents& events, TTracks const& tracks, Preslice<TTracks>& preSlice, MixingPool& pool)
+  {
+    for (auto& event : events) {
+      MixingPoolEvent poolEvent;
+      auto eventTracks = tracks.sliceBy(preSlice, event.globalIndex());
+      if constexpr (TPairType == pairTypeMuMu) {
+        compactTracks<true>(eventTracks, fTwoMuonFilterMask, poolEvent.fTracks);
+      } else {
+        compactTracks<false>(eventTracks, fTwoTrackFilterMask, poolEvent.fTracks);
+      }
+      if (poolEvent.fTracks.empty()) {
+        continue;
+      }
+      VarManager::ResetValues(0, VarManager::kNVars);
+      VarManager::FillEvent<TEventFillMap>(event, VarManager::fgValues);
+      for (auto& pooledEvent : pool.GetEvents(event.mixingHash())) {
+        runMixedPairing<TPairType>(pooledEvent.fTracks, poolEvent.fTracks);
+      }
+      pool.Add(event.mixingHash(), std::move(poolEvent));
+    }
+  }
+
+  // barrel-muon event mixing using the pool of events kept across dataframes
+  // The barrel tracks of the pooled events are paired with the muons of the current event
+  template <uint32_t TEventFillMap, typename TEvents, typename TTracks, typename TMuons>
+  void runBarrelMuonPool(TEvents& events, TTracks const& tracks, TMuons const& muons, MixingPool& pool)
+  {
+    for (auto& event : events) {
+      MixingPoolEvent poolEvent;
+      auto eventTracks = tracks.sliceBy(perEventsSelectedT, event.globalIndex());
+      auto eventMuons = muons.sliceBy(perEventsSelectedM, event.globalIndex());
+      compactTracks<false>(eventTracks, fTwoTrackFilterMask, poolEvent.fTracks);
+      compactTracks<true>(eventMuons, fTwoMuonFilterMask, poolEvent.fMuons);
+      if (poolEvent.fTracks.empty() && poolEvent.fMuons.empty()) {
+        continue;
+      }
+      VarManager::ResetValues(0, VarManager::kNVars);
+      VarManager::FillEvent<TEventFillMap>(event, VarManager::fgValues);
+      for (auto& pooledEvent : pool.GetEvents(event.mixingHash())) {
+        runMixedPairing<pairTypeEMu>(pooledEvent.fTracks, poolEvent.fMuons);
+      }
+      pool.Add(event.mixingHash(), std::move(poolEvent));
+    }
+  }
+
   // barrel-muon event mixing
   template <uint32_t TEventFillMap, typename TEvents, typename TTracks, typename TMuons>
   void runBarrelMuon(TEvents& events, TTracks const& tracks, TMuons const& muons)
   {
     events.bindExternalIndices(&muons);
+    if (fConfigMixingPoolDepth.value > 0) {
+      runBarrelMuonPool<TEventFillMap>(events, tracks, muons, fMixingPools[kPoolBarrelMuon]);
+      updateMixingPoolStats(kPoolBarrelMuon);
+      return;
+    }
 
     for (auto& [event1, event2] : selfCombinations(hashBin, 100, -1, events, events)) {
       VarManager::ResetValues(0, VarManager::kNVars);
@@ -677,11 +851,11 @@ struct AnalysisEventMixing {
 
   void processBarrelSkimmed(soa::Filtered<MyEventsHashSelected>& events, soa::Filtered<MyBarrelTracksSelected> const& tracks)
   {
-    runSameSide<pairTypeEE, gkEventFillMap>(events, tracks, perEventsSelectedT);
+    runSameSide<pairTypeEE, gkEventFillMap>(events, tracks, perEventsSelectedT, kPoolBarrel);
   }
   void processMuonSkimmed(soa::Filtered<MyEventsHashSelected>& events, soa::Filtered<MyMuonTracksSelected> const& muons)
   {
-    runSameSide<pairTypeMuMu, gkEventFillMap>(events, muons, perEventsSelectedM);
+    runSameSide<pairTypeMuMu, gkEventFillMap>(events, muons, perEventsSelectedM, kPoolMuon);
   }
   void processBarrelMuonSkimmed(soa::Filtered<MyEventsHashSelected>& events, soa::Filtered<MyBarrelTracksSelected> const& tracks, soa::Filtered<MyMuonTracksSelected> const& muons)
   {
@@ -689,11 +863,11 @@ struct AnalysisEventMixing {
   }
   void processBarrelVnSkimmed(soa::Filtered<MyEventsHashSelectedQvector>& events, soa::Filtered<MyBarrelTracksSelected> const& tracks)
   {
-    runSameSide<pairTypeEE, gkEventFillMapWithQvector>(events, tracks, perEventsSelectedT);
+    runSameSide<pairTypeEE, gkEventFillMapWithQvector>(events, tracks, perEventsSelectedT, kPoolBarrelVn);
   }
   void processMuonVnSkimmed(soa::Filtered<MyEventsHashSelectedQvector>& events, soa::Filtered<MyMuonTracksSelected> const& muons)
   {
-    runSameSide<pairTypeMuMu, gkEventFillMapWithQvector>(events, muons, perEventsSelectedM);
+    runSameSide<pairTypeMuMu, gkEventFillMapWithQvector>(events, muons, perEventsSelectedM, kPoolMuonVn);
   }
   // TODO: This is a dummy process function for the case when the user does not want to run any of the process functions (no event mixing)
   //    If there is no process function enabled, the workflow hangs
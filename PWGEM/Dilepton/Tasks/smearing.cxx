@@ -15,8 +15,13 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <TMath.h>
 #include <TH1D.h>
+#include <TH2D.h>
+#include <TAxis.h>
 #include <TString.h>
 #include <TGrid.h>
 #include <TObjArray.h>
@@ -39,6 +44,140 @@ using namespace o2::framework;
 using namespace o2::framework::expressions;
 using namespace o2::aod;
 
+// Walker alias table of a resolution histogram, to draw from it in constant time.
+// As in TH1::GetRandom(), the value is uniformly distributed within the selected bin.
+struct AliasSampler {
+  std::vector<float> fProb;
+  std::vector<int> fAlias;
+  std::vector<double> fLowEdge;
+  std::vector<double> fWidth;
+
+  bool empty() const { return fProb.empty(); }
+
+  void build(TH1D const* hist)
+  {
+    fProb.clear();
+    fAlias.clear();
+    fLowEdge.clear();
+    fWidth.clear();
+    if (!hist || hist->GetEntries() <= 0) {
+      return;
+    }
+    int nbins = hist->GetNbinsX();
+    std::vector<double> weights(nbins);
+    double total = 0.;
+    for (int i = 0; i < nbins; i++) {
+      weights[i] = std::max(0., hist->GetBinContent(i + 1));
+      total += weights[i];
+    }
+    if (total <= 0.) {
+      return;
+    }
+    fProb.resize(nbins);
+    fAlias.resize(nbins);
+    fLowEdge.resize(nbins);
+    fWidth.resize(nbins);
+    std::vector<int> small, large;
+    for (int i = 0; i < nbins; i++) {
+      fLowEdge[i] = hist->GetXaxis()->GetBinLowEdge(i + 1);
+      fWidth[i] = hist->GetXaxis()->GetBinWidth(i + 1);
+      weights[i] *= nbins / total;
+      fAlias[i] = i;
+      (weights[i] < 1. ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+      int s = small.back();
+      small.pop_back();
+      int l = large.back();
+      fProb[s] = weights[s];
+      fAlias[s] = l;
+      weights[l] -= 1. - weights[s];
+      if (weights[l] < 1.) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // the remaining columns are full (up to rounding)
+    for (auto i : small) {
+      fProb[i] = 1.;
+    }
+    for (auto i : large) {
+      fProb[i] = 1.;
+    }
+  }
+
+  // u1 selects the column and decides between the bin and its alias, u2 gives the position within the bin
+  double sample(double u1, double u2) const
+  {
+    int n = fProb.size();
+    double x = u1 * n;
+    int column = std::min(static_cast<int>(x), n - 1);
+    int bin = (x - column < fProb[column]) ? column : fAlias[column];
+    return fLowEdge[bin] + fWidth[bin] * u2;
+  }
+};
+
+// Resolution map: the pt binning and one alias table per pt slice
+struct ResolutionMap {
+  TAxis fAxis;
+  std::vector<AliasSampler> fSlices; // index 0 is unused, as in the resolution arrays
+  int fLast = 0;
+
+  void build(TObjArray* arr)
+  {
+    fSlices.clear();
+    fLast = 0;
+    if (!arr) {
+      return;
+    }
+    fAxis = *(reinterpret_cast<TH2D*>(arr->At(0))->GetXaxis());
+    fLast = arr->GetLast();
+    fSlices.resize(fLast + 1);
+    for (int i = 1; i <= fLast; i++) {
+      fSlices[i].build(reinterpret_cast<TH1D*>(arr->At(i)));
+    }
+  }
+
+  int findSlice(float pt) const // 0 if the map is not available
+  {
+    if (fLast < 1) {
+      return 0;
+    }
+    int bin = fAxis.FindFixBin(pt);
+    return std::clamp(bin, 1, fLast);
+  }
+};
+
+// Counter-based random numbers: the values depend only on the seed and the counters,
+// so the smearing of a particle does not depend on the processing order
+static uint64_t splitMix64(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static double uniformFromCounter(uint64_t key, uint64_t counter)
+{
+  return (splitMix64(key ^ splitMix64(counter)) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t floatBits(float x)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+// Key of the random numbers of a particle, from the seed and the generated kinematics and PDG code of the particle only,
+// so that it does not depend on the DF, on the row of the particle in it or on the job which processes it
+static uint64_t particleKey(uint64_t seed, float pt, float eta, float phi, int pdgCode)
+{
+  uint64_t key = splitMix64(seed ^ splitMix64((floatBits(pt) << 32) | floatBits(eta)));
+  return splitMix64(key ^ splitMix64((floatBits(phi) << 32) | static_cast<uint32_t>(pdgCode)));
+}
+
 struct ApplySmearing {
   Produces<aod::SmearedTracks> smearedtrack;
 
@@ -50,11 +189,12 @@ struct ApplySmearing {
   Configurable<std::string> fConfigResEtaHistName{"cfgResEtaHistName", "EtaResArr", "histogram name for eta in resolution file"};
   Configurable<std::string> fConfigResPhiPosHistName{"cfgResPhiPosHistName", "PhiPosResArr", "histogram name for phi pos in resolution file"};
   Configurable<std::string> fConfigResPhiNegHistName{"cfgResPhiNegHistName", "PhiEleResArr", "hisogram for phi neg in resolution file"};
+  Configurable<int> fConfigSeed{"cfgSeed", 0, "seed of the random numbers used for the smearing"};
 
-  TObjArray* fArrResoPt;
-  TObjArray* fArrResoEta;
-  TObjArray* fArrResoPhi_Pos;
-  TObjArray* fArrResoPhi_Neg;
+  ResolutionMap fResoPt;
+  ResolutionMap fResoEta;
+  ResolutionMap fResoPhi_Pos;
+  ResolutionMap fResoPhi_Neg;
 
   void init(InitContext& context)
   {
@@ -98,13 +238,27 @@ struct ApplySmearing {
       LOGP(error, "Could not open {} from file {}", TString(fConfigResPhiNegHistName), TString(fConfigResFileName));
     }
 
-    fArrResoPt = ArrResoPt;
-    fArrResoEta = ArrResoEta;
-    fArrResoPhi_Pos = ArrResoPhi_Pos;
-    fArrResoPhi_Neg = ArrResoPhi_Neg;
+    // precompute the alias tables of all the resolution slices
+    fResoPt.build(ArrResoPt);
+    fResoEta.build(ArrResoEta);
+    fResoPhi_Pos.build(ArrResoPhi_Pos);
+    fResoPhi_Neg.build(ArrResoPhi_Neg);
     fFile->Close();
   }
 
+  // draw from the slice of a resolution map; the counters 2*draw and 2*draw+1 of the particle key are used
+  double drawSmearing(ResolutionMap const& map, int slice, uint64_t key, int draw)
+  {
+    if (slice < 1 || slice >= static_cast<int>(map.fSlices.size())) {
+      return 0.;
+    }
+    AliasSampler const& sampler = map.fSlices[slice];
+    if (sampler.empty()) {
+      return 0.;
+    }
+    return sampler.sample(uniformFromCounter(key, 2 * draw), uniformFromCounter(key, 2 * draw + 1));
+  }
+
   template <typename TTracksMC>
   void applySmearing(TTracksMC const& tracksMC)
   {
@@ -115,53 +269,23 @@ struct ApplySmearing {
 
       if (abs(mctrack.pdgCode()) == fPdgCode) {
         // apply smearing for electrons or muons.
+        // The random numbers are keyed on the seed and on the generated particle itself.
+        uint64_t key = particleKey(fConfigSeed.value, ptgen, etagen, phigen, mctrack.pdgCode());
 
         // smear pt
-        int ptbin = reinterpret_cast<TH2D*>(fArrResoPt->At(0))->GetXaxis()->FindBin(ptgen);
-        if (ptbin < 1) {
-          ptbin = 1;
-        }
-        if (ptbin > fArrResoPt->GetLast()) {
-          ptbin = fArrResoPt->GetLast();
-        }
-        float smearing = 0.;
-        TH1D* thisHist = reinterpret_cast<TH1D*>(fArrResoPt->At(ptbin));
-        if (thisHist->GetEntries() > 0) {
-          smearing = thisHist->GetRandom() * ptgen;
-        }
+        float smearing = drawSmearing(fResoPt, fResoPt.findSlice(ptgen), key, 0) * ptgen;
         float ptsmeared = ptgen - smearing;
 
         // smear eta
-        ptbin = reinterpret_cast<TH2D*>(fArrResoEta->At(0))->GetXaxis()->FindBin(ptgen);
-        if (ptbin < 1) {
-          ptbin = 1;
-        }
-        if (ptbin > fArrResoEta->GetLast()) {
-          ptbin = fArrResoEta->GetLast();
-        }
-        smearing = 0.;
-        thisHist = reinterpret_cast<TH1D*>(fArrResoEta->At(ptbin));
-        if (thisHist->GetEntries() > 0) {
-          smearing = thisHist->GetRandom();
-        }
+        smearing = drawSmearing(fResoEta, fResoEta.findSlice(ptgen), key, 1);
         float etasmeared = etagen - smearing;
 
         // smear phi
-        ptbin = reinterpret_cast<TH2D*>(fArrResoPhi_Pos->At(0))->GetXaxis()->FindBin(ptgen);
-        if (ptbin < 1) {
-          ptbin = 1;
-        }
-        if (ptbin > fArrResoPhi_Pos->GetLast()) {
-          ptbin = fArrResoPhi_Pos->GetLast();
-        }
-        smearing = 0.;
+        int ptbin = fResoPhi_Pos.findSlice(ptgen);
         if (mctrack.pdgCode() < 0) { // positron: -11
-          thisHist = reinterpret_cast<TH1D*>(fArrResoPhi_Pos->At(ptbin));
-        } else if (mctrack.pdgCode() > 0) { // electron: 11
-          thisHist = reinterpret_cast<TH1D*>(fArrResoPhi_Neg->At(ptbin));
-        }
-        if (thisHist->GetEntries() > 0) {
-          smearing = thisHist->GetRandom();
+          smearing = drawSmearing(fResoPhi_Pos, ptbin, key, 2);
+        } else { // electron: 11
+          smearing = drawSmearing(fResoPhi_Neg, ptbin, key, 2);
         }
         float phismeared = phigen - smearing;
 
@@ -14,7 +14,14 @@
 // This code produces photon data tables.
 //    Please write to: daiki.sekihata@cern.ch
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "Framework/runDataProcessing.h"
 #include "Framework/AnalysisTask.h"
 #include "Framework/AnalysisDataModel.h"
@@ -82,12 +89,39 @@ struct createPCM {
   Configurable<float> max_tpcdEdx{"max_tpcdEdx", 110.0, "max TPC dE/dx"};
   Configurable<bool> useTPConly{"useTPConly", false, "Use truly TPC only tracks for V0 finder"};
   Configurable<bool> rejectTPConly{"rejectTPConly", false, "Reject truly TPC only tracks for V0 finder"};
+  Configurable<bool> usePreFilter{"usePreFilter", false, "apply a geometric pre-selection of the pairs before the DCA fit"};
+  Configurable<float> preMaxDistXY{"preMaxDistXY", 10.0, "pre-filter: max distance between the helices of the legs in the transverse plane (cm)"};
+  Configurable<float> preRadiusMargin{"preRadiusMargin", 5.0, "pre-filter: margin on the V0 radius window for the approximate conversion point (cm)"};
+  Configurable<int> nThreads{"nThreads", 1, "Number of threads used for the DCA fits (1: no additional threads), only with useMatCorrType = 0"};
 
   int mRunNumber;
   float d_bz;
   Service<o2::ccdb::BasicCCDBManager> ccdb;
   o2::base::MatLayerCylSet* lut = nullptr;
-  o2::vertexing::DCAFitterN<2> fitter;
+  std::vector<o2::vertexing::DCAFitterN<2>> fitters; // one fitter per thread
+
+  // pair of legs which passed the track selection and the pre-filter, to be fitted
+  struct V0Candidate {
+    int64_t collisionId;
+    array<float, 3> pVtx;
+    int64_t posId;
+    int64_t eleId;
+    float posDcaXY;
+    float eleDcaXY;
+    o2::track::TrackParCov pTrack;
+    o2::track::TrackParCov nTrack;
+  };
+  struct V0FitResult {
+    bool accepted = false;
+    float xPos = 0.f;
+    float xEle = 0.f;
+    array<float, 3> svpos = {0.};
+    array<float, 3> pvec0 = {0.};
+    array<float, 3> pvec1 = {0.};
+    float v0dca = 0.f;
+  };
+  std::vector<V0Candidate> candidates;
+  std::vector<V0FitResult> results;
 
   void init(InitContext& context)
   {
@@ -110,22 +144,31 @@ struct createPCM {
       lut = o2::base::MatLayerCylSet::rectifyPtrFromFile(ccdb->get<o2::base::MatLayerCylSet>(lutPath));
     }
 
-    fitter.setPropagateToPCA(true);
-    fitter.setMaxR(200.);
-    fitter.setMinParamChange(1e-3);
-    fitter.setMinRelChi2Change(0.9);
-    fitter.setMaxDZIni(1e9);
-    fitter.setMaxChi2(1e9);
-    fitter.setUseAbsDCA(d_UseAbsDCA);
-    fitter.setWeightedFinalPCA(d_UseWeightedPCA);
-
     // Material correction in the DCA fitter
     o2::base::Propagator::MatCorrType matCorr = o2::base::Propagator::MatCorrType::USEMatCorrNONE;
     if (useMatCorrType == 1)
       matCorr = o2::base::Propagator::MatCorrType::USEMatCorrTGeo;
     if (useMatCorrType == 2)
       matCorr = o2::base::Propagator::MatCorrType::USEMatCorrLUT;
-    fitter.setMatCorrType(matCorr);
+
+    // With material corrections the fitters go through the shared Propagator (TGeo or LUT), which is not thread-safe
+    int nFitters = std::max(1, nThreads.value);
+    if (useMatCorrType != 0 && nFitters > 1) {
+      LOGF(warning, "nThreads = %d requested with material corrections (useMatCorrType = %d), the DCA fits run on one thread", nFitters, useMatCorrType.value);
+      nFitters = 1;
+    }
+    fitters.resize(nFitters);
+    for (auto& fitter : fitters) {
+      fitter.setPropagateToPCA(true);
+      fitter.setMaxR(200.);
+      fitter.setMinParamChange(1e-3);
+      fitter.setMinRelChi2Change(0.9);
+      fitter.setMaxDZIni(1e9);
+      fitter.setMaxChi2(1e9);
+      fitter.setUseAbsDCA(d_UseAbsDCA);
+      fitter.setWeightedFinalPCA(d_UseWeightedPCA);
+      fitter.setMatCorrType(matCorr);
+    }
   }
 
   void initCCDB(aod::BCsWithTimestamps::iterator const& bc)
@@ -137,7 +180,9 @@ struct createPCM {
     // In case override, don't proceed, please - no CCDB access required
     if (d_bz_input > -990) {
       d_bz = d_bz_input;
-      fitter.setBz(d_bz);
+      for (auto& fitter : fitters) {
+        fitter.setBz(d_bz);
+      }
       o2::parameters::GRPMagField grpmag;
       if (fabs(d_bz) > 1e-5) {
         grpmag.setL3Current(30000.f / (d_bz / 5.0f));
@@ -167,7 +212,9 @@ struct createPCM {
     }
     mRunNumber = bc.runNumber();
     // Set magnetic field value once known
-    fitter.setBz(d_bz);
+    for (auto& fitter : fitters) {
+      fitter.setBz(d_bz);
+    }
 
     if (useMatCorrType == 2) {
       // setMatLUT only after magfield has been initalized
@@ -186,39 +233,104 @@ struct createPCM {
     }
   }
 
-  template <typename TCollision, typename TTrack>
-  void fillV0Table(TCollision const& collision, TTrack const& ele, TTrack const& pos)
+  // Cheap geometric pre-selection of a pair before the DCA fit, using the helices of the legs in the transverse plane.
+  // The circles must come closer than preMaxDistXY, and the approximate conversion point must lie in the V0 radius
+  // window and in the direction of the total momentum of the pair.
+  template <typename TCollision>
+  bool isPairCompatible(TCollision const& collision, o2::track::TrackParCov const& pTrack, o2::track::TrackParCov const& nTrack)
   {
-    array<float, 3> pVtx = {collision.posX(), collision.posY(), collision.posZ()};
-    array<float, 3> svpos = {0.}; // secondary vertex position
-    array<float, 3> pvec0 = {0.};
-    array<float, 3> pvec1 = {0.};
-
-    auto pTrack = getTrackParCov(pos); // positive
-    auto nTrack = getTrackParCov(ele); // negative
+    o2::math_utils::CircleXYf_t c0, c1;
+    float sna, csa;
+    pTrack.getCircleParams(d_bz, c0, sna, csa);
+    nTrack.getCircleParams(d_bz, c1, sna, csa);
+    float dx = c1.xC - c0.xC;
+    float dy = c1.yC - c0.yC;
+    float d = std::hypot(dx, dy);
+    if (d < 1e-4f) {
+      return true; // concentric circles, leave the decision to the fitter
+    }
+    float ux = dx / d;
+    float uy = dy / d;
+
+    // closest approach between the two circles, and the approximate conversion point(s)
+    float dist = 0.f;
+    int nPoints = 1;
+    array<float, 2> pointX, pointY;
+    if (d > c0.rC + c1.rC) { // separated circles
+      dist = d - c0.rC - c1.rC;
+      pointX[0] = c0.xC + ux * (c0.rC + 0.5f * dist);
+      pointY[0] = c0.yC + uy * (c0.rC + 0.5f * dist);
+    } else if (d < std::abs(c0.rC - c1.rC)) { // one circle inside the other
+      dist = std::abs(c0.rC - c1.rC) - d;
+      float sign = (c0.rC > c1.rC) ? 1.f : -1.f; // direction from the center of the larger circle to the smaller one
+      pointX[0] = 0.5f * (c0.xC + c1.xC + sign * ux * (c0.rC + c1.rC));
+      pointY[0] = 0.5f * (c0.yC + c1.yC + sign * uy * (c0.rC + c1.rC));
+    } else { // intersecting circles
+      float a = (c0.rC * c0.rC - c1.rC * c1.rC + d * d) / (2.f * d);
+      float h = std::sqrt(std::max(0.f, c0.rC * c0.rC - a * a));
+      nPoints = 2;
+      pointX[0] = c0.xC + a * ux - h * uy;
+      pointY[0] = c0.yC + a * uy + h * ux;
+      pointX[1] = c0.xC + a * ux + h * uy;
+      pointY[1] = c0.yC + a * uy - h * ux;
+    }
+    if (dist > preMaxDistXY) {
+      return false;
+    }
 
-    int nCand = fitter.process(pTrack, nTrack);
-    if (nCand != 0) {
-      fitter.propagateTracksToVertex();
-      const auto& vtx = fitter.getPCACandidate();
-      for (int i = 0; i < 3; i++) {
-        svpos[i] = vtx[i];
+    array<float, 3> p0, p1;
+    pTrack.getPxPyPzGlo(p0);
+    nTrack.getPxPyPzGlo(p1);
+    for (int i = 0; i < nPoints; i++) {
+      float radius = std::hypot(pointX[i], pointY[i]);
+      if (radius < v0Rmin - preRadiusMargin || v0Rmax + preRadiusMargin < radius) {
+        continue;
       }
-      fitter.getTrack(0).getPxPyPzGlo(pvec0); // positive
-      fitter.getTrack(1).getPxPyPzGlo(pvec1); // negative
-    } else {
+      // the legs must open toward the conversion point, as seen from the primary vertex
+      float fx = pointX[i] - collision.posX();
+      float fy = pointY[i] - collision.posY();
+      if (fx * (p0[0] + p1[0]) + fy * (p0[1] + p1[1]) < 0.f && std::hypot(fx, fy) > preRadiusMargin) {
+        continue;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  template <typename TCollision, typename TTrack>
+  void addCandidate(TCollision const& collision, TTrack const& ele, TTrack const& pos)
+  {
+    V0Candidate candidate{collision.globalIndex(), {collision.posX(), collision.posY(), collision.posZ()}, pos.globalIndex(), ele.globalIndex(), pos.dcaXY(), ele.dcaXY(), getTrackParCov(pos), getTrackParCov(ele)};
+    if (usePreFilter && !isPairCompatible(collision, candidate.pTrack, candidate.nTrack)) {
       return;
     }
+    candidates.emplace_back(std::move(candidate));
+  }
+
+  void fitCandidate(o2::vertexing::DCAFitterN<2>& fitter, V0Candidate& candidate, V0FitResult& result)
+  {
+    result.accepted = false;
+    int nCand = fitter.process(candidate.pTrack, candidate.nTrack);
+    if (nCand == 0) {
+      return;
+    }
+    fitter.propagateTracksToVertex();
+    const auto& vtx = fitter.getPCACandidate();
+    for (int i = 0; i < 3; i++) {
+      result.svpos[i] = vtx[i];
+    }
+    fitter.getTrack(0).getPxPyPzGlo(result.pvec0); // positive
+    fitter.getTrack(1).getPxPyPzGlo(result.pvec1); // negative
 
-    float px = pvec0[0] + pvec1[0];
-    float py = pvec0[1] + pvec1[1];
-    float pz = pvec0[2] + pvec1[2];
+    float px = result.pvec0[0] + result.pvec1[0];
+    float py = result.pvec0[1] + result.pvec1[1];
+    float pz = result.pvec0[2] + result.pvec1[2];
 
-    float v0dca = fitter.getChi2AtPCACandidate(); // distance between 2 legs.
-    float v0CosinePA = RecoDecay::cpa(pVtx, array{svpos[0], svpos[1], svpos[2]}, array{px, py, pz});
-    float v0radius = RecoDecay::sqrtSumOfSquares(svpos[0], svpos[1]);
+    result.v0dca = fitter.getChi2AtPCACandidate(); // distance between 2 legs.
+    float v0CosinePA = RecoDecay::cpa(candidate.pVtx, result.svpos, array{px, py, pz});
+    float v0radius = RecoDecay::sqrtSumOfSquares(result.svpos[0], result.svpos[1]);
 
-    if (v0dca > maxdcav0dau) {
+    if (result.v0dca > maxdcav0dau) {
       return;
     }
     if (v0radius < v0Rmin || v0Rmax < v0radius) {
@@ -227,13 +339,59 @@ struct createPCM {
     if (v0CosinePA < minv0cospa) {
       return;
     }
+    result.xPos = fitter.getTrack(0).getX();
+    result.xEle = fitter.getTrack(1).getX();
+    result.accepted = true;
+  }
 
-    v0data(pos.globalIndex(), ele.globalIndex(), collision.globalIndex(), -1,
-           fitter.getTrack(0).getX(), fitter.getTrack(1).getX(),
-           svpos[0], svpos[1], svpos[2],
-           pvec0[0], pvec0[1], pvec0[2],
-           pvec1[0], pvec1[1], pvec1[2],
-           v0dca, pos.dcaXY(), ele.dcaXY());
+  /// Fits the candidates of all the collisions of the DF, distributed over nThreads threads each with its own fitter,
+  /// and fills the V0 table in the order of the candidates.
+  /// The threads are started once per DF, so that their cost is shared by all the candidates of the DF.
+  void fitCandidates()
+  {
+    const size_t nCandidates = candidates.size();
+    results.resize(nCandidates);
+
+    constexpr size_t chunkSize = 64;
+    const size_t nChunks = (nCandidates + chunkSize - 1) / chunkSize;
+    std::atomic<size_t> nextChunk{0};
+    auto worker = [&](o2::vertexing::DCAFitterN<2>& fitter) {
+      for (size_t chunk = nextChunk++; chunk < nChunks; chunk = nextChunk++) {
+        const size_t last = std::min(nCandidates, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < last; i++) {
+          fitCandidate(fitter, candidates[i], results[i]);
+        }
+      }
+    };
+    const size_t nWorkers = std::min(fitters.size(), nChunks);
+    if (nWorkers <= 1) {
+      worker(fitters[0]);
+    } else {
+      std::vector<std::thread> threads;
+      threads.reserve(nWorkers - 1);
+      for (size_t iWorker = 1; iWorker < nWorkers; iWorker++) {
+        threads.emplace_back(worker, std::ref(fitters[iWorker]));
+      }
+      worker(fitters[0]);
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    }
+
+    for (size_t i = 0; i < nCandidates; i++) {
+      const auto& result = results[i];
+      if (!result.accepted) {
+        continue;
+      }
+      const auto& candidate = candidates[i];
+      v0data(candidate.posId, candidate.eleId, candidate.collisionId, -1,
+             result.xPos, result.xEle,
+             result.svpos[0], result.svpos[1], result.svpos[2],
+             result.pvec0[0], result.pvec0[1], result.pvec0[2],
+             result.pvec1[0], result.pvec1[1], result.pvec1[2],
+             result.v0dca, candidate.posDcaXY, candidate.eleDcaXY);
+    }
+    candidates.clear();
   }
 
   Filter trackFilter = o2::aod::track::x < maxX && o2::aod::track::pt > minpt&& nabs(o2::aod::track::eta) < maxeta&& dcamin < nabs(o2::aod::track::dcaXY) && nabs(o2::aod::track::dcaXY) < dcamax&& o2::aod::track::tpcChi2NCl < maxchi2tpc&& min_tpcdEdx < o2::aod::track::tpcSignal&& o2::aod::track::tpcSignal < max_tpcdEdx;
@@ -267,10 +425,11 @@ struct createPCM {
         if (rejectTPConly && (IsTPConlyTrack(ele) || IsTPConlyTrack(pos))) {
           continue;
         }
-        fillV0Table(collision, ele, pos);
+        addCandidate(collision, ele, pos);
       }
     } // end of collision loop
-  }   // end of process
+    fitCandidates();
+  } // end of process
   PROCESS_SWITCH(createPCM, processSA, "create V0s with stand-alone way", true);
 
   Preslice<aod::TrackAssoc> trackIndicesPerCollision = aod::track_association::collisionId;
@@ -325,13 +484,14 @@ struct createPCM {
         }
 
         if (ele.sign() < 0) {
-          fillV0Table(collision, ele, pos);
+          addCandidate(collision, ele, pos);
         } else {
-          fillV0Table(collision, pos, ele);
+          addCandidate(collision, pos, ele);
         }
       }
     } // end of collision loop
-  }   // end of process
+    fitCandidates();
+  } // end of process
   PROCESS_SWITCH(createPCM, processTrkCollAsso, "create V0s with track-to-collision associator", false);
 };
 
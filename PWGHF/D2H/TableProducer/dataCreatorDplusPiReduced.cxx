@@ -25,6 +25,7 @@
 #include "PWGHF/DataModel/CandidateSelectionTables.h"
 #include "PWGHF/D2H/DataModel/ReducedDataModel.h"
 #include "PWGHF/Utils/utilsBfieldCCDB.h"
+#include "PWGHF/Utils/utilsReducedDataCreation.h"
 
 using namespace o2;
 using namespace o2::aod;
@@ -82,7 +83,6 @@ struct HfDataCreatorDplusPiReduced {
   double massPi = RecoDecay::getMassPDG(kPiPlus);
   double massD = RecoDecay::getMassPDG(pdg::Code::kDMinus);
   double massB0 = RecoDecay::getMassPDG(pdg::Code::kB0);
-  double massDPi{0.};
   double invMassD{0.};
   double bz{0.};
 
@@ -91,6 +91,9 @@ struct HfDataCreatorDplusPiReduced {
   // Fitter to redo D-vertex to get extrapolated daughter tracks (3-prong vertex filter)
   o2::vertexing::DCAFitterN<3> df3;
 
+  // pions of the current collision passing the single-track selection
+  HfReducedBachelorBuffer pionBuffer;
+
   using TracksPIDWithSel = soa::Join<aod::BigTracksPIDExtended, aod::TrackSelection>;
   using CandsDFiltered = soa::Filtered<soa::Join<aod::HfCand3Prong, aod::HfSelDplusToPiKPi>>;
 
@@ -140,14 +143,12 @@ struct HfDataCreatorDplusPiReduced {
     runNumber = 0;
   }
 
-  /// Pion selection (D Pi <-- B0)
+  /// Pion selection (D Pi <-- B0), independent of the D candidate
+  /// The rejection of D daughters and of pions with the same sign as the D is done when pairing, see HfReducedBachelorBuffer::selectPairs
   /// \param trackPion is a track with the pion hypothesis
-  /// \param track0 is prong0 of selected D candidate
-  /// \param track1 is prong1 of selected D candidate
-  /// \param track2 is prong2 of selected D candidate
   /// \return true if trackPion passes all cuts
-  template <typename T1, typename T2>
-  bool isPionSelected(const T1& trackPion, const T2& track0, const T2& track1, const T2& track2)
+  template <typename T1>
+  bool isPionSelected(const T1& trackPion)
   {
     // check isGlobalTrackWoDCA status for pions if wanted
     if (usePionIsGlobalTrackWoDCA && !trackPion.isGlobalTrackWoDCA()) {
@@ -157,14 +158,6 @@ struct HfDataCreatorDplusPiReduced {
     if (trackPion.pt() < ptPionMin || !isSelectedTrackDCA(trackPion)) {
       return false;
     }
-    // reject pions that are D daughters
-    if (trackPion.globalIndex() == track0.globalIndex() || trackPion.globalIndex() == track1.globalIndex() || trackPion.globalIndex() == track2.globalIndex()) {
-      return false;
-    }
-    // reject pi D with same sign as D
-    if (trackPion.sign() * track0.sign() > 0) {
-      return false;
-    }
     return true;
   }
 
@@ -191,7 +184,7 @@ struct HfDataCreatorDplusPiReduced {
   void process(aod::Collisions const& collisions,
                CandsDFiltered const& candsD,
                aod::TrackAssoc const& trackIndices,
-               TracksPIDWithSel const&,
+               TracksPIDWithSel const& tracks,
                aod::BCsWithTimestamps const&)
   {
     // store configurables needed for B0 workflow
@@ -212,8 +205,6 @@ struct HfDataCreatorDplusPiReduced {
 
       // helpers for ReducedTables filling
       int hfReducedCollisionIndex = hfReducedCollision.lastIndex() + 1;
-      std::vector<int64_t> selectedTracksPion;
-      selectedTracksPion.reserve(trackIndices.size());
       bool fillHfReducedCollision = false;
 
       auto primaryVertex = getPrimaryVertex(collision);
@@ -235,6 +226,19 @@ struct HfDataCreatorDplusPiReduced {
 
       auto thisCollId = collision.globalIndex();
       auto candsDThisColl = candsD.sliceBy(candsDPerCollision, thisCollId);
+
+      // select the pions of this collision once, they are then paired with all the D candidates
+      pionBuffer.clear();
+      if (candsDThisColl.size() > 0) {
+        auto trackIdsThisCollision = trackIndices.sliceBy(trackIndicesPerCollision, thisCollId);
+        for (const auto& trackId : trackIdsThisCollision) {
+          auto trackPion = trackId.track_as<TracksPIDWithSel>();
+          if (isPionSelected(trackPion)) {
+            pionBuffer.add(trackPion, massPi);
+          }
+        }
+      }
+
       for (const auto& candD : candsDThisColl) {
         bool fillHfCand3Prong = false;
         float invMassD;
@@ -297,19 +301,15 @@ struct HfDataCreatorDplusPiReduced {
         auto trackParCovD = o2::dataformats::V0(df3.getPCACandidatePos(), pVecD, df3.calcPCACovMatrixFlat(),
                                                 trackParCovPiK, trackParCov2, {0, 0}, {0, 0});
 
-        auto trackIdsThisCollision = trackIndices.sliceBy(trackIndicesPerCollision, thisCollId);
-        for (const auto& trackId : trackIdsThisCollision) {
-          auto trackPion = trackId.track_as<TracksPIDWithSel>();
-
-          // apply selections on pion tracks
-          if (!isPionSelected(trackPion, track0, track1, track2) || !isSelectedTrackDCA(trackPion)) {
+        // pair the D candidate with all the selected pions: sign, D daughters and B0 invariant-mass window
+        pionBuffer.selectPairs(pVecD, massD, track0.sign(), std::array<int64_t, 3>{track0.globalIndex(), track1.globalIndex(), track2.globalIndex()}, massB0, invMassWindowB0);
+        for (size_t iPion = 0; iPion < pionBuffer.size(); ++iPion) {
+          if (!pionBuffer.isCompatible[iPion]) {
             continue;
           }
-          registry.fill(HIST("hPtPion"), trackPion.pt());
-          std::array<float, 3> pVecPion = {trackPion.px(), trackPion.py(), trackPion.pz()};
-          // compute invariant mass and apply selection
-          massDPi = RecoDecay::m(std::array{pVecD, pVecPion}, std::array{massD, massPi});
-          if (std::abs(massDPi - massB0) > invMassWindowB0) {
+          registry.fill(HIST("hPtPion"), pionBuffer.pt[iPion]);
+          // invariant-mass selection
+          if (!pionBuffer.isInMassWindow[iPion]) {
             continue;
           }
 
@@ -317,7 +317,8 @@ struct HfDataCreatorDplusPiReduced {
 
           // fill Pion tracks table
           // if information on track already stored, go to next track
-          if (!std::count(selectedTracksPion.begin(), selectedTracksPion.end(), trackPion.globalIndex())) {
+          if (pionBuffer.reducedIndex[iPion] < 0) {
+            auto trackPion = tracks.rawIteratorAt(pionBuffer.globalIndex[iPion]);
             hfTrackPion(trackPion.globalIndex(), hfReducedCollisionIndex,
                         trackPion.x(), trackPion.alpha(),
                         trackPion.y(), trackPion.z(), trackPion.snp(),
@@ -334,9 +335,8 @@ struct HfDataCreatorDplusPiReduced {
                            trackPion.hasTPC(), trackPion.hasTOF(),
                            trackPion.tpcNSigmaEl(), trackPion.tpcNSigmaMu(), trackPion.tpcNSigmaPi(), trackPion.tpcNSigmaKa(), trackPion.tpcNSigmaPr(),
                            trackPion.tofNSigmaEl(), trackPion.tofNSigmaMu(), trackPion.tofNSigmaPi(), trackPion.tofNSigmaKa(), trackPion.tofNSigmaPr());
-            // add trackPion.globalIndex() to a list
-            // to keep memory of the pions filled in the table and avoid refilling them if they are paired to another D candidate
-            selectedTracksPion.emplace_back(trackPion.globalIndex());
+            // keep memory of the pions filled in the table and avoid refilling them if they are paired to another D candidate
+            pionBuffer.reducedIndex[iPion] = hfTrackPion.lastIndex();
           }
           fillHfCand3Prong = true;
         }                       // pion loop
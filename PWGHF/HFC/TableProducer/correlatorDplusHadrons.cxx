@@ -22,6 +22,7 @@
 #include "Framework/runDataProcessing.h"
 #include "PWGHF/DataModel/CandidateReconstructionTables.h"
 #include "PWGHF/DataModel/CandidateSelectionTables.h"
+#include "PWGHF/Utils/utilsCorrelationMixing.h"
 
 using namespace o2;
 using namespace o2::framework;
@@ -162,6 +163,18 @@ struct HfCorrelatorDplusHadrons {
   Configurable<float> multMax{"multMax", 10000., "maximum multiplicity accepted"};
   Configurable<std::vector<double>> binsPt{"binsPt", std::vector<double>{o2::analysis::hf_cuts_dplus_to_pi_k_pi::vecBinsPt}, "pT bin limits for candidate mass plots and efficiency"};
   Configurable<std::vector<double>> efficiencyD{"efficiencyD", std::vector<double>{efficiencyDmeson_v}, "Efficiency values for Dplus meson"};
+  Configurable<int> mixingDepth{"mixingDepth", 5, "number of events stored per pool bin for the event mixing"};
+  Configurable<bool> fillMixedEventHistogram{"fillMixedEventHistogram", false, "fill the binned mixed-event histogram instead of the pair tables"};
+  ConfigurableAxis binsDeltaPhi{"binsDeltaPhi", {phiAxisBins, phiAxisMin, phiAxisMax}, "#Delta#varphi binning of the mixed-event histogram"};
+  ConfigurableAxis binsDeltaEta{"binsDeltaEta", {40, -2., 2.}, "#Delta#eta binning of the mixed-event histogram"};
+  ConfigurableAxis binsPtHadron{"binsPtHadron", {VARIABLE_WIDTH, 0.3, 1., 2., 3., 5., 8., 50.}, "hadron #it{p}_{T} binning of the mixed-event histogram"};
+
+  // one engine per mixed-event process, so that the processes never mix with the pools of each other
+  HfCorrelationMixingEngine mixingEngineData;  // pools of processDataMixedEvent
+  HfCorrelationMixingEngine mixingEngineMcRec; // pools of processMcRecMixedEvent
+  HfCorrelationMixingEngine mixingEngineMcGen; // pools of processMcGenMixedEvent
+  HfCorrelationParticles mixingTriggers;
+  HfCorrelationParticles mixingAssociates;
 
   Partition<soa::Join<aod::HfCand3Prong, aod::HfSelDplusToPiKPi>> selectedDplusCandidates = aod::hf_sel_candidate_dplus::isSelDplusToPiKPi >= selectionFlagDplus;
   Partition<soa::Join<aod::HfCand3Prong, aod::HfSelDplusToPiKPi, aod::HfCand3ProngMcRec>> recoFlagDplusCandidates = aod::hf_sel_candidate_dplus::isSelDplusToPiKPi >= selectionFlagDplus;
@@ -206,6 +219,39 @@ struct HfCorrelatorDplusHadrons {
     registry.add("hMassDplusMCRecSig", "Dplus signal candidates - MC reco;inv. mass (#pi K) (GeV/#it{c}^{2});entries", {HistType::kTH2F, {{massAxisBins, massAxisMin, massAxisMax}, {vbins, "#it{p}_{T} (GeV/#it{c})"}}});
     registry.add("hMassDplusMCRecBkg", "Dplus background candidates - MC reco;inv. mass (#pi K) (GeV/#it{c}^{2});entries", {HistType::kTH2F, {{massAxisBins, massAxisMin, massAxisMax}, {vbins, "#it{p}_{T} (GeV/#it{c})"}}});
     registry.add("hcountDplustriggersMCGen", "Dplus trigger particles - MC gen;;N of trigger Dplus", {HistType::kTH2F, {{1, -0.5, 0.5}, {vbins, "#it{p}_{T} (GeV/#it{c})"}}});
+
+    mixingEngineData.setDepth(mixingDepth);
+    mixingEngineMcRec.setDepth(mixingDepth);
+    mixingEngineMcGen.setDepth(mixingDepth);
+    if (fillMixedEventHistogram) {
+      const int nPoolBins = AxisSpec(zBins).getNbins() * AxisSpec(multBins).getNbins();
+      registry.add("hCorrelMixedEvent", "Dplus-hadron pairs - mixed event", {HistType::kTHnF, {{binsDeltaPhi, "#Delta#varphi"}, {binsDeltaEta, "#Delta#eta"}, {vbins, "#it{p}_{T}^{D} (GeV/#it{c})"}, {binsPtHadron, "#it{p}_{T}^{hadron} (GeV/#it{c})"}, {nPoolBins, 0., static_cast<double>(nPoolBins), "pool bin"}}});
+      auto* hCorrelMixedEvent = registry.get<THn>(HIST("hCorrelMixedEvent")).get();
+      mixingEngineData.setHistogram(hCorrelMixedEvent);
+      mixingEngineMcRec.setHistogram(hCorrelMixedEvent);
+      mixingEngineMcGen.setHistogram(hCorrelMixedEvent);
+    }
+  }
+
+  /// Mixes the triggers of the current event with the events stored in its pool bin, then stores its associates
+  /// \param engine is the mixing engine of the calling process
+  /// \param poolBin is the pool bin of the current event
+  /// \param fillRecoInfo tells whether the reconstruction information of the pairs is written
+  void mixEvent(HfCorrelationMixingEngine& engine, int poolBin, bool fillRecoInfo)
+  {
+    if (fillMixedEventHistogram) {
+      engine.mixIntoHistogram(poolBin, mixingTriggers);
+    } else {
+      engine.mix(poolBin, mixingTriggers, [&](size_t iTrig, const HfCorrelationParticles& associates, const float* deltaPhi, const float* deltaEta) {
+        for (size_t iAssoc = 0; iAssoc < associates.size(); ++iAssoc) {
+          entryDplusHadronPair(deltaPhi[iAssoc], deltaEta[iAssoc], mixingTriggers.pt[iTrig], associates.pt[iAssoc], poolBin);
+          if (fillRecoInfo) {
+            entryDplusHadronRecoInfo(mixingTriggers.invMass[iTrig], (mixingTriggers.flags[iTrig] & hf_correlation_trigger::Signal) != 0);
+          }
+        }
+      });
+    }
+    engine.store(poolBin, mixingAssociates);
   }
 
   /// Dplus-hadron correlation pair builder - for real data and data-like analysis (i.e. reco-level w/o matching request via MC truth)
@@ -483,20 +529,21 @@ struct HfCorrelatorDplusHadrons {
 
   void processDataMixedEvent(mySelCollisions& collisions, myCandidatesData& candidates, myTracks& tracks)
   {
-    auto tracksTuple = std::make_tuple(candidates, tracks);
-    Pair<mySelCollisions, myCandidatesData, myTracks, BinningType> pairData{corrBinning, 5, -1, collisions, tracksTuple, &cache};
-
-    for (auto& [c1, tracks1, c2, tracks2] : pairData) {
-      // LOGF(info, "Mixed event collisions: Index = (%d, %d), tracks Size: (%d, %d), Z Vertex: (%f, %f), Pool Bin: (%d, %d)", c1.globalIndex(), c2.globalIndex(), tracks1.size(), tracks2.size(), c1.posZ(), c2.posZ(), corrBinning.getBin(std::make_tuple(c1.posZ(), c1.multFV0M())),corrBinning.getBin(std::make_tuple(c2.posZ(), c2.multFV0M()))); // For debug
-      int poolBin = corrBinning.getBin(std::make_tuple(c2.posZ(), c2.multFV0M()));
-      for (auto& [t1, t2] : o2::soa::combinations(o2::soa::CombinationsFullIndexPolicy(tracks1, tracks2))) {
-
-        if (yCandMax >= 0. && std::abs(yDplus(t1)) > yCandMax) {
+    for (const auto& collision : collisions) {
+      int poolBin = corrBinning.getBin(std::make_tuple(collision.posZ(), collision.multFV0M()));
+      auto candidatesThisColl = candidates.sliceByCached(aod::hf_cand::collisionId, collision.globalIndex(), cache);
+      auto tracksThisColl = tracks.sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
+      mixingTriggers.clear();
+      for (const auto& candidate : candidatesThisColl) {
+        if (yCandMax >= 0. && std::abs(yDplus(candidate)) > yCandMax) {
           continue;
         }
-        entryDplusHadronPair(getDeltaPhi(t1.phi(), t2.phi()), t1.eta() - t2.eta(), t1.pt(), t2.pt(), poolBin);
-        entryDplusHadronRecoInfo(invMassDplusToPiKPi(t1), 0);
+        mixingTriggers.add(candidate.pt(), candidate.eta(), candidate.phi(), invMassDplusToPiKPi(candidate));
+      }
+      for (const auto& track : tracksThisColl) {
+        mixingAssociates.add(track.pt(), track.eta(), track.phi());
       }
+      mixEvent(mixingEngineData, poolBin, true);
     }
   }
   PROCESS_SWITCH(HfCorrelatorDplusHadrons, processDataMixedEvent, "Process Mixed Event Data", false);
@@ -506,19 +553,21 @@ struct HfCorrelatorDplusHadrons {
 
   void processMcRecMixedEvent(mySelCollisions& collisions, myCandidatesMcRec& candidates, myTracks& tracks)
   {
-    auto tracksTuple = std::make_tuple(candidates, tracks);
-    Pair<mySelCollisions, myCandidatesMcRec, myTracks, BinningType> pairMcRec{corrBinning, 5, -1, collisions, tracksTuple, &cache};
-
-    for (auto& [c1, tracks1, c2, tracks2] : pairMcRec) {
-      int poolBin = corrBinning.getBin(std::make_tuple(c2.posZ(), c2.multFV0M()));
-      for (auto& [t1, t2] : o2::soa::combinations(o2::soa::CombinationsFullIndexPolicy(tracks1, tracks2))) {
-
-        if (yCandMax >= 0. && std::abs(yDplus(t1)) > yCandMax) {
+    for (const auto& collision : collisions) {
+      int poolBin = corrBinning.getBin(std::make_tuple(collision.posZ(), collision.multFV0M()));
+      auto candidatesThisColl = candidates.sliceByCached(aod::hf_cand::collisionId, collision.globalIndex(), cache);
+      auto tracksThisColl = tracks.sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
+      mixingTriggers.clear();
+      for (const auto& candidate : candidatesThisColl) {
+        if (yCandMax >= 0. && std::abs(yDplus(candidate)) > yCandMax) {
           continue;
         }
-        entryDplusHadronPair(getDeltaPhi(t1.phi(), t2.phi()), t1.eta() - t2.eta(), t1.pt(), t2.pt(), poolBin);
-        entryDplusHadronRecoInfo(invMassDplusToPiKPi(t1), 0);
+        mixingTriggers.add(candidate.pt(), candidate.eta(), candidate.phi(), invMassDplusToPiKPi(candidate));
+      }
+      for (const auto& track : tracksThisColl) {
+        mixingAssociates.add(track.pt(), track.eta(), track.phi());
       }
+      mixEvent(mixingEngineMcRec, poolBin, true);
     }
   }
   PROCESS_SWITCH(HfCorrelatorDplusHadrons, processMcRecMixedEvent, "Process Mixed Event MCRec", false);
@@ -549,35 +598,28 @@ struct HfCorrelatorDplusHadrons {
     using BinningTypeMcGen = FlexibleBinningPolicy<std::tuple<decltype(getTracksSize)>, aod::mccollision::PosZ, decltype(getTracksSize)>;
     BinningTypeMcGen corrBinningMcGen{{getTracksSize}, {zBins, multBins}, true};
 
-    auto tracksTuple = std::make_tuple(particlesMc, particlesMc);
-    Pair<mySelCollisionsMcGen, myTracksMcGen, myTracksMcGen, BinningTypeMcGen> pairMcGen{corrBinningMcGen, 5, -1, collisions, tracksTuple, &cache};
-
-    for (auto& [c1, tracks1, c2, tracks2] : pairMcGen) {
-      for (auto& [t1, t2] : o2::soa::combinations(o2::soa::CombinationsFullIndexPolicy(tracks1, tracks2))) {
-
-        // Check track t1 is Dplus
-        if (std::abs(t1.pdgCode()) != pdg::Code::kDPlus) {
-          continue;
-        }
-
-        double yD = RecoDecay::y(array{t1.px(), t1.py(), t1.pz()}, RecoDecay::getMassPDG(t1.pdgCode()));
-        if (yCandMax >= 0. && std::abs(yD) > yCandMax) {
-          continue;
+    for (const auto& collision : collisions) {
+      int poolBin = corrBinningMcGen.getBin(std::make_tuple(collision.posZ(), getTracksSize(collision)));
+      auto particlesThisColl = particlesMc.sliceByCached(o2::aod::mcparticle::mcCollisionId, collision.globalIndex(), cache);
+      mixingTriggers.clear();
+      for (const auto& particle : particlesThisColl) {
+        if (std::abs(particle.eta()) <= etaTrackMax && particle.pt() >= ptTrackMin) {
+          mixingAssociates.add(particle.pt(), particle.eta(), particle.phi());
         }
-        if (ptCandMin >= 0. && t1.pt() < ptCandMin) {
+        // Check particle is Dplus
+        if (std::abs(particle.pdgCode()) != pdg::Code::kDPlus) {
           continue;
         }
-
-        if (std::abs(t2.eta()) > etaTrackMax) {
+        double yD = RecoDecay::y(array{particle.px(), particle.py(), particle.pz()}, RecoDecay::getMassPDG(particle.pdgCode()));
+        if (yCandMax >= 0. && std::abs(yD) > yCandMax) {
           continue;
         }
-        if (t2.pt() < ptTrackMin) {
+        if (ptCandMin >= 0. && particle.pt() < ptCandMin) {
           continue;
         }
-        int poolBin = corrBinningMcGen.getBin(std::make_tuple(c2.posZ(), getTracksSize(c2)));
-        // LOGF(info, "Mixed event collisions: Index = (%d,%d), tracks Size: (%d,%d), Z Vertex: (%f), Pool Bin: (%d)", c1.globalIndex(), c2.globalIndex(), getTracksSize(c1), getTracksSize(c2), c2.posZ(), poolBin); // For debug
-        entryDplusHadronPair(getDeltaPhi(t2.phi(), t1.phi()), t2.eta() - t1.eta(), t1.pt(), t2.pt(), poolBin);
+        mixingTriggers.add(particle.pt(), particle.eta(), particle.phi());
       }
+      mixEvent(mixingEngineMcGen, poolBin, false);
     }
   }
   PROCESS_SWITCH(HfCorrelatorDplusHadrons, processMcGenMixedEvent, "Process Mixed Event MCGen", false);
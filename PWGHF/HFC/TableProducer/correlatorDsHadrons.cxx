@@ -24,6 +24,7 @@
 #include "Framework/runDataProcessing.h"
 #include "PWGHF/DataModel/CandidateReconstructionTables.h"
 #include "PWGHF/DataModel/CandidateSelectionTables.h"
+#include "PWGHF/Utils/utilsCorrelationMixing.h"
 
 using namespace o2;
 using namespace o2::framework;
@@ -172,6 +173,17 @@ struct HfCorrelatorDsHadrons {
   Configurable<float> multMax{"multMax", 10000., "maximum multiplicity accepted"};
   Configurable<std::vector<double>> binsPt{"binsPt", std::vector<double>{o2::analysis::hf_cuts_ds_to_k_k_pi::vecBinsPt}, "pT bin limits for candidate mass plots and efficiency"};
   Configurable<std::vector<double>> efficiencyD{"efficiencyD", std::vector<double>{vecEfficiencyDmeson}, "Efficiency values for Ds meson"};
+  Configurable<int> mixingDepth{"mixingDepth", 5, "number of events stored per pool bin for the event mixing"};
+  Configurable<bool> fillMixedEventHistogram{"fillMixedEventHistogram", false, "fill the binned mixed-event histogram instead of the pair tables"};
+  ConfigurableAxis binsDeltaPhi{"binsDeltaPhi", {32, -o2::constants::math::PIHalf, 3. * o2::constants::math::PIHalf}, "#Delta#varphi binning of the mixed-event histogram"};
+  ConfigurableAxis binsDeltaEta{"binsDeltaEta", {40, -2., 2.}, "#Delta#eta binning of the mixed-event histogram"};
+  ConfigurableAxis binsPtHadron{"binsPtHadron", {VARIABLE_WIDTH, 0.3, 1., 2., 3., 5., 8., 50.}, "hadron #it{p}_{T} binning of the mixed-event histogram"};
+
+  // one engine per mixed-event process, so that the processes never mix with the pools of each other
+  HfCorrelationMixingEngine mixingEngineData;  // pools of processDataME
+  HfCorrelationMixingEngine mixingEngineMcRec; // pools of processMcRecME
+  HfCorrelationParticles mixingTriggers;
+  HfCorrelationParticles mixingAssociates;
 
   Filter collisionFilter = aod::hf_sel_collision_ds::dsFound == true;
   Filter flagDsFilter = (o2::aod::hf_track_index::hfflag & static_cast<uint8_t>(1 << DecayType::DsToKKPi)) != static_cast<uint8_t>(0);
@@ -249,6 +261,37 @@ struct HfCorrelatorDsHadrons {
     registry.add("hMassDsMCRecSig", "Ds signal candidates - MC Reco", {HistType::kTH2F, {{axisMassD}, {vbins, "#it{p}_{T} (GeV/#it{c})"}}});
     registry.add("hMassDsMCRecBkg", "Ds background candidates - MC Reco", {HistType::kTH2F, {{axisMassD}, {vbins, "#it{p}_{T} (GeV/#it{c})"}}});
     registry.add("hCountDstriggersMCGen", "Ds trigger particles - MC Gen", {HistType::kTH2F, {{1, -0.5, 0.5, "number of Ds triggers"}, {vbins, "#it{p}_{T} (GeV/#it{c})"}}});
+
+    mixingEngineData.setDepth(mixingDepth);
+    mixingEngineMcRec.setDepth(mixingDepth);
+    if (fillMixedEventHistogram) {
+      const int nPoolBins = AxisSpec(zBins).getNbins() * AxisSpec(multBins).getNbins();
+      registry.add("hCorrelMixedEvent", "Ds-hadron pairs - mixed event", {HistType::kTHnF, {{binsDeltaPhi, "#Delta#varphi"}, {binsDeltaEta, "#Delta#eta"}, {vbins, "#it{p}_{T}^{D} (GeV/#it{c})"}, {binsPtHadron, "#it{p}_{T}^{hadron} (GeV/#it{c})"}, {nPoolBins, 0., static_cast<double>(nPoolBins), "pool bin"}}});
+      auto* hCorrelMixedEvent = registry.get<THn>(HIST("hCorrelMixedEvent")).get();
+      mixingEngineData.setHistogram(hCorrelMixedEvent);
+      mixingEngineMcRec.setHistogram(hCorrelMixedEvent);
+    }
+  }
+
+  /// Mixes the triggers of the current event with the events stored in its pool bin, then stores its associates
+  /// \param engine is the mixing engine of the calling process
+  /// \param poolBin is the pool bin of the current event
+  void mixEvent(HfCorrelationMixingEngine& engine, int poolBin)
+  {
+    if (fillMixedEventHistogram) {
+      engine.mixIntoHistogram(poolBin, mixingTriggers);
+    } else {
+      engine.mix(poolBin, mixingTriggers, [&](size_t iTrig, const HfCorrelationParticles& associates, const float* deltaPhi, const float* deltaEta) {
+        const bool isSignal = (mixingTriggers.flags[iTrig] & hf_correlation_trigger::Signal) != 0;
+        const bool isPrompt = (mixingTriggers.flags[iTrig] & hf_correlation_trigger::Prompt) != 0;
+        for (size_t iAssoc = 0; iAssoc < associates.size(); ++iAssoc) {
+          entryDsHadronPair(deltaPhi[iAssoc], deltaEta[iAssoc], mixingTriggers.pt[iTrig], associates.pt[iAssoc], poolBin);
+          entryDsHadronRecoInfo(mixingTriggers.invMass[iTrig], isSignal);
+          entryDsHadronGenInfo(isPrompt);
+        }
+      });
+    }
+    engine.store(poolBin, mixingAssociates);
   }
 
   /// Fill histograms of quantities independent from the daugther-mass hypothesis for data
@@ -623,80 +666,62 @@ struct HfCorrelatorDsHadrons {
   // Event Mixing
   void processDataME(SelCollisionsWithDs& collisions, CandDsData& candidates, MyTracksData& tracks)
   {
-    auto tracksTuple = std::make_tuple(candidates, tracks);
-    Pair<SelCollisionsWithDs, CandDsData, MyTracksData, BinningType> pairData{corrBinning, 5, -1, collisions, tracksTuple, &cache};
-
-    for (auto& [c1, tracks1, c2, tracks2] : pairData) {
-      LOGF(info, "Mixed event collisions: Index = (%d, %d), tracks Size: (%d, %d), Z Vertex: (%f, %f), Pool Bin: (%d, %d)", c1.globalIndex(), c2.globalIndex(), tracks1.size(), tracks2.size(), c1.posZ(), c2.posZ(), corrBinning.getBin(std::make_tuple(c1.posZ(), c1.multFV0M())), corrBinning.getBin(std::make_tuple(c2.posZ(), c2.multFV0M())));
-      int poolBin = corrBinning.getBin(std::make_tuple(c2.posZ(), c2.multFV0M()));
-      for (auto& [candidate, pAssoc] : o2::soa::combinations(o2::soa::CombinationsFullIndexPolicy(tracks1, tracks2))) {
-
+    for (const auto& collision : collisions) {
+      int poolBin = corrBinning.getBin(std::make_tuple(collision.posZ(), collision.multFV0M()));
+      auto candidatesThisColl = candidates.sliceByCached(aod::hf_cand::collisionId, collision.globalIndex(), cache);
+      auto tracksThisColl = tracks.sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
+      mixingTriggers.clear();
+      for (const auto& candidate : candidatesThisColl) {
         if (yCandMax >= 0. && std::abs(yDs(candidate)) > yCandMax) {
           continue;
         }
         // DsToKKPi and DsToPiKK division
         if (candidate.isSelDsToKKPi() == selectionFlagDs) {
-          LOGF(info, "Mixed event tracks pair: (%d, %d) from events (%d, %d), track event: (%d, %d)", candidate.index(), pAssoc.index(), c1.index(), c2.index(), candidate.collision().index(), pAssoc.collision().index());
-          entryDsHadronPair(getDeltaPhi(candidate.phi(), pAssoc.phi()),
-                            candidate.eta() - pAssoc.eta(),
-                            candidate.pt(),
-                            pAssoc.pt(),
-                            poolBin);
-          entryDsHadronRecoInfo(invMassDsToKKPi(candidate), false);
-          entryDsHadronGenInfo(false);
+          mixingTriggers.add(candidate.pt(), candidate.eta(), candidate.phi(), invMassDsToKKPi(candidate));
         } else if (candidate.isSelDsToPiKK() == selectionFlagDs) {
-          LOGF(info, "Mixed event tracks pair: (%d, %d) from events (%d, %d), track event: (%d, %d)", candidate.index(), pAssoc.index(), c1.index(), c2.index(), candidate.collision().index(), pAssoc.collision().index());
-          entryDsHadronPair(getDeltaPhi(candidate.phi(), pAssoc.phi()),
-                            candidate.eta() - pAssoc.eta(),
-                            candidate.pt(),
-                            pAssoc.pt(),
-                            poolBin);
-          entryDsHadronRecoInfo(invMassDsToPiKK(candidate), false);
-          entryDsHadronGenInfo(false);
+          mixingTriggers.add(candidate.pt(), candidate.eta(), candidate.phi(), invMassDsToPiKK(candidate));
         }
       }
+      for (const auto& track : tracksThisColl) {
+        mixingAssociates.add(track.pt(), track.eta(), track.phi());
+      }
+      mixEvent(mixingEngineData, poolBin);
     }
   }
   PROCESS_SWITCH(HfCorrelatorDsHadrons, processDataME, "Process Mixed Event Data", false);
 
   void processMcRecME(SelCollisionsWithDs& collisions, CandDsMcReco& candidates, CandDsMcGen const& particlesMc, MyTracksMc& tracks)
   {
-    auto tracksTuple = std::make_tuple(candidates, tracks);
-    Pair<SelCollisionsWithDs, CandDsMcReco, MyTracksMc, BinningType> pairMcRec{corrBinning, 5, -1, collisions, tracksTuple, &cache};
-
-    bool isDsPrompt = false;
-    bool isDsSignal = false;
-    for (auto& [c1, tracks1, c2, tracks2] : pairMcRec) {
-      int poolBin = corrBinning.getBin(std::make_tuple(c2.posZ(), c2.multFV0M()));
-      for (auto& [candidate, pAssoc] : o2::soa::combinations(o2::soa::CombinationsFullIndexPolicy(tracks1, tracks2))) {
-        auto prong0McPart = candidate.prong0_as<MyTracksMc>().mcParticle_as<CandDsMcGen>();
-        // prompt and non-prompt division
-        isDsPrompt = candidate.originMcRec() == RecoDecay::OriginType::Prompt;
-        // Ds Signal
-        isDsSignal = std::abs(candidate.flagMcMatchRec()) == 1 << DecayType::DsToKKPi;
-
+    for (const auto& collision : collisions) {
+      int poolBin = corrBinning.getBin(std::make_tuple(collision.posZ(), collision.multFV0M()));
+      auto candidatesThisColl = candidates.sliceByCached(aod::hf_cand::collisionId, collision.globalIndex(), cache);
+      auto tracksThisColl = tracks.sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
+      mixingTriggers.clear();
+      for (const auto& candidate : candidatesThisColl) {
         if (yCandMax >= 0. && std::abs(yDplus(candidate)) > yCandMax) {
           continue;
         }
+        uint8_t flags = 0;
+        // Ds Signal
+        if (std::abs(candidate.flagMcMatchRec()) == 1 << DecayType::DsToKKPi) {
+          flags |= hf_correlation_trigger::Signal;
+        }
+        // prompt and non-prompt division
+        if (candidate.originMcRec() == RecoDecay::OriginType::Prompt) {
+          flags |= hf_correlation_trigger::Prompt;
+        }
         // DsToKKPi and DsToPiKK division
+        auto prong0McPart = candidate.prong0_as<MyTracksMc>().mcParticle_as<CandDsMcGen>();
         if (std::abs(prong0McPart.pdgCode()) == kKPlus) {
-          entryDsHadronPair(getDeltaPhi(candidate.phi(), pAssoc.phi()),
-                            candidate.eta() - pAssoc.eta(),
-                            candidate.pt(),
-                            pAssoc.pt(),
-                            poolBin);
-          entryDsHadronRecoInfo(invMassDsToKKPi(candidate), isDsSignal);
-          entryDsHadronGenInfo(isDsPrompt);
+          mixingTriggers.add(candidate.pt(), candidate.eta(), candidate.phi(), invMassDsToKKPi(candidate), flags);
         } else if (std::abs(prong0McPart.pdgCode()) == kPiPlus) {
-          entryDsHadronPair(getDeltaPhi(candidate.phi(), pAssoc.phi()),
-                            candidate.eta() - pAssoc.eta(),
-                            candidate.pt(),
-                            pAssoc.pt(),
-                            poolBin);
-          entryDsHadronRecoInfo(invMassDsToPiKK(candidate), isDsSignal);
-          entryDsHadronGenInfo(isDsPrompt);
+          mixingTriggers.add(candidate.pt(), candidate.eta(), candidate.phi(), invMassDsToPiKK(candidate), flags);
         }
       }
+      for (const auto& track : tracksThisColl) {
+        mixingAssociates.add(track.pt(), track.eta(), track.phi());
+      }
+      mixEvent(mixingEngineMcRec, poolBin);
     }
   }
   PROCESS_SWITCH(HfCorrelatorDsHadrons, processMcRecME, "Process Mixed Event MCRec", false);
@@ -0,0 +1,250 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/// \file utilsCorrelationMixing.h
+/// \brief Event-mixing engine for the HF-hadron correlators, with ring-buffer pools of compact particle arrays
+
+#ifndef PWGHF_UTILS_UTILSCORRELATIONMIXING_H_
+#define PWGHF_UTILS_UTILSCORRELATIONMIXING_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <TAxis.h>
+#include <THn.h>
+
+#include "CommonConstants/MathConstants.h"
+
+#include "Common/Core/HistogramAccumulator.h"
+
+namespace hf_correlation_trigger
+{
+/// Flags of the triggers stored in HfCorrelationParticles
+enum Flag : uint8_t {
+  Signal = 1 << 0, ///< matched to a true signal candidate in MC
+  Prompt = 1 << 1  ///< prompt origin in MC
+};
+} // namespace hf_correlation_trigger
+
+/// \brief Struct-of-arrays storage of the triggers or of the associates of one event
+///
+/// The invariant mass and the flags (e.g. MC signal, prompt origin) are only used for the triggers.
+struct HfCorrelationParticles {
+  std::vector<float> pt;      ///< transverse momentum
+  std::vector<float> eta;     ///< pseudorapidity
+  std::vector<float> phi;     ///< azimuthal angle in [0, 2pi)
+  std::vector<float> invMass; ///< invariant mass of the trigger candidate
+  std::vector<uint8_t> flags; ///< user flags of the trigger
+  std::vector<int> binPt;     ///< bin of the pT in the binned mixed-event histogram, set by the engine
+
+  void clear()
+  {
+    pt.clear();
+    eta.clear();
+    phi.clear();
+    invMass.clear();
+    flags.clear();
+    binPt.clear();
+  }
+
+  size_t size() const { return pt.size(); }
+
+  void add(float ptParticle, float etaParticle, float phiParticle, float invMassParticle = 0.f, uint8_t flagsParticle = 0)
+  {
+    pt.push_back(ptParticle);
+    eta.push_back(etaParticle);
+    phi.push_back(phiParticle);
+    invMass.push_back(invMassParticle);
+    flags.push_back(flagsParticle);
+  }
+};
+
+/// \brief Event-mixing engine shared by the HF-hadron correlators
+///
+/// For each pool bin (z vertex, multiplicity) the associates of the last `depth` events are kept in a ring buffer.
+/// The triggers of the current event are mixed with all the stored events of its pool bin, then the associates of
+/// the current event replace the oldest stored event. The pools are members of the task, so they span dataframes.
+///
+/// The angular differences follow the convention of the same-event pairs of the correlators:
+/// deltaPhi = phiTrig - phiAssoc in [-pi/2, 3pi/2) and deltaEta = etaAssoc - etaTrig.
+/// They are computed for a whole stored event at once, in branch-free loops over the associate arrays.
+class HfCorrelationMixingEngine
+{
+ public:
+  /// Sets the number of events stored per pool bin and empties the pools
+  void setDepth(int depth)
+  {
+    mDepth = std::max(depth, 1);
+    mPools.clear();
+  }
+
+  /// Enables the binned output, with the first four axes of hist being deltaPhi, deltaEta, pT trig and pT assoc
+  /// and the fifth the pool bin
+  void setHistogram(THn* hist)
+  {
+    mHist = hist;
+    mAxisDeltaPhi.set(hist->GetAxis(0));
+    mAxisDeltaEta.set(hist->GetAxis(1));
+    mAxisPtTrig.set(hist->GetAxis(2));
+    mAxisPtAssoc.set(hist->GetAxis(3));
+    mNPhi = mAxisDeltaPhi.nBins + 2;
+    mNEta = mAxisDeltaEta.nBins + 2;
+    mNPtAssoc = mAxisPtAssoc.nBins + 2;
+    mNPtTrig = mAxisPtTrig.nBins + 2;
+    mCounts.resize(static_cast<size_t>(mNPhi) * mNEta * mNPtAssoc * mNPtTrig);
+  }
+
+  /// Mixes the triggers with the events stored in the pool
+  /// \param poolBin is the pool bin of the current event
+  /// \param triggers are the triggers of the current event
+  /// \param fillPairs is called for each trigger and stored event as fillPairs(iTrigger, associates, deltaPhi, deltaEta)
+  template <typename F>
+  void mix(int poolBin, const HfCorrelationParticles& triggers, F&& fillPairs)
+  {
+    if (poolBin < 0 || poolBin >= static_cast<int>(mPools.size()) || triggers.size() == 0) {
+      return;
+    }
+    for (const auto& associates : mPools[poolBin].events) {
+      const size_t nAssoc = associates.size();
+      reserveScratch(nAssoc);
+      for (size_t iTrig = 0; iTrig < triggers.size(); ++iTrig) {
+        computeDeltas(triggers.phi[iTrig], triggers.eta[iTrig], associates);
+        fillPairs(iTrig, associates, mDeltaPhi.data(), mDeltaEta.data());
+      }
+    }
+  }
+
+  /// Mixes the triggers with the events stored in the pool and adds the pairs to the binned histogram
+  void mixIntoHistogram(int poolBin, HfCorrelationParticles& triggers)
+  {
+    if (!mHist || poolBin < 0 || poolBin >= static_cast<int>(mPools.size()) || triggers.size() == 0) {
+      return;
+    }
+    triggers.binPt.resize(triggers.size());
+    for (size_t iTrig = 0; iTrig < triggers.size(); ++iTrig) {
+      triggers.binPt[iTrig] = mAxisPtTrig.find(triggers.pt[iTrig]);
+    }
+    for (const auto& associates : mPools[poolBin].events) {
+      const size_t nAssoc = associates.size();
+      reserveScratch(nAssoc);
+      for (size_t iTrig = 0; iTrig < triggers.size(); ++iTrig) {
+        computeDeltas(triggers.phi[iTrig], triggers.eta[iTrig], associates);
+        const int offsetTrig = triggers.binPt[iTrig] * mNPtAssoc;
+        for (size_t iAssoc = 0; iAssoc < nAssoc; ++iAssoc) {
+          const int cell = mAxisDeltaPhi.find(mDeltaPhi[iAssoc]) + mNPhi * (mAxisDeltaEta.find(mDeltaEta[iAssoc]) + mNEta * (associates.binPt[iAssoc] + offsetTrig));
+          mCounts.add(cell);
+        }
+      }
+    }
+    flushHistogram(poolBin);
+  }
+
+  /// Stores the associates of the current event in the pool, replacing the oldest event if the pool is full.
+  /// The associates are swapped with the buffer of the replaced event, so the caller gets back allocated storage.
+  /// The associates are cleared in all cases, also for events outside the pool binning (poolBin < 0).
+  void store(int poolBin, HfCorrelationParticles& associates)
+  {
+    if (poolBin < 0) {
+      associates.clear();
+      return;
+    }
+    if (poolBin >= static_cast<int>(mPools.size())) {
+      mPools.resize(poolBin + 1);
+    }
+    if (mHist) {
+      associates.binPt.resize(associates.size());
+      for (size_t iAssoc = 0; iAssoc < associates.size(); ++iAssoc) {
+        associates.binPt[iAssoc] = mAxisPtAssoc.find(associates.pt[iAssoc]);
+      }
+    }
+    auto& pool = mPools[poolBin];
+    if (static_cast<int>(pool.events.size()) < mDepth) {
+      pool.events.emplace_back();
+      std::swap(pool.events.back(), associates);
+    } else {
+      std::swap(pool.events[pool.next], associates);
+      pool.next = (pool.next + 1) % mDepth;
+    }
+    associates.clear();
+  }
+
+ private:
+  struct Pool {
+    std::vector<HfCorrelationParticles> events; ///< stored events, at most depth
+    int next = 0;                               ///< next event to be replaced once the pool is full
+  };
+
+  void reserveScratch(size_t n)
+  {
+    if (mDeltaPhi.size() < n) {
+      mDeltaPhi.resize(n);
+      mDeltaEta.resize(n);
+    }
+  }
+
+  void computeDeltas(float phiTrig, float etaTrig, const HfCorrelationParticles& associates)
+  {
+    constexpr float phiMin = -o2::constants::math::PIHalf;
+    constexpr float phiMax = 3.f * o2::constants::math::PIHalf;
+    constexpr float twoPi = o2::constants::math::TwoPI;
+    const size_t nAssoc = associates.size();
+    const float* phiAssoc = associates.phi.data();
+    const float* etaAssoc = associates.eta.data();
+    float* deltaPhi = mDeltaPhi.data();
+    float* deltaEta = mDeltaEta.data();
+    for (size_t iAssoc = 0; iAssoc < nAssoc; ++iAssoc) {
+      float dPhi = phiTrig - phiAssoc[iAssoc];
+      dPhi += (dPhi < phiMin) ? twoPi : 0.f;
+      dPhi -= (dPhi >= phiMax) ? twoPi : 0.f;
+      deltaPhi[iAssoc] = dPhi;
+      deltaEta[iAssoc] = etaAssoc[iAssoc] - etaTrig;
+    }
+  }
+
+  void flushHistogram(int poolBin)
+  {
+    const int binPool = mHist->GetAxis(4)->FindBin(poolBin);
+    double entries = 0.;
+    mCounts.flush([&](uint32_t index, uint32_t count) {
+      const int cell = static_cast<int>(index);
+      Int_t coordinates[5] = {cell % mNPhi, (cell / mNPhi) % mNEta, cell / (mNPhi * mNEta * mNPtAssoc), (cell / (mNPhi * mNEta)) % mNPtAssoc, binPool};
+      Long64_t bin = mHist->GetBin(coordinates);
+      mHist->AddBinContent(bin, count);
+      if (mHist->GetCalculateErrors()) {
+        mHist->AddBinError2(bin, count);
+      }
+      entries += count;
+    });
+    if (entries > 0) {
+      mHist->SetEntries(mHist->GetEntries() + entries);
+    }
+  }
+
+  int mDepth = 5;
+  std::vector<Pool> mPools;
+  std::vector<float> mDeltaPhi;
+  std::vector<float> mDeltaEta;
+
+  THn* mHist = nullptr;
+  o2::analysis::AxisBinning mAxisDeltaPhi;
+  o2::analysis::AxisBinning mAxisDeltaEta;
+  o2::analysis::AxisBinning mAxisPtTrig;
+  o2::analysis::AxisBinning mAxisPtAssoc;
+  int mNPhi = 0;
+  int mNEta = 0;
+  int mNPtAssoc = 0;
+  int mNPtTrig = 0;
+  o2::analysis::DenseCounts mCounts;
+};
+
+#endif // PWGHF_UTILS_UTILSCORRELATIONMIXING_H_
@@ -0,0 +1,110 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/// \file utilsReducedDataCreation.h
+/// \brief Per-collision buffer of bachelor-track candidates for the creators of reduced data (D + bachelor pairs)
+
+#ifndef PWGHF_UTILS_UTILSREDUCEDDATACREATION_H_
+#define PWGHF_UTILS_UTILSREDUCEDDATACREATION_H_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// \brief Struct-of-arrays buffer of the bachelor tracks of one collision which pass the single-track selection
+///
+/// The bachelors are selected once per collision, then each D candidate is paired with the whole buffer in a single
+/// loop over plain arrays. The buffer also keeps, for each bachelor, the index of its row in the reduced track table,
+/// so that each track is written at most once per collision.
+struct HfReducedBachelorBuffer {
+  std::vector<int64_t> globalIndex;    ///< global index of the track
+  std::vector<float> pt;               ///< transverse momentum of the track
+  std::vector<double> px;              ///< momentum of the track
+  std::vector<double> py;              ///< momentum of the track
+  std::vector<double> pz;              ///< momentum of the track
+  std::vector<double> energy;          ///< energy of the track with the bachelor mass hypothesis
+  std::vector<int8_t> sign;            ///< sign of the track
+  std::vector<int> reducedIndex;       ///< index of the track in the reduced track table, -1 if not written yet
+  std::vector<uint8_t> isCompatible;   ///< output of selectPairs: opposite sign to the D and not one of its prongs
+  std::vector<uint8_t> isInMassWindow; ///< output of selectPairs: invariant mass of the pair within the window
+
+  void clear()
+  {
+    globalIndex.clear();
+    pt.clear();
+    px.clear();
+    py.clear();
+    pz.clear();
+    energy.clear();
+    sign.clear();
+    reducedIndex.clear();
+    isCompatible.clear();
+    isInMassWindow.clear();
+  }
+
+  size_t size() const { return globalIndex.size(); }
+
+  /// Adds a selected bachelor track to the buffer
+  /// \param track is the bachelor track
+  /// \param mass is the mass hypothesis of the bachelor
+  template <typename T>
+  void add(const T& track, double mass)
+  {
+    const double pxTrack = track.px();
+    const double pyTrack = track.py();
+    const double pzTrack = track.pz();
+    globalIndex.push_back(track.globalIndex());
+    pt.push_back(track.pt());
+    px.push_back(pxTrack);
+    py.push_back(pyTrack);
+    pz.push_back(pzTrack);
+    energy.push_back(std::sqrt(pxTrack * pxTrack + pyTrack * pyTrack + pzTrack * pzTrack + mass * mass));
+    sign.push_back(track.sign());
+    reducedIndex.push_back(-1);
+  }
+
+  /// Flags the bachelors which can be paired with a D candidate, i.e. with opposite sign to the D and not one of
+  /// its prongs (isCompatible), and those for which the invariant mass of the pair is within the window around the
+  /// mother mass (isInMassWindow)
+  /// \param pVecD is the momentum of the D candidate
+  /// \param massD is the mass hypothesis of the D candidate
+  /// \param signD is the sign of the first prong of the D candidate
+  /// \param prongIds are the global indices of the D prongs
+  /// \param massMother is the nominal mass of the mother
+  /// \param invMassWindow is the half-width of the invariant-mass window
+  template <std::size_t N>
+  void selectPairs(const std::array<float, 3>& pVecD, double massD, int signD, const std::array<int64_t, N>& prongIds, double massMother, double invMassWindow)
+  {
+    const size_t nBachelors = size();
+    isCompatible.resize(nBachelors);
+    isInMassWindow.resize(nBachelors);
+    const double pxD = pVecD[0];
+    const double pyD = pVecD[1];
+    const double pzD = pVecD[2];
+    const double energyD = std::sqrt(pxD * pxD + pyD * pyD + pzD * pzD + massD * massD);
+    for (size_t i = 0; i < nBachelors; ++i) {
+      const double e = energyD + energy[i];
+      const double pxSum = pxD + px[i];
+      const double pySum = pyD + py[i];
+      const double pzSum = pzD + pz[i];
+      const double invMass = std::sqrt(e * e - pxSum * pxSum - pySum * pySum - pzSum * pzSum);
+      bool compatible = (sign[i] * signD <= 0);
+      for (std::size_t iProng = 0; iProng < N; ++iProng) {
+        compatible &= (globalIndex[i] != prongIds[iProng]);
+      }
+      isCompatible[i] = compatible;
+      isInMassWindow[i] = !(std::abs(invMass - massMother) > invMassWindow);
+    }
+  }
+};
+
+#endif // PWGHF_UTILS_UTILSREDUCEDDATACREATION_H_
@@ -15,6 +15,10 @@
 ///
 /// \author Bong-Hwi Lim <bong-hwi.lim@cern.ch>
 
+#include <algorithm>
+#include <array>
+#include <vector>
+
 #include "Common/DataModel/PIDResponse.h"
 #include "Common/Core/TrackSelection.h"
 #include "Common/DataModel/Centrality.h"
@@ -41,6 +45,68 @@ using namespace o2::framework;
 using namespace o2::framework::expressions;
 using namespace o2::soa;
 
+/// Compact lineage of the MC particles of one DF, indexed by McParticle row.
+/// For each particle it keeps the global indices and PDG codes of the first two mothers and of the first two
+/// daughters (daughters with global index 0 are skipped), -1 when missing. It is built once per DF, by a dedicated
+/// process function which runs before the per-collision ones, so that the MC tables of the resonance candidates are
+/// filled by indexed lookups instead of walking mothers and daughters for each candidate.
+struct ResoMCLineage {
+  std::vector<int> pdg;
+  std::vector<std::array<int, 2>> mothers;
+  std::vector<std::array<int, 2>> motherPDGs;
+  std::vector<std::array<int, 2>> daughters;
+  std::vector<std::array<int, 2>> daughterPDGs;
+
+  /// Row in the lineage of the MC particle with global index globalIndex
+  int64_t row(int64_t globalIndex) const { return globalIndex - mOffset; }
+
+  /// Builds the lineage of the McParticles table of the DF
+  template <typename McParticlesType>
+  void build(McParticlesType const& mcParticles)
+  {
+    const auto nParticles = mcParticles.size();
+    mOffset = mcParticles.offset();
+
+    pdg.resize(nParticles);
+    int64_t i = 0;
+    for (auto& particle : mcParticles) {
+      pdg[i++] = particle.pdgCode();
+    }
+
+    mothers.assign(nParticles, {-1, -1});
+    motherPDGs.assign(nParticles, {-1, -1});
+    daughters.assign(nParticles, {-1, -1});
+    daughterPDGs.assign(nParticles, {-1, -1});
+    i = 0;
+    for (auto& particle : mcParticles) {
+      if (particle.has_mothers()) {
+        const auto& motherIds = particle.mothersIds();
+        const int nMothers = std::min<int>(motherIds.size(), 2);
+        for (int iMother = 0; iMother < nMothers; ++iMother) {
+          mothers[i][iMother] = motherIds[iMother];
+          motherPDGs[i][iMother] = pdg[row(motherIds[iMother])];
+        }
+      }
+      if (particle.has_daughters()) {
+        const auto& daughterIds = particle.daughtersIds();
+        int nDaughters = 0;
+        for (int daughterId = daughterIds[0]; daughterId <= daughterIds[1] && nDaughters < 2; ++daughterId) {
+          if (daughterId == 0) {
+            continue;
+          }
+          daughters[i][nDaughters] = daughterId;
+          daughterPDGs[i][nDaughters] = pdg[row(daughterId)];
+          ++nDaughters;
+        }
+      }
+      ++i;
+    }
+  }
+
+ private:
+  int64_t mOffset = 0;
+};
+
 /// Initializer for the resonance candidate producers
 struct reso2initializer {
   float cXiMass = RecoDecay::getMassPDG(3312);
@@ -57,6 +123,8 @@ struct reso2initializer {
   Produces<aod::ResoMCV0s> reso2mcv0s;
   Produces<aod::ResoMCCascades> reso2mccascades;
 
+  ResoMCLineage mcLineage; // MC mothers and daughters of the current DF, built by processMCLineage
+
   // CCDB options
   Configurable<std::string> ccdburl{"ccdb-url", "http://alice-ccdb.cern.ch", "url of the ccdb repository"};
   Configurable<std::string> grpPath{"grpPath", "GLO/GRP/GRP", "Path of the grp file"};
@@ -373,48 +441,20 @@ struct reso2initializer {
   template <typename TrackType>
   void fillMCTrack(TrackType const& track)
   {
-    // ------ Temporal lambda function to prevent error in build
-    auto getMothersIndeces = [&](auto const& theMcParticle) {
-      std::vector<int> lMothersIndeces{};
-      for (auto& lMother : theMcParticle.template mothers_as<aod::McParticles>()) {
-        LOGF(debug, "   mother index lMother: %d", lMother.globalIndex());
-        lMothersIndeces.push_back(lMother.globalIndex());
-      }
-      return lMothersIndeces;
-    };
-    auto getMothersPDGCodes = [&](auto const& theMcParticle) {
-      std::vector<int> lMothersPDGs{};
-      for (auto& lMother : theMcParticle.template mothers_as<aod::McParticles>()) {
-        LOGF(debug, "   mother pdgcode lMother: %d", lMother.pdgCode());
-        lMothersPDGs.push_back(lMother.pdgCode());
-      }
-      return lMothersPDGs;
-    };
-    // ------
-    std::vector<int> mothers = {-1, -1};
-    std::vector<int> motherPDGs = {-1, -1};
     if (track.has_mcParticle()) {
-      //
       // Get the MC particle
       const auto& particle = track.mcParticle();
-      if (particle.has_mothers()) {
-        mothers = getMothersIndeces(particle);
-        motherPDGs = getMothersPDGCodes(particle);
-      }
-      while (mothers.size() > 2) {
-        mothers.pop_back();
-        motherPDGs.pop_back();
-      }
+      const auto row = mcLineage.row(track.mcParticleId());
       reso2mctracks(particle.pdgCode(),
-                    mothers[0],
-                    motherPDGs[0],
+                    mcLineage.mothers[row][0],
+                    mcLineage.motherPDGs[row][0],
                     particle.isPhysicalPrimary(),
                     particle.producedByGenerator());
     } else {
       // No MC particle associated
       reso2mctracks(0,
-                    mothers[0],
-                    motherPDGs[0],
+                    -1,
+                    -1,
                     0,
                     0);
     }
@@ -423,70 +463,14 @@ struct reso2initializer {
   template <typename V0Type>
   void fillMCV0(V0Type const& v0)
   {
-    // ------ Temporal lambda function to prevent error in build
-    auto getMothersIndeces = [&](auto const& theMcParticle) {
-      std::vector<int> lMothersIndeces{};
-      for (auto& lMother : theMcParticle.template mothers_as<aod::McParticles>()) {
-        LOGF(debug, "   mother index lMother: %d", lMother.globalIndex());
-        lMothersIndeces.push_back(lMother.globalIndex());
-      }
-      return lMothersIndeces;
-    };
-    auto getMothersPDGCodes = [&](auto const& theMcParticle) {
-      std::vector<int> lMothersPDGs{};
-      for (auto& lMother : theMcParticle.template mothers_as<aod::McParticles>()) {
-        LOGF(debug, "   mother pdgcode lMother: %d", lMother.pdgCode());
-        lMothersPDGs.push_back(lMother.pdgCode());
-      }
-      return lMothersPDGs;
-    };
-    auto getDaughtersIndeces = [&](auto const& theMcParticle) {
-      std::vector<int> lDaughtersIndeces{};
-      for (auto& lDaughter : theMcParticle.template daughters_as<aod::McParticles>()) {
-        LOGF(debug, "   daughter index lDaughter: %d", lDaughter.globalIndex());
-        if (lDaughter.globalIndex() != 0) {
-          lDaughtersIndeces.push_back(lDaughter.globalIndex());
-        }
-      }
-      return lDaughtersIndeces;
-    };
-    auto getDaughtersPDGCodes = [&](auto const& theMcParticle) {
-      std::vector<int> lDaughtersPDGs{};
-      for (auto& lDaughter : theMcParticle.template daughters_as<aod::McParticles>()) {
-        LOGF(debug, "   daughter pdgcode lDaughter: %d", lDaughter.pdgCode());
-        if (lDaughter.globalIndex() != 0) {
-          lDaughtersPDGs.push_back(lDaughter.pdgCode());
-        }
-      }
-      return lDaughtersPDGs;
-    };
-    // ------
-    std::vector<int> mothers = {-1, -1};
-    std::vector<int> motherPDGs = {-1, -1};
-    std::vector<int> daughters = {-1, -1};
-    std::vector<int> daughterPDGs = {-1, -1};
     if (v0.has_mcParticle()) {
       auto v0mc = v0.mcParticle();
-      if (v0mc.has_mothers()) {
-        mothers = getMothersIndeces(v0mc);
-        motherPDGs = getMothersPDGCodes(v0mc);
-      }
-      while (mothers.size() > 2) {
-        mothers.pop_back();
-        motherPDGs.pop_back();
-      }
-      if (v0mc.has_daughters()) {
-        daughters = getDaughtersIndeces(v0mc);
-        daughterPDGs = getDaughtersPDGCodes(v0mc);
-      }
-      while (daughters.size() > 2) {
-        LOGF(info, "daughters.size() is larger than 2");
-        daughters.pop_back();
-        daughterPDGs.pop_back();
-      }
+      const auto row = mcLineage.row(v0.mcParticleId());
+      const auto& daughters = mcLineage.daughters[row];
+      const auto& daughterPDGs = mcLineage.daughterPDGs[row];
       reso2mcv0s(v0mc.pdgCode(),
-                 mothers[0],
-                 motherPDGs[0],
+                 mcLineage.mothers[row][0],
+                 mcLineage.motherPDGs[row][0],
                  daughters[0],
                  daughters[1],
                  daughterPDGs[0],
@@ -495,12 +479,12 @@ struct reso2initializer {
                  v0mc.producedByGenerator());
     } else {
       reso2mcv0s(0,
-                 mothers[0],
-                 motherPDGs[0],
-                 daughters[0],
-                 daughters[1],
-                 daughterPDGs[0],
-                 daughterPDGs[1],
+                 -1,
+                 -1,
+                 -1,
+                 -1,
+                 -1,
+                 -1,
                  0,
                  0);
     }
@@ -509,70 +493,14 @@ struct reso2initializer {
   template <typename CascType>
   void fillMCCascade(CascType const& casc)
   {
-    // ------ Temporal lambda function to prevent error in build
-    auto getMothersIndeces = [&](auto const& theMcParticle) {
-      std::vector<int> lMothersIndeces{};
-      for (auto& lMother : theMcParticle.template mothers_as<aod::McParticles>()) {
-        LOGF(debug, "   mother index lMother: %d", lMother.globalIndex());
-        lMothersIndeces.push_back(lMother.globalIndex());
-      }
-      return lMothersIndeces;
-    };
-    auto getMothersPDGCodes = [&](auto const& theMcParticle) {
-      std::vector<int> lMothersPDGs{};
-      for (auto& lMother : theMcParticle.template mothers_as<aod::McParticles>()) {
-        LOGF(debug, "   mother pdgcode lMother: %d", lMother.pdgCode());
-        lMothersPDGs.push_back(lMother.pdgCode());
-      }
-      return lMothersPDGs;
-    };
-    auto getDaughtersIndeces = [&](auto const& theMcParticle) {
-      std::vector<int> lDaughtersIndeces{};
-      for (auto& lDaughter : theMcParticle.template daughters_as<aod::McParticles>()) {
-        LOGF(debug, "   daughter index lDaughter: %d", lDaughter.globalIndex());
-        if (lDaughter.globalIndex() != 0) {
-          lDaughtersIndeces.push_back(lDaughter.globalIndex());
-        }
-      }
-      return lDaughtersIndeces;
-    };
-    auto getDaughtersPDGCodes = [&](auto const& theMcParticle) {
-      std::vector<int> lDaughtersPDGs{};
-      for (auto& lDaughter : theMcParticle.template daughters_as<aod::McParticles>()) {
-        LOGF(debug, "   daughter pdgcode lDaughter: %d", lDaughter.pdgCode());
-        if (lDaughter.globalIndex() != 0) {
-          lDaughtersPDGs.push_back(lDaughter.pdgCode());
-        }
-      }
-      return lDaughtersPDGs;
-    };
-    // ------
-    std::vector<int> mothers = {-1, -1};
-    std::vector<int> motherPDGs = {-1, -1};
-    std::vector<int> daughters = {-1, -1};
-    std::vector<int> daughterPDGs = {-1, -1};
     if (casc.has_mcParticle()) {
       auto cascmc = casc.mcParticle();
-      if (cascmc.has_mothers()) {
-        mothers = getMothersIndeces(cascmc);
-        motherPDGs = getMothersPDGCodes(cascmc);
-      }
-      while (mothers.size() > 2) {
-        mothers.pop_back();
-        motherPDGs.pop_back();
-      }
-      if (cascmc.has_daughters()) {
-        daughters = getDaughtersIndeces(cascmc);
-        daughterPDGs = getDaughtersPDGCodes(cascmc);
-      }
-      while (daughters.size() > 2) {
-        LOGF(info, "daughters.size() is larger than 2");
-        daughters.pop_back();
-        daughterPDGs.pop_back();
-      }
+      const auto row = mcLineage.row(casc.mcParticleId());
+      const auto& daughters = mcLineage.daughters[row];
+      const auto& daughterPDGs = mcLineage.daughterPDGs[row];
       reso2mccascades(cascmc.pdgCode(),
-                      mothers[0],
-                      motherPDGs[0],
+                      mcLineage.mothers[row][0],
+                      mcLineage.motherPDGs[row][0],
                       daughters[0],
                       daughters[1],
                       daughterPDGs[0],
@@ -581,28 +509,26 @@ struct reso2initializer {
                       cascmc.producedByGenerator());
     } else {
       reso2mccascades(0,
-                      mothers[0],
-                      motherPDGs[0],
-                      daughters[0],
-                      daughters[1],
-                      daughterPDGs[0],
-                      daughterPDGs[1],
+                      -1,
+                      -1,
+                      -1,
+                      -1,
+                      -1,
+                      -1,
                       0,
                       0);
     }
   }
   // Additonoal information for MC Cascades
-  template <typename SelectedMCPartType, typename TotalMCParts>
-  void fillMCParticles(SelectedMCPartType const& mcParts, TotalMCParts const& mcParticles)
+  template <typename SelectedMCPartType>
+  void fillMCParticles(SelectedMCPartType const& mcParts)
   {
     for (auto& mcPart : mcParts) {
-      std::vector<int> daughterPDGs;
+      int daughterPDGs[2] = {-1, -1};
       if (mcPart.has_daughters()) {
-        auto daughter01 = mcParticles.rawIteratorAt(mcPart.daughtersIds()[0] - mcParticles.offset());
-        auto daughter02 = mcParticles.rawIteratorAt(mcPart.daughtersIds()[1] - mcParticles.offset());
-        daughterPDGs = {daughter01.pdgCode(), daughter02.pdgCode()};
-      } else {
-        daughterPDGs = {-1, -1};
+        // first and last daughter of the slice
+        daughterPDGs[0] = mcLineage.pdg[mcLineage.row(mcPart.daughtersIds()[0])];
+        daughterPDGs[1] = mcLineage.pdg[mcLineage.row(mcPart.daughtersIds()[1])];
       }
       reso2mcparents(resoCollisions.lastIndex(),
                      mcPart.globalIndex(),
@@ -617,7 +543,6 @@ struct reso2initializer {
                      mcPart.eta(),
                      mcPart.phi(),
                      mcPart.y());
-      daughterPDGs.clear();
     }
   }
 
@@ -627,6 +552,9 @@ struct reso2initializer {
     d_bz = 0;
     colCuts.setCuts(ConfEvtZvtx, ConfEvtTriggerCheck, ConfEvtTriggerSel, ConfEvtOfflineCheck, ConfIsRun3);
     colCuts.init(&qaRegistry);
+    if ((doprocessTrackMC || doprocessTrackV0MC || doprocessTrackV0CascMC) && !doprocessMCLineage) {
+      LOGF(fatal, "processMCLineage must be enabled together with the MC processes");
+    }
   }
 
   void initCCDB(aod::BCsWithTimestamps::iterator const& bc) // Simple copy from LambdaKzeroFinder.cxx
@@ -740,6 +668,14 @@ struct reso2initializer {
   }
   PROCESS_SWITCH(reso2initializer, processTrackV0CascData, "Process for data", false);
 
+  // The process functions are run in the order of their declaration: the lineage is built for the whole DF before
+  // the per-collision MC processes use it
+  void processMCLineage(aod::McParticles const& mcParticles)
+  {
+    mcLineage.build(mcParticles);
+  }
+  PROCESS_SWITCH(reso2initializer, processMCLineage, "Build the MC lineage of the DF, needed by the MC processes", false);
+
   Preslice<aod::McParticles> perMcCollision = aod::mcparticle::mcCollisionId;
   void processTrackMC(soa::Filtered<soa::Join<ResoEvents, aod::McCollisionLabels>>::iterator const& collision,
                       aod::McCollisions const& mcCols, soa::Filtered<ResoTracksMC> const& tracks,
@@ -762,7 +698,7 @@ struct reso2initializer {
 
     // Loop over all MC particles
     auto mcParts = selectedMCParticles->sliceBy(perMcCollision, collision.mcCollision().globalIndex());
-    fillMCParticles(mcParts, mcParticles);
+    fillMCParticles(mcParts);
   }
   PROCESS_SWITCH(reso2initializer, processTrackMC, "Process for MC", false);
 
@@ -789,7 +725,7 @@ struct reso2initializer {
 
     // Loop over all MC particles
     auto mcParts = selectedMCParticles->sliceBy(perMcCollision, collision.mcCollision().globalIndex());
-    fillMCParticles(mcParts, mcParticles);
+    fillMCParticles(mcParts);
   }
   PROCESS_SWITCH(reso2initializer, processTrackV0MC, "Process for MC", false);
 
@@ -819,7 +755,7 @@ struct reso2initializer {
 
     // Loop over all MC particles
     auto mcParts = selectedMCParticles->sliceBy(perMcCollision, collision.mcCollision().globalIndex());
-    fillMCParticles(mcParts, mcParticles);
+    fillMCParticles(mcParts);
   }
   PROCESS_SWITCH(reso2initializer, processTrackV0CascMC, "Process for MC", false);
 };
@@ -19,6 +19,7 @@
 // o2-analysis-pid-tof-base, o2-analysis-multiplicity-table, o2-analysis-event-selection
 
 #include <cmath>
+#include <vector>
 
 #include "Math/Vector4D.h"
 
@@ -161,6 +162,56 @@ std::shared_ptr<TH2> hGloTOFtracks[2];
 o2::base::MatLayerCylSet* lut = nullptr;
 
 std::vector<NucleusCandidate> candidates;
+
+/// Batch TPC PID of the tracks of one collision.
+/// The rigidity and the dE/dx of the tracks are stored in contiguous arrays and the expected Bethe-Bloch and the TPC
+/// nsigma are evaluated species by species in plain loops over the tracks. The output is a bitmask per track, with
+/// BIT(iS) set if the track is compatible with the species iS, so that the propagation to the vertex and the TOF mass
+/// are computed only for the nuclei candidates.
+struct TPCPIDKernel {
+  std::vector<float> rigidity;
+  std::vector<float> dEdx;
+  std::vector<uint8_t> chargeIndex; /// 0 for positive, 1 for negative tracks
+  std::vector<uint8_t> isGood;      /// track passing the quality selections
+  std::vector<float> nSigma[species];
+  std::vector<uint8_t> mask;
+
+  void clear()
+  {
+    rigidity.clear();
+    dEdx.clear();
+    chargeIndex.clear();
+    isGood.clear();
+    mask.clear();
+  }
+
+  size_t size() const { return rigidity.size(); }
+
+  void add(float aRigidity, float aDEdx, int iC, bool good)
+  {
+    rigidity.push_back(aRigidity);
+    dEdx.push_back(aDEdx);
+    chargeIndex.push_back(iC);
+    isGood.push_back(good);
+  }
+
+  void evaluate(const double bgScalings[species][2], const double bbParams[species][6], const float cuts[species][2])
+  {
+    const size_t n{size()};
+    mask.assign(n, 0u);
+    for (int iS{0}; iS < species; ++iS) {
+      nSigma[iS].resize(n);
+      const double* par{bbParams[iS]};
+      const float cutMin{cuts[iS][0]}, cutMax{cuts[iS][1]};
+      for (size_t i{0}; i < n; ++i) {
+        const double expBethe{tpc::BetheBlochAleph(static_cast<double>(rigidity[i] * bgScalings[iS][chargeIndex[i]]), par[0], par[1], par[2], par[3], par[4])};
+        const float nSigmaTrack{static_cast<float>((dEdx[i] - expBethe) / (expBethe * par[5]))};
+        nSigma[iS][i] = nSigmaTrack;
+        mask[i] |= static_cast<uint8_t>((isGood[i] && nSigmaTrack > cutMin && nSigmaTrack < cutMax) << iS);
+      }
+    }
+  }
+};
 } // namespace nuclei
 
 struct nucleiSpectra {
@@ -232,6 +283,7 @@ struct nucleiSpectra {
 
   HistogramRegistry spectra{"spectra", {}, OutputObjHandlingPolicy::AnalysisObject, true, true};
   o2::pid::tof::Beta<TrackCandidates::iterator> responseBeta;
+  nuclei::TPCPIDKernel mPIDKernel;
 
   void initCCDB(aod::BCsWithTimestamps::iterator const& bc)
   {
@@ -342,39 +394,53 @@ struct nucleiSpectra {
       {nuclei::charges[2] * cfgMomentumScalingBetheBloch->get(2u, 0u) / nuclei::masses[2], nuclei::charges[2] * cfgMomentumScalingBetheBloch->get(2u, 1u) / nuclei::masses[2]},
       {nuclei::charges[3] * cfgMomentumScalingBetheBloch->get(3u, 0u) / nuclei::masses[3], nuclei::charges[3] * cfgMomentumScalingBetheBloch->get(3u, 1u) / nuclei::masses[3]}};
 
+    double bbParams[4][6];
+    for (int iS{0}; iS < nuclei::species; ++iS) {
+      for (int iPar{0}; iPar < 6; ++iPar) {
+        bbParams[iS][iPar] = cfgBetheBlochParams->get(iS, iPar);
+      }
+    }
+
     int nGloTracks[2]{0, 0}, nTOFTracks[2]{0, 0};
-    for (auto& track : tracks) { // start loop over tracks
-      if (track.itsNCls() < cfgCutNclusITS ||
-          track.tpcNClsFound() < cfgCutNclusTPC ||
-          track.tpcNClsCrossedRows() < 70 ||
-          track.tpcNClsCrossedRows() < 0.8 * track.tpcNClsFindable() ||
-          track.tpcChi2NCl() > 4.f ||
-          track.itsChi2NCl() > 36.f) {
+    mPIDKernel.clear();
+    for (auto& track : tracks) { // first loop over tracks: quality selections and inputs of the TPC PID
+      const bool isGood{track.itsNCls() >= cfgCutNclusITS &&
+                        track.tpcNClsFound() >= cfgCutNclusTPC &&
+                        track.tpcNClsCrossedRows() >= 70 &&
+                        track.tpcNClsCrossedRows() >= 0.8 * track.tpcNClsFindable() &&
+                        track.tpcChi2NCl() <= 4.f &&
+                        track.itsChi2NCl() <= 36.f};
+      const int iC{track.sign() < 0};
+      mPIDKernel.add(track.tpcInnerParam(), track.tpcSignal(), iC, isGood);
+      if (!isGood) {
         continue;
       }
       spectra.fill(HIST("hTpcSignalData"), track.tpcInnerParam() * track.sign(), track.tpcSignal());
-      float nSigma[2][4]{
-        {-10., -10., -10., -10.},
-        {0.f, 0.f, 0.f, 0.f}}; /// then we will calibrate the TOF mass for the He3 and Alpha
-      const int iC{track.sign() < 0};
 
       /// Checking if we have outliers in the TPC-TOF correlation
       nGloTracks[iC]++;
       if (track.hasTOF()) {
         nTOFTracks[iC]++;
       }
+    }
+    mPIDKernel.evaluate(bgScalings, bbParams, nuclei::pidCuts[0]);
 
-      bool selectedTPC[4]{false}, goodToAnalyse{false};
-      for (int iS{0}; iS < nuclei::species; ++iS) {
-        double expBethe{tpc::BetheBlochAleph(static_cast<double>(track.tpcInnerParam() * bgScalings[iS][iC]), cfgBetheBlochParams->get(iS, 0u), cfgBetheBlochParams->get(iS, 1u), cfgBetheBlochParams->get(iS, 2u), cfgBetheBlochParams->get(iS, 3u), cfgBetheBlochParams->get(iS, 4u))};
-        double expSigma{expBethe * cfgBetheBlochParams->get(iS, 5u)};
-        nSigma[0][iS] = static_cast<float>((track.tpcSignal() - expBethe) / expSigma);
-        selectedTPC[iS] = (nSigma[0][iS] > nuclei::pidCuts[0][iS][0] && nSigma[0][iS] < nuclei::pidCuts[0][iS][1]);
-        goodToAnalyse = goodToAnalyse || selectedTPC[iS];
-      }
-      if (!goodToAnalyse) {
+    size_t iTrack{0};
+    for (auto& track : tracks) { // start loop over tracks
+      const size_t iKernel{iTrack++};
+      const uint8_t pidMask{mPIDKernel.mask[iKernel]};
+      if (!pidMask) {
         continue;
       }
+      float nSigma[2][4]{
+        {mPIDKernel.nSigma[0][iKernel], mPIDKernel.nSigma[1][iKernel], mPIDKernel.nSigma[2][iKernel], mPIDKernel.nSigma[3][iKernel]},
+        {0.f, 0.f, 0.f, 0.f}}; /// then we will calibrate the TOF mass for the He3 and Alpha
+      const int iC{mPIDKernel.chargeIndex[iKernel]};
+
+      bool selectedTPC[4]{false};
+      for (int iS{0}; iS < nuclei::species; ++iS) {
+        selectedTPC[iS] = pidMask & BIT(iS);
+      }
 
       auto trackParCov = getTrackParCov(track); // should we set the charge according to the nucleus?
       gpu::gpustd::array<float, 2> dcaInfo;
@@ -30,7 +30,13 @@
 #include "Framework/ASoAHelpers.h"
 #include "Common/DataModel/Multiplicity.h"
 #include "Common/DataModel/Centrality.h"
+#include "Common/Core/HistogramAccumulator.h"
 #include "Framework/StaticFor.h"
+#include "THn.h"
+#include "TAxis.h"
+
+#include <array>
+#include <vector>
 
 using namespace o2;
 using namespace o2::framework;
@@ -71,132 +77,237 @@ struct correlateStrangeness {
   static constexpr std::string_view v0names[] = {"K0Short", "Lambda", "AntiLambda"};
   static constexpr std::string_view cascadenames[] = {"XiMinus", "XiPlus", "OmegaMinus", "OmegaPlus"};
 
-  /// Function to aid in calculating delta-phi
-  /// \param phi1 first phi value
-  /// \param phi2 second phi value
-  Double_t ComputeDeltaPhi(Double_t phi1, Double_t phi2)
-  {
-    Double_t deltaPhi = phi1 - phi2;
-    if (deltaPhi < -TMath::Pi() / 2.) {
-      deltaPhi += 2. * TMath::Pi();
+  /// Dense local (delta phi, delta eta, pt assoc) histograms, one per species and mass region.
+  /// The pv z and multiplicity are constant within one call of the correlation functions, so the
+  /// pairs are counted here and added to the THn once per call.
+  struct CorrelationAccumulator {
+    static constexpr int nSlots = 12; // 3 mass regions x at most 4 species
+    int nPhi = 0;                     // number of bins including under- and overflow
+    int nEta = 0;
+    int nPt = 0;
+    int nCells = 0;
+    o2::analysis::DenseCounts counts; // indexed by slot * nCells + cell
+
+    void setup(int nPhiBins, int nEtaBins, int nPtBins)
+    {
+      nPhi = nPhiBins + 2;
+      nEta = nEtaBins + 2;
+      nPt = nPtBins + 2;
+      nCells = nPhi * nEta * nPt;
+      counts.resize(nSlots * nCells);
     }
-    if (deltaPhi > 3 * TMath::Pi() / 2.) {
-      deltaPhi -= 2. * TMath::Pi();
+    void add(int slot, int cell) { counts.add(slot * nCells + cell); }
+  };
+
+  // struct-of-arrays buffers of the triggers and associated particles of the current call
+  struct TriggerBuffer {
+    std::vector<float> phi;
+    std::vector<float> eta;
+    std::vector<int64_t> trackId;
+    void clear()
+    {
+      phi.clear();
+      eta.clear();
+      trackId.clear();
     }
-    return deltaPhi;
-  }
+  };
+  struct AssociatedBuffer {
+    std::vector<float> phi;
+    std::vector<float> eta;
+    std::vector<int> ptBin;
+    std::vector<uint32_t> regions; // bit (3 * species + region) set if the pair is to be counted for this species and mass region
+    std::vector<int64_t> daughter0;
+    std::vector<int64_t> daughter1;
+    std::vector<int64_t> daughter2; // -1 for V0s
+    void clear()
+    {
+      phi.clear();
+      eta.clear();
+      ptBin.clear();
+      regions.clear();
+      daughter0.clear();
+      daughter1.clear();
+      daughter2.clear();
+    }
+  };
 
-  void fillCorrelationsV0(aod::TriggerTracks const& triggers, aod::AssocV0s const& assocs, bool mixing, float pvz, float mult)
-  {
-    bool correlateV0s[3];
-    for (int ip = 0; ip < 3; ip++)
-      correlateV0s[ip] = false;
-    if (doCorrelationK0Short)
-      correlateV0s[0] = true;
-    if (doCorrelationLambda)
-      correlateV0s[1] = true;
-    if (doCorrelationAntiLambda)
-      correlateV0s[2] = true;
+  TriggerBuffer triggerBuffer;
+  AssociatedBuffer assocBuffer;
+  CorrelationAccumulator accumulator;
+  o2::analysis::AxisBinning binningDeltaPhi, binningDeltaEta, binningPtAssoc;
+  std::vector<float> pairDeltaPhi, pairDeltaEta;
+  std::vector<uint8_t> pairAccepted;
+
+  // correlation histograms indexed by [mixing][3 * species + region], null if the species is not enabled
+  std::array<std::array<THn*, CorrelationAccumulator::nSlots>, 2> hCorrelationsV0{};
+  std::array<std::array<THn*, CorrelationAccumulator::nSlots>, 2> hCorrelationsCascade{};
 
+  void fillTriggerBuffer(aod::TriggerTracks const& triggers, bool mixing, float mult, bool isV0)
+  {
+    triggerBuffer.clear();
     for (auto& triggerTrack : triggers) {
       auto trigg = triggerTrack.track_as<TracksComplete>();
-      if (!mixing)
-        histos.fill(HIST("sameEvent/TriggerParticlesV0"), trigg.pt(), mult);
-      for (auto& assocCandidate : assocs) {
-        auto assoc = assocCandidate.v0Data();
-
-        //---] removing autocorrelations [---
-        auto postrack = assoc.posTrack_as<TracksComplete>();
-        auto negtrack = assoc.negTrack_as<TracksComplete>();
-        if (trigg.globalIndex() == postrack.globalIndex())
+      if (!mixing) {
+        if (isV0) {
+          histos.fill(HIST("sameEvent/TriggerParticlesV0"), trigg.pt(), mult);
+        } else {
+          histos.fill(HIST("sameEvent/TriggerParticlesCascade"), trigg.pt(), mult);
+        }
+      }
+      triggerBuffer.phi.push_back(trigg.phi());
+      triggerBuffer.eta.push_back(trigg.eta());
+      triggerBuffer.trackId.push_back(trigg.globalIndex());
+    }
+  }
+
+  /// Correlates all triggers with all associated particles in the buffers.
+  /// Delta phi, delta eta and the autocorrelation check are computed for a full row of associated
+  /// particles in a branch-free loop, the accepted pairs are then counted in the local histograms.
+  void correlateBuffers()
+  {
+    const size_t nAssoc = assocBuffer.phi.size();
+    if (nAssoc == 0) {
+      return;
+    }
+    pairDeltaPhi.resize(nAssoc);
+    pairDeltaEta.resize(nAssoc);
+    pairAccepted.resize(nAssoc);
+    const float* assocPhi = assocBuffer.phi.data();
+    const float* assocEta = assocBuffer.eta.data();
+    const int64_t* daughter0 = assocBuffer.daughter0.data();
+    const int64_t* daughter1 = assocBuffer.daughter1.data();
+    const int64_t* daughter2 = assocBuffer.daughter2.data();
+    float* deltaPhi = pairDeltaPhi.data();
+    float* deltaEta = pairDeltaEta.data();
+    uint8_t* accepted = pairAccepted.data();
+    constexpr float phiLow = -0.5f * static_cast<float>(M_PI);
+    constexpr float phiHigh = 1.5f * static_cast<float>(M_PI);
+    constexpr float twoPi = 2.f * static_cast<float>(M_PI);
+
+    for (size_t iTrigger = 0; iTrigger < triggerBuffer.phi.size(); iTrigger++) {
+      const float triggerPhi = triggerBuffer.phi[iTrigger];
+      const float triggerEta = triggerBuffer.eta[iTrigger];
+      const int64_t triggerId = triggerBuffer.trackId[iTrigger];
+      for (size_t j = 0; j < nAssoc; j++) {
+        float dphi = triggerPhi - assocPhi[j];
+        dphi += (dphi < phiLow) ? twoPi : 0.f;
+        dphi -= (dphi > phiHigh) ? twoPi : 0.f;
+        deltaPhi[j] = dphi;
+        deltaEta[j] = triggerEta - assocEta[j];
+        // removing autocorrelations
+        accepted[j] = (daughter0[j] != triggerId) & (daughter1[j] != triggerId) & (daughter2[j] != triggerId);
+      }
+      for (size_t j = 0; j < nAssoc; j++) {
+        if (!accepted[j]) {
           continue;
-        if (trigg.globalIndex() == negtrack.globalIndex())
+        }
+        int cell = binningDeltaPhi.find(deltaPhi[j]) + accumulator.nPhi * (binningDeltaEta.find(deltaEta[j]) + accumulator.nEta * assocBuffer.ptBin[j]);
+        for (uint32_t regions = assocBuffer.regions[j]; regions; regions &= regions - 1) {
+          accumulator.add(__builtin_ctz(regions), cell);
+        }
+      }
+    }
+  }
+
+  /// Adds the local histograms to the THn at the given pv z and multiplicity, and resets them
+  void flushAccumulator(std::array<THn*, CorrelationAccumulator::nSlots> const& hists, float pvz, float mult)
+  {
+    std::array<double, CorrelationAccumulator::nSlots> entries{};
+    accumulator.counts.flush([&](uint32_t idx, uint32_t count) {
+      int slot = idx / accumulator.nCells;
+      int cell = idx % accumulator.nCells;
+      THn* hist = hists[slot];
+      if (!hist) {
+        return;
+      }
+      Int_t coordinates[5] = {cell % accumulator.nPhi, (cell / accumulator.nPhi) % accumulator.nEta, cell / (accumulator.nPhi * accumulator.nEta),
+                              hist->GetAxis(3)->FindBin(pvz), hist->GetAxis(4)->FindBin(mult)};
+      Long64_t bin = hist->GetBin(coordinates);
+      hist->AddBinContent(bin, count);
+      if (hist->GetCalculateErrors()) {
+        hist->AddBinError2(bin, count);
+      }
+      entries[slot] += count;
+    });
+    for (int slot = 0; slot < CorrelationAccumulator::nSlots; slot++) {
+      if (entries[slot] > 0) {
+        hists[slot]->SetEntries(hists[slot]->GetEntries() + entries[slot]);
+      }
+    }
+  }
+
+  void fillCorrelationsV0(aod::TriggerTracks const& triggers, aod::AssocV0s const& assocs, bool mixing, float pvz, float mult)
+  {
+    bool correlateV0s[3] = {doCorrelationK0Short, doCorrelationLambda, doCorrelationAntiLambda};
+
+    fillTriggerBuffer(triggers, mixing, mult, true);
+    assocBuffer.clear();
+    for (auto& assocCandidate : assocs) {
+      uint32_t regions = 0;
+      for (int index = 0; index < 3; index++) {
+        if (!correlateV0s[index] || !assocCandidate.compatible(index)) {
           continue;
-        // TODO: add histogram checking how many pairs are rejected (should be small!)
-
-        float deltaphi = ComputeDeltaPhi(trigg.phi(), assoc.phi());
-        float deltaeta = trigg.eta() - assoc.eta();
-        float ptassoc = assoc.pt();
-        static_for<0, 2>([&](auto i) {
-          constexpr int index = i.value;
-          if (correlateV0s[index]) {
-            if (assocCandidate.compatible(index) && !mixing && assocCandidate.inMassRegionCheck(index, 1))
-              histos.fill(HIST("sameEvent/LeftBg/") + HIST(v0names[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && !mixing && assocCandidate.inMassRegionCheck(index, 2))
-              histos.fill(HIST("sameEvent/Signal/") + HIST(v0names[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && !mixing && assocCandidate.inMassRegionCheck(index, 3))
-              histos.fill(HIST("sameEvent/RightBg/") + HIST(v0names[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && mixing && assocCandidate.inMassRegionCheck(index, 1))
-              histos.fill(HIST("mixedEvent/LeftBg/") + HIST(v0names[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && mixing && assocCandidate.inMassRegionCheck(index, 2))
-              histos.fill(HIST("mixedEvent/Signal/") + HIST(v0names[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && mixing && assocCandidate.inMassRegionCheck(index, 3))
-              histos.fill(HIST("mixedEvent/RightBg/") + HIST(v0names[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
+        }
+        for (int region = 0; region < 3; region++) {
+          if (assocCandidate.inMassRegionCheck(index, region + 1)) {
+            regions |= 1u << (3 * index + region);
           }
-        });
+        }
       }
+      if (regions == 0) {
+        continue;
+      }
+      auto assoc = assocCandidate.v0Data();
+      assocBuffer.phi.push_back(assoc.phi());
+      assocBuffer.eta.push_back(assoc.eta());
+      assocBuffer.ptBin.push_back(binningPtAssoc.find(assoc.pt()));
+      assocBuffer.regions.push_back(regions);
+      assocBuffer.daughter0.push_back(assoc.posTrackId());
+      assocBuffer.daughter1.push_back(assoc.negTrackId());
+      assocBuffer.daughter2.push_back(-1);
     }
+    // TODO: add histogram checking how many pairs are rejected (should be small!)
+    correlateBuffers();
+    flushAccumulator(hCorrelationsV0[mixing], pvz, mult);
   }
 
   void fillCorrelationsCascade(aod::TriggerTracks const& triggers, aod::AssocCascades const& assocs, bool mixing, float pvz, float mult)
   {
-    bool correlateCascades[4];
-    for (int ip = 0; ip < 4; ip++)
-      correlateCascades[ip] = false;
-    if (doCorrelationXiMinus)
-      correlateCascades[0] = true;
-    if (doCorrelationXiPlus)
-      correlateCascades[1] = true;
-    if (doCorrelationOmegaMinus)
-      correlateCascades[2] = true;
-    if (doCorrelationOmegaPlus)
-      correlateCascades[3] = true;
-
-    for (auto& triggerTrack : triggers) {
-      auto trigg = triggerTrack.track_as<TracksComplete>();
-      if (!mixing)
-        histos.fill(HIST("sameEvent/TriggerParticlesCascade"), trigg.pt(), mult);
-      for (auto& assocCandidate : assocs) {
-        auto assoc = assocCandidate.cascData();
-
-        //---] removing autocorrelations [---
-        auto v0index = assoc.v0_as<o2::aod::V0sLinked>();
-        if (!(v0index.has_v0Data()))
-          continue;                      // this should not happen - included for safety
-        auto assocV0 = v0index.v0Data(); // de-reference index to correct v0data in case it exists
-        auto postrack = assocV0.posTrack_as<TracksComplete>();
-        auto negtrack = assocV0.negTrack_as<TracksComplete>();
-        auto bachtrack = assoc.bachelor_as<TracksComplete>();
-        if (trigg.globalIndex() == postrack.globalIndex())
-          continue;
-        if (trigg.globalIndex() == negtrack.globalIndex())
-          continue;
-        if (trigg.globalIndex() == bachtrack.globalIndex())
+    bool correlateCascades[4] = {doCorrelationXiMinus, doCorrelationXiPlus, doCorrelationOmegaMinus, doCorrelationOmegaPlus};
+
+    fillTriggerBuffer(triggers, mixing, mult, false);
+    assocBuffer.clear();
+    for (auto& assocCandidate : assocs) {
+      uint32_t regions = 0;
+      for (int index = 0; index < 4; index++) {
+        if (!correlateCascades[index] || !assocCandidate.compatible(index)) {
           continue;
-        // TODO: add histogram checking how many pairs are rejected (should be small!)
-
-        float deltaphi = ComputeDeltaPhi(trigg.phi(), assoc.phi());
-        float deltaeta = trigg.eta() - assoc.eta();
-        float ptassoc = assoc.pt();
-        static_for<0, 3>([&](auto i) {
-          constexpr int index = i.value;
-          if (correlateCascades[index]) {
-            if (assocCandidate.compatible(index) && !mixing && assocCandidate.inMassRegionCheck(index, 1))
-              histos.fill(HIST("sameEvent/LeftBg/") + HIST(cascadenames[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && !mixing && assocCandidate.inMassRegionCheck(index, 2))
-              histos.fill(HIST("sameEvent/Signal/") + HIST(cascadenames[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && !mixing && assocCandidate.inMassRegionCheck(index, 3))
-              histos.fill(HIST("sameEvent/RightBg/") + HIST(cascadenames[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && mixing && assocCandidate.inMassRegionCheck(index, 1))
-              histos.fill(HIST("mixedEvent/LeftBg/") + HIST(cascadenames[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && mixing && assocCandidate.inMassRegionCheck(index, 2))
-              histos.fill(HIST("mixedEvent/Signal/") + HIST(cascadenames[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
-            if (assocCandidate.compatible(index) && mixing && assocCandidate.inMassRegionCheck(index, 3))
-              histos.fill(HIST("mixedEvent/RightBg/") + HIST(cascadenames[index]), deltaphi, deltaeta, ptassoc, pvz, mult);
+        }
+        for (int region = 0; region < 3; region++) {
+          if (assocCandidate.inMassRegionCheck(index, region + 1)) {
+            regions |= 1u << (3 * index + region);
           }
-        });
+        }
+      }
+      if (regions == 0) {
+        continue;
       }
+      auto assoc = assocCandidate.cascData();
+      auto v0index = assoc.v0_as<o2::aod::V0sLinked>();
+      if (!(v0index.has_v0Data()))
+        continue;                      // this should not happen - included for safety
+      auto assocV0 = v0index.v0Data(); // de-reference index to correct v0data in case it exists
+      assocBuffer.phi.push_back(assoc.phi());
+      assocBuffer.eta.push_back(assoc.eta());
+      assocBuffer.ptBin.push_back(binningPtAssoc.find(assoc.pt()));
+      assocBuffer.regions.push_back(regions);
+      assocBuffer.daughter0.push_back(assocV0.posTrackId());
+      assocBuffer.daughter1.push_back(assocV0.negTrackId());
+      assocBuffer.daughter2.push_back(assoc.bachelorId());
     }
+    // TODO: add histogram checking how many pairs are rejected (should be small!)
+    correlateBuffers();
+    flushAccumulator(hCorrelationsCascade[mixing], pvz, mult);
   }
 
   void init(InitContext const&)
@@ -259,6 +370,47 @@ struct correlateStrangeness {
     histos.add("EventQA/hMixingQA", "mixing QA", kTH1F, {{2, -0.5, 1.5}});
     histos.add("EventQA/hMult", "Multiplicity", kTH1F, {ConfMultBins});
     histos.add("EventQA/hPvz", ";pvz;Entries", kTH1F, {{30, -15, 15}});
+
+    // pointers to the correlation histograms for the pair kernel
+    bool doMixing = doprocessMixedEventHV0s || doprocessMixedEventHCascades;
+    bool correlateV0s[3] = {doCorrelationK0Short, doCorrelationLambda, doCorrelationAntiLambda};
+    bool correlateCascades[4] = {doCorrelationXiMinus, doCorrelationXiPlus, doCorrelationOmegaMinus, doCorrelationOmegaPlus};
+    THn* hTemplate = nullptr;
+    static_for<0, 2>([&](auto i) {
+      constexpr int index = i.value;
+      if (correlateV0s[index]) {
+        hCorrelationsV0[0][3 * index + 0] = histos.get<THn>(HIST("sameEvent/LeftBg/") + HIST(v0names[index])).get();
+        hCorrelationsV0[0][3 * index + 1] = histos.get<THn>(HIST("sameEvent/Signal/") + HIST(v0names[index])).get();
+        hCorrelationsV0[0][3 * index + 2] = histos.get<THn>(HIST("sameEvent/RightBg/") + HIST(v0names[index])).get();
+        if (doMixing) {
+          hCorrelationsV0[1][3 * index + 0] = histos.get<THn>(HIST("mixedEvent/LeftBg/") + HIST(v0names[index])).get();
+          hCorrelationsV0[1][3 * index + 1] = histos.get<THn>(HIST("mixedEvent/Signal/") + HIST(v0names[index])).get();
+          hCorrelationsV0[1][3 * index + 2] = histos.get<THn>(HIST("mixedEvent/RightBg/") + HIST(v0names[index])).get();
+        }
+        hTemplate = hCorrelationsV0[0][3 * index + 1];
+      }
+    });
+    static_for<0, 3>([&](auto i) {
+      constexpr int index = i.value;
+      if (correlateCascades[index]) {
+        hCorrelationsCascade[0][3 * index + 0] = histos.get<THn>(HIST("sameEvent/LeftBg/") + HIST(cascadenames[index])).get();
+        hCorrelationsCascade[0][3 * index + 1] = histos.get<THn>(HIST("sameEvent/Signal/") + HIST(cascadenames[index])).get();
+        hCorrelationsCascade[0][3 * index + 2] = histos.get<THn>(HIST("sameEvent/RightBg/") + HIST(cascadenames[index])).get();
+        if (doMixing) {
+          hCorrelationsCascade[1][3 * index + 0] = histos.get<THn>(HIST("mixedEvent/LeftBg/") + HIST(cascadenames[index])).get();
+          hCorrelationsCascade[1][3 * index + 1] = histos.get<THn>(HIST("mixedEvent/Signal/") + HIST(cascadenames[index])).get();
+          hCorrelationsCascade[1][3 * index + 2] = histos.get<THn>(HIST("mixedEvent/RightBg/") + HIST(cascadenames[index])).get();
+        }
+        hTemplate = hCorrelationsCascade[0][3 * index + 1];
+      }
+    });
+    // all correlation histograms share the same axes
+    if (hTemplate) {
+      binningDeltaPhi.set(hTemplate->GetAxis(0));
+      binningDeltaEta.set(hTemplate->GetAxis(1));
+      binningPtAssoc.set(hTemplate->GetAxis(2));
+      accumulator.setup(binningDeltaPhi.nBins, binningDeltaEta.nBins, binningPtAssoc.nBins);
+    }
   }
   BinningType colBinning{{ConfVtxBins, ConfMultBins}, true}; // true is for 'ignore overflows' (true by default). Underflows and overflows will have bin -1.
   void processSameEventHV0s(soa::Join<aod::Collisions, aod::EvSels, aod::CentFT0Ms>::iterator const& collision,
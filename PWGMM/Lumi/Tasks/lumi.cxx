@@ -20,6 +20,7 @@
 #include <iostream>
 #include <vector>
 
+#include "Common/Core/PVRefitter.h"
 #include "Common/Core/TrackSelection.h"
 #include "Common/Core/trackUtilities.h"
 #include "Common/DataModel/EventSelection.h"
@@ -128,6 +129,7 @@ struct lumiTask {
        {HistType::kTH2F, {{1000, -1, 1, "y"}, {1000, -1, 1, "ry"}}}} //
     }};
   bool doPVrefit = true;
+  o2::analysis::PVRefitter refitter;
 
   void init(InitContext&)
   {
@@ -137,39 +139,33 @@ struct lumiTask {
     uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     ccdb->setCreatedNotAfter(now);
     mRunNumber = 0;
+    refitter.setRemoveMeanVertexConstraint(true); // we want to refit w/o MeanVertex constraint
   }
 
-  void process(aod::Collision const& collision, aod::BCsWithTimestamps const&,
+  void process(aod::Collisions const& collisions, aod::BCsWithTimestamps const&,
                o2::soa::Join<o2::aod::Tracks, o2::aod::TrackSelection,
                              o2::aod::TracksCov, o2::aod::TracksExtra,
                              o2::aod::TracksDCA> const& tracks,
                o2::soa::Join<o2::aod::Tracks, o2::aod::TracksCov,
                              o2::aod::TracksExtra> const& unfiltered_tracks)
   {
+    // group the PV contributors of all the collisions of the DF
+    refitter.build(collisions, unfiltered_tracks, [](const auto& unfiltered_track) {
+      return unfiltered_track.hasITS() && unfiltered_track.pt() >= 0.8 && unfiltered_track.itsNCls() >= 5;
+    });
+    for (const auto& collision : collisions) {
+      fillCollision(collision);
+    }
+  }
 
+  void fillCollision(aod::Collision const& collision)
+  {
     auto bc = collision.bc_as<aod::BCsWithTimestamps>();
     uint64_t relTS = bc.timestamp() - ftts;
 
-    std::vector<int64_t> vec_globID_contr = {};
-    std::vector<o2::track::TrackParCov> vec_TrkContributos = {};
-
-    int nContrib = 0;
-    int nNonContrib = 0;
-    for (const auto& unfiltered_track : unfiltered_tracks) {
-      if (!unfiltered_track.hasITS()) {
-        nNonContrib++;
-        continue;
-      }
-      if (unfiltered_track.pt() < 0.8 || unfiltered_track.itsNCls() < 5) {
-        nNonContrib++;
-        continue;
-      }
-      vec_globID_contr.push_back(unfiltered_track.globalIndex());
-      vec_TrkContributos.push_back(getTrackParCov(unfiltered_track));
-      nContrib++;
-    }
-
-    std::vector<bool> vec_useTrk_PVrefit(vec_globID_contr.size(), true);
+    const int iCollision = collision.globalIndex();
+    const int nContrib = refitter.nContributors(iCollision);
+    std::vector<bool> vec_useTrk_PVrefit(nContrib, true);
 
     if (mRunNumber != bc.runNumber()) {
       o2::parameters::GRPMagField* grpo = ccdb->getForTimeStamp<o2::parameters::GRPMagField>(ccdbpath_grp, bc.timestamp());
@@ -183,22 +179,7 @@ struct lumiTask {
       mRunNumber = bc.runNumber();
     }
 
-    o2::dataformats::VertexBase Pvtx;
-    Pvtx.setX(collision.posX());
-    Pvtx.setY(collision.posY());
-    Pvtx.setZ(collision.posZ());
-    Pvtx.setCov(collision.covXX(), collision.covXY(), collision.covYY(),
-                collision.covXZ(), collision.covYZ(), collision.covZZ());
-    // configure PVertexer
-
-    o2::dataformats::VertexBase PVbase_recalculated;
-
-    o2::vertexing::PVertexer vertexer;
-    o2::conf::ConfigurableParam::updateFromString(
-      "pvertexer.useMeanVertexConstraint=false"); // we want to refit w/o
-                                                  // MeanVertex constraint
-    vertexer.init();
-    bool PVrefit_doable = vertexer.prepareVertexRefit(vec_TrkContributos, Pvtx);
+    bool PVrefit_doable = refitter.prepare(iCollision);
     double chi2 = -1.;
     double refitX = -9999.;
     double refitY = -9999.;
@@ -208,7 +189,7 @@ struct lumiTask {
     double refitXY = -9999.;
 
     if (doPVrefit && PVrefit_doable) {
-      auto Pvtx_refitted = vertexer.refitVertex(vec_useTrk_PVrefit, Pvtx);
+      auto Pvtx_refitted = refitter.refit(iCollision, vec_useTrk_PVrefit);
       chi2 = Pvtx_refitted.getChi2();
       refitX = Pvtx_refitted.getX();
       refitY = Pvtx_refitted.getY();
@@ -221,9 +202,6 @@ struct lumiTask {
     rowEventInfo(relTS, refitX, refitY, refitZ, refitXX, refitYY, refitXY, chi2,
                  nContrib);
 
-    //    LOGP(info,"chi2: {}, Ncont: {}, nonctr:
-    //    {}",chi2,nContrib,nNonContrib);
-
     histos.fill(HIST("chisquare_Refitted"), chi2);
     if (nContrib > nContribMin && nContrib < nContribMax &&
         (chi2 / nContrib) < 4.0 && chi2 > 0) {
@@ -61,6 +61,59 @@ class DGSelector
       }
     }
 
+    return IsSelectedTracks(diffCuts, collision, tracks, fwdtracks);
+  };
+
+  // Function to check if collisions passes DG filter
+  // The FIT signals are checked in the BCs [first, last) of bcWindow with the prefix sums of bcTimeline
+  template <typename CC, typename TCs, typename FWs>
+  int IsSelectedInBCWindow(DGCutparHolder diffCuts, CC& collision, udhelpers::BCTimeline const& bcTimeline, std::pair<int64_t, int64_t> const& bcWindow, TCs& tracks, FWs& fwdtracks)
+  {
+    LOGF(debug, "Number of close BCs: %i", bcWindow.second - bcWindow.first);
+
+    // check that there are no FIT signals in any of the compatible BCs
+    // Double Gap (DG) condition
+    if (bcTimeline.hasFITActivity(bcWindow)) {
+      return 1;
+    }
+
+    return IsSelectedTracks(diffCuts, collision, tracks, fwdtracks);
+  };
+
+  // Function to check if BC passes DG filter (without associated collision)
+  template <typename BCs, typename TCs, typename FWs>
+  int IsSelected(DGCutparHolder diffCuts, BCs& bcRange, TCs& tracks, FWs& fwdtracks)
+  {
+    // check that there are no FIT signals in bcRange
+    // Double Gap (DG) condition
+    for (auto const& bc : bcRange) {
+      if (!udhelpers::cleanFIT(bc, diffCuts.FITAmpLimits())) {
+        return 1;
+      }
+    }
+
+    return IsSelectedTracks(diffCuts, tracks, fwdtracks);
+  };
+
+  // Function to check if BC passes DG filter (without associated collision)
+  // The FIT signals are checked in the BCs [first, last) of bcWindow with the prefix sums of bcTimeline
+  template <typename TCs, typename FWs>
+  int IsSelectedInBCWindow(DGCutparHolder diffCuts, udhelpers::BCTimeline const& bcTimeline, std::pair<int64_t, int64_t> const& bcWindow, TCs& tracks, FWs& fwdtracks)
+  {
+    // check that there are no FIT signals in bcWindow
+    // Double Gap (DG) condition
+    if (bcTimeline.hasFITActivity(bcWindow)) {
+      return 1;
+    }
+
+    return IsSelectedTracks(diffCuts, tracks, fwdtracks);
+  };
+
+ private:
+  // DG selection of the tracks of a collision
+  template <typename CC, typename TCs, typename FWs>
+  int IsSelectedTracks(DGCutparHolder& diffCuts, CC& collision, TCs& tracks, FWs& fwdtracks)
+  {
     // no activity in forward direction
     LOGF(debug, "FwdTracks %i", fwdtracks.size());
     for (auto& fwdtrack : fwdtracks) {
@@ -148,18 +201,10 @@ class DGSelector
     return 0;
   };
 
-  // Function to check if BC passes DG filter (without associated collision)
-  template <typename BCs, typename TCs, typename FWs>
-  int IsSelected(DGCutparHolder diffCuts, BCs& bcRange, TCs& tracks, FWs& fwdtracks)
+  // DG selection of the tracks of a BC (without associated collision)
+  template <typename TCs, typename FWs>
+  int IsSelectedTracks(DGCutparHolder& diffCuts, TCs& tracks, FWs& fwdtracks)
   {
-    // check that there are no FIT signals in bcRange
-    // Double Gap (DG) condition
-    for (auto const& bc : bcRange) {
-      if (!udhelpers::cleanFIT(bc, diffCuts.FITAmpLimits())) {
-        return 1;
-      }
-    }
-
     // no activity in muon arm
     LOGF(debug, "FwdTracks %i", fwdtracks.size());
     for (auto& fwdtrack : fwdtracks) {
@@ -220,7 +265,6 @@ class DGSelector
     return 0;
   };
 
- private:
   TDatabasePDG* fPDG;
 
   ClassDefNV(DGSelector, 1);
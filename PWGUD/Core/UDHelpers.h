@@ -16,8 +16,12 @@
 #ifndef PWGUD_CORE_UDHELPERS_H_
 #define PWGUD_CORE_UDHELPERS_H_
 
-#include <vector>
+#include <algorithm>
+#include <array>
 #include <bitset>
+#include <cmath>
+#include <utility>
+#include <vector>
 #include "Framework/Logger.h"
 #include "DataFormatsFT0/Digit.h"
 #include "CommonConstants/LHCConstants.h"
@@ -453,6 +457,213 @@ bool cleanCalo(T const& bc, aod::Calos& calos, std::vector<float>& lims, SliceCa
   return (CaloBC.size() == 0);
 }
 
+// -----------------------------------------------------------------------------
+// Per-DF timeline of the BCs table.
+// The BCs are indexed in the order of the BCs table, which is sorted in globalBC. Hence the
+// index of a BC in the timeline is its row in the BCs table.
+// Rows of other tables (collisions, tracks, FT0, FV0A, FDD, ZDC) can be attached to the BCs.
+// They are stored in a CSR layout, i.e. grouped by BC with offsets per BC.
+// buildFIT computes prefix sums of the FIT amplitudes and of the number of BCs with FIT
+// activity above the limits. Checking the FIT veto over a window of BCs is then an O(1) query.
+struct BCTimeline {
+  // tables whose rows can be attached to the BCs
+  enum Rows {
+    kCollisions = 0,
+    kTracks,
+    kFT0s,
+    kFV0As,
+    kFDDs,
+    kZDCs,
+    kNRows
+  };
+
+  // FIT amplitudes
+  enum Amplitudes {
+    kFV0A = 0,
+    kFT0A,
+    kFT0C,
+    kFDDA,
+    kFDDC,
+    kNAmplitudes
+  };
+
+  std::vector<uint64_t> globalBCs;                             // global BC of each row of the BCs table
+  std::array<std::vector<uint32_t>, kNRows> offsets;           // per table, globalBCs.size() + 1 offsets into rowIds
+  std::array<std::vector<int64_t>, kNRows> rowIds;             // per table, row IDs grouped by BC
+  std::array<std::vector<double>, kNAmplitudes> amplitudeSums; // prefix sums of the FIT amplitudes
+  std::vector<uint32_t> activeFITSums;                         // prefix sums of the number of BCs with FIT activity
+
+  std::array<std::vector<int64_t>, kNRows> entryBCIds; // collected entries, cleared by buildRows()
+  std::array<std::vector<int64_t>, kNRows> entryIds;
+
+  template <typename BCs>
+  void build(BCs const& bcs)
+  {
+    clear();
+    globalBCs.reserve(bcs.size());
+    for (auto const& bc : bcs) {
+      globalBCs.push_back(bc.globalBC());
+    }
+  }
+
+  // FIT amplitude limits as in cleanFIT
+  //  lims[0]: FV0A
+  //  lims[1]: FT0A
+  //  lims[2]: FT0C
+  //  lims[3]: FDDA
+  //  lims[4]: FDDC
+  template <typename BCs>
+  void buildFIT(BCs const& bcs, std::vector<float> const& lims)
+  {
+    for (auto& sums : amplitudeSums) {
+      sums.clear();
+      sums.reserve(bcs.size() + 1);
+      sums.push_back(0.);
+    }
+    activeFITSums.clear();
+    activeFITSums.reserve(bcs.size() + 1);
+    activeFITSums.push_back(0);
+    for (auto const& bc : bcs) {
+      std::array<double, kNAmplitudes> amps{};
+      bool active = false;
+      if (bc.has_foundFV0()) {
+        amps[kFV0A] = FV0AmplitudeA(bc.foundFV0());
+        active = active || amps[kFV0A] > lims[0];
+      }
+      if (bc.has_foundFT0()) {
+        amps[kFT0A] = FT0AmplitudeA(bc.foundFT0());
+        amps[kFT0C] = FT0AmplitudeC(bc.foundFT0());
+        active = active || amps[kFT0A] > lims[1] || amps[kFT0C] > lims[2];
+      }
+      if (bc.has_foundFDD()) {
+        amps[kFDDA] = FDDAmplitudeA(bc.foundFDD());
+        amps[kFDDC] = FDDAmplitudeC(bc.foundFDD());
+        active = active || amps[kFDDA] > lims[3] || amps[kFDDC] > lims[4];
+      }
+      for (int iamp = 0; iamp < kNAmplitudes; ++iamp) {
+        amplitudeSums[iamp].push_back(amplitudeSums[iamp].back() + amps[iamp]);
+      }
+      activeFITSums.push_back(activeFITSums.back() + (active ? 1 : 0));
+    }
+  }
+
+  // attach row rowId of table to the BC with index bcId
+  void addRow(Rows table, int64_t bcId, int64_t rowId)
+  {
+    if (bcId < 0) {
+      return;
+    }
+    entryBCIds[table].push_back(bcId);
+    entryIds[table].push_back(rowId);
+  }
+
+  // attach the rows of a table with a bcId column
+  template <typename T>
+  void addRows(Rows table, T const& rows)
+  {
+    for (auto const& row : rows) {
+      addRow(table, row.bcId(), row.globalIndex());
+    }
+  }
+
+  // group the collected rows of table by BC, keeping their order within each BC
+  void buildRows(Rows table)
+  {
+    auto& offs = offsets[table];
+    auto& ids = rowIds[table];
+    auto& bcIds = entryBCIds[table];
+    offs.assign(globalBCs.size() + 1, 0);
+    for (auto bcId : bcIds) {
+      offs[bcId + 1]++;
+    }
+    for (size_t ibc = 0; ibc < globalBCs.size(); ++ibc) {
+      offs[ibc + 1] += offs[ibc];
+    }
+    ids.resize(bcIds.size());
+    std::vector<uint32_t> pos(offs.begin(), offs.end() - 1);
+    for (size_t i = 0; i < bcIds.size(); ++i) {
+      ids[pos[bcIds[i]]++] = entryIds[table][i];
+    }
+    bcIds.clear();
+    entryIds[table].clear();
+  }
+
+  void clear()
+  {
+    globalBCs.clear();
+    for (int table = 0; table < kNRows; ++table) {
+      offsets[table].clear();
+      rowIds[table].clear();
+      entryBCIds[table].clear();
+      entryIds[table].clear();
+    }
+    for (auto& sums : amplitudeSums) {
+      sums.clear();
+    }
+    activeFITSums.clear();
+  }
+
+  int64_t size() const { return globalBCs.size(); }
+
+  // index of the first BC >= bc, size() if none
+  int64_t lowerBound(uint64_t bc) const { return std::lower_bound(globalBCs.begin(), globalBCs.end(), bc) - globalBCs.begin(); }
+
+  // index of bc, -1 if bc is not in the BCs table
+  int64_t find(uint64_t bc) const
+  {
+    int64_t ibc = lowerBound(bc);
+    return (ibc < size() && globalBCs[ibc] == bc) ? ibc : -1;
+  }
+
+  // indices [first, last) of the BCs within meanBC +- deltaBC
+  std::pair<int64_t, int64_t> window(uint64_t meanBC, int deltaBC) const
+  {
+    uint64_t minBC = (uint64_t)deltaBC < meanBC ? meanBC - (uint64_t)deltaBC : 0;
+    uint64_t maxBC = meanBC + (uint64_t)deltaBC;
+    return {lowerBound(minBC), lowerBound(maxBC + 1)};
+  }
+
+  // indices [first, last) of the BCs compatible with a collision, computed as in compatibleBCs
+  template <typename C>
+  std::pair<int64_t, int64_t> window(C const& collision, int ndt, int nMinBCs = 7) const
+  {
+    if (!collision.has_foundBC()) {
+      return {0, 0};
+    }
+    uint64_t meanBC = globalBCs[collision.foundBCId()] + std::lround(collision.collisionTime() / o2::constants::lhc::LHCBunchSpacingNS);
+    int deltaBC = std::ceil(collision.collisionTimeRes() / o2::constants::lhc::LHCBunchSpacingNS * ndt);
+    if (deltaBC < nMinBCs) {
+      deltaBC = nMinBCs;
+    }
+    return window(meanBC, deltaBC);
+  }
+
+  // is there any FIT activity above the limits in the BCs [first, last)
+  bool hasFITActivity(std::pair<int64_t, int64_t> const& bcWindow) const
+  {
+    return activeFITSums[bcWindow.second] != activeFITSums[bcWindow.first];
+  }
+
+  // sum of a FIT amplitude in the BCs [first, last)
+  double amplitude(Amplitudes amp, std::pair<int64_t, int64_t> const& bcWindow) const
+  {
+    return amplitudeSums[amp][bcWindow.second] - amplitudeSums[amp][bcWindow.first];
+  }
+
+  // number of rows of table attached to the BC with index ibc
+  uint32_t nRows(Rows table, int64_t ibc) const { return offsets[table][ibc + 1] - offsets[table][ibc]; }
+
+  // first row of table attached to the BC with index ibc, -1 if none
+  int64_t firstRow(Rows table, int64_t ibc) const { return nRows(table, ibc) > 0 ? rowIds[table][offsets[table][ibc]] : -1; }
+
+  // appends the rows of table attached to the BC with index ibc to ids
+  template <typename I>
+  void appendRows(Rows table, int64_t ibc, std::vector<I>& ids) const
+  {
+    ids.insert(ids.end(), rowIds[table].begin() + offsets[table][ibc], rowIds[table].begin() + offsets[table][ibc + 1]);
+  }
+};
+
 // -----------------------------------------------------------------------------
 // check if all tracks come from same MCCollision
 template <typename T>
@@ -12,6 +12,9 @@
 #ifndef O2PHYSICS_UPCHELPERS_H
 #define O2PHYSICS_UPCHELPERS_H
 
+#include <algorithm>
+#include <vector>
+
 #include "Framework/AnalysisDataModel.h"
 #include "Common/DataModel/EventSelection.h"
 #include "Common/CCDB/EventSelectionParams.h"
@@ -127,6 +130,78 @@ void applyBarrelCuts(UPCCutparHolder& upcCuts, const BarrelTracks::iterator& tra
   }
 }
 
+// global BC -> track IDs index in compressed sparse row layout
+// entries are collected with add(), then build() groups them by BC with a counting sort:
+// tracks of BC bcs[i] are trackIds[offsets[i]], ..., trackIds[offsets[i + 1] - 1], in the order they were added
+struct BCTracksIndex {
+  std::vector<uint64_t> bcs;     // sorted unique global BCs
+  std::vector<uint32_t> offsets; // bcs.size() + 1 offsets into trackIds
+  std::vector<int64_t> trackIds; // track IDs grouped by BC
+
+  std::vector<uint64_t> entryBCs; // collected entries, cleared by build()
+  std::vector<int64_t> entryIds;
+
+  void add(uint64_t bc, int64_t trkId)
+  {
+    entryBCs.push_back(bc);
+    entryIds.push_back(trkId);
+  }
+
+  void build()
+  {
+    // first pass: sorted unique keys and number of tracks per key
+    bcs.assign(entryBCs.begin(), entryBCs.end());
+    std::sort(bcs.begin(), bcs.end());
+    bcs.erase(std::unique(bcs.begin(), bcs.end()), bcs.end());
+    offsets.assign(bcs.size() + 1, 0);
+    std::vector<uint32_t> keys(entryBCs.size());
+    for (size_t i = 0; i < entryBCs.size(); ++i) {
+      keys[i] = std::lower_bound(bcs.begin(), bcs.end(), entryBCs[i]) - bcs.begin();
+      offsets[keys[i] + 1]++;
+    }
+    for (size_t ibc = 0; ibc < bcs.size(); ++ibc) {
+      offsets[ibc + 1] += offsets[ibc];
+    }
+    // second pass: scatter track IDs, keeping their order within each BC
+    trackIds.resize(entryIds.size());
+    std::vector<uint32_t> pos(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < entryIds.size(); ++i) {
+      trackIds[pos[keys[i]]++] = entryIds[i];
+    }
+    entryBCs.clear();
+    entryIds.clear();
+  }
+
+  void clear()
+  {
+    bcs.clear();
+    offsets.clear();
+    trackIds.clear();
+    entryBCs.clear();
+    entryIds.clear();
+  }
+
+  uint32_t size() const { return bcs.size(); }
+
+  uint32_t nTracks(uint32_t ibc) const { return offsets[ibc + 1] - offsets[ibc]; }
+
+  // index of the first BC >= bc, size() if none
+  uint32_t lowerBound(uint64_t bc) const { return std::lower_bound(bcs.begin(), bcs.end(), bc) - bcs.begin(); }
+
+  // index of bc, -1 if there are no tracks in bc
+  int32_t find(uint64_t bc) const
+  {
+    uint32_t ibc = lowerBound(bc);
+    return (ibc < bcs.size() && bcs[ibc] == bc) ? static_cast<int32_t>(ibc) : -1;
+  }
+
+  // appends the tracks of BC with index ibc to ids
+  void appendTracks(uint32_t ibc, std::vector<int64_t>& ids) const
+  {
+    ids.insert(ids.end(), trackIds.begin() + offsets[ibc], trackIds.begin() + offsets[ibc + 1]);
+  }
+};
+
 } // namespace upchelpers
 
 #endif // O2PHYSICS_UPCHELPERS_H
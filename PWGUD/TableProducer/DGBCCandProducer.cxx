@@ -46,6 +46,27 @@ struct tracksWGTInBCs {
   Preslice<aod::AmbiguousTracks> perTrack = aod::ambiguous::trackId;
   Preslice<aod::AmbiguousFwdTracks> perFwdTrack = aod::ambiguous::fwdtrackId;
 
+  // tracks with good timing grouped by their matching/closest BC, and the BCs of the DF
+  upchelpers::BCTracksIndex tracksInBCs;
+  udhelpers::BCTimeline bcTimeline;
+  std::vector<int32_t> trackIds;
+
+  // fills the table with the tracks grouped in tracksInBCs
+  template <typename T>
+  void fillTracksInBCs(T& table, int rnum)
+  {
+    tracksInBCs.build();
+    for (uint32_t ibc = 0; ibc < tracksInBCs.size(); ++ibc) {
+      auto bcnum = tracksInBCs.bcs[ibc];
+      // find corresponding BC
+      int indBCToSave = bcTimeline.find(bcnum);
+      trackIds.assign(tracksInBCs.trackIds.begin() + tracksInBCs.offsets[ibc], tracksInBCs.trackIds.begin() + tracksInBCs.offsets[ibc + 1]);
+      table(indBCToSave, rnum, bcnum, trackIds);
+      LOGF(debug, " BC %i/%u with %i tracks with good timing", indBCToSave, bcnum, trackIds.size());
+    }
+    tracksInBCs.clear();
+  }
+
   void init(InitContext& context)
   {
     if (context.mOptions.get<bool>("processBarrel")) {
@@ -64,8 +85,8 @@ struct tracksWGTInBCs {
     // run number
     int rnum = bcs.iteratorAt(0).runNumber();
 
-    // container to sort tracks with good timing according to their matching/closest BC
-    std::map<uint64_t, std::vector<int32_t>> tracksInBCList{};
+    // tracks with good timing are grouped according to their matching/closest BC
+    bcTimeline.build(bcs);
     uint64_t closestBC = 0;
 
     // loop over all tracks and fill tracksInBCList
@@ -97,31 +118,13 @@ struct tracksWGTInBCs {
           closestBC = collision.foundBC_as<BCs>().globalBC();
         }
 
-        // update tracksInBCList
-        tracksInBCList[closestBC].emplace_back((int32_t)track.globalIndex());
+        // update tracksInBCs
+        tracksInBCs.add(closestBC, track.globalIndex());
       }
     }
 
     // fill tracksWGTInBCs
-    int indBCToStart = 0;
-    int indBCToSave;
-    for (auto const& tracksInBC : tracksInBCList) {
-      indBCToSave = -1;
-      // find corresponding BC
-      for (auto ind = indBCToStart; ind < bcs.size(); ind++) {
-        auto bc = bcs.rawIteratorAt(ind);
-        if (bc.globalBC() == tracksInBC.first) {
-          indBCToSave = ind;
-          indBCToStart = ind;
-          break;
-        }
-        if (bc.globalBC() > tracksInBC.first) {
-          break;
-        }
-      }
-      tracksWGTInBCs(indBCToSave, rnum, tracksInBC.first, tracksInBC.second);
-      LOGF(debug, " BC %i/%u with %i tracks with good timing", indBCToSave, tracksInBC.first, tracksInBC.second.size());
-    }
+    fillTracksInBCs(tracksWGTInBCs, rnum);
     LOGF(debug, "barrel done");
   }
   PROCESS_SWITCH(tracksWGTInBCs, processBarrel, "Process barrel tracks", false);
@@ -134,8 +137,8 @@ struct tracksWGTInBCs {
     // run number
     int rnum = bcs.iteratorAt(0).runNumber();
 
-    // container to sort forward tracks according to their matching/closest BC
-    std::map<uint64_t, std::vector<int32_t>> fwdTracksInBCList{};
+    // forward tracks with good timing are grouped according to their matching/closest BC
+    bcTimeline.build(bcs);
     uint64_t closestBC = 0;
 
     // loop over all forward tracks and fill fwdTracksInBCList
@@ -169,31 +172,13 @@ struct tracksWGTInBCs {
           closestBC = collision.bc_as<BCs>().globalBC();
         }
 
-        // update tracksInBCList
-        fwdTracksInBCList[closestBC].emplace_back((int32_t)fwdTrack.globalIndex());
+        // update tracksInBCs
+        tracksInBCs.add(closestBC, fwdTrack.globalIndex());
       }
     }
 
     // fill fwdTracksWGTInBCs
-    int indBCToStart = 0;
-    int indBCToSave;
-    for (auto const& fwdTracksInBC : fwdTracksInBCList) {
-      indBCToSave = -1;
-      // find corresponding BC
-      for (auto ind = indBCToStart; ind < bcs.size(); ind++) {
-        auto bc = bcs.rawIteratorAt(ind);
-        if (bc.globalBC() == fwdTracksInBC.first) {
-          indBCToSave = ind;
-          indBCToStart = ind;
-          break;
-        }
-        if (bc.globalBC() > fwdTracksInBC.first) {
-          break;
-        }
-      }
-      fwdTracksWGTInBCs(indBCToSave, rnum, fwdTracksInBC.first, fwdTracksInBC.second);
-      LOGF(debug, " BC %i/%u with %i forward tracks with good timing", indBCToSave, fwdTracksInBC.first, fwdTracksInBC.second.size());
-    }
+    fillTracksInBCs(fwdTracksWGTInBCs, rnum);
     LOGF(debug, "fwd done");
   }
   PROCESS_SWITCH(tracksWGTInBCs, processForward, "Process forward tracks", false);
@@ -225,6 +210,10 @@ struct DGBCCandProducer {
   // DG selector
   DGSelector dgSelector = DGSelector();
 
+  // BCs of the DF with their FIT activity and associated collisions
+  udhelpers::BCTimeline bcTimeline;
+  std::vector<uint64_t> tibcBCs;
+
   HistogramRegistry registry{
     "registry",
     {}};
@@ -248,32 +237,37 @@ struct DGBCCandProducer {
   void fillBGBBFlags(upchelpers::FITInfo& info, uint64_t const& minbc, BCR const& bcrange)
   {
     for (auto const& bc2u : bcrange) {
-
-      // 0 <= bit <= 31
-      auto bit = bc2u.globalBC() - minbc;
-      if (!bc2u.selection_bit(evsel::kNoBGT0A))
-        SETBIT(info.BGFT0Apf, bit);
-      if (!bc2u.selection_bit(evsel::kNoBGT0C))
-        SETBIT(info.BGFT0Cpf, bit);
-      if (bc2u.selection_bit(evsel::kIsBBT0A))
-        SETBIT(info.BBFT0Apf, bit);
-      if (bc2u.selection_bit(evsel::kIsBBT0C))
-        SETBIT(info.BBFT0Cpf, bit);
-      if (!bc2u.selection_bit(evsel::kNoBGV0A))
-        SETBIT(info.BGFV0Apf, bit);
-      if (bc2u.selection_bit(evsel::kIsBBV0A))
-        SETBIT(info.BBFV0Apf, bit);
-      if (!bc2u.selection_bit(evsel::kNoBGFDA))
-        SETBIT(info.BGFDDApf, bit);
-      if (!bc2u.selection_bit(evsel::kNoBGFDC))
-        SETBIT(info.BGFDDCpf, bit);
-      if (bc2u.selection_bit(evsel::kIsBBFDA))
-        SETBIT(info.BBFDDApf, bit);
-      if (bc2u.selection_bit(evsel::kIsBBFDC))
-        SETBIT(info.BBFDDCpf, bit);
+      fillBGBBFlag(info, minbc, bc2u);
     }
   }
 
+  // fill BB and BG information of one BC into FITInfo
+  void fillBGBBFlag(upchelpers::FITInfo& info, uint64_t const& minbc, BC const& bc2u)
+  {
+    // 0 <= bit <= 31
+    auto bit = bc2u.globalBC() - minbc;
+    if (!bc2u.selection_bit(evsel::kNoBGT0A))
+      SETBIT(info.BGFT0Apf, bit);
+    if (!bc2u.selection_bit(evsel::kNoBGT0C))
+      SETBIT(info.BGFT0Cpf, bit);
+    if (bc2u.selection_bit(evsel::kIsBBT0A))
+      SETBIT(info.BBFT0Apf, bit);
+    if (bc2u.selection_bit(evsel::kIsBBT0C))
+      SETBIT(info.BBFT0Cpf, bit);
+    if (!bc2u.selection_bit(evsel::kNoBGV0A))
+      SETBIT(info.BGFV0Apf, bit);
+    if (bc2u.selection_bit(evsel::kIsBBV0A))
+      SETBIT(info.BBFV0Apf, bit);
+    if (!bc2u.selection_bit(evsel::kNoBGFDA))
+      SETBIT(info.BGFDDApf, bit);
+    if (!bc2u.selection_bit(evsel::kNoBGFDC))
+      SETBIT(info.BGFDDCpf, bit);
+    if (bc2u.selection_bit(evsel::kIsBBFDA))
+      SETBIT(info.BBFDDApf, bit);
+    if (bc2u.selection_bit(evsel::kIsBBFDC))
+      SETBIT(info.BBFDDCpf, bit);
+  }
+
   // extract FIT information
   upchelpers::FITInfo getFITinfo(uint64_t const& bcnum, BCs const& bcs, aod::FT0s const& ft0s, aod::FV0As const& fv0as, aod::FDDs const& fdds)
   {
@@ -288,54 +282,7 @@ struct DGBCCandProducer {
     // if BC exists then update FIT information for this BC
     if (selbc.size() > 0) {
       auto bc = bcs.iteratorAt(selbc.begin().globalIndex());
-
-      // FT0
-      if (bc.has_foundFT0()) {
-        auto ft0 = ft0s.iteratorAt(bc.foundFT0Id());
-        info.timeFT0A = ft0.timeA();
-        info.timeFT0C = ft0.timeC();
-        const auto& ampsA = ft0.amplitudeA();
-        const auto& ampsC = ft0.amplitudeC();
-        info.ampFT0A = 0.;
-        for (auto amp : ampsA) {
-          info.ampFT0A += amp;
-        }
-        info.ampFT0C = 0.;
-        for (auto amp : ampsC) {
-          info.ampFT0C += amp;
-        }
-        info.triggerMaskFT0 = ft0.triggerMask();
-      }
-
-      // FV0A
-      if (bc.has_foundFV0()) {
-        auto fv0a = fv0as.iteratorAt(bc.foundFV0Id());
-        info.timeFV0A = fv0a.time();
-        const auto& amps = fv0a.amplitude();
-        info.ampFV0A = 0.;
-        for (auto amp : amps) {
-          info.ampFV0A += amp;
-        }
-        info.triggerMaskFV0A = fv0a.triggerMask();
-      }
-
-      // FDD
-      if (bc.has_foundFDD()) {
-        auto fdd = fdds.iteratorAt(bc.foundFDDId());
-        info.timeFDDA = fdd.timeA();
-        info.timeFDDC = fdd.timeC();
-        const auto& ampsA = fdd.chargeA();
-        const auto& ampsC = fdd.chargeC();
-        info.ampFDDA = 0.;
-        for (auto amp : ampsA) {
-          info.ampFDDA += amp;
-        }
-        info.ampFDDC = 0.;
-        for (auto amp : ampsC) {
-          info.ampFDDC += amp;
-        }
-        info.triggerMaskFDD = fdd.triggerMask();
-      }
+      fillFITAmplitudes(info, bc, ft0s, fv0as, fdds);
 
       auto bcrange = udhelpers::compatibleBCs(bc, bcnum, 16, bcs);
       fillBGBBFlags(info, minbc, bcrange);
@@ -346,6 +293,77 @@ struct DGBCCandProducer {
     return info;
   }
 
+  // extract FIT information, with the BC lookup on the BC timeline
+  upchelpers::FITInfo getFITinfo(uint64_t const& bcnum, udhelpers::BCTimeline const& timeline, BCs const& bcs, aod::FT0s const& ft0s, aod::FV0As const& fv0as, aod::FDDs const& fdds)
+  {
+    // FITinfo
+    upchelpers::FITInfo info{};
+    uint64_t minbc = bcnum > 16 ? bcnum - 16 : 0;
+
+    // if BC exists then update FIT information for this BC
+    auto ibc = timeline.find(bcnum);
+    if (ibc >= 0) {
+      fillFITAmplitudes(info, bcs.iteratorAt(ibc), ft0s, fv0as, fdds);
+    }
+    auto bcWindow = timeline.window(bcnum, 16);
+    for (auto ibc2u = bcWindow.first; ibc2u < bcWindow.second; ++ibc2u) {
+      fillBGBBFlag(info, minbc, bcs.iteratorAt(ibc2u));
+    }
+    return info;
+  }
+
+  // fill FIT amplitudes, times, and trigger masks of bc into FITInfo
+  void fillFITAmplitudes(upchelpers::FITInfo& info, BC const& bc, aod::FT0s const& ft0s, aod::FV0As const& fv0as, aod::FDDs const& fdds)
+  {
+    // FT0
+    if (bc.has_foundFT0()) {
+      auto ft0 = ft0s.iteratorAt(bc.foundFT0Id());
+      info.timeFT0A = ft0.timeA();
+      info.timeFT0C = ft0.timeC();
+      const auto& ampsA = ft0.amplitudeA();
+      const auto& ampsC = ft0.amplitudeC();
+      info.ampFT0A = 0.;
+      for (auto amp : ampsA) {
+        info.ampFT0A += amp;
+      }
+      info.ampFT0C = 0.;
+      for (auto amp : ampsC) {
+        info.ampFT0C += amp;
+      }
+      info.triggerMaskFT0 = ft0.triggerMask();
+    }
+
+    // FV0A
+    if (bc.has_foundFV0()) {
+      auto fv0a = fv0as.iteratorAt(bc.foundFV0Id());
+      info.timeFV0A = fv0a.time();
+      const auto& amps = fv0a.amplitude();
+      info.ampFV0A = 0.;
+      for (auto amp : amps) {
+        info.ampFV0A += amp;
+      }
+      info.triggerMaskFV0A = fv0a.triggerMask();
+    }
+
+    // FDD
+    if (bc.has_foundFDD()) {
+      auto fdd = fdds.iteratorAt(bc.foundFDDId());
+      info.timeFDDA = fdd.timeA();
+      info.timeFDDC = fdd.timeC();
+      const auto& ampsA = fdd.chargeA();
+      const auto& ampsC = fdd.chargeC();
+      info.ampFDDA = 0.;
+      for (auto amp : ampsA) {
+        info.ampFDDA += amp;
+      }
+      info.ampFDDC = 0.;
+      for (auto amp : ampsC) {
+        info.ampFDDC += amp;
+      }
+      info.triggerMaskFDD = fdd.triggerMask();
+    }
+  }
+
   // function to update UDTracks, UDTracksCov, UDTracksDCA, UDTracksPID, UDTracksExtra, UDTracksFlag,
   // and UDTrackCollisionIDs
   template <typename TTrack>
@@ -599,6 +617,18 @@ struct DGBCCandProducer {
       return;
     }
 
+    // index the BCs of the DF with their FIT activity and associated collisions
+    bcTimeline.build(bcs);
+    bcTimeline.buildFIT(bcs, diffCuts.FITAmpLimits());
+    for (auto const& col : collisions) {
+      bcTimeline.addRow(udhelpers::BCTimeline::kCollisions, col.foundBCId(), col.globalIndex());
+    }
+    bcTimeline.buildRows(udhelpers::BCTimeline::kCollisions);
+    tibcBCs.clear();
+    for (auto const& tibc : tibcs) {
+      tibcBCs.push_back(tibc.bcnum());
+    }
+
     // run over globalBC [minGlobalBC, maxGlobalBC] ...
     float vpos[3];
     uint64_t minGlobalBC = bcs.iteratorAt(0).globalBC();
@@ -627,23 +657,21 @@ struct DGBCCandProducer {
         ++bc;
       }
       // find associated collision
-      Partition<CCs> colSlize = aod::evsel::foundBCId == bc.globalIndex();
-      colSlize.bindTable(collisions);
-      colSlize.bindExternalIndices(&bcs);
+      auto colId = bcTimeline.firstRow(udhelpers::BCTimeline::kCollisions, bc.globalIndex());
 
       if (bc.globalBC() == bcnum) {
         SETBIT(bcFlag, 1);
 
-        if (colSlize.size() > 0) {
+        if (colId >= 0) {
           // -> vertex position: col.[posX(), posY(), posZ()]
           SETBIT(bcFlag, 2);
 
-          auto col = colSlize.begin();
+          auto col = collisions.iteratorAt(colId);
           ntr1 = col.numContrib();
           auto colTracks = tracks.sliceBy(TCperCollision, col.globalIndex());
           auto colFwdTracks = fwdtracks.sliceBy(FWperCollision, col.globalIndex());
-          auto bcRange = udhelpers::compatibleBCs1(col, diffCuts.NDtcoll(), bcs, diffCuts.minNBCs());
-          isDG1 = dgSelector.IsSelected(diffCuts, col, bcRange, colTracks, colFwdTracks);
+          auto bcWindow = bcTimeline.window(col, diffCuts.NDtcoll(), diffCuts.minNBCs());
+          isDG1 = dgSelector.IsSelectedInBCWindow(diffCuts, col, bcTimeline, bcWindow, colTracks, colFwdTracks);
           if (isDG1 == 0) {
             // this is a DG candidate with proper collision vertex
             SETBIT(bcFlag, 3);
@@ -651,7 +679,7 @@ struct DGBCCandProducer {
 
             auto rtrwTOF = udhelpers::rPVtrwTOF<true>(colTracks, col.numContrib());
             auto nCharge = udhelpers::netCharge<true>(colTracks);
-            auto fitInfo = getFITinfo(bcnum, bcs, ft0s, fv0as, fdds);
+            auto fitInfo = getFITinfo(bcnum, bcTimeline, bcs, ft0s, fv0as, fdds);
             updateUDTables(false, bcnum, bc.runNumber(), col.posX(), col.posY(), col.posZ(),
                            col.numContrib(), nCharge, rtrwTOF, colTracks, fitInfo);
             // fill UDZdcs
@@ -676,7 +704,7 @@ struct DGBCCandProducer {
         if (tibc.bcnum() == bcnum) {
           SETBIT(bcFlag, 4);
 
-          auto bcRange = udhelpers::compatibleBCs(bc, bcnum, diffCuts.minNBCs(), bcs);
+          auto bcWindow = bcTimeline.window(bcnum, diffCuts.minNBCs());
           auto tracksArray = tibc.track_as<TCs>();
           ntr2 = tracksArray.size();
 
@@ -686,14 +714,14 @@ struct DGBCCandProducer {
             }
             if (ftibc.bcnum() == bcnum) {
               auto fwdTracksArray = ftibc.fwdtrack_as<FTCs>();
-              isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+              isDG2 = dgSelector.IsSelectedInBCWindow(diffCuts, bcTimeline, bcWindow, tracksArray, fwdTracksArray);
             } else {
               auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-              isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+              isDG2 = dgSelector.IsSelectedInBCWindow(diffCuts, bcTimeline, bcWindow, tracksArray, fwdTracksArray);
             }
           } else {
             auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-            isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+            isDG2 = dgSelector.IsSelectedInBCWindow(diffCuts, bcTimeline, bcWindow, tracksArray, fwdTracksArray);
           }
 
           if (isDG2 == 0) {
@@ -703,11 +731,11 @@ struct DGBCCandProducer {
 
             auto rtrwTOF = udhelpers::rPVtrwTOF<false>(tracksArray, tracksArray.size());
             auto nCharge = udhelpers::netCharge<false>(tracksArray);
-            auto fitInfo = getFITinfo(bcnum, bcs, ft0s, fv0as, fdds);
+            auto fitInfo = getFITinfo(bcnum, bcTimeline, bcs, ft0s, fv0as, fdds);
 
             // distinguish different cases
             if (bc.globalBC() == bcnum) {
-              if (colSlize.size() > 0) {
+              if (colId >= 0) {
                 vpos[0] = -1.;
                 vpos[1] = 1.;
                 vpos[2] = -1.;
@@ -748,6 +776,25 @@ struct DGBCCandProducer {
       if (isDG1 == 0 && isDG2 == 0) {
         registry.get<TH2>(HIST("data/ntr1vsntr2Cand"))->Fill(ntr1, ntr2);
       }
+
+      // the BCs up to the next one contained in the BCs or TracksWGTInBCs tables have no
+      // collision and no tracks, account for them at once
+      uint64_t nextbcnum = maxGlobalBC + 1;
+      auto ibcNext = bcTimeline.lowerBound(bcnum + 1);
+      if (ibcNext < bcTimeline.size()) {
+        nextbcnum = std::min(nextbcnum, bcTimeline.globalBCs[ibcNext]);
+      }
+      auto itibcNext = std::upper_bound(tibcBCs.begin(), tibcBCs.end(), bcnum);
+      if (itibcNext != tibcBCs.end()) {
+        nextbcnum = std::min(nextbcnum, *itibcNext);
+      }
+      if (nextbcnum > bcnum + 1) {
+        auto nEmpty = nextbcnum - bcnum - 1;
+        registry.get<TH1>(HIST("data/bcFlag"))->Fill(1, nEmpty);
+        registry.get<TH2>(HIST("data/isDG1vsisDG2"))->Fill(-1, -1, nEmpty);
+        registry.get<TH2>(HIST("data/ntr1vsntr2All"))->Fill(-1, -1, nEmpty);
+        bcnum = nextbcnum - 1;
+      }
     }
   }
 
@@ -32,6 +32,9 @@ struct DGCandProducer {
   // DG selector
   DGSelector dgSelector;
 
+  // BCs of the DF with their FIT activity
+  udhelpers::BCTimeline bcTimeline;
+
   void init(InitContext&)
   {
     diffCuts = (DGCutparHolder)DGCuts;
@@ -86,12 +89,11 @@ struct DGCandProducer {
   void getFITinfo(upchelpers::FITInfo& info, uint64_t const& bcnum, BCs const& bcs, aod::FT0s const& ft0s, aod::FV0As const& fv0as, aod::FDDs const& fdds)
   {
     // find bc with globalBC = bcnum
-    Partition<BCs> selbc = aod::bc::globalBC == bcnum;
-    selbc.bindTable(bcs);
+    auto ibc = bcTimeline.find(bcnum);
 
     // if BC exists then update FIT information for this BC
-    if (selbc.size() > 0) {
-      auto bc = selbc.begin();
+    if (ibc >= 0) {
+      auto bc = bcs.iteratorAt(ibc);
 
       // FT0
       if (bc.has_foundFT0()) {
@@ -146,11 +148,11 @@ struct DGCandProducer {
     // compute range to check
     auto minbc = bcnum - 16;
     auto maxbc = bcnum + 15;
-    Partition<BCs> bcrange = aod::bc::globalBC >= minbc && aod::bc::globalBC <= maxbc;
-    bcrange.bindTable(bcs);
+    auto lastbc = bcTimeline.lowerBound(maxbc + 1);
 
     // loop over bcrange and check
-    for (auto const& bc2u : bcrange) {
+    for (auto ibc2u = bcTimeline.lowerBound(minbc); ibc2u < lastbc; ++ibc2u) {
+      auto bc2u = bcs.iteratorAt(ibc2u);
 
       // 0 <= bit <= 31
       auto bit = bc2u.globalBC() - minbc;
@@ -290,9 +292,29 @@ struct DGCandProducer {
     }
   }
 
+  Preslice<TCs> tracksPerCollisionData = aod::track::collisionId;
+  Preslice<FWs> fwdTracksPerCollisionData = aod::fwdtrack::collisionId;
+
   // process function for real data
-  void processData(CC const& collision, BCs const& bcs, TCs& tracks, FWs& fwdtracks,
+  // The BCs of the DF are indexed once, then the FIT veto over the compatible BCs of each
+  // collision is a range query on the BC timeline
+  void processData(CCs const& collisions, BCs const& bcs, TCs const& allTracks, FWs const& allFwdTracks,
                    aod::Zdcs& zdcs, aod::FT0s& ft0s, aod::FV0As& fv0as, aod::FDDs& fdds)
+  {
+    bcTimeline.build(bcs);
+    bcTimeline.buildFIT(bcs, diffCuts.FITAmpLimits());
+
+    for (auto const& collision : collisions) {
+      selectCollision(collision, bcs, allTracks.sliceBy(tracksPerCollisionData, collision.globalIndex()),
+                      allFwdTracks.sliceBy(fwdTracksPerCollisionData, collision.globalIndex()), ft0s, fv0as, fdds);
+    }
+  }
+  PROCESS_SWITCH(DGCandProducer, processData, "Process real data", false);
+
+  // DG selection and output of a collision
+  template <typename TTracks, typename TFwdTracks>
+  void selectCollision(CC const& collision, BCs const& bcs, TTracks const& tracks, TFwdTracks const& fwdtracks,
+                       aod::FT0s& ft0s, aod::FV0As& fv0as, aod::FDDs& fdds)
   {
     // nominal BC
     if (!collision.has_foundBC()) {
@@ -301,12 +323,12 @@ struct DGCandProducer {
     auto bc = collision.foundBC_as<BCs>();
     LOGF(debug, "<DGCandProducer>  BC id %d", bc.globalBC());
 
-    // obtain slice of compatible BCs
-    auto bcRange = udhelpers::compatibleBCs(collision, diffCuts.NDtcoll(), bcs, diffCuts.minNBCs());
-    LOGF(debug, "<DGCandProducer>  Size of bcRange %d", bcRange.size());
+    // obtain window of compatible BCs
+    auto bcWindow = bcTimeline.window(collision, diffCuts.NDtcoll(), diffCuts.minNBCs());
+    LOGF(debug, "<DGCandProducer>  Size of bcRange %d", bcWindow.second - bcWindow.first);
 
     // apply DG selection
-    auto isDGEvent = dgSelector.IsSelected(diffCuts, collision, bcRange, tracks, fwdtracks);
+    auto isDGEvent = dgSelector.IsSelectedInBCWindow(diffCuts, collision, bcTimeline, bcWindow, tracks, fwdtracks);
 
     // save DG candidates
     if (isDGEvent == 0) {
@@ -375,7 +397,6 @@ struct DGCandProducer {
       }
     }
   }
-  PROCESS_SWITCH(DGCandProducer, processData, "Process real data", false);
 
   Preslice<MCTCs> tracksPerCollision = aod::track::collisionId;
   Preslice<FWs> fwdTracksPerCollision = aod::fwdtrack::collisionId;
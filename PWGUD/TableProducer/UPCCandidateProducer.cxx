@@ -75,8 +75,6 @@ struct UpcCandProducer {
                                      o2::aod::pidTPCFullEl, o2::aod::pidTPCFullMu, o2::aod::pidTPCFullPi, o2::aod::pidTPCFullKa, o2::aod::pidTPCFullPr,
                                      o2::aod::TOFSignal, o2::aod::pidTOFFullEl, o2::aod::pidTOFFullMu, o2::aod::pidTOFFullPi, o2::aod::pidTOFFullKa, o2::aod::pidTOFFullPr>;
 
-  typedef std::pair<uint64_t, std::vector<int64_t>> BCTracksPair;
-
   void init(InitContext&)
   {
     fwdSelectors.resize(upchelpers::kNFwdSels - 1, false);
@@ -462,18 +460,8 @@ struct UpcCandProducer {
     }
   }
 
-  void addTrack(std::vector<BCTracksPair>& v, uint64_t bc, int64_t trkId)
-  {
-    auto it = std::find_if(v.begin(), v.end(),
-                           [bc](const BCTracksPair& element) { return element.first == bc; });
-    if (it != v.end())
-      it->second.push_back(trkId);
-    else
-      v.emplace_back(std::make_pair(bc, std::vector<int64_t>({trkId})));
-  }
-
-  void collectBarrelTracks(std::vector<BCTracksPair>& bcsMatchedTrIdsA,
-                           std::vector<BCTracksPair>& bcsMatchedTrIdsB,
+  void collectBarrelTracks(upchelpers::BCTracksIndex& bcsMatchedTrIdsA,
+                           upchelpers::BCTracksIndex& bcsMatchedTrIdsB,
                            BCsWithBcSels const& bcs,
                            o2::aod::Collisions const& collisions,
                            BarrelTracks const& barrelTracks,
@@ -506,13 +494,15 @@ struct UpcCandProducer {
       bool needTOFWithITS = !upcCuts.getProduceITSITS() && upcCuts.getRequireITSTPC() && trk.hasTOF() && trk.hasITS() && trk.hasTPC();
       bool addToA = needITSITS || needAllTOF || needTOFWithITS;
       if (addToA)
-        addTrack(bcsMatchedTrIdsA, bc, trkId);
+        bcsMatchedTrIdsA.add(bc, trkId);
       if (fSearchITSTPC == 1 && !trk.hasTOF() && trk.hasITS() && trk.hasTPC())
-        addTrack(bcsMatchedTrIdsB, bc, trkId);
+        bcsMatchedTrIdsB.add(bc, trkId);
     }
+    bcsMatchedTrIdsA.build();
+    bcsMatchedTrIdsB.build();
   }
 
-  void collectForwardTracks(std::vector<BCTracksPair>& bcsMatchedTrIdsMID,
+  void collectForwardTracks(upchelpers::BCTracksIndex& bcsMatchedTrIdsMID,
                             BCsWithBcSels const& bcs,
                             o2::aod::Collisions const& collisions,
                             ForwardTracks const& fwdTracks,
@@ -540,52 +530,77 @@ struct UpcCandProducer {
       if (bc > fMaxBC)
         continue;
       if (nContrib <= upcCuts.getMaxNContrib())
-        addTrack(bcsMatchedTrIdsMID, bc, trkId);
+        bcsMatchedTrIdsMID.add(bc, trkId);
     }
+    bcsMatchedTrIdsMID.build();
   }
 
   int32_t searchTracks(uint64_t midbc, uint64_t range, uint32_t tracksToFind,
                        std::vector<int64_t>& tracks,
-                       std::vector<BCTracksPair>& v,
+                       const upchelpers::BCTracksIndex& v,
                        std::unordered_set<int64_t>& matchedTracks,
                        bool skipMidBC = false)
   {
     uint32_t count = 0;
     uint64_t left = midbc >= range ? midbc - range : 0;
     uint64_t right = fMaxBC >= midbc + range ? midbc + range : fMaxBC;
-    BCTracksPair dummyPair(left, {});
-    auto curit = std::lower_bound(v.begin(), v.end(), dummyPair,
-                                  [](const BCTracksPair& left, const BCTracksPair& right) { return left.first < right.first; });
-    if (curit == v.end()) // no ITS-TPC tracks nearby at all -> near last BCs
+    uint32_t nBCs = v.size();
+    uint32_t ibc = v.lowerBound(left);
+    if (ibc == nBCs) // no ITS-TPC tracks nearby at all -> near last BCs
       return -1;
-    uint64_t curbc = curit->first;
+    uint64_t curbc = v.bcs[ibc];
     while (curbc <= right) { // moving forward to midbc+range
       if (skipMidBC && curbc == midbc) {
-        ++curit;
-        if (curit == v.end())
+        ++ibc;
+        if (ibc == nBCs)
           break;
-        curbc = curit->first;
+        curbc = v.bcs[ibc];
       }
-      uint32_t size = curit->second.size();
+      uint32_t size = v.nTracks(ibc);
       if (size > 1) // too many tracks per BC -> possibly another event
         return -2;
       count += size;
       if (count > tracksToFind) // too many tracks nearby
         return -3;
-      if (matchedTracks.find(curit->second[0]) == matchedTracks.end()) {
-        tracks.push_back(curit->second[0]);
-        matchedTracks.insert(curit->second[0]);
+      int64_t trkId = v.trackIds[v.offsets[ibc]];
+      if (matchedTracks.find(trkId) == matchedTracks.end()) {
+        tracks.push_back(trkId);
+        matchedTracks.insert(trkId);
       }
-      ++curit;
-      if (curit == v.end())
+      ++ibc;
+      if (ibc == nBCs)
         break;
-      curbc = curit->first;
+      curbc = v.bcs[ibc];
     }
     if (count != tracksToFind)
       return -4;
     return 0; // found exactly tracksToFind tracks in [midbc - range, midbc + range]
   }
 
+  // adds ITS-TPC tracks found around bc to barrelTrackIDs, which holds nTOFtracks TOF tracks
+  // returns false if the BC has to be rejected
+  bool addITSTPCTracks(uint64_t bc, uint32_t nTOFtracks, bool skipMidBCIfComplete,
+                       std::vector<int64_t>& barrelTrackIDs,
+                       const upchelpers::BCTracksIndex& bcsMatchedTrIdsITSTPC,
+                       std::unordered_set<int64_t>& matchedTracks)
+  {
+    std::vector<int64_t> tracks;
+    tracks.reserve(fNBarProngs * 2); // precautions
+    if (nTOFtracks == fNBarProngs) { // check for ITS-TPC tracks
+      int32_t res = searchTracks(bc, fSearchRangeITSTPC, 0, tracks, bcsMatchedTrIdsITSTPC, matchedTracks, skipMidBCIfComplete);
+      if (res < 0) // too many tracks nearby -> rejecting
+        return false;
+    }
+    if (nTOFtracks < fNBarProngs && !upcCuts.getRequireTOF()) { // add ITS-TPC track if needed
+      uint32_t tracksToFind = fNBarProngs - nTOFtracks;
+      int32_t res = searchTracks(bc, fSearchRangeITSTPC, tracksToFind, tracks, bcsMatchedTrIdsITSTPC, matchedTracks, true);
+      if (res < 0) // too many or not enough tracks nearby -> rejecting
+        return false;
+      barrelTrackIDs.insert(barrelTrackIDs.end(), tracks.begin(), tracks.end());
+    }
+    return true;
+  }
+
   void createCandidatesCentral(BarrelTracks const& barrelTracks,
                                o2::aod::AmbiguousTracks const& ambBarrelTracks,
                                BCsWithBcSels const& bcs,
@@ -597,9 +612,9 @@ struct UpcCandProducer {
   {
     fMaxBC = bcs.iteratorAt(bcs.size() - 1).globalBC(); // restrict ITS-TPC track search to [0, fMaxBC]
 
-    // pairs of global BCs and vectors of matched track IDs:
-    std::vector<BCTracksPair> bcsMatchedTrIdsTOF;
-    std::vector<BCTracksPair> bcsMatchedTrIdsITSTPC;
+    // global BCs and matched track IDs:
+    upchelpers::BCTracksIndex bcsMatchedTrIdsTOF;
+    upchelpers::BCTracksIndex bcsMatchedTrIdsITSTPC;
 
     // trackID -> index in amb. track table
     std::unordered_map<int64_t, uint64_t> ambBarrelTrBCs;
@@ -610,42 +625,8 @@ struct UpcCandProducer {
                         barrelTracks, ambBarrelTracks, ambBarrelTrBCs);
 
     uint32_t nBCsWithITSTPC = bcsMatchedTrIdsITSTPC.size();
-
-    std::sort(bcsMatchedTrIdsTOF.begin(), bcsMatchedTrIdsTOF.end(),
-              [](const auto& left, const auto& right) { return left.first < right.first; });
-    std::sort(bcsMatchedTrIdsITSTPC.begin(), bcsMatchedTrIdsITSTPC.end(),
-              [](const auto& left, const auto& right) { return left.first < right.first; });
-
-    if (nBCsWithITSTPC > 0 && fSearchITSTPC == 1) {
-      std::unordered_set<int64_t> matchedTracks;
-      for (auto& pair : bcsMatchedTrIdsTOF) {
-        uint64_t bc = pair.first;
-        auto& trackIds = pair.second;
-        uint32_t nTOFtracks = trackIds.size();
-        if (nTOFtracks > fNBarProngs) // too many TOF tracks?!
-          continue;
-        if (nTOFtracks == fNBarProngs) { // check for ITS-TPC tracks
-          std::vector<int64_t> tracks;
-          tracks.reserve(fNBarProngs * 2); // precautions
-          int32_t res = searchTracks(bc, fSearchRangeITSTPC, 0, tracks, bcsMatchedTrIdsITSTPC, matchedTracks, true);
-          if (res < 0) { // too many tracks nearby -> rejecting
-            trackIds.push_back(0);
-            continue;
-          }
-        }
-        if (nTOFtracks < fNBarProngs && !upcCuts.getRequireTOF()) { // add ITS-TPC track if needed
-          uint32_t tracksToFind = fNBarProngs - nTOFtracks;
-          std::vector<int64_t> tracks;
-          tracks.reserve(fNBarProngs * 2); // precautions
-          int32_t res = searchTracks(bc, fSearchRangeITSTPC, tracksToFind, tracks, bcsMatchedTrIdsITSTPC, matchedTracks, true);
-          if (res < 0) // too many or not enough tracks nearby -> rejecting
-            continue;
-          trackIds.insert(trackIds.end(), tracks.begin(), tracks.end());
-        }
-      }
-    }
-
-    bcsMatchedTrIdsITSTPC.clear();
+    uint32_t nBCsWithTOF = bcsMatchedTrIdsTOF.size();
+    bool searchITSTPC = nBCsWithITSTPC > 0 && fSearchITSTPC == 1;
 
     // todo: calculate position of UD collision?
     float dummyX = 0.;
@@ -662,16 +643,26 @@ struct UpcCandProducer {
     int32_t runNumber = bcs.iteratorAt(0).runNumber();
 
     // storing n-prong matches
+    // ITS-TPC tracks are matched to the TOF BCs in increasing BC order, so that each ITS-TPC track is used once
+    std::unordered_set<int64_t> matchedTracks;
+    std::vector<int64_t> barrelTrackIDs;
+    barrelTrackIDs.reserve(fNBarProngs * 2);
     int32_t candID = 0;
-    for (const auto& item : bcsMatchedTrIdsTOF) {
-      auto& barrelTrackIDs = item.second;
+    for (uint32_t ibc = 0; ibc < nBCsWithTOF; ++ibc) {
+      uint64_t bc = bcsMatchedTrIdsTOF.bcs[ibc];
+      uint32_t nTOFtracks = bcsMatchedTrIdsTOF.nTracks(ibc);
+      if (nTOFtracks > fNBarProngs) // too many TOF tracks?!
+        continue;
+      barrelTrackIDs.clear();
+      bcsMatchedTrIdsTOF.appendTracks(ibc, barrelTrackIDs);
+      if (searchITSTPC && !addITSTPCTracks(bc, nTOFtracks, true, barrelTrackIDs, bcsMatchedTrIdsITSTPC, matchedTracks))
+        continue;
       uint16_t numContrib = barrelTrackIDs.size();
       // sanity check
       if (numContrib != fNBarProngs)
         continue;
       // fetching FT0, FDD, FV0 information
       // if there is no relevant signal, dummy info will be used
-      uint64_t bc = item.first;
       upchelpers::FITInfo fitInfo{};
       processFITInfo(fitInfo, bc, indexBCglId, bcs, ft0s, fdds, fv0as);
       if (fFilterFT0) {
@@ -724,10 +715,10 @@ struct UpcCandProducer {
 
     fMaxBC = bcs.iteratorAt(bcs.size() - 1).globalBC(); // restrict ITS-TPC track search to [0, fMaxBC]
 
-    // pairs of global BCs and vectors of matched track IDs:
-    std::vector<BCTracksPair> bcsMatchedTrIdsTOF;
-    std::vector<BCTracksPair> bcsMatchedTrIdsITSTPC;
-    std::vector<BCTracksPair> bcsMatchedTrIdsMID;
+    // global BCs and matched track IDs:
+    upchelpers::BCTracksIndex bcsMatchedTrIdsTOF;
+    upchelpers::BCTracksIndex bcsMatchedTrIdsITSTPC;
+    upchelpers::BCTracksIndex bcsMatchedTrIdsMID;
 
     // trackID -> index in amb. track table
     std::unordered_map<int64_t, uint64_t> ambBarrelTrBCs;
@@ -749,60 +740,7 @@ struct UpcCandProducer {
 
     uint32_t nBCsWithITSTPC = bcsMatchedTrIdsITSTPC.size();
     uint32_t nBCsWithMID = bcsMatchedTrIdsMID.size();
-
-    std::sort(bcsMatchedTrIdsMID.begin(), bcsMatchedTrIdsMID.end(),
-              [](const auto& left, const auto& right) { return left.first < right.first; });
-
-    std::vector<BCTracksPair> bcsMatchedTrIdsTOFTagged(nBCsWithMID);
-    for (const auto& pair : bcsMatchedTrIdsTOF) {
-      uint64_t bc = pair.first;
-      auto it = std::find_if(bcsMatchedTrIdsMID.begin(), bcsMatchedTrIdsMID.end(),
-                             [bc](const auto& item) { return item.first == bc; });
-      if (it != bcsMatchedTrIdsMID.end()) {
-        uint32_t ibc = it - bcsMatchedTrIdsMID.begin();
-        bcsMatchedTrIdsTOFTagged[ibc].second = pair.second;
-      }
-    }
-
-    bcsMatchedTrIdsTOF.clear();
-
-    std::sort(bcsMatchedTrIdsITSTPC.begin(), bcsMatchedTrIdsITSTPC.end(),
-              [](const auto& left, const auto& right) { return left.first < right.first; });
-
-    if (nBCsWithITSTPC > 0 && fSearchITSTPC == 1) {
-      std::unordered_set<int64_t> matchedTracks;
-      for (uint32_t ibc = 0; ibc < nBCsWithMID; ++ibc) {
-        auto& pairMID = bcsMatchedTrIdsMID[ibc];
-        auto& pairTOF = bcsMatchedTrIdsTOFTagged[ibc];
-        uint64_t bc = pairMID.first;
-        auto& trackIdsMID = pairMID.second;
-        auto& trackIdsTOF = pairTOF.second;
-        uint32_t nMIDtracks = trackIdsMID.size();
-        uint32_t nTOFtracks = trackIdsTOF.size();
-        if (nMIDtracks > fNFwdProngs || nTOFtracks > fNBarProngs) // too many MID and/or TOF tracks?!
-          continue;
-        if (nMIDtracks == fNFwdProngs && nTOFtracks == fNBarProngs) { // check for ITS-TPC tracks
-          std::vector<int64_t> tracks;
-          tracks.reserve(fNBarProngs * 2); // precautions
-          int32_t res = searchTracks(bc, fSearchRangeITSTPC, 0, tracks, bcsMatchedTrIdsITSTPC, matchedTracks, false);
-          if (res < 0) { // too many tracks nearby -> rejecting
-            trackIdsTOF.push_back(0);
-            continue;
-          }
-        }
-        if (nMIDtracks == fNFwdProngs && nTOFtracks < fNBarProngs && !upcCuts.getRequireTOF()) { // add ITS-TPC track if needed
-          uint32_t tracksToFind = fNBarProngs - nTOFtracks;
-          std::vector<int64_t> tracks;
-          tracks.reserve(fNBarProngs * 2); // precautions
-          int32_t res = searchTracks(bc, fSearchRangeITSTPC, tracksToFind, tracks, bcsMatchedTrIdsITSTPC, matchedTracks, true);
-          if (res < 0) // too many or not enough tracks nearby -> rejecting
-            continue;
-          trackIdsTOF.insert(trackIdsTOF.end(), tracks.begin(), tracks.end());
-        }
-      }
-    }
-
-    bcsMatchedTrIdsITSTPC.clear();
+    bool searchITSTPC = nBCsWithITSTPC > 0 && fSearchITSTPC == 1;
 
     // todo: calculate position of UD collision?
     float dummyX = 0.;
@@ -819,13 +757,26 @@ struct UpcCandProducer {
     int32_t runNumber = bcs.iteratorAt(0).runNumber();
 
     // storing n-prong matches
+    // ITS-TPC tracks are matched to the MID BCs in increasing BC order, so that each ITS-TPC track is used once
+    std::unordered_set<int64_t> matchedTracks;
+    std::vector<int64_t> fwdTrackIDs;
+    std::vector<int64_t> barrelTrackIDs;
+    barrelTrackIDs.reserve(fNBarProngs * 2);
     int32_t candID = 0;
     for (uint32_t ibc = 0; ibc < nBCsWithMID; ++ibc) {
-      auto& pairMID = bcsMatchedTrIdsMID[ibc];
-      auto& pairTOF = bcsMatchedTrIdsTOFTagged[ibc];
-      auto& fwdTrackIDs = pairMID.second;
-      auto& barrelTrackIDs = pairTOF.second;
-      uint32_t nMIDtracks = fwdTrackIDs.size();
+      uint64_t bc = bcsMatchedTrIdsMID.bcs[ibc];
+      int32_t ibcTOF = bcsMatchedTrIdsTOF.find(bc); // TOF tracks in the same BC
+      uint32_t nMIDtracks = bcsMatchedTrIdsMID.nTracks(ibc);
+      uint32_t nTOFtracks = ibcTOF < 0 ? 0 : bcsMatchedTrIdsTOF.nTracks(ibcTOF);
+      if (nMIDtracks > fNFwdProngs || nTOFtracks > fNBarProngs) // too many MID and/or TOF tracks?!
+        continue;
+      barrelTrackIDs.clear();
+      if (ibcTOF >= 0)
+        bcsMatchedTrIdsTOF.appendTracks(ibcTOF, barrelTrackIDs);
+      if (searchITSTPC && nMIDtracks == fNFwdProngs && !addITSTPCTracks(bc, nTOFtracks, false, barrelTrackIDs, bcsMatchedTrIdsITSTPC, matchedTracks))
+        continue;
+      fwdTrackIDs.clear();
+      bcsMatchedTrIdsMID.appendTracks(ibc, fwdTrackIDs);
       uint32_t nBarrelTracks = barrelTrackIDs.size(); // TOF + ITS-TPC tracks
       uint16_t numContrib = nBarrelTracks + nMIDtracks;
       // sanity check
@@ -833,7 +784,6 @@ struct UpcCandProducer {
         continue;
       // fetching FT0, FDD, FV0 information
       // if there is no relevant signal, dummy info will be used
-      uint64_t bc = pairMID.first;
       upchelpers::FITInfo fitInfo{};
       processFITInfo(fitInfo, bc, indexBCglId, bcs, ft0s, fdds, fv0as);
       if (fFilterFT0) {
@@ -867,7 +817,7 @@ struct UpcCandProducer {
     ambFwdTrBCs.clear();
     bcsMatchedTrIdsMID.clear();
     ambBarrelTrBCs.clear();
-    bcsMatchedTrIdsTOFTagged.clear();
+    bcsMatchedTrIdsTOF.clear();
   }
 
   // data processors